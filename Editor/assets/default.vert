@@ -2,11 +2,15 @@
 
 in vec3 position;
 
-uniform mat4 model_matrix;
-uniform mat4 view_matrix;
-uniform mat4 projection_matrix;
+in mat4 instance_model_matrix;
+layout(std140) uniform CameraBlock {
+    mat4 view_matrix;
+    mat4 projection_matrix;
+    float screen_width;
+    float screen_height;
+};
 
 void main()
 {
-    gl_Position = projection_matrix * view_matrix * model_matrix * vec4(position, 1.0);
+    gl_Position = projection_matrix * view_matrix * instance_model_matrix * vec4(position, 1.0);
 }
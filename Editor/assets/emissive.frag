@@ -10,15 +10,23 @@ in vec2 UV;
 out vec4 frag_color;
 
 // Built-in Variables
-uniform vec3 point_light_ambient[4];
-uniform vec3 point_light_intensity[4];
-uniform vec3 point_light_position[4];
-uniform float point_light_atten_quad[4];
-uniform float point_light_atten_linear[4];
-uniform float point_light_atten_const[4];
-uniform vec3 dir_light_ambient[4];
-uniform vec3 dir_light_intensity[4];
-uniform vec3 dir_light_direction[4];
+layout(std140) uniform LightBlock {
+    vec3 dir_light_ambient[4];
+    vec3 dir_light_intensity[4];
+    vec3 dir_light_direction[4];
+    vec3 point_light_ambient[4];
+    vec3 point_light_intensity[4];
+    vec3 point_light_position[4];
+    float point_light_atten_const[4];
+    float point_light_atten_linear[4];
+    float point_light_atten_quad[4];
+    vec3 area_light_ambient[4];
+    vec3 area_light_intensity[4];
+    vec3 area_light_position[4];
+    float area_light_atten_const[4];
+    float area_light_atten_linear[4];
+    float area_light_atten_quad[4];
+};
 
 // User-defined Variables
 uniform vec3 Color;
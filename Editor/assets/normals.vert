@@ -6,8 +6,12 @@ in vec3 normal;
 out vec4 exploded;
 
 uniform mat4 model_matrix;
-uniform mat4 view_matrix;
-uniform mat4 projection_matrix;
+layout(std140) uniform CameraBlock {
+    mat4 view_matrix;
+    mat4 projection_matrix;
+    float screen_width;
+    float screen_height;
+};
 uniform float NormalLength;
 
 void main()
@@ -20,16 +20,12 @@
 Curve::Curve(CurvesPlot& parent_plot) :
     parent_plot_(&parent_plot),
     graph_(parent_plot.addGraph()),
-    tracer_(new QCPItemTracer(&parent_plot)),
     curve_type_(CurveType::Linear),
     visible_(false),
     wrap_curve_(false),
     animation_length_(parent_plot.GetAnimationLength())
 {
     graph_->setAntialiased(true);
-    tracer_->setGraph(graph_);
-    tracer_->setStyle(QCPItemTracer::tsNone);
-    tracer_->setInterpolating(true);
 
     // Listen for changes in the animation length
     parent_plot.AnimationLengthChanged.Connect(this, &Curve::OnAnimationLengthChanged);
@@ -39,9 +35,8 @@ Curve::Curve(CurvesPlot& parent_plot) :
 }
 
 float Curve::SampleAt(float t) const {
-    tracer_->setGraphKey(t);
-    parent_plot_->replot(); // Necessary to update the tracer's position
-    return tracer_->position->value();
+    std::shared_ptr<const CompiledCurve> compiled = std::atomic_load(&compiled_);
+    return compiled ? compiled->Sample(t) : 0.f;
 }
 
 std::vector<Keyframe*> Curve::GetKeyframes() const {
@@ -179,6 +174,7 @@ void Curve::GenerateCurve() {
         y[i] = evaluated_pts[i].y;
     }
     graph_->setData(x, y);
+    std::atomic_store(&compiled_, std::shared_ptr<const CompiledCurve>(new CompiledCurve(evaluated_pts)));
 
     parent_plot_->replot();
     delete curve_evaluator;
@@ -13,12 +13,12 @@
 #include <animator.h>
 #include <animation/curvesampler.h>
 #include <animation/curveevaluator.h>
+#include <animation/compiledcurve.h>
 
 class QRectF;
 class CurvesPlot;
 class ControlPoint;
 class QCPGraph;
-class QCPItemTracer;
 
 // TODO: Add discrete curves that use integral values of y.
 // TODO: Add binary curves that only use values 0 and 1 for y.
@@ -27,7 +27,7 @@ public:
     // Curve is hidden by default
     Curve(CurvesPlot& parent_plot);
 
-    // Samples the splined curve at time t.
+    // Samples the splined curve at time t, without touching the plot. Safe to call from any thread.
     virtual float SampleAt(float t) const override;
 
     // Returns a vector of Control Points representing Keyframe<time, value>
@@ -94,7 +94,8 @@ protected:
     std::set<ControlPoint*> hidden_points_;
     CurvesPlot* parent_plot_;
     QCPGraph* graph_;
-    QCPItemTracer* tracer_;
+    // Replaced whole by GenerateCurve, so samplers on other threads keep a consistent copy
+    std::shared_ptr<const CompiledCurve> compiled_;
     CurveType curve_type_;
     bool visible_;
     bool wrap_curve_;
@@ -324,7 +324,7 @@ void GizmoManager::ObjectTranslated(int x, int y)
     SceneObject* selected_object = GetManipulatedObject();
     glm::vec3 translation;
     translator_->TranslationUpdate(x, y, translation);
-    glm::mat4 world2obj = glm::inverse(selected_object->GetParentModelMatrix());
+    const glm::mat4& world2obj = selected_object->GetParent()->GetInverseModelMatrix();
     glm::vec4 local_translation = world2obj*glm::vec4(translation, 0);
     selected_object->GetTransform().Translate(local_translation, Space::World);
 }
@@ -356,7 +356,7 @@ void GizmoManager::ObjectRotated(int x, int y)
     glm::vec3 axis;
     SceneObject* selected_object = GetManipulatedObject();
     rotator_->RotationUpdate(x, y, axis, angle);
-    glm::mat4 world2obj = glm::inverse(selected_object->GetModelMatrix());
+    const glm::mat4& world2obj = selected_object->GetInverseModelMatrix();
     glm::vec4 local_rotation_axis = glm::normalize(world2obj*glm::vec4(axis,0));
     selected_object->GetTransform().Rotate(local_rotation_axis, angle);
 }
@@ -48,7 +48,8 @@ MainWindow::MainWindow(QWidget *parent) :
     selected_object_(nullptr),
     ui(new Ui::MainWindow),
     actions_(this),
-    hierarchy_context_menu_(new QMenu(tr("Hierarchy Context Menu"), this))
+    hierarchy_context_menu_(new QMenu(tr("Hierarchy Context Menu"), this)),
+    asset_load_timer_(new QTimer(this))
 {
     // Creates the widgets from the .ui designer file
     ui->setupUi(this);
@@ -85,6 +86,11 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(&hierarchy_, &HierarchyView::InspectableAdded, &inspector_, &Inspector::OnAddInspectable);
     connect(&assets_, &AssetBrowser::InspectableSelected, &inspector_, &Inspector::OnSelectInspectable);
     connect(&assets_, &AssetBrowser::InspectableAdded, &inspector_, &Inspector::OnAddInspectable);
+    connect(asset_load_timer_, &QTimer::timeout, this, [this]() {
+        // Placeholders are swapped for the loaded assets here, on the GUI thread
+        if (scene_ != nullptr && scene_->GetAssetManager().PublishLoads() > 0) RedrawSceneViews();
+    });
+    asset_load_timer_->start(16);
 
     // Dock Widget stuff
     setTabPosition(Qt::TopDockWidgetArea, QTabWidget::North);
@@ -485,17 +491,20 @@ void MainWindow::SetScene(Scene& scene) {
         // Disable filtering if there is no selected object with a mesh on it
         if (obj == nullptr) {
             actions_["Filter Selected"]->setDisabled(true);
+            actions_["Taubin Smooth Selected"]->setDisabled(true);
             actions_["Flip Normals on Selected"]->setDisabled(true);
             actions_["Export Mesh"]->setDisabled(true);
         } else {
             Geometry* geo = obj->GetComponent<Geometry>();
             if (geo == nullptr || geo->GetRenderMesh() == nullptr) {
                 actions_["Filter Selected"]->setDisabled(true);
+                actions_["Taubin Smooth Selected"]->setDisabled(true);
                 actions_["Flip Normals on Selected"]->setDisabled(true);
                 actions_["Export Mesh"]->setDisabled(true);
             } else {
                 TriangleMesh* trimesh = obj->GetComponent<TriangleMesh>();
                 actions_["Filter Selected"]->setDisabled(trimesh == nullptr);
+                actions_["Taubin Smooth Selected"]->setDisabled(trimesh == nullptr);
                 actions_["Flip Normals on Selected"]->setDisabled(trimesh == nullptr);
                 actions_["Export Mesh"]->setDisabled(false);
             }
@@ -857,6 +866,19 @@ void MainWindow::CreateAssetsActions() {
         }
     });
 
+    // Smooths without shrinking, one step per trigger
+    QAction *taubin_smooth_action = actions_.CreateAction("Taubin Smooth Selected");
+    connect(taubin_smooth_action, &QAction::triggered, this, [this] {
+        TriangleMesh* geo = selected_object_->GetComponent<TriangleMesh>();
+        Mesh* mesh = geo->MeshFilter.Get();
+        std::string name = "Smoothed " + mesh->GetName();
+        Mesh* filtered_mesh = scene_->GetAssetManager().CreateMesh(name, MeshType::Triangles, true, false);
+        if (filtered_mesh == nullptr) filtered_mesh = scene_->GetAssetManager().GetMesh(name);
+        MeshProcessing::TaubinFilterMesh(*mesh, *filtered_mesh);
+        geo->MeshFilter.Set(filtered_mesh);
+        RedrawSceneViews();
+    });
+
     QAction *flip_normals_action = actions_.CreateAction("Flip Normals on Selected");
     connect(flip_normals_action, &QAction::triggered, this, [this] {
         TriangleMesh* geo = selected_object_->GetComponent<TriangleMesh>();
@@ -1071,6 +1093,16 @@ void MainWindow::CreateSceneObjectsActions() {
         hierarchy_.SelectObject(new_node);
     });
 
+    QAction *add_mesh_collider_action = actions_.CreateAction("Add Mesh Collider to selected");
+    add_mesh_collider_action->setToolTip(tr("Collide particles with the mesh of the selected SceneObject"));
+    connect(add_mesh_collider_action, &QAction::triggered, this, [this] {
+        SceneObject* selected_object = hierarchy_.GetSelectedSceneObject();
+        if (selected_object && selected_object->GetComponent<Geometry>() && !selected_object->GetComponent<MeshCollider>()) {
+            selected_object->AddComponent<MeshCollider>();
+        }
+    });
+    addAction(add_mesh_collider_action);
+
     QAction *add_armprop_action = actions_.CreateAction("Add Robot Arm Property to selected");
     add_armprop_action->setToolTip(tr("Add a Robot Arm Property to the selected SceneObject"));
     connect(add_armprop_action, &QAction::triggered, this, [this] {
@@ -1293,6 +1325,7 @@ void MainWindow::CreateMenus() {
     asset_menu_->addAction(actions_["Export Mesh"]);
     QMenu* asset_process_mesh_menu_ = asset_menu_->addMenu(tr("Mesh Processing"));
     asset_process_mesh_menu_->addAction(actions_["Filter Selected"]);
+    asset_process_mesh_menu_->addAction(actions_["Taubin Smooth Selected"]);
     asset_process_mesh_menu_->addAction(actions_["Flip Normals on Selected"]);
     asset_menu_->addAction(actions_["Reload Assets"]);
 
@@ -1319,6 +1352,7 @@ void MainWindow::CreateMenus() {
     object_colliders_menu_->addAction(actions_["Create Sphere Collider"]);
     object_colliders_menu_->addAction(actions_["Create Plane Collider"]);
     object_colliders_menu_->addAction(actions_["Create Cylinder Collider"]);
+    object_colliders_menu_->addAction(actions_["Add Mesh Collider to selected"]);
     object_menu_->addSeparator();
     object_menu_->addAction(actions_["Add Robot Arm Property to selected"]);
     object_menu_->addAction(actions_["Add Customized Property to selected"]);
@@ -23,6 +23,7 @@
 #include <QMainWindow>
 #include <QProcess>
 #include <QSplitter>
+#include <QTimer>
 #include <scene/scenemanager.h>
 #include <scene/translator.h>
 #include <actionmanager.h>
@@ -76,6 +77,7 @@ protected:
     QSplitter* hsplit1_;
     QSplitter* hsplit2_;
     QMenu* hierarchy_context_menu_;
+    QTimer* asset_load_timer_; // Publishes assets loaded in the background
 
     void ShowSplit();
     void HideSplit();
@@ -18,6 +18,7 @@
 #include <scene/sceneobject.h>
 #include <scene/components/camera.h>
 #include <opengl/glrenderer.h>
+#include <QOpenGLContext>
 #include <trace/raytracer.h>
 
 RenderView::RenderView(QWidget* parent) :
@@ -37,10 +38,20 @@ void RenderView::SaveFrame(Scene& scene, SceneObject& rendercam, std::string out
     scene_ = &scene;
     render_cam_ = &rendercam;
     trace_ = trace;
+    // Frames are saved straight after loading a scene, so its assets mustn't still be placeholders
+    scene.WaitUntilLoaded();
 
     if (trace) {
-        // automatically starts drawing on other threads
-        tracer_.reset(new RayTracer(scene, rendercam));
+        // The old tracer shares the trace scene and may still be tracing it, so it's cancelled and joined first
+        tracer_.reset();
+        tracer_.reset(new RayTracer(scene, rendercam, trace_scene_));
+        trace_scene_ = tracer_->GetTraceScene();
+        tracer_->ScenePrepared.Connect(this, &RenderView::OnTraceStageFinished);
+        tracer_->PreviewFinished.Connect(this, &RenderView::OnTraceStageFinished);
+        tracer_->PassFinished.Connect(this, &RenderView::OnTracePassFinished);
+        tracer_->RenderFinished.Connect(this, &RenderView::OnTraceStageFinished);
+        // Only once every stage signal is connected, as the pipeline emits them from its own thread
+        tracer_->Start();
 
         //if window is closed, tracer_ is deleted
         while(tracer_!=nullptr && tracer_->GetProgress() < 100) {
@@ -67,16 +78,20 @@ void RenderView::SaveFrame(Scene& scene, SceneObject& rendercam, std::string out
             } else {
                 cnv.scaled(rwidth, rheight).save(rfile);
             }
+            if (trace && cam->TraceSaveHDR.Get() && !tracer_->SaveHDR(output_filename + ".pfm")) {
+                Debug::Log.WriteLine("Failed to write " + output_filename + ".pfm", Priority::Error);
+            }
         }
 }
 
 void RenderView::Cancel() {
     tracer_.reset(nullptr);
+    trace_scene_.reset();
 }
 
 void RenderView::mousePressEvent(QMouseEvent *event)
 {
-    if (tracer_) {
+    if (tracer_ && tracer_->IsSceneReady()) {
         tracer_->ComputePixel(event->x(), height()-event->y(), render_cam_->GetComponent<Camera>());
     }
 
@@ -89,14 +104,36 @@ void RenderView::mousePressEvent(QMouseEvent *event)
     qw->RedrawSceneViews();
 }
 
+void RenderView::OnTraceStageFinished() {
+    QMetaObject::invokeMethod(this, "update", Qt::QueuedConnection);
+}
+
+void RenderView::OnTracePassFinished(unsigned int) {
+    QMetaObject::invokeMethod(this, "update", Qt::QueuedConnection);
+}
+
 void RenderView::ContextChanged(bool) {
     renderer_->ContextChanged();
     blitter_.reset();
     update();
 }
 
+RenderView::~RenderView() {
+    ReleaseGLObjects();
+    // QOpenGLWidget destroys the context after the renderer is gone, so it mustn't call back in here
+    if (context()) disconnect(context(), &QOpenGLContext::aboutToBeDestroyed, this, &RenderView::ReleaseGLObjects);
+}
+
+void RenderView::ReleaseGLObjects() {
+    makeCurrent();
+    renderer_->ReleaseGLObjects();
+    doneCurrent();
+}
+
 void RenderView::initializeGL() {
     renderer_->Initialize();
+    // Moving the widget to another window replaces its context
+    connect(context(), &QOpenGLContext::aboutToBeDestroyed, this, &RenderView::ReleaseGLObjects);
 }
 
 void RenderView::paintGL() {
@@ -131,7 +168,12 @@ void RenderView::paintGL() {
 
         glPixelStorei(GL_UNPACK_ALIGNMENT, 1); //this took way too long to figure out
 
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, tracer_->settings.width, tracer_->settings.height, 0, GL_RGB, GL_UNSIGNED_BYTE, tracer_->buffer);
+        if (camera->TraceShowSampleHeatmap.Get()) {
+            std::vector<uint8_t> heatmap = tracer_->GetSampleHeatmap();
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, tracer_->settings.width, tracer_->settings.height, 0, GL_RGB, GL_UNSIGNED_BYTE, heatmap.data());
+        } else {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, tracer_->settings.width, tracer_->settings.height, 0, GL_RGB, GL_UNSIGNED_BYTE, tracer_->buffer);
+        }
         // Set texture properties
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -28,6 +28,7 @@ class RenderView : public QOpenGLWidget {
 
 public:
     RenderView(QWidget* parent = nullptr);
+    ~RenderView();
     void SaveFrame(Scene& scene, SceneObject& rendercam, std::string output_filename, bool trace);
     void Cancel();
 
@@ -44,9 +45,17 @@ private:
     bool trace_;
     std::unique_ptr<QOpenGLTextureBlitter> blitter_;
     std::unique_ptr<RayTracer> tracer_;
+    // Kept between frames so the tracer only refits what moved
+    std::shared_ptr<TraceScene> trace_scene_;
 
     void initializeGL() override;
     void paintGL() override;
+    // Frees the renderer's own GL objects while this widget's context is current, before the context goes away
+    void ReleaseGLObjects();
+
+    // Tracer pipeline slots, called on the tracer's thread so they only queue a repaint
+    void OnTraceStageFinished();
+    void OnTracePassFinished(unsigned int pass);
 };
 
 #endif // RENDERVIEW_H
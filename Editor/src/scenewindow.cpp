@@ -12,6 +12,7 @@
 #include <scenewindow.h>
 #include <scene/components/camera.h>
 #include <opengl/glrenderer.h>
+#include <QOpenGLContext>
 #include <QMouseEvent>
 #include <QSurface>
 #include <QVBoxLayout>
@@ -21,6 +22,8 @@
 #include <QApplication>
 #include <QDesktopWidget>
 #include <QFileDialog>
+#include <QLabel>
+#include <QElapsedTimer>
 #include <widgets/filepicker.h>
 
 std::map<int, glm::vec3> cameraControls = {
@@ -116,11 +119,24 @@ SceneWindow::SceneWindow(QVBoxLayout& managing_layout, QWidget *parent) :
     colliders_action->setChecked(true);
     connect(colliders_action, &QAction::triggered, this, [this](bool checked) { renderer_->DisplayColliders(checked); Redraw(); });
 
+    // Frame rate and culling counts, drawn over the view
+    stats_label_ = new QLabel(this);
+    stats_label_->setStyleSheet("QLabel{color:white; background:rgba(0,0,0,128); padding:2px;}");
+    stats_label_->move(4, 4);
+    stats_label_->setAttribute(Qt::WA_TransparentForMouseEvents);
+    stats_label_->hide();
+    QAction* stats_action = new QAction(tr("Statistics"), this);
+    stats_action->setCheckable(true);
+    stats_action->setChecked(false);
+    connect(stats_action, &QAction::triggered, this, [this](bool checked) { stats_label_->setVisible(checked); Redraw(); });
+
     QMenu* gizmos_menu = new QMenu(tr("Display"), this);
     QAction* display_action = new QAction(tr("Display"), this);
     gizmos_menu->addAction(lights_action);
     gizmos_menu->addAction(camera_action);
     gizmos_menu->addAction(colliders_action);
+    gizmos_menu->addSeparator();
+    gizmos_menu->addAction(stats_action);
 
     // Camera Menu
     render_cam_menu = new QMenu(tr("Render Camera"), this);
@@ -293,8 +309,22 @@ void SceneWindow::SetScene(Scene& scene, SceneCamera* camera) {
     Redraw();
 }
 
+SceneWindow::~SceneWindow() {
+    ReleaseGLObjects();
+    // QOpenGLWidget destroys the context after the renderer is gone, so it mustn't call back in here
+    if (context()) disconnect(context(), &QOpenGLContext::aboutToBeDestroyed, this, &SceneWindow::ReleaseGLObjects);
+}
+
+void SceneWindow::ReleaseGLObjects() {
+    makeCurrent();
+    renderer_->ReleaseGLObjects();
+    doneCurrent();
+}
+
 void SceneWindow::initializeGL() {
     renderer_->Initialize();
+    // Moving the widget to another window replaces its context
+    connect(context(), &QOpenGLContext::aboutToBeDestroyed, this, &SceneWindow::ReleaseGLObjects);
     InitializeFrameBuffers();
 }
 
@@ -408,6 +438,8 @@ void SceneWindow::RemoveVertexController() {
 
 
 void SceneWindow::paintGL() {
+    QElapsedTimer frame_timer;
+    frame_timer.start();
     glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
 
     // Clear the buffer
@@ -448,6 +480,9 @@ void SceneWindow::paintGL() {
     // Render the scene root
     renderer_->SetMaterialOverride(nullptr);
     renderer_->RenderNode(scene_->GetSceneRoot(), view, proj, dimensions);
+    GLRenderer::CullingStats view_stats = renderer_->GetPassStats();
+    GLRenderer::CullingStats frame_stats = renderer_->GetFrameStats();
+    GLRenderer::RenderQueueStats queue_stats = renderer_->GetQueueStats();
 
     // Render the selected object
     if (render_selected_ && selected_object_ > 0) {
@@ -532,6 +567,23 @@ void SceneWindow::paintGL() {
     glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
 
     renderer_->SetMaterialOverride(nullptr);
+
+    if (stats_label_->isVisible()) {
+        // The rate frames could be drawn at, the view is only redrawn when something changes
+        double frame_ms = std::max(frame_timer.nsecsElapsed() * 1e-6, 1e-3);
+        double fps = fps_counter_.GetAverageFPS(1000.0 / frame_ms);
+        GLResourceManager::MemoryStats memory_stats = renderer_->GetMemoryStats();
+        stats_label_->setText(QString("%1 fps (%2 ms)\nView: %3 drawn, %4 culled\nFrame: %5 drawn, %6 culled\n"
+                                      "Draw calls: %7, state changes: %8, instances: %9")
+                              .arg(fps, 0, 'f', 0).arg(frame_ms, 0, 'f', 2)
+                              .arg(view_stats.drawn).arg(view_stats.culled)
+                              .arg(frame_stats.drawn).arg(frame_stats.culled)
+                              .arg(queue_stats.draw_calls).arg(queue_stats.state_changes).arg(queue_stats.instances)
+                              + QString("\nGPU memory: meshes %1 MB, textures %2 MB, cubemaps %3 MB, targets %4 MB")
+                              .arg(memory_stats.meshes / 1048576.0, 0, 'f', 1).arg(memory_stats.textures / 1048576.0, 0, 'f', 1)
+                              .arg(memory_stats.cubemaps / 1048576.0, 0, 'f', 1).arg(memory_stats.render_targets / 1048576.0, 0, 'f', 1));
+        stats_label_->adjustSize();
+    }
 }
 
 void SceneWindow::keyPressEvent(QKeyEvent *event) {
@@ -21,6 +21,7 @@
 #include <QMenuBar>
 #include <QVBoxLayout>
 #include <QTimer>
+#include <QLabel>
 #include <widgets/menutoolbutton.h>
 #include <gizmomanager.h>
 #include <opengl/glrenderer.h>
@@ -41,6 +42,7 @@ public:
     };
 
     SceneWindow(QVBoxLayout& managing_layout, QWidget *parent = nullptr);
+    ~SceneWindow();
 
     void ShowNormals(bool show);
     void ShowSelected(bool show);
@@ -59,6 +61,8 @@ public:
 protected:
     void initializeGL() override;
     void resizeGL(int w, int h) override;
+    // Frees the renderer's own GL objects while this widget's context is current, before the context goes away
+    void ReleaseGLObjects();
     void paintGL() override;
     void InitializeFrameBuffers();
 
@@ -82,6 +86,7 @@ private:
     Translator translator_;
     uint64_t selected_object_;
     FPSCounter fps_counter_;
+    QLabel* stats_label_;
     GizmoManager* gizmo_manager_;
 
     // UI Elements
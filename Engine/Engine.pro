@@ -41,6 +41,9 @@ HEADERS +=  src/components.h \
     src/resource/importers.h \
     src/resource/material.h \
     src/resource/mesh.h \
+    src/resource/meshcache.h \
+    src/resource/halfedgemesh.h \
+    src/resource/assetloader.h \
     src/resource/shaderprogram.h \
     src/resource/shapes.h \
     src/resource/texture.h \
@@ -61,8 +64,11 @@ HEADERS +=  src/components.h \
     src/scene/components/surfaceofrevolution.h \
     src/scene/components/transform.h \
     src/opengl/glresourcemanager.h \
+    src/opengl/glresidency.h \
     src/opengl/glrenderer.h \
     src/opengl/glshaderprogram.h \
+    src/opengl/gluniformblocks.h \
+    src/opengl/gllightclusters.h \
     src/opengl/gltexture2d.h \
     src/resource/shaderfactory.h \
     src/opengl/glmesh.h \
@@ -73,6 +79,7 @@ HEADERS +=  src/components.h \
     src/animation/curveevaluator.h \
     src/animation/linearcurveevaluator.h \
     src/animation/curvesampler.h \
+    src/animation/compiledcurve.h \
     src/glinclude.h \
     src/vectors.h \
     src/animation/beziercurveevaluator.h \
@@ -88,6 +95,7 @@ HEADERS +=  src/components.h \
     src/scene/components/spherecollider.h \
     src/scene/components/planecollider.h \
     src/scene/components/cylindercollider.h \
+    src/scene/components/meshcollider.h \
     src/opengl/glcubemap.h \
     src/scene/components/environmentmap.h \
     src/resource/cubemap.h \
@@ -97,12 +105,22 @@ HEADERS +=  src/components.h \
     src/yamlextensions.h \
     src/animator.h \
     src/scene/boundingbox.h \
+    src/scene/particlebuffer.h \
+    src/scene/particlecollision.h \
+    src/scene/aabbtree.h \
+    src/scene/frustum.h \
     src/trace/ray.h \
     #src/trace/tracematerial.h \
     src/scene/components/trianglemesh.h \
     src/trace/tracelight.h \
     src/trace/tracescene.h \
     src/trace/bsptree.h \
+    src/trace/bvh.h \
+    src/trace/bvh4.h \
+    src/trace/simd.h \
+    src/trace/tracemesh.h \
+    src/trace/tonemapping.h \
+    src/trace/tilescheduler.h \
     src/trace/raytracer.h \
     src/scene/components/triangleface.h \
     src/trace/randomsampler.h \
@@ -131,6 +149,9 @@ SOURCES +=  src/debug/debug.cpp \
     src/resource/importers.cpp \
     src/resource/material.cpp \
     src/resource/mesh.cpp \
+    src/resource/meshcache.cpp \
+    src/resource/halfedgemesh.cpp \
+    src/resource/assetloader.cpp \
     src/resource/texture.cpp \
     src/scene/scene.cpp \
     src/scene/scenecamera.cpp \
@@ -147,13 +168,16 @@ SOURCES +=  src/debug/debug.cpp \
     src/scene/components/surfaceofrevolution.cpp \
     src/scene/components/transform.cpp \
     src/opengl/glresourcemanager.cpp \
+    src/opengl/glresidency.cpp \
     src/opengl/glrenderer.cpp \
     src/opengl/glshaderprogram.cpp \
+    src/opengl/gllightclusters.cpp \
     src/opengl/glmesh.cpp \
     src/opengl/gltexture2d.cpp \
     src/scene/components/particlesystem.cpp \
     src/animation/linearcurveevaluator.cpp \
     src/animation/curvesampler.cpp \
+    src/animation/compiledcurve.cpp \
     src/opengl/glslshaderfactory.cpp \
     src/animation/beziercurveevaluator.cpp \
     src/animation/catmullromcurveevaluator.cpp \
@@ -166,6 +190,7 @@ SOURCES +=  src/debug/debug.cpp \
     src/scene/components/spherecollider.cpp \
     src/scene/components/planecollider.cpp \
     src/scene/components/cylindercollider.cpp \
+    src/scene/components/meshcollider.cpp \
     src/opengl/glcubemap.cpp \
     src/scene/components/environmentmap.cpp \
     src/resource/cubemap.cpp \
@@ -174,12 +199,21 @@ SOURCES +=  src/debug/debug.cpp \
     src/opengl/gltexturebase.cpp \
     src/yamlextensions.cpp \
     src/scene/boundingbox.cpp \
+    src/scene/particlebuffer.cpp \
+    src/scene/particlecollision.cpp \
+    src/scene/aabbtree.cpp \
+    src/scene/frustum.cpp \
     src/trace/ray.cpp \
     #src/trace/tracematerial.cpp
     src/scene/components/trianglemesh.cpp \
     src/trace/tracelight.cpp \
     src/trace/tracescene.cpp \
     src/trace/raytracer.cpp \
+    src/trace/bvh.cpp \
+    src/trace/bvh4.cpp \
+    src/trace/tracemesh.cpp \
+    src/trace/tonemapping.cpp \
+    src/trace/tilescheduler.cpp \
     src/scene/components/triangleface.cpp \
     src/trace/randomsampler.cpp \
     src/trace/tracesceneobject.cpp \
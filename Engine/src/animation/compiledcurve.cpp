@@ -0,0 +1,48 @@
+#include "compiledcurve.h"
+#include <algorithm>
+
+CompiledCurve::CompiledCurve(const std::vector<glm::vec2>& evaluated_pts) {
+    Build(evaluated_pts);
+}
+
+void CompiledCurve::Build(const std::vector<glm::vec2>& evaluated_pts) {
+    keys_.clear();
+    segments_.clear();
+    end_value_ = 0.f;
+    if (evaluated_pts.empty()) {
+        return;
+    }
+
+    std::vector<glm::vec2> pts(evaluated_pts);
+    std::stable_sort(pts.begin(), pts.end(), [](const glm::vec2& a, const glm::vec2& b) { return a.x < b.x; });
+
+    keys_.reserve(pts.size());
+    segments_.reserve(pts.size());
+    for (size_t i = 0; i + 1 < pts.size(); i++) {
+        float dx = pts[i + 1].x - pts[i].x;
+        // Points at the same time make a jump, which a zero length segment can't represent, so skip it
+        if (dx <= 0.f) {
+            continue;
+        }
+        keys_.push_back(pts[i].x);
+        segments_.push_back(Segment{pts[i].y, (pts[i + 1].y - pts[i].y) / dx});
+    }
+    keys_.push_back(pts.back().x);
+    end_value_ = pts.back().y;
+}
+
+float CompiledCurve::Sample(float t) const {
+    if (keys_.empty()) {
+        return 0.f;
+    }
+    if (segments_.empty() || t <= keys_.front()) {
+        return segments_.empty() ? end_value_ : segments_.front().value;
+    }
+    if (t >= keys_.back()) {
+        return end_value_;
+    }
+    // keys_ has one more entry than segments_, its last entry is where the last segment ends
+    size_t i = std::upper_bound(keys_.begin(), keys_.end() - 1, t) - keys_.begin() - 1;
+    const Segment& segment = segments_[i];
+    return segment.value + segment.slope * (t - keys_[i]);
+}
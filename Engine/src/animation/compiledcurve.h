@@ -0,0 +1,39 @@
+#ifndef COMPILEDCURVE_H
+#define COMPILEDCURVE_H
+
+#include <vectors.h>
+#include <vector>
+
+// Piecewise linear form of an evaluated curve, for sampling animated values without the plot.
+// Samples between two evaluated points are interpolated linearly and samples outside of them are clamped,
+// matching what the curve editor draws. Build replaces the whole curve, sampling never modifies it,
+// so a built curve can be sampled from any number of threads.
+class CompiledCurve
+{
+public:
+    CompiledCurve() {}
+    // Same as Build(evaluated_pts)
+    explicit CompiledCurve(const std::vector<glm::vec2>& evaluated_pts);
+
+    // Takes the output of a CurveEvaluator, the points don't need to be sorted by time
+    void Build(const std::vector<glm::vec2>& evaluated_pts);
+
+    float Sample(float t) const;
+
+    bool IsEmpty() const { return keys_.empty(); }
+    size_t GetSegmentCount() const { return segments_.size(); }
+
+private:
+    // y = value + slope * (t - start) over [start, next start)
+    struct Segment {
+        float value;
+        float slope;
+    };
+
+    // Start times, kept apart from the coefficients so the binary search walks a dense array
+    std::vector<float> keys_;
+    std::vector<Segment> segments_;
+    float end_value_ = 0.f;
+};
+
+#endif // COMPILEDCURVE_H
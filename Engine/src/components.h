@@ -26,6 +26,7 @@
 #include <scene/components/spherecollider.h>
 #include <scene/components/planecollider.h>
 #include <scene/components/cylindercollider.h>
+#include <scene/components/meshcollider.h>
 #include <scene/components/environmentmap.h>
 
 #include <scene/components/robotarmprop.h>
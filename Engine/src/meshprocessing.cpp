@@ -10,44 +10,234 @@
 #include "meshprocessing.h"
 #include <algorithm>
 
+namespace {
+
+glm::dvec3 GetPosition(const std::vector<float>& positions, unsigned int vertex) {
+    return glm::dvec3(positions[3 * vertex], positions[3 * vertex + 1], positions[3 * vertex + 2]);
+}
+
+std::vector<glm::dvec3> GetWeldedPositions(const HalfEdgeMesh& half_edges, const std::vector<float>& positions) {
+    std::vector<glm::dvec3> welded(half_edges.GetVertexCount());
+    for (unsigned int v = 0; v < half_edges.GetVertexCount(); v++) welded[v] = GetPosition(positions, half_edges.GetMeshVertex(v));
+    return welded;
+}
+
+// Every copy of a welded vertex gets its position
+std::vector<float> GetMeshPositions(const HalfEdgeMesh& half_edges, const std::vector<glm::dvec3>& welded, size_t mesh_vertex_count) {
+    std::vector<float> positions(3 * mesh_vertex_count);
+    for (unsigned int i = 0; i < mesh_vertex_count; i++) {
+        const glm::dvec3& position = welded[half_edges.GetVertex(i)];
+        positions[3 * i] = (float)position.x;
+        positions[3 * i + 1] = (float)position.y;
+        positions[3 * i + 2] = (float)position.z;
+    }
+    return positions;
+}
+
+glm::dvec3 SumNeighbors(const unsigned int* neighbors, unsigned int count, const std::vector<glm::dvec3>& positions) {
+    glm::dvec3 sum(0.0);
+    for (unsigned int i = 0; i < count; i++) sum += positions[neighbors[i]];
+    return sum;
+}
+
+// Moves each vertex by factor of the way to the mean of its neighbors
+std::vector<glm::dvec3> LaplacianStep(const HalfEdgeMesh& half_edges, const std::vector<glm::dvec3>& positions, double factor) {
+    std::vector<glm::dvec3> smoothed(positions);
+    for (unsigned int v = 0; v < half_edges.GetVertexCount(); v++) {
+        unsigned int boundary_valence = half_edges.GetBoundaryValence(v);
+        glm::dvec3 mean;
+        if (boundary_valence == 0) {
+            unsigned int valence = half_edges.GetValence(v);
+            if (valence == 0) continue;
+            mean = SumNeighbors(half_edges.GetNeighbors(v), valence, positions) / double(valence);
+        } else if (boundary_valence == 2) {
+            // Inner neighbors would pull the boundary in and shrink the hole's outline
+            mean = SumNeighbors(half_edges.GetBoundaryNeighbors(v), 2, positions) / 2.0;
+        } else {
+            continue;
+        }
+        smoothed[v] = positions[v] + factor * (mean - positions[v]);
+    }
+    return smoothed;
+}
+
+// A copy of the mesh's arrays with the positions replaced, the binormals and tangents left to be found again
+MeshData WithPositions(const Mesh& mesh, std::vector<float> positions) {
+    MeshData data;
+    data.positions = std::move(positions);
+    data.colors = mesh.GetColors();
+    data.UVs = mesh.GetUVs();
+    data.normals = mesh.GetNormals();
+    data.triangles = mesh.GetTriangles();
+    return data;
+}
+
+// Applies a Laplacian step by each factor in turn
+void SmoothMesh(const Mesh& input_mesh, Mesh& filtered_mesh, std::initializer_list<double> factors) {
+    const HalfEdgeMesh& half_edges = input_mesh.GetHalfEdges();
+    std::vector<glm::dvec3> positions = GetWeldedPositions(half_edges, input_mesh.GetPositions());
+    for (double factor : factors) positions = LaplacianStep(half_edges, positions, factor);
+    // Everything is read from the input before it's replaced, in case they're the same mesh
+    MeshData data = WithPositions(input_mesh, GetMeshPositions(half_edges, positions, input_mesh.GetPositions().size() / 3));
+    filtered_mesh.SetData(std::move(data));
+    MeshProcessing::ComputeNormals(filtered_mesh);
+}
+
+// Loop's weight for each neighbor of an interior vertex with valence of them
+double LoopBeta(unsigned int valence) {
+    double c = 3.0 / 8.0 + std::cos(2.0 * M_PI / valence) / 4.0;
+    return (5.0 / 8.0 - c * c) / valence;
+}
+
+glm::dvec3 EvenVertexPosition(const HalfEdgeMesh& half_edges, const std::vector<glm::dvec3>& positions, unsigned int v) {
+    unsigned int boundary_valence = half_edges.GetBoundaryValence(v);
+    if (boundary_valence == 2) {
+        return 0.75 * positions[v] + 0.125 * SumNeighbors(half_edges.GetBoundaryNeighbors(v), 2, positions);
+    }
+    unsigned int valence = half_edges.GetValence(v);
+    // Corners, where more than two boundaries or creases meet, stay put
+    if (boundary_valence > 0 || valence < 3) return positions[v];
+    double beta = LoopBeta(valence);
+    return (1.0 - valence * beta) * positions[v] + beta * SumNeighbors(half_edges.GetNeighbors(v), valence, positions);
+}
+
+glm::dvec3 LimitPosition(const HalfEdgeMesh& half_edges, const std::vector<glm::dvec3>& positions, unsigned int v) {
+    unsigned int boundary_valence = half_edges.GetBoundaryValence(v);
+    if (boundary_valence == 2) {
+        return (2.0 / 3.0) * positions[v] + (1.0 / 6.0) * SumNeighbors(half_edges.GetBoundaryNeighbors(v), 2, positions);
+    }
+    unsigned int valence = half_edges.GetValence(v);
+    if (boundary_valence > 0 || valence < 3) return positions[v];
+    double chi = 1.0 / (3.0 / (8.0 * LoopBeta(valence)) + valence);
+    return (1.0 - valence * chi) * positions[v] + chi * SumNeighbors(half_edges.GetNeighbors(v), valence, positions);
+}
+
+}
+
 void MeshProcessing::ComputeNormals(Mesh& mesh) {
-    // MODELER: Recompute the normals for a mesh by taking a weighted
-    // average of the normals of the adjacent faces
+    const std::vector<float>& positions = mesh.GetPositions();
+    const std::vector<unsigned int>& triangles = mesh.GetTriangles();
+    const HalfEdgeMesh& half_edges = mesh.GetHalfEdges();
+
+    // Weighting by angle keeps a vertex's normal from leaning towards whichever side happens to have more triangles
+    std::vector<glm::dvec3> sums(half_edges.GetVertexCount(), glm::dvec3(0.0));
+    for (unsigned int f = 0; f < half_edges.GetFaceCount(); f++) {
+        glm::dvec3 corners[3];
+        for (int i = 0; i < 3; i++) corners[i] = GetPosition(positions, triangles[3 * f + i]);
+        glm::dvec3 normal = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+        double length = glm::length(normal);
+        if (length == 0.0) continue;
+        normal /= length;
+        for (int i = 0; i < 3; i++) {
+            glm::dvec3 to_next = corners[(i + 1) % 3] - corners[i];
+            glm::dvec3 to_prev = corners[(i + 2) % 3] - corners[i];
+            double angle = std::atan2(glm::length(glm::cross(to_next, to_prev)), glm::dot(to_next, to_prev));
+            sums[half_edges.Origin(3 * f + i)] += angle * normal;
+        }
+    }
+
+    // Vertices on no faces keep the normals they had
+    std::vector<float> normals = mesh.GetNormals();
+    normals.resize(positions.size(), 0.f);
+    for (unsigned int i = 0; i < positions.size() / 3; i++) {
+        const glm::dvec3& sum = sums[half_edges.GetVertex(i)];
+        double length = glm::length(sum);
+        if (length == 0.0) continue;
+        normals[3 * i] = float(sum.x / length);
+        normals[3 * i + 1] = float(sum.y / length);
+        normals[3 * i + 2] = float(sum.z / length);
+    }
+    mesh.SetNormals(std::move(normals));
 }
 
 void MeshProcessing::FilterMesh(const Mesh& input_mesh, Mesh& filtered_mesh, double a) {
-    const std::vector<float>& input_positions = input_mesh.GetPositions();
-    const std::vector<float>& input_normals = input_mesh.GetNormals();
-    const std::vector<float>& input_UVs = input_mesh.GetUVs();
-    const std::vector<unsigned int>& input_faces = input_mesh.GetTriangles();
-
-    // MODELER: Take a weighted sum of the vertex and its neighbors to produce a new mesh
-    // with the same connectivity as the original mesh, but with updated vertex positions.
-    // Vertices are neighbors if they share an edge. Filter weights will be 1 for the vertex,
-    // and a / N for each neighboring vertex. The weights will then be normalized.
-    // "a" controls smoothing or sharpening, and N is the number of neighboring vertices.
+    // Weights of 1 for the vertex and a/N for each of its N neighbors, normalized, come to a step of a/(1+a)
+    if (std::abs(1.0 + a) < 1e-9) {
+        Debug::Log.WriteLine("Can't filter with a = -1, the weights sum to zero", Priority::Warning);
+        SmoothMesh(input_mesh, filtered_mesh, {0.0});
+        return;
+    }
+    SmoothMesh(input_mesh, filtered_mesh, {a / (1.0 + a)});
+}
 
-    filtered_mesh.SetPositions(input_positions);
-    filtered_mesh.SetNormals(input_normals);
-    filtered_mesh.SetUVs(input_UVs);
-    filtered_mesh.SetTriangles(input_faces);
-    ComputeNormals(filtered_mesh);
+void MeshProcessing::TaubinFilterMesh(const Mesh& input_mesh, Mesh& filtered_mesh, double lambda, double mu) {
+    SmoothMesh(input_mesh, filtered_mesh, {lambda, mu});
 }
 
 void MeshProcessing::SubdivideMesh(const Mesh& input_mesh, Mesh& filtered_mesh, bool limit) {
     const std::vector<float>& input_positions = input_mesh.GetPositions();
-    const std::vector<float>& input_normals = input_mesh.GetNormals();
+    const std::vector<float>& input_colors = input_mesh.GetColors();
     const std::vector<float>& input_UVs = input_mesh.GetUVs();
     const std::vector<unsigned int>& input_faces = input_mesh.GetTriangles();
+    const HalfEdgeMesh& half_edges = input_mesh.GetHalfEdges();
+    unsigned int vertex_count = input_positions.size() / 3;
+    bool has_colors = input_colors.size() == 3 * vertex_count;
+    bool has_UVs = input_UVs.size() == 2 * vertex_count;
+    std::vector<glm::dvec3> positions = GetWeldedPositions(half_edges, input_positions);
+
+    // The old vertices stay, moved by the even rules
+    std::vector<glm::dvec3> even_positions(half_edges.GetVertexCount());
+    for (unsigned int v = 0; v < half_edges.GetVertexCount(); v++) even_positions[v] = EvenVertexPosition(half_edges, positions, v);
+    MeshData data;
+    data.positions = GetMeshPositions(half_edges, even_positions, vertex_count);
+    if (has_colors) data.colors = input_colors;
+    if (has_UVs) data.UVs = input_UVs;
 
-    // MODELER - EXTRA CREDIT (457): Perform one iteration of Loop subdivision on the mesh, assuming
-    // the mesh is watertight (has no boundary vertices or edges).
-    // For an extra bell, also detect and subdivide boundary vertices and edges
+    // A new vertex goes on each edge between mesh vertices, rather than welded ones, so both sides of a UV
+    // seam get their own UVs. Their positions come from the welded edge, so the copies still land together.
+    std::unordered_map<uint64_t, unsigned int> edge_vertices;
+    edge_vertices.reserve(half_edges.GetHalfEdgeCount());
+    auto edge_vertex = [&](unsigned int h) {
+        mesh_edge edge = make_edge(input_faces[h], input_faces[HalfEdgeMesh::Next(h)]);
+        auto inserted = edge_vertices.emplace((uint64_t(edge.first) << 32) | edge.second, (unsigned int)data.positions.size() / 3);
+        if (!inserted.second) return inserted.first->second;
 
-    filtered_mesh.SetPositions(input_positions);
-    filtered_mesh.SetNormals(input_normals);
-    filtered_mesh.SetUVs(input_UVs);
-    filtered_mesh.SetTriangles(input_faces);
+        const glm::dvec3& origin = positions[half_edges.Origin(h)];
+        const glm::dvec3& target = positions[half_edges.Target(h)];
+        glm::dvec3 position;
+        if (half_edges.IsBoundary(h)) {
+            position = 0.5 * (origin + target);
+        } else {
+            const glm::dvec3& opposite = positions[half_edges.Opposite(h)];
+            const glm::dvec3& twin_opposite = positions[half_edges.Opposite(half_edges.Twin(h))];
+            position = 0.375 * (origin + target) + 0.125 * (opposite + twin_opposite);
+        }
+        data.positions.insert(data.positions.end(), {(float)position.x, (float)position.y, (float)position.z});
+        if (has_colors) {
+            for (int i = 0; i < 3; i++) data.colors.push_back(0.5f * (input_colors[3 * edge.first + i] + input_colors[3 * edge.second + i]));
+        }
+        if (has_UVs) {
+            for (int i = 0; i < 2; i++) data.UVs.push_back(0.5f * (input_UVs[2 * edge.first + i] + input_UVs[2 * edge.second + i]));
+        }
+        return inserted.first->second;
+    };
+
+    // Each triangle splits into one at each corner and one in the middle
+    data.triangles.reserve(4 * 3 * half_edges.GetFaceCount());
+    for (unsigned int f = 0; f < half_edges.GetFaceCount(); f++) {
+        const unsigned int* corners = &input_faces[3 * f];
+        unsigned int middles[3];
+        for (int i = 0; i < 3; i++) middles[i] = edge_vertex(3 * f + i);
+        data.triangles.insert(data.triangles.end(), {
+            corners[0], middles[0], middles[2],
+            corners[1], middles[1], middles[0],
+            corners[2], middles[2], middles[1],
+            middles[0], middles[1], middles[2]
+        });
+    }
+
+    // Everything is read from the input before it's replaced, in case they're the same mesh
+    filtered_mesh.SetData(std::move(data));
+
+    if (limit) {
+        const HalfEdgeMesh& subdivided_half_edges = filtered_mesh.GetHalfEdges();
+        std::vector<glm::dvec3> subdivided_positions = GetWeldedPositions(subdivided_half_edges, filtered_mesh.GetPositions());
+        std::vector<glm::dvec3> limit_positions(subdivided_half_edges.GetVertexCount());
+        for (unsigned int v = 0; v < subdivided_half_edges.GetVertexCount(); v++) {
+            limit_positions[v] = LimitPosition(subdivided_half_edges, subdivided_positions, v);
+        }
+        filtered_mesh.SetPositions(GetMeshPositions(subdivided_half_edges, limit_positions, filtered_mesh.GetPositions().size() / 3));
+    }
 
     ComputeNormals(filtered_mesh);
 }
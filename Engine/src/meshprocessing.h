@@ -12,11 +12,20 @@
 #include <resource/mesh.h>
 #include <utility>
 
+// Work on the mesh's half-edges, so copies of a vertex along UV seams move together and seams don't open up.
+// The input and output mesh may be the same one.
 class MeshProcessing {
 public:
+    // Averages the normals of the faces around each vertex, weighted by their angle at it
     static void ComputeNormals(Mesh& mesh);
+    // Moves each vertex towards the mean of its neighbors, by a/(1+a) of the way. Boundary vertices only follow
+    // their neighbors along the boundary, and corners stay put. Negative a sharpens.
     static void FilterMesh(const Mesh& input_mesh, Mesh& filtered_mesh, double a);
+    // A smoothing step by lambda followed by an inflating step by mu, which keeps the mesh from shrinking
+    static void TaubinFilterMesh(const Mesh& input_mesh, Mesh& filtered_mesh, double lambda=0.5, double mu=-0.53);
     static void FlipNormals(const Mesh& input_mesh, Mesh& filtered_mesh);
+    // One step of Loop subdivision, with boundaries and creases following the cubic B-spline rules.
+    // With limit set, the new vertices are then moved to where endless subdivision would take them.
     static void SubdivideMesh(const Mesh& input_mesh, Mesh& filtered_mesh, bool limit=false);
 
 private:
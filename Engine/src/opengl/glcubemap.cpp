@@ -28,6 +28,7 @@ void GLCubeMap::SetData(const Cubemap &cubemap) {
         // Load the data from the image buffer to define the GLTexture
         glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X+face, 0, GL_RGBA, resolution, resolution, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
     }
+    memory_size_ = size_t(resolution) * resolution * 4 * Cubemap::NUM_CUBEMAP_FACES;
 
     // Set texture additional properties
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -0,0 +1,192 @@
+#include "gllightclusters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+GLLightClusters::GLLightClusters() :
+    bounds_valid_(false),
+    perspective_(true),
+    near_(0.f),
+    far_(0.f),
+    slice_near_(0.f),
+    slice_scale_(0.f),
+    slice_bias_(0.f)
+{
+}
+
+float GLLightClusters::LightRange(const glm::vec3& intensity, float atten_const, float atten_linear, float atten_quad) {
+    float brightest = std::max(intensity.x, std::max(intensity.y, intensity.z));
+    // The shaders don't light with an attenuation that isn't positive
+    if (brightest <= 0.f || (atten_const <= 0.f && atten_linear <= 0.f && atten_quad <= 0.f)) {
+        return 0.f;
+    }
+
+    // Solve c + l*r + q*r^2 = brightest / cutoff for r
+    float target = brightest / LIGHT_CLUSTER_CUTOFF;
+    if (atten_const >= target) {
+        return 0.f;
+    }
+    if (atten_quad > 0.f) {
+        return (-atten_linear + std::sqrt(atten_linear * atten_linear + 4.f * atten_quad * (target - atten_const))) / (2.f * atten_quad);
+    }
+    if (atten_linear > 0.f) {
+        return (target - atten_const) / atten_linear;
+    }
+    return -1.f;
+}
+
+int GLLightClusters::Slice(float depth) const {
+    int slice = (int)std::floor(std::log(std::max(depth, slice_near_)) * slice_scale_ + slice_bias_);
+    return std::max(0, std::min(LIGHT_CLUSTERS_Z - 1, slice));
+}
+
+void GLLightClusters::BuildBounds(const glm::mat4& proj_matrix) {
+    proj_matrix_ = proj_matrix;
+    bounds_valid_ = true;
+
+    // Recover the clip planes from the projection
+    perspective_ = proj_matrix[2][3] != 0.f;
+    if (perspective_) {
+        near_ = proj_matrix[3][2] / (proj_matrix[2][2] - 1.f);
+        far_ = proj_matrix[3][2] / (proj_matrix[2][2] + 1.f);
+    } else {
+        near_ = (proj_matrix[3][2] + 1.f) / proj_matrix[2][2];
+        far_ = (proj_matrix[3][2] - 1.f) / proj_matrix[2][2];
+    }
+
+    // Slices grow exponentially from a positive depth, orthographic views may start at or behind the eye
+    slice_near_ = std::max(near_, 0.05f);
+    float slice_far = std::max(far_, slice_near_ * 2.f);
+    float log_ratio = std::log(slice_far / slice_near_);
+    slice_scale_ = LIGHT_CLUSTERS_Z / log_ratio;
+    slice_bias_ = -LIGHT_CLUSTERS_Z * std::log(slice_near_) / log_ratio;
+
+    // View space rays through the tile corners, as their points on the near and far planes
+    const int corners_x = LIGHT_CLUSTERS_X + 1;
+    const int corners_y = LIGHT_CLUSTERS_Y + 1;
+    std::vector<glm::vec3> ray_near(corners_x * corners_y);
+    std::vector<glm::vec3> ray_far(corners_x * corners_y);
+    glm::mat4 inverse_proj = glm::inverse(proj_matrix);
+    for (int y = 0; y < corners_y; y++) {
+        for (int x = 0; x < corners_x; x++) {
+            glm::vec2 ndc(2.f * x / LIGHT_CLUSTERS_X - 1.f, 2.f * y / LIGHT_CLUSTERS_Y - 1.f);
+            glm::vec4 point_near = inverse_proj * glm::vec4(ndc, -1.f, 1.f);
+            glm::vec4 point_far = inverse_proj * glm::vec4(ndc, 1.f, 1.f);
+            ray_near[y * corners_x + x] = glm::vec3(point_near) / point_near.w;
+            ray_far[y * corners_x + x] = glm::vec3(point_far) / point_far.w;
+        }
+    }
+    auto at_depth = [&](int corner, float depth) {
+        const glm::vec3& a = ray_near[corner];
+        const glm::vec3& b = ray_far[corner];
+        float t = (depth + a.z) / (a.z - b.z);
+        return a + t * (b - a);
+    };
+
+    cluster_min_.resize(LIGHT_CLUSTER_COUNT);
+    cluster_max_.resize(LIGHT_CLUSTER_COUNT);
+    for (int z = 0; z < LIGHT_CLUSTERS_Z; z++) {
+        // The first and last slices also take the depths that get clamped into them
+        float depth_start = z == 0 ? std::min(near_, slice_near_) : std::exp((z - slice_bias_) / slice_scale_);
+        float depth_end = z == LIGHT_CLUSTERS_Z - 1 ? std::max(far_, slice_far) : std::exp((z + 1 - slice_bias_) / slice_scale_);
+        for (int y = 0; y < LIGHT_CLUSTERS_Y; y++) {
+            for (int x = 0; x < LIGHT_CLUSTERS_X; x++) {
+                int corners[4] = { y * corners_x + x, y * corners_x + x + 1, (y + 1) * corners_x + x, (y + 1) * corners_x + x + 1 };
+                glm::vec3 min(std::numeric_limits<float>::max());
+                glm::vec3 max(-std::numeric_limits<float>::max());
+                for (int corner : corners) {
+                    glm::vec3 p0 = at_depth(corner, depth_start);
+                    glm::vec3 p1 = at_depth(corner, depth_end);
+                    min = glm::min(min, glm::min(p0, p1));
+                    max = glm::max(max, glm::max(p0, p1));
+                }
+                // Pad so fragments on a boundary find their lights in whichever cluster the GPU rounds them to
+                glm::vec3 pad = (glm::abs(min) + glm::abs(max) + glm::vec3(1.f)) * 1e-4f;
+                int index = (z * LIGHT_CLUSTERS_Y + y) * LIGHT_CLUSTERS_X + x;
+                cluster_min_[index] = min - pad;
+                cluster_max_[index] = max + pad;
+            }
+        }
+    }
+}
+
+void GLLightClusters::Build(const std::vector<ClusterLight>& lights, const glm::mat4& view_matrix, const glm::mat4& proj_matrix) {
+    if (!bounds_valid_ || proj_matrix != proj_matrix_) {
+        BuildBounds(proj_matrix);
+    }
+
+    hits_.clear();
+    for (uint32_t light_num = 0; light_num < lights.size(); light_num++) {
+        const ClusterLight& light = lights[light_num];
+        if (light.range == 0.f) {
+            continue;
+        }
+        if (light.range < 0.f) {
+            for (uint32_t cluster = 0; cluster < LIGHT_CLUSTER_COUNT; cluster++) {
+                hits_.push_back(std::make_pair(cluster, light_num));
+            }
+            continue;
+        }
+
+        glm::vec3 center = glm::vec3(view_matrix * glm::vec4(light.position, 1.f));
+        float radius = light.range;
+        float depth = -center.z;
+        if (depth + radius < near_ || depth - radius > far_) {
+            continue;
+        }
+
+        int x0 = 0, x1 = LIGHT_CLUSTERS_X - 1;
+        int y0 = 0, y1 = LIGHT_CLUSTERS_Y - 1;
+        int z0 = Slice(depth - radius), z1 = Slice(depth + radius);
+        // Narrow down the tiles to the projected bounds of the sphere, when it's entirely in front of the eye
+        if (!perspective_ || depth - radius > near_) {
+            glm::vec2 ndc_min(std::numeric_limits<float>::max());
+            glm::vec2 ndc_max(-std::numeric_limits<float>::max());
+            for (int c = 0; c < 8; c++) {
+                glm::vec3 offset((c & 1) ? radius : -radius, (c & 2) ? radius : -radius, (c & 4) ? radius : -radius);
+                glm::vec4 clip = proj_matrix * glm::vec4(center + offset, 1.f);
+                glm::vec2 ndc = glm::vec2(clip) / clip.w;
+                ndc_min = glm::min(ndc_min, ndc);
+                ndc_max = glm::max(ndc_max, ndc);
+            }
+            if (ndc_max.x < -1.f || ndc_max.y < -1.f || ndc_min.x > 1.f || ndc_min.y > 1.f) {
+                continue;
+            }
+            x0 = std::max(0, (int)std::floor((ndc_min.x + 1.f) * 0.5f * LIGHT_CLUSTERS_X));
+            x1 = std::min(LIGHT_CLUSTERS_X - 1, (int)std::floor((ndc_max.x + 1.f) * 0.5f * LIGHT_CLUSTERS_X));
+            y0 = std::max(0, (int)std::floor((ndc_min.y + 1.f) * 0.5f * LIGHT_CLUSTERS_Y));
+            y1 = std::min(LIGHT_CLUSTERS_Y - 1, (int)std::floor((ndc_max.y + 1.f) * 0.5f * LIGHT_CLUSTERS_Y));
+        }
+
+        for (int z = z0; z <= z1; z++) {
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    uint32_t cluster = (z * LIGHT_CLUSTERS_Y + y) * LIGHT_CLUSTERS_X + x;
+                    glm::vec3 closest = glm::clamp(center, cluster_min_[cluster], cluster_max_[cluster]);
+                    glm::vec3 d = closest - center;
+                    if (glm::dot(d, d) <= radius * radius) {
+                        hits_.push_back(std::make_pair(cluster, light_num));
+                    }
+                }
+            }
+        }
+    }
+
+    // Count per cluster, turn the counts into offsets, then scatter the lights in order
+    grid_.assign(LIGHT_CLUSTER_COUNT, glm::uvec2(0));
+    for (auto& hit : hits_) {
+        grid_[hit.first].y++;
+    }
+    uint32_t offset = 0;
+    for (glm::uvec2& cell : grid_) {
+        cell.x = offset;
+        offset += cell.y;
+        cell.y = 0;
+    }
+    indices_.resize(hits_.size());
+    for (auto& hit : hits_) {
+        glm::uvec2& cell = grid_[hit.first];
+        indices_[cell.x + cell.y++] = hit.second;
+    }
+}
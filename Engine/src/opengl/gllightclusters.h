@@ -0,0 +1,68 @@
+#ifndef GLLIGHTCLUSTERS_H
+#define GLLIGHTCLUSTERS_H
+
+#include <vectors.h>
+#include <vector>
+#include <cstdint>
+
+// Froxel grid: screen tiles in x and y, exponentially spaced view depth slices in z
+#define LIGHT_CLUSTERS_X 16
+#define LIGHT_CLUSTERS_Y 9
+#define LIGHT_CLUSTERS_Z 24
+#define LIGHT_CLUSTER_COUNT (LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z)
+
+// Contributions under this fraction of full intensity are left out of a light's range
+#define LIGHT_CLUSTER_CUTOFF (1.f / 256.f)
+
+// A light with a position, as seen by the binning
+struct ClusterLight {
+    glm::vec3 position; // World space
+    float range;        // Distance past which the light doesn't contribute, negative if it never falls off
+};
+
+// Bins point-like lights into the view frustum's froxels on the CPU, so a fragment shader only loops over
+// the lights of its own cluster. Cluster (x, y, z) is number (z * LIGHT_CLUSTERS_Y + y) * LIGHT_CLUSTERS_X + x.
+// A fragment finds its slice as floor(log(max(depth, near)) * scale + bias), where depth is the view space
+// distance along -z, and its tile from its normalized device coordinates.
+class GLLightClusters
+{
+public:
+    GLLightClusters();
+
+    // Rebins lights for a camera. The cluster bounds are only rebuilt when the projection changes.
+    void Build(const std::vector<ClusterLight>& lights, const glm::mat4& view_matrix, const glm::mat4& proj_matrix);
+
+    // Offset into the index list and light count of each cluster
+    const std::vector<glm::uvec2>& GetGrid() const { return grid_; }
+    // Light numbers, in the order of lights given to Build
+    const std::vector<uint32_t>& GetIndices() const { return indices_; }
+
+    float GetNear() const { return slice_near_; }
+    float GetSliceScale() const { return slice_scale_; }
+    float GetSliceBias() const { return slice_bias_; }
+
+    // Distance where intensity / (c + l*r + q*r^2) drops below LIGHT_CLUSTER_CUTOFF,
+    // zero if the light never lights anything and negative if it never gets there
+    static float LightRange(const glm::vec3& intensity, float atten_const, float atten_linear, float atten_quad);
+
+private:
+    glm::mat4 proj_matrix_;
+    bool bounds_valid_;
+    bool perspective_;
+    float near_;
+    float far_;
+    float slice_near_;
+    float slice_scale_;
+    float slice_bias_;
+    std::vector<glm::vec3> cluster_min_; // View space bounds of every cluster
+    std::vector<glm::vec3> cluster_max_;
+
+    std::vector<glm::uvec2> grid_;
+    std::vector<uint32_t> indices_;
+    std::vector<std::pair<uint32_t, uint32_t>> hits_; // (cluster, light)
+
+    void BuildBounds(const glm::mat4& proj_matrix);
+    int Slice(float depth) const;
+};
+
+#endif // GLLIGHTCLUSTERS_H
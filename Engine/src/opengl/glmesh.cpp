@@ -10,6 +10,7 @@
 #include <glextinclude.h>
 #include "glmesh.h"
 #include <opengl/glshaderprogram.h>
+#include <cstddef>
 
 GLMesh::GLMesh(const Mesh& mesh) :
     Cacheable(&mesh)
@@ -31,89 +32,97 @@ GLMesh::GLMesh(const Mesh& mesh) :
 
 void GLMesh::SetMeshData(const Mesh& mesh) {
     mesh_type_ = mesh.GetMeshType();
+    memory_size_ = 0;
     glBindVertexArray(vertex_array_);
     auto attributes = GLShaderProgram::AttributeLocations();
 
     // Positions
-    auto positions = mesh.GetPositions();
+    const std::vector<float>& positions = mesh.GetPositions();
     GLint posAttrib = attributes["position"];
     if (positions.size() > 0) {
         num_vertices_ = positions.size()/3;
         glEnableVertexAttribArray(posAttrib);
         glBindBuffer(GL_ARRAY_BUFFER, position_vbo_);
         glBufferData(GL_ARRAY_BUFFER, sizeof(float) * positions.size(), positions.data(), GL_STATIC_DRAW); // Static, Dynamic, or Stream
+        memory_size_ += sizeof(float) * positions.size();
         glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), 0);
     } else {
         glDisableVertexAttribArray(posAttrib);
     }
 
     // Normals
-    auto normals = mesh.GetNormals();
+    const std::vector<float>& normals = mesh.GetNormals();
     GLint nmlAttrib = attributes["normal"];
     if (normals.size() > 0) {
         glEnableVertexAttribArray(nmlAttrib);
         glBindBuffer(GL_ARRAY_BUFFER, normal_vbo_);
         glBufferData(GL_ARRAY_BUFFER, sizeof(float) * normals.size(), normals.data(), GL_STATIC_DRAW); // Static, Dynamic, or Stream
+        memory_size_ += sizeof(float) * normals.size();
         glVertexAttribPointer(nmlAttrib, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), 0);
     } else {
         glDisableVertexAttribArray(nmlAttrib);
     }
 
     // Colors
-    auto colors = mesh.GetColors();
+    const std::vector<float>& colors = mesh.GetColors();
     GLint colAttrib = attributes["color"];
     if (colors.size() > 0) {
         glEnableVertexAttribArray(colAttrib);
         glBindBuffer(GL_ARRAY_BUFFER, color_vbo_);
         glBufferData(GL_ARRAY_BUFFER, sizeof(float) * colors.size(), colors.data(), GL_STATIC_DRAW); // Static, Dynamic, or Stream
+        memory_size_ += sizeof(float) * colors.size();
         glVertexAttribPointer(colAttrib, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), 0);
     } else {
         glDisableVertexAttribArray(colAttrib);
     }
 
     // Texture Coords
-    auto UVs = mesh.GetUVs();
+    const std::vector<float>& UVs = mesh.GetUVs();
     GLint texAttrib = attributes["texcoord"];
     if (UVs.size() > 0) {
         glEnableVertexAttribArray(texAttrib);
         glBindBuffer(GL_ARRAY_BUFFER, UV_vbo_);
         glBufferData(GL_ARRAY_BUFFER, sizeof(float) * UVs.size(), UVs.data(), GL_STATIC_DRAW); // Static, Dynamic, or Stream
+        memory_size_ += sizeof(float) * UVs.size();
         glVertexAttribPointer(texAttrib, 2, GL_FLOAT, GL_FALSE, 2*sizeof(float), 0);
     } else {
         glDisableVertexAttribArray(texAttrib);
     }
 
     // Binormals
-    auto binormals = mesh.GetBinormals();
+    const std::vector<float>& binormals = mesh.GetBinormals();
     GLint binmlAttrib = attributes["binormal"];
     if (binormals.size() > 0) {
         glEnableVertexAttribArray(binmlAttrib);
         glBindBuffer(GL_ARRAY_BUFFER, binormal_vbo_);
         glBufferData(GL_ARRAY_BUFFER, sizeof(float) * binormals.size(), binormals.data(), GL_STATIC_DRAW); // Static, Dynamic, or Stream
+        memory_size_ += sizeof(float) * binormals.size();
         glVertexAttribPointer(binmlAttrib, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), 0);
     } else {
         glDisableVertexAttribArray(binmlAttrib);
     }
 
     // Tangents
-    auto tangents = mesh.GetTangents();
+    const std::vector<float>& tangents = mesh.GetTangents();
     GLint tngtAttrib = attributes["tangent"];
     if (tangents.size() > 0) {
         glEnableVertexAttribArray(tngtAttrib);
         glBindBuffer(GL_ARRAY_BUFFER, tangent_vbo_);
         glBufferData(GL_ARRAY_BUFFER, sizeof(float) * tangents.size(), tangents.data(), GL_STATIC_DRAW); // Static, Dynamic, or Stream
+        memory_size_ += sizeof(float) * tangents.size();
         glVertexAttribPointer(tngtAttrib, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), 0);
     } else {
         glDisableVertexAttribArray(tngtAttrib);
     }
 
     // Triangles
-    auto triangles = mesh.GetTriangles();
+    const std::vector<unsigned int>& triangles = mesh.GetTriangles();
     // TODO: Watch out for meshes that have too many triangles or vertices.
     num_indices_ = triangles.size();
     if (num_indices_ > 0) {
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elements_vbo_);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * triangles.size(), triangles.data(), GL_STATIC_DRAW);
+        memory_size_ += sizeof(unsigned int) * triangles.size();
     }
     glBindVertexArray(0);
 }
@@ -132,6 +141,62 @@ void GLMesh::Render() const {
     }
 }
 
+void GLMesh::RenderInstanced(GLuint instance_buffer, unsigned int count) const {
+    if (count == 0 || mesh_type_ != MeshType::Triangles || IndicesCount() == 0) return;
+    glBindVertexArray(vertex_array_);
+
+    // Point the per-instance attributes at the instance buffer, advancing once per instance
+    auto attributes = GLShaderProgram::AttributeLocations();
+    const GLint instance_attributes[4] = { attributes["instance_position"], attributes["instance_rotation"], attributes["instance_color"], attributes["instance_age"] };
+    const GLint sizes[4] = { 4, 4, 4, 1 };
+    const size_t offsets[4] = { offsetof(GLMeshInstance, position_scale), offsetof(GLMeshInstance, rotation), offsetof(GLMeshInstance, color), offsetof(GLMeshInstance, age) };
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+    for (int i = 0; i < 4; i++) {
+        glEnableVertexAttribArray(instance_attributes[i]);
+        glVertexAttribPointer(instance_attributes[i], sizes[i], GL_FLOAT, GL_FALSE, sizeof(GLMeshInstance), (const void*)offsets[i]);
+        glVertexAttribDivisor(instance_attributes[i], 1);
+    }
+
+    glDrawElementsInstanced(GL_TRIANGLES, IndicesCount(), GL_UNSIGNED_INT, 0, count);
+
+    // Leave the mesh as it was for non-instanced draws
+    for (int i = 0; i < 4; i++) {
+        glVertexAttribDivisor(instance_attributes[i], 0);
+        glDisableVertexAttribArray(instance_attributes[i]);
+    }
+    glBindVertexArray(0);
+}
+
+void GLMesh::RenderInstancedMatrices(GLuint matrix_buffer, unsigned int count) const {
+    if (count == 0 || mesh_type_ != MeshType::Triangles || IndicesCount() == 0) return;
+    glBindVertexArray(vertex_array_);
+
+    // A mat4 attribute is four vec4 columns in consecutive locations
+    GLint location = GLShaderProgram::AttributeLocations().at("instance_model_matrix");
+    glBindBuffer(GL_ARRAY_BUFFER, matrix_buffer);
+    for (int column = 0; column < 4; column++) {
+        glEnableVertexAttribArray(location + column);
+        glVertexAttribPointer(location + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (const void*)(sizeof(glm::vec4) * column));
+        glVertexAttribDivisor(location + column, 1);
+    }
+
+    glDrawElementsInstanced(GL_TRIANGLES, IndicesCount(), GL_UNSIGNED_INT, 0, count);
+
+    for (int column = 0; column < 4; column++) {
+        glVertexAttribDivisor(location + column, 0);
+        glDisableVertexAttribArray(location + column);
+    }
+    glBindVertexArray(0);
+}
+
+void GLMesh::SetModelMatrixAttribute(const glm::mat4& model_matrix) {
+    // With the attribute arrays disabled, every vertex reads the current generic attribute values
+    GLint location = GLShaderProgram::AttributeLocations().at("instance_model_matrix");
+    for (int column = 0; column < 4; column++) {
+        glVertexAttrib4fv(location + column, glm::value_ptr(model_matrix[column]));
+    }
+}
+
 GLMesh::~GLMesh() {
     glDeleteVertexArrays(1, &vertex_array_);
     glDeleteBuffers(1, &elements_vbo_);
@@ -13,14 +13,32 @@
 #include <glinclude.h>
 #include <resource/mesh.h>
 
+// Per-instance vertex attributes for instanced rendering
+struct GLMeshInstance {
+    glm::vec4 position_scale; // World position, uniform scale
+    glm::vec4 rotation;       // Quaternion as x, y, z, w
+    glm::vec4 color;
+    float age;
+};
+
 class GLMesh : public Cacheable {
 public:
     GLMesh(const Mesh& mesh);
     ~GLMesh();
     virtual void Render() const;
+    // Draws count copies of the mesh in one call. instance_buffer holds one GLMeshInstance per copy.
+    void RenderInstanced(GLuint instance_buffer, unsigned int count) const;
+    // Draws count copies of the mesh in one call, for shaders reading instance_model_matrix.
+    // matrix_buffer holds one glm::mat4 per copy.
+    void RenderInstancedMatrices(GLuint matrix_buffer, unsigned int count) const;
+    // The instance_model_matrix that draws not reading it from a buffer see
+    static void SetModelMatrixAttribute(const glm::mat4& model_matrix);
     void SetMeshData(const Mesh& mesh);
     unsigned int IndicesCount() const { return num_indices_; }
     unsigned int VerticesCount() const { return num_vertices_; }
+    MeshType GetMeshType() const { return mesh_type_; }
+    // Bytes of the vertex and index buffers
+    size_t GetMemorySize() const { return memory_size_; }
 protected:
     GLuint vertex_array_;
     GLuint elements_vbo_;
@@ -32,6 +50,7 @@ protected:
     GLuint tangent_vbo_;
     unsigned int num_vertices_;
     unsigned int num_indices_;
+    size_t memory_size_;
 
     MeshType mesh_type_;
 };
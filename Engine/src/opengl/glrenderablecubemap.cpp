@@ -43,6 +43,8 @@ void GLRenderableCubeMap::SetResolution(int resolution) {
     for (int i = 0; i < 6; i++) {
         glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X+i, 0, GL_RGBA, resolution_, resolution_, 0, GL_RGBA, GL_FLOAT, nullptr);
     }
+    // Six RGBA8 faces and the depth buffer
+    memory_size_ = size_t(resolution_) * resolution_ * 4 * 7;
 
     // Set texture additional properties
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -42,6 +42,8 @@ void GLRenderableTexture::SetResolution(int width, int height) {
 
     // Update texture size
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width_, height_, 0, GL_RGBA, GL_FLOAT, nullptr);
+    // RGBA8 with mipmaps, and the depth buffer
+    memory_size_ = size_t(width_) * height_ * 4 * 4 / 3 + size_t(width_) * height_ * 4;
 
     // Set texture additional properties
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -14,16 +14,38 @@
 #include <opengl/glrenderablecubemap.h>
 #include <opengl/glshaderprogram.h>
 #include <glm/gtx/matrix_decompose.hpp>
+#include <algorithm>
+#include <cstring>
 
 #include <scene/components/camera.h>
 #include <trace/raytracer.h>
 
 GLRenderer::GLRenderer() :
-    asset_manager_(nullptr)
+    asset_manager_(nullptr),
+    scene_(nullptr)
 {
 
 }
 
+GLRenderer::~GLRenderer() {
+    ReleaseGLObjects();
+}
+
+void GLRenderer::ReleaseGLObjects() {
+    GLuint* buffers[] = {&camera_block_buffer_, &light_block_buffer_, &cluster_block_buffer_,
+                         &light_data_buffer_.buffer, &light_grid_buffer_.buffer, &light_index_buffer_.buffer,
+                         &particle_instance_buffer_, &batch_matrix_buffer_};
+    for (GLuint* buffer : buffers) {
+        if (*buffer != 0) glDeleteBuffers(1, buffer);
+        *buffer = 0;
+    }
+    GLuint* textures[] = {&light_data_buffer_.texture, &light_grid_buffer_.texture, &light_index_buffer_.texture};
+    for (GLuint* texture : textures) {
+        if (*texture != 0) glDeleteTextures(1, texture);
+        *texture = 0;
+    }
+}
+
 void GLRenderer::Initialize() {
     // GlobalInitialize();
 }
@@ -58,6 +80,12 @@ void GLRenderer::Clear() {
 
 void GLRenderer::Setup(Scene& scene) {
     asset_manager_ = &scene.GetAssetManager();
+    scene_ = &scene;
+    frame_stats_ = CullingStats();
+    queue_stats_ = RenderQueueStats();
+    resource_manager_.BeginFrame();
+    setup_count_++;
+    PruneUniformBindings();
 
     // Draw either filled triangles, triangles edges, or just triangle vertices
     switch(rendering_mode_) {
@@ -89,6 +117,7 @@ void GLRenderer::Setup(Scene& scene) {
         else if (DirectionalLight* d_light = light->as<DirectionalLight>()) dir_lights_.push_back(kv);
         else if (AreaLight* a_light = light->as<AreaLight>()) area_lights_.push_back(kv);
     }
+    UpdateLightBlock();
 }
 
 void GLRenderer::RenderNode(SceneObject& node, const glm::mat4& view_matrix, const glm::mat4& proj_matrix, const glm::vec2& screen_size) {
@@ -97,11 +126,41 @@ void GLRenderer::RenderNode(SceneObject& node, const glm::mat4& view_matrix, con
     view_matrix_ = view_matrix;
     proj_matrix_ = proj_matrix;
     screen_size_ = screen_size;
+    UploadCameraBlock();
+    UpdateLightClusters();
 
     // Calculate the model_matrix for this node's parent
     model_matrix_ = node.GetParentModelMatrix();
 
+    CullGeometry(node);
     if (node.IsEnabled()) Render(node);
+    FlushDraws();
+    frame_stats_.drawn += pass_stats_.drawn;
+    frame_stats_.culled += pass_stats_.culled;
+}
+
+void GLRenderer::CullGeometry(SceneObject& node) {
+    pass_stats_ = CullingStats();
+    // The selection draws the editor mesh, which the bounds aren't of
+    culling_pass_ = frustum_culling_ && !rendering_selection_ && scene_ != nullptr && node.GetScene() == scene_;
+    if (!culling_pass_) return;
+
+    const AABBTree& bounds = scene_->GetGeometryBounds();
+    if (visible_pass_.size() < (size_t)bounds.GetNodeCapacity()) visible_pass_.resize(bounds.GetNodeCapacity(), 0);
+    cull_pass_++;
+    if (cull_pass_ == 0) {
+        // Wrapped around, forget the old passes
+        std::fill(visible_pass_.begin(), visible_pass_.end(), 0);
+        cull_pass_ = 1;
+    }
+    bounds.Query(Frustum(proj_matrix_ * view_matrix_), [this](int proxy) { visible_pass_[proxy] = cull_pass_; });
+}
+
+bool GLRenderer::IsCulled(SceneObject& node) {
+    if (!culling_pass_) return false;
+    // Objects that aren't in the bounds, like ones added since Setup, are always drawn
+    int proxy = scene_->GetGeometryProxy(node);
+    return proxy != AABBTree::NULL_NODE && visible_pass_[proxy] != cull_pass_;
 }
 
 void GLRenderer::RenderEnvMaps(SceneObject& root) {
@@ -143,12 +202,9 @@ void GLAPIENTRY GLErrorMessageCallback(GLenum source, GLenum type, GLuint id, GL
 void GLRenderer::Render(SceneObject& node) {
     if (&node == ignored_node_) return;
 
-    // Push onto the matrix stack
-    matrix_stack_.push(model_matrix_);
-
-    // Perform the transformation
+    // Cached on the node, so there is nothing to push or concatenate
     // NOTE: GLM uses column major ordering which is OpenGL's traditional layout
-    model_matrix_ = model_matrix_ * node.GetTransform().GetMatrix();
+    model_matrix_ = node.GetModelMatrix();
 
     if (node_prefix_.empty() || node.GetName().compare(0, node_prefix_.length(), node_prefix_) == 0) {
         try {
@@ -161,11 +217,29 @@ void GLRenderer::Render(SceneObject& node) {
 
             // Mesh rendering
             Geometry* geo = node.GetComponent<Geometry>();
-            if (geo != nullptr) Render(node, *geo);
+            if (geo != nullptr) {
+                if (IsCulled(node)) {
+                    pass_stats_.culled++;
+                } else {
+                    pass_stats_.drawn++;
+                    Render(node, *geo);
+                }
+            }
 
-            // Particle System rendering
+            // Particle System rendering, queued with the geometry so it can be ordered among the transparent draws
             ParticleSystem* particles = node.GetComponent<ParticleSystem>();
-            if (particles != nullptr) Render(node, *particles);
+            if (particles != nullptr) {
+                Geometry* particle_geo = node.GetComponent<Geometry>();
+                if (particle_geo == nullptr) throw RenderingException(node.GetName() + " does not have a Geometry component to render");
+                Mesh* mesh = particle_geo->GetRenderMesh();
+                if (mesh == nullptr) throw RenderingException(node.GetName() + "'s Geometry does not have a Mesh");
+                Material* material = particles->ParticleMaterial.Get();
+                if (material == nullptr) throw RenderingException(node.GetName() + "'s Mesh Renderer material does not have a shader program");
+                ShaderProgram* program = material->Shader.Get();
+                if (program == nullptr) throw RenderingException(node.GetName() + " does not have a suitable OpenGLShaderProgram");
+                bool transparent = material->Transparent.Get() || particles->SortBackToFront.Get();
+                QueueDraw(DrawItem{&node, material, &resource_manager_.GetGLShaderProgram(*program), &resource_manager_.GetGLMesh(*mesh), particles, transparent, model_matrix_});
+            }
 
             // Camera rendering
             if (draw_camera_) {
@@ -203,10 +277,6 @@ void GLRenderer::Render(SceneObject& node) {
     for (auto& child : children) {
         if (child->IsEnabled()) Render(*child);
     }
-
-    // Pop from the matrix stack
-    model_matrix_ = matrix_stack_.top();
-    matrix_stack_.pop();
 }
 
 void GLRenderer::Render(SceneObject& node, PlaneCollider& collider) {
@@ -781,15 +851,118 @@ void GLRenderer::Render(SceneObject& node, Geometry &geo) {
             throw RenderingException(node.GetName() + "'s Mesh Renderer material does not have a shader program");
         else return;
     }
-    // TODO: Batch rendering
     // Pick the shader to use
     ShaderProgram* program = material->Shader.Get();
     if (program == nullptr) throw RenderingException(node.GetName() + " does not have a suitable OpenGLShaderProgram");
     GLShaderProgram& shader = resource_manager_.GetGLShaderProgram(*program);
-    SetUniforms(shader, *material, node);
 
-    GLMesh& gl_mesh = resource_manager_.GetGLMesh(*mesh);
-    gl_mesh.Render();
+    QueueDraw(DrawItem{&node, material, &shader, &resource_manager_.GetGLMesh(*mesh), nullptr, material->Transparent.Get(), model_matrix_});
+}
+
+void GLRenderer::QueueDraw(const DrawItem& item) {
+    draw_items_.push_back(item);
+}
+
+void GLRenderer::FlushDraws() {
+    // Dense ids in order of first use, so they fit their bits of the key
+    auto dense_id = [](std::unordered_map<const void*, uint32_t>& ids, const void* key) -> uint64_t {
+        return ids.emplace(key, (uint32_t)ids.size()).first->second;
+    };
+    shader_ids_.clear();
+    material_ids_.clear();
+    mesh_ids_.clear();
+    draw_packets_.clear();
+    for (uint32_t i = 0; i < draw_items_.size(); i++) {
+        const DrawItem& item = draw_items_[i];
+        uint64_t shader = dense_id(shader_ids_, item.shader);
+        uint64_t material = dense_id(material_ids_, item.material);
+        uint64_t mesh = dense_id(mesh_ids_, item.mesh);
+        // Distance in front of the camera. The bits of a non-negative float sort the same as the float.
+        float distance = std::max(-(view_matrix_ * item.model_matrix[3]).z, 0.f);
+        uint32_t distance_bits;
+        std::memcpy(&distance_bits, &distance, sizeof(float));
+
+        uint64_t key;
+        if (!item.transparent) {
+            // 2 bits pass, 12 shader, 16 material, 16 mesh, 18 near to far
+            key = (shader & 0xFFF) << 50 | (material & 0xFFFF) << 34 | (mesh & 0xFFFF) << 18 | (distance_bits >> 13);
+        } else {
+            // 2 bits pass, 24 far to near, 12 shader, 14 material, 12 mesh
+            uint64_t far_to_near = ~(distance_bits >> 7) & 0xFFFFFF;
+            key = (uint64_t)1 << 62 | far_to_near << 38 | (shader & 0xFFF) << 26 | (material & 0x3FFF) << 12 | (mesh & 0xFFF);
+        }
+        draw_packets_.push_back(DrawPacket{key, i});
+    }
+    std::sort(draw_packets_.begin(), draw_packets_.end(), [](const DrawPacket& a, const DrawPacket& b) {
+        return a.key < b.key || (a.key == b.key && a.item < b.item);
+    });
+
+    GLShaderProgram* bound_shader = nullptr;
+    Material* bound_material = nullptr;
+    size_t next = 0;
+    while (next < draw_packets_.size()) {
+        const DrawItem& item = draw_items_[draw_packets_[next].item];
+        size_t begin = next++;
+        try {
+            if (item.shader != bound_shader || item.material != bound_material) queue_stats_.state_changes++;
+
+            if (item.particles != nullptr) {
+                model_matrix_ = item.model_matrix;
+                Render(*item.node, *item.particles);
+                unsigned int count = (unsigned int)item.particles->GetParticles().Count();
+                queue_stats_.draw_calls += item.shader->IsInstanced() ? (count > 0 ? 1 : 0) : count;
+                queue_stats_.instances += count;
+                // Its uniforms were set for the particles
+                bound_shader = nullptr;
+                bound_material = nullptr;
+                continue;
+            }
+
+            const UniformBindingTable& table = GetUniformBindings(*item.shader, *item.material);
+            // Later copies of the mesh with the same shader and material join this draw.
+            // The keys only order the ids, so the items themselves are compared.
+            if (!table.node_uniforms && item.shader->HasInstanceModelMatrix() && item.mesh->GetMeshType() == MeshType::Triangles) {
+                while (next < draw_packets_.size()) {
+                    const DrawItem& other = draw_items_[draw_packets_[next].item];
+                    if (other.particles != nullptr || other.shader != item.shader || other.material != item.material || other.mesh != item.mesh) break;
+                    next++;
+                }
+            }
+
+            model_matrix_ = item.model_matrix;
+            if (item.shader != bound_shader || item.material != bound_material || table.node_uniforms) {
+                SetUniforms(*item.shader, *item.material, *item.node);
+                bound_shader = item.shader;
+                bound_material = item.material;
+            } else {
+                SetModelMatrix(*item.shader, *item.material);
+            }
+
+            unsigned int count = (unsigned int)(next - begin);
+            if (count == 1) {
+                item.mesh->Render();
+            } else {
+                batch_matrices_.clear();
+                for (size_t i = begin; i < next; i++) batch_matrices_.push_back(draw_items_[draw_packets_[i].item].model_matrix);
+                if (batch_matrix_buffer_ == 0) glGenBuffers(1, &batch_matrix_buffer_);
+                glBindBuffer(GL_ARRAY_BUFFER, batch_matrix_buffer_);
+                // Orphan last batch's storage so the driver doesn't wait on it
+                glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4) * batch_matrices_.size(), nullptr, GL_STREAM_DRAW);
+                glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(glm::mat4) * batch_matrices_.size(), batch_matrices_.data());
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+                item.mesh->RenderInstancedMatrices(batch_matrix_buffer_, count);
+            }
+            queue_stats_.draw_calls++;
+            queue_stats_.instances += count;
+            GLCheckError();
+        } catch (const RenderingException& e) {
+            Debug::Log.WriteLine(e.what(), Priority::Error);
+            bound_shader = nullptr;
+            bound_material = nullptr;
+        }
+    }
+    draw_items_.clear();
+    draw_packets_.clear();
 }
 
 void GLRenderer::Render(SceneObject& node, ParticleSystem& particles) {
@@ -816,27 +989,71 @@ void GLRenderer::Render(SceneObject& node, ParticleSystem& particles) {
     glm::vec4 perspective;
     glm::quat orientation; // Decompose returns the conjugate of the quaternion for some reason
     glm::decompose(model_matrix_, s, orientation, t, skew, perspective);
-    glm::mat4 parent_rot = glm::toMat4(glm::conjugate(orientation));
-    //
-    // EXTRA CREDIT:
-    // Billboard the particles when billboarding is enabled (rotate so they always face the camera)
-    // view_matrix_ will be useful for this
-
-    // For each particle:
-    for (auto& particle : particles.GetParticles()) {
-        // Set the model_matrix to reflect the particle's world position and rotation
-        glm::mat4 translation = glm::translate(glm::mat4(), particle->Position);
-        // ZXY Rotation
-        glm::quat QuatAroundX = glm::angleAxis( glm::radians(particle->Rotation.x), glm::vec3(1.0, 0.0, 0.0) );
-        glm::quat QuatAroundY = glm::angleAxis( glm::radians(particle->Rotation.y), glm::vec3(0.0, 1.0, 0.0) );
-        glm::quat QuatAroundZ = glm::angleAxis( glm::radians(particle->Rotation.z), glm::vec3(0.0, 0.0, 1.0) );
-        glm::mat4 rotation = glm::toMat4(QuatAroundZ * QuatAroundY * QuatAroundX);
-        model_matrix_ = translation * parent_rot * rotation;
-
-        // Pass the model_matrix and other uniforms to the shader
+    glm::quat parent_rot = glm::conjugate(orientation);
+
+    const ParticleBuffer& buffer = particles.GetParticles();
+    // Oldest first, or back to front by view space depth, which is more negative further away
+    particle_order_.clear();
+    for (size_t i = 0; i < buffer.Count(); i++) {
+        unsigned int slot = (unsigned int)buffer.Slot(i);
+        float depth = particles.SortBackToFront.Get() ? (view_matrix_ * glm::vec4(buffer.position[slot], 1.f)).z : 0.f;
+        particle_order_.push_back(std::make_pair(depth, slot));
+    }
+    if (particles.SortBackToFront.Get()) {
+        std::stable_sort(particle_order_.begin(), particle_order_.end(),
+                         [](const std::pair<float, unsigned int>& a, const std::pair<float, unsigned int>& b) { return a.first < b.first; });
+    }
+
+    // Billboards take the camera's rotation in place of their own
+    bool billboard = particles.Billboards.Get();
+    glm::mat4 camera_rotation = glm::mat4(glm::transpose(glm::mat3(view_matrix_)));
+    float scale = particles.ParticleScale.Get();
+
+    particle_instances_.clear();
+    for (auto& entry : particle_order_) {
+        unsigned int slot = entry.second;
+        glm::quat rotation;
+        if (!billboard) {
+            // ZXY Rotation
+            const glm::vec3& angles = buffer.rotation[slot];
+            glm::quat QuatAroundX = glm::angleAxis( glm::radians(angles.x), glm::vec3(1.0, 0.0, 0.0) );
+            glm::quat QuatAroundY = glm::angleAxis( glm::radians(angles.y), glm::vec3(0.0, 1.0, 0.0) );
+            glm::quat QuatAroundZ = glm::angleAxis( glm::radians(angles.z), glm::vec3(0.0, 0.0, 1.0) );
+            rotation = parent_rot * QuatAroundZ * QuatAroundY * QuatAroundX;
+        }
+        GLMeshInstance instance;
+        instance.position_scale = glm::vec4(buffer.position[slot], scale);
+        instance.rotation = glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+        instance.color = buffer.color[slot];
+        instance.age = buffer.age[slot];
+        particle_instances_.push_back(instance);
+    }
+
+    if (shader.IsInstanced()) {
+        // One draw for the whole system, the vertex shader places and billboards each instance
+        if (particle_instance_buffer_ == 0) glGenBuffers(1, &particle_instance_buffer_);
+        glBindBuffer(GL_ARRAY_BUFFER, particle_instance_buffer_);
+        // Orphan last draw's storage so the driver doesn't wait on it
+        glBufferData(GL_ARRAY_BUFFER, sizeof(GLMeshInstance) * particle_instances_.size(), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(GLMeshInstance) * particle_instances_.size(), particle_instances_.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        model_matrix_ = glm::mat4();
+        particle_billboard_ = billboard;
         SetUniforms(shader, *material, node);
-        // TODO: Instanced rendering, for now just draw glDrawElements once for each particle
-        resource_manager_.GetGLMesh(*mesh).Render();
+        particle_billboard_ = false;
+        resource_manager_.GetGLMesh(*mesh).RenderInstanced(particle_instance_buffer_, particle_instances_.size());
+    } else {
+        // Shaders without instance attributes get one draw per particle
+        for (auto& instance : particle_instances_) {
+            glm::mat4 translation = glm::translate(glm::mat4(), glm::vec3(instance.position_scale));
+            glm::mat4 rotation = billboard ? camera_rotation : glm::toMat4(glm::quat(instance.rotation.w, instance.rotation.x, instance.rotation.y, instance.rotation.z));
+            model_matrix_ = translation * rotation * glm::scale(glm::mat4(), glm::vec3(instance.position_scale.w));
+
+            // Pass the model_matrix and other uniforms to the shader
+            SetUniforms(shader, *material, node);
+            resource_manager_.GetGLMesh(*mesh).Render();
+        }
     }
 
     // Pop from the matrix stack
@@ -884,328 +1101,411 @@ void GLRenderer::RenderDeformedMesh(SceneObject& node, std::vector<glm::vec3> ve
     resource_manager_.GetGLMesh(*deformed_mesh).Render();
 }
 
+// Whether prop can feed a uniform of the given type
+static bool PropertyMatches(Property* prop, DataType type) {
+    switch(type) {
+        case DataType::Float:
+        case DataType::Double:
+            return dynamic_cast<DoubleProperty*>(prop) != nullptr;
+        case DataType::Float3:
+        case DataType::Double3:
+            return dynamic_cast<Vec3Property*>(prop) != nullptr;
+        case DataType::UInt:
+        case DataType::Int:
+            return dynamic_cast<IntProperty*>(prop) != nullptr;
+        case DataType::Bool:
+            return dynamic_cast<BooleanProperty*>(prop) != nullptr;
+        case DataType::Texture2D:
+            return dynamic_cast<TextureProperty*>(prop) != nullptr;
+        case DataType::ColorRGB:
+        case DataType::ColorRGBA:
+            return dynamic_cast<ColorProperty*>(prop) != nullptr;
+        case DataType::Cubemap:
+            return dynamic_cast<ResourceProperty<Cubemap>*>(prop) != nullptr;
+        default:
+            return prop != nullptr;
+    }
+}
+
+void GLRenderer::PruneUniformBindings() {
+    // Setup calls a table can go unused before it's dropped. A table is cheap to resolve again if it's needed after all.
+    static const uint64_t UNUSED_SETUPS = 300;
+    if (setup_count_ % UNUSED_SETUPS != 0) return;
+    for (auto it = uniform_bindings_.begin(); it != uniform_bindings_.end();) {
+        if (it->second.last_used + UNUSED_SETUPS < setup_count_) it = uniform_bindings_.erase(it);
+        else ++it;
+    }
+}
+
+const GLRenderer::UniformBindingTable& GLRenderer::GetUniformBindings(GLShaderProgram& shader, Material& material) {
+    UniformBindingTable& table = uniform_bindings_[std::make_pair(&shader, material.GetUID())];
+    table.last_used = setup_count_;
+    if (table.shader_version == shader.GetUniformsVersion() && table.material_version == material.GetUniformsVersion()) {
+        return table;
+    }
+
+    static const std::map<std::string, BuiltinUniform> builtin_values = {
+        {"model_matrix", BuiltinUniform::ModelMatrix},
+        {"view_matrix", BuiltinUniform::ViewMatrix},
+        {"projection_matrix", BuiltinUniform::ProjectionMatrix},
+        {"screen_width", BuiltinUniform::ScreenWidth},
+        {"screen_height", BuiltinUniform::ScreenHeight},
+        {"object_id", BuiltinUniform::ObjectId},
+        {"environment_map", BuiltinUniform::EnvironmentMap},
+        {"light_data", BuiltinUniform::LightData},
+        {"light_grid", BuiltinUniform::LightGrid},
+        {"light_indices", BuiltinUniform::LightIndices},
+        {"particle_billboard", BuiltinUniform::ParticleBillboard}
+    };
+    const std::set<std::string> builtin_uniforms = GLShaderProgram::BuiltinUniforms();
+
+    table.shader_version = shader.GetUniformsVersion();
+    table.material_version = material.GetUniformsVersion();
+    table.uniforms.clear();
+    for (auto& uniform : shader.GetUniformLocations()) {
+        UniformBinding binding;
+        binding.location = uniform.second.first;
+        binding.type = uniform.second.second;
+        binding.builtin = BuiltinUniform::None;
+        binding.property = nullptr;
+        assert(binding.location >= 0);
+
+        if (builtin_uniforms.find(uniform.first) != builtin_uniforms.end()) {
+            auto builtin = builtin_values.find(uniform.first);
+            // Lights are set from the light arrays
+            if (builtin == builtin_values.end()) continue;
+            binding.builtin = builtin->second;
+        } else {
+            // Otherwise the value comes from the property the material made for this uniform
+            Property* prop = material.Uniforms.GetProperty(uniform.first);
+            assert(prop != nullptr); // Should never be true
+            if (PropertyMatches(prop, binding.type)) binding.property = prop;
+        }
+        table.uniforms.push_back(binding);
+    }
+    for (int member = 0; member < GL_LIGHT_MEMBER_COUNT; member++) {
+        table.light_locations[member] = shader.GetUniformLocation(GetLightMemberName(member));
+    }
+    table.point_light_shadowmap = shader.GetUniformLocation("point_light_shadowmap");
+    table.node_uniforms = false;
+    for (const UniformBinding& binding : table.uniforms) {
+        if (binding.builtin == BuiltinUniform::ObjectId || binding.builtin == BuiltinUniform::EnvironmentMap) table.node_uniforms = true;
+    }
+    return table;
+}
+
+void GLRenderer::UpdateLightBlock() {
+    for (auto& member : light_block_.members) std::fill(member, member + LIGHT_BLOCK_MAX_LIGHTS, glm::vec4(0.f));
+    shadowed_point_lights_.assign(LIGHT_BLOCK_MAX_LIGHTS, nullptr);
+
+    unsigned int count = 0;
+    for (auto& kv : dir_lights_) {
+        SceneObject* node = kv.first;
+        if (!node->IsEnabled()) continue;
+        if (count >= LIGHT_BLOCK_MAX_LIGHTS) break;
+        DirectionalLight* light = node->GetComponent<Light>()->as<DirectionalLight>();
+        // We will take the vector <0, -1, 0> and rotate it by the directional lights rotation
+        light_block_.members[DirLightDirection][count] = kv.second * glm::vec4(0, -1, 0, 0);
+        light_block_.members[DirLightAmbient][count] = glm::vec4(glm::vec3(light->Ambient.Get()), 0);
+        light_block_.members[DirLightIntensity][count] = glm::vec4(glm::vec3(light->GetIntensity()), 0);
+        count++;
+    }
+
+    count = 0;
+    for (auto& kv : point_lights_) {
+        SceneObject* node = kv.first;
+        if (!node->IsEnabled()) continue;
+        if (count >= LIGHT_BLOCK_MAX_LIGHTS) break;
+        PointLight* light = node->GetComponent<Light>()->as<PointLight>();
+        light_block_.members[PointLightPosition][count] = kv.second * glm::vec4(0, 0, 0, 1);
+        light_block_.members[PointLightAmbient][count] = glm::vec4(glm::vec3(light->Ambient.Get()), 0);
+        light_block_.members[PointLightIntensity][count] = glm::vec4(glm::vec3(light->GetIntensity()), 0);
+        light_block_.members[PointLightAttenConst][count].x = light->AttenC.Get();
+        light_block_.members[PointLightAttenLinear][count].x = light->AttenB.Get();
+        light_block_.members[PointLightAttenQuad][count].x = light->AttenA.Get();
+        if (node->GetComponent<EnvironmentMap>()) shadowed_point_lights_[count] = node;
+        count++;
+    }
+
+    // area light (in scene-view, renders just like point light)
+    count = 0;
+    for (auto& kv : area_lights_) {
+        SceneObject* node = kv.first;
+        if (!node->IsEnabled()) continue;
+        if (count >= LIGHT_BLOCK_MAX_LIGHTS) break;
+        AreaLight* light = node->GetComponent<Light>()->as<AreaLight>();
+        light_block_.members[AreaLightPosition][count] = kv.second * glm::vec4(0, 0, 0, 1);
+        light_block_.members[AreaLightAmbient][count] = glm::vec4(glm::vec3(light->Ambient.Get()), 0);
+        light_block_.members[AreaLightIntensity][count] = glm::vec4(glm::vec3(light->GetIntensity()), 0);
+        light_block_.members[AreaLightAttenConst][count].x = light->AttenC.Get();
+        light_block_.members[AreaLightAttenLinear][count].x = light->AttenB.Get();
+        light_block_.members[AreaLightAttenQuad][count].x = light->AttenA.Get();
+        count++;
+    }
+
+    // Tightly packed copies for shaders that declare the lights as plain uniform arrays
+    for (int member = 0; member < GL_LIGHT_MEMBER_COUNT; member++) {
+        int size = GetLightMemberSize(member);
+        for (int i = 0; i < LIGHT_BLOCK_MAX_LIGHTS; i++) {
+            for (int c = 0; c < size; c++) {
+                packed_lights_[member][i * size + c] = light_block_.members[member][i][c];
+            }
+        }
+    }
+
+    if (light_block_buffer_ == 0) glGenBuffers(1, &light_block_buffer_);
+    glBindBuffer(GL_UNIFORM_BUFFER, light_block_buffer_);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(GLLightBlock), &light_block_, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, GL_LIGHT_BLOCK_BINDING, light_block_buffer_);
+
+    // Every light for the clustered path, directional lights first
+    light_data_.clear();
+    cluster_lights_.clear();
+    glm::vec3 ambient(0.f);
+    unsigned int dir_count = 0;
+    for (auto& kv : dir_lights_) {
+        SceneObject* node = kv.first;
+        if (!node->IsEnabled()) continue;
+        DirectionalLight* light = node->GetComponent<Light>()->as<DirectionalLight>();
+        light_data_.push_back(kv.second * glm::vec4(0, -1, 0, 0));
+        light_data_.push_back(glm::vec4(glm::vec3(light->GetIntensity()), 0));
+        light_data_.push_back(glm::vec4(glm::vec3(light->Ambient.Get()), 0));
+        ambient += glm::vec3(light->Ambient.Get());
+        dir_count++;
+    }
+    // Area lights render like point lights, with one more constant attenuation
+    auto add_local_light = [&](const std::pair<SceneObject*, glm::mat4>& kv, AttenuatingLight* light, float extra_atten_const) {
+        glm::vec3 position = glm::vec3(kv.second * glm::vec4(0, 0, 0, 1));
+        glm::vec3 intensity = light->GetIntensity();
+        float atten_const = light->AttenC.Get() + extra_atten_const;
+        float atten_linear = light->AttenB.Get();
+        float atten_quad = light->AttenA.Get();
+        light_data_.push_back(glm::vec4(position, atten_const));
+        light_data_.push_back(glm::vec4(intensity, atten_linear));
+        light_data_.push_back(glm::vec4(glm::vec3(light->Ambient.Get()), atten_quad));
+        ambient += glm::vec3(light->Ambient.Get());
+        cluster_lights_.push_back(ClusterLight{position, GLLightClusters::LightRange(intensity, atten_const, atten_linear, atten_quad)});
+    };
+    for (auto& kv : point_lights_) {
+        if (kv.first->IsEnabled()) add_local_light(kv, kv.first->GetComponent<Light>()->as<PointLight>(), 0.f);
+    }
+    for (auto& kv : area_lights_) {
+        if (kv.first->IsEnabled()) add_local_light(kv, kv.first->GetComponent<Light>()->as<AreaLight>(), 1.f);
+    }
+    UploadTextureBuffer(light_data_buffer_, GL_RGBA32F, light_data_.data(), light_data_.size() * sizeof(glm::vec4));
+    cluster_block_.cluster_dims = glm::uvec4(LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y, LIGHT_CLUSTERS_Z, dir_count);
+    cluster_block_.light_ambient = glm::vec4(ambient, 0);
+    lights_version_++;
+}
+
+void GLRenderer::UpdateLightClusters() {
+    if (clustered_lights_version_ != lights_version_ || clustered_view_ != view_matrix_ || clustered_proj_ != proj_matrix_) {
+        light_clusters_.Build(cluster_lights_, view_matrix_, proj_matrix_);
+        const std::vector<glm::uvec2>& grid = light_clusters_.GetGrid();
+        const std::vector<uint32_t>& indices = light_clusters_.GetIndices();
+        UploadTextureBuffer(light_grid_buffer_, GL_RG32UI, grid.data(), grid.size() * sizeof(glm::uvec2));
+        UploadTextureBuffer(light_index_buffer_, GL_R32UI, indices.data(), indices.size() * sizeof(uint32_t));
+
+        cluster_block_.cluster_slicing = glm::vec4(light_clusters_.GetNear(), light_clusters_.GetSliceScale(), light_clusters_.GetSliceBias(), 0);
+        if (cluster_block_buffer_ == 0) glGenBuffers(1, &cluster_block_buffer_);
+        glBindBuffer(GL_UNIFORM_BUFFER, cluster_block_buffer_);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(GLClusterBlock), &cluster_block_, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        clustered_lights_version_ = lights_version_;
+        clustered_view_ = view_matrix_;
+        clustered_proj_ = proj_matrix_;
+    }
+    glBindBufferBase(GL_UNIFORM_BUFFER, GL_CLUSTER_BLOCK_BINDING, cluster_block_buffer_);
+}
+
+void GLRenderer::UploadTextureBuffer(GLTextureBuffer& target, GLenum format, const void* data, size_t size) {
+    // Keep the buffer from being empty, shaders can still fetch from it
+    static const glm::vec4 empty(0.f);
+    if (size == 0) {
+        data = &empty;
+        size = sizeof(empty);
+    }
+    if (target.buffer == 0) {
+        glGenBuffers(1, &target.buffer);
+        glGenTextures(1, &target.texture);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, target.buffer);
+    glBufferData(GL_TEXTURE_BUFFER, size, data, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, target.texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, target.buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void GLRenderer::UploadCameraBlock() {
+    GLCameraBlock block;
+    block.view_matrix = view_matrix_;
+    block.projection_matrix = proj_matrix_;
+    block.screen_width = screen_size_.x;
+    block.screen_height = screen_size_.y;
+    block.pad[0] = block.pad[1] = 0.f;
+
+    if (camera_block_buffer_ == 0) glGenBuffers(1, &camera_block_buffer_);
+    glBindBuffer(GL_UNIFORM_BUFFER, camera_block_buffer_);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(GLCameraBlock), &block, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, GL_CAMERA_BLOCK_BINDING, camera_block_buffer_);
+    if (light_block_buffer_ != 0) glBindBufferBase(GL_UNIFORM_BUFFER, GL_LIGHT_BLOCK_BINDING, light_block_buffer_);
+}
+
 void GLRenderer::SetUniforms(GLShaderProgram& shader, Material& material, SceneObject& node) {
     GLuint shader_program = shader.GetProgram();
     glUseProgram(shader_program);
+    if (shader.HasInstanceModelMatrix()) GLMesh::SetModelMatrixAttribute(model_matrix_);
 
-    // Loop through all the ShaderProgram's Uniforms and set them appropriately.
+    // Set all of the ShaderProgram's Uniforms from the bindings resolved for this material.
     // We have to do this everytime since ShaderPrograms can be shared between different materials.
-    std::map<std::string, std::pair<GLint, DataType>> uniforms = shader.GetUniformLocations();
+    const UniformBindingTable& table = GetUniformBindings(shader, material);
     GLuint tex_counter = 1; //there are issues when starting at zero
-    for (auto& uniform : uniforms) {
-        // Query for the uniform's location
-        GLint uniform_loc = uniform.second.first;
-        assert(uniform_loc >= 0);
-
-        // If the uniform is a builtin variable, we need to set it
-        auto builtin_uniforms = GLShaderProgram::BuiltinUniforms();
-        if (builtin_uniforms.find(uniform.first) != builtin_uniforms.end()) {
-            if (uniform.first == "model_matrix") {
+    for (const UniformBinding& binding : table.uniforms) {
+        GLint uniform_loc = binding.location;
+        switch (binding.builtin) {
+            case BuiltinUniform::ModelMatrix:
                 glUniformMatrix4fv(uniform_loc, 1, GL_FALSE, glm::value_ptr(model_matrix_));
-            } else if (uniform.first == "view_matrix") {
+                continue;
+            case BuiltinUniform::ViewMatrix:
                 glUniformMatrix4fv(uniform_loc, 1, GL_FALSE, glm::value_ptr(view_matrix_));
-            } else if (uniform.first == "projection_matrix") {
+                continue;
+            case BuiltinUniform::ProjectionMatrix:
                 glUniformMatrix4fv(uniform_loc, 1, GL_FALSE, glm::value_ptr(proj_matrix_));
-            } else if (uniform.first == "screen_width") {
+                continue;
+            case BuiltinUniform::ScreenWidth:
                 // TODO: Should be an int
                 glUniform1f(uniform_loc, screen_size_.x);
-            } else if (uniform.first == "screen_height") {
+                continue;
+            case BuiltinUniform::ScreenHeight:
                 glUniform1f(uniform_loc, screen_size_.y);
-            } else if (uniform.first == "object_id") {
+                continue;
+            case BuiltinUniform::ObjectId:
                 glUniform1i(uniform_loc, node.GetUID());
-            } else if (uniform.first == "environment_map") {
+                continue;
+            case BuiltinUniform::EnvironmentMap: {
                 EnvironmentMap* envmap = node.GetComponent<EnvironmentMap>();
                 if (envmap) {
                     glUniform1i(uniform_loc, tex_counter);
                     resource_manager_.GetGLTexture(envmap->GetCubemap()).Bind(GL_TEXTURE0 + tex_counter);
                     tex_counter++;
                 }
-            }
-            // Set the Lights later
-        } else {
-            // Otherwise we can just pass on the value that we assume has been set by the user on the material
-            Property* prop = material.Uniforms.GetProperty(uniform.first);
-            assert(prop != nullptr); // Should never be true
-            switch(uniform.second.second) {
-                case DataType::Float: {
-                    DoubleProperty* float_prop = dynamic_cast<DoubleProperty*>(prop);
-                    assert(float_prop != nullptr);
-                    glUniform1f(uniform_loc, float_prop->Get());
-                    break; }
-                case DataType::Double: {
-                    DoubleProperty* dbl_prop = dynamic_cast<DoubleProperty*>(prop);
-                    assert(dbl_prop != nullptr);
-                    glUniform1d(uniform_loc, dbl_prop->Get());
-                    break; }
-                case DataType::Float3: {
-                    Vec3Property* vec3_prop = dynamic_cast<Vec3Property*>(prop);
-                    assert(vec3_prop != nullptr);
-                    glm::vec3 v = vec3_prop->Get();
-                    glUniform3f(uniform_loc, v.x, v.y, v.z);
-                    break; }
-                case DataType::Double3: {
-                    Vec3Property* vec3_prop = dynamic_cast<Vec3Property*>(prop);
-                    assert(vec3_prop != nullptr);
-                    glm::vec3 v = vec3_prop->Get();
-                    glUniform3d(uniform_loc, v.x, v.y, v.z);
-                    break; }
-                case DataType::UInt:
-                case DataType::Int: {
-                    IntProperty* int_prop = dynamic_cast<IntProperty*>(prop);
-                    glUniform1i(uniform_loc, int_prop->Get());
-                    break; }
-                case DataType::Float4:
-                case DataType::Double4:
-                case DataType::FloatMat4x4:
-                case DataType::DoubleMat4x4:
-                    assert(false); // Unimplemented
-                    break;
-                case DataType::Bool: {
-                    BooleanProperty* bool_prop = dynamic_cast<BooleanProperty*>(prop);
-                    assert(bool_prop != nullptr);
-                    glUniform1i(uniform_loc, bool_prop->Get());
-                    break; }
-                case DataType::Texture2D: {
-                    TextureProperty* tex_prop = dynamic_cast<TextureProperty*>(prop);
-                    assert(tex_prop != nullptr);
-                    auto tex = tex_prop->Get();
-                    glUniform1i(uniform_loc, tex_counter);
-                    if (tex != nullptr) {
-                        resource_manager_.GetGLTexture(*tex).Bind(GL_TEXTURE0 + tex_counter);
-                    } else if (default_texture_ != nullptr) {
-                        resource_manager_.GetGLTexture(*default_texture_).Bind(GL_TEXTURE0 + tex_counter);
-                    }
-                    tex_counter++;
-                    break; }
-                case DataType::ColorRGB: {
-                    ColorProperty* color_prop = dynamic_cast<ColorProperty*>(prop);
-                    assert(color_prop != nullptr);
-                    glUniform3fv(uniform_loc, 1, glm::value_ptr(color_prop->Get()));
-                    break; }
-                case DataType::ColorRGBA: {
-                    ColorProperty* color_prop = dynamic_cast<ColorProperty*>(prop);
-                    assert(color_prop != nullptr);
-                    glUniform4fv(uniform_loc, 1, glm::value_ptr(color_prop->Get()));
-                    break; }
-                case DataType::Cubemap: {
-                    ResourceProperty<Cubemap>* cubemap_prop = dynamic_cast<ResourceProperty<Cubemap>*>(prop);
-                    assert(cubemap_prop != nullptr);
-                    auto cubemap = cubemap_prop->Get();
-                    glUniform1i(uniform_loc, tex_counter);
-                    if (cubemap != nullptr) {
-                        resource_manager_.GetGLTexture(*cubemap).Bind(GL_TEXTURE0 + tex_counter);
-                    } else {
-                        glActiveTexture(GL_TEXTURE0 + tex_counter);
-                        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-                    }
-                    tex_counter++;
-                    break; }
-                case DataType::Unsupported:
-                    break;
-            }
+                continue; }
+            case BuiltinUniform::LightData:
+            case BuiltinUniform::LightGrid:
+            case BuiltinUniform::LightIndices: {
+                const GLTextureBuffer& buffer = binding.builtin == BuiltinUniform::LightData ? light_data_buffer_ :
+                                                binding.builtin == BuiltinUniform::LightGrid ? light_grid_buffer_ : light_index_buffer_;
+                glUniform1i(uniform_loc, tex_counter);
+                glActiveTexture(GL_TEXTURE0 + tex_counter);
+                glBindTexture(GL_TEXTURE_BUFFER, buffer.texture);
+                tex_counter++;
+                continue; }
+            case BuiltinUniform::ParticleBillboard:
+                glUniform1i(uniform_loc, particle_billboard_);
+                continue;
+            case BuiltinUniform::None:
+                break;
         }
-    }
 
-    // Set the Builtin Light Uniforms
-    const unsigned int NUM_LIGHTS = 4;
-    float* ambient = new float[NUM_LIGHTS * 3];
-    float* intensity = new float[NUM_LIGHTS * 3];
-    float* direction = new float[NUM_LIGHTS * 3];
-    int* shadowmaps = new int[NUM_LIGHTS];
-
-    int arr_index = 0;
-    for (size_t i = 0; i < dir_lights_.size(); i++) {
-        SceneObject* node = dir_lights_[i].first;
-        glm::mat4 model_matrix = dir_lights_[i].second;
-        if (!node->IsEnabled()) continue;
-        // We will take the vector <0, -1, 0> and rotate it by the directional lights rotation
-        glm::vec3 vals(0, -1, 0);
-        glm::vec4 worldspace_direction = model_matrix * glm::vec4(vals, 0.0);
-        direction[arr_index] = worldspace_direction.x;
-        direction[arr_index+1] = worldspace_direction.y;
-        direction[arr_index+2] = worldspace_direction.z;
-        DirectionalLight* light = node->GetComponent<Light>()->as<DirectionalLight>();
-        vals = light->Ambient.Get();
-        ambient[arr_index] = vals.x;
-        ambient[arr_index+1] = vals.y;
-        ambient[arr_index+2] = vals.z;
-        vals = light->GetIntensity();
-        intensity[arr_index] = vals.x;
-        intensity[arr_index+1] = vals.y;
-        intensity[arr_index+2] = vals.z;
-        arr_index += 3;
+        // Otherwise we can just pass on the value that we assume has been set by the user on the material
+        Property* prop = binding.property;
+        if (prop == nullptr) continue;
+        switch(binding.type) {
+            case DataType::Float:
+                glUniform1f(uniform_loc, static_cast<DoubleProperty*>(prop)->Get());
+                break;
+            case DataType::Double:
+                glUniform1d(uniform_loc, static_cast<DoubleProperty*>(prop)->Get());
+                break;
+            case DataType::Float3: {
+                glm::vec3 v = static_cast<Vec3Property*>(prop)->Get();
+                glUniform3f(uniform_loc, v.x, v.y, v.z);
+                break; }
+            case DataType::Double3: {
+                glm::vec3 v = static_cast<Vec3Property*>(prop)->Get();
+                glUniform3d(uniform_loc, v.x, v.y, v.z);
+                break; }
+            case DataType::UInt:
+            case DataType::Int:
+                glUniform1i(uniform_loc, static_cast<IntProperty*>(prop)->Get());
+                break;
+            case DataType::Float4:
+            case DataType::Double4:
+            case DataType::FloatMat4x4:
+            case DataType::DoubleMat4x4:
+                assert(false); // Unimplemented
+                break;
+            case DataType::Bool:
+                glUniform1i(uniform_loc, static_cast<BooleanProperty*>(prop)->Get());
+                break;
+            case DataType::Texture2D: {
+                auto tex = static_cast<TextureProperty*>(prop)->Get();
+                glUniform1i(uniform_loc, tex_counter);
+                if (tex != nullptr) {
+                    resource_manager_.GetGLTexture(*tex).Bind(GL_TEXTURE0 + tex_counter);
+                } else if (default_texture_ != nullptr) {
+                    resource_manager_.GetGLTexture(*default_texture_).Bind(GL_TEXTURE0 + tex_counter);
+                }
+                tex_counter++;
+                break; }
+            case DataType::ColorRGB:
+                glUniform3fv(uniform_loc, 1, glm::value_ptr(static_cast<ColorProperty*>(prop)->Get()));
+                break;
+            case DataType::ColorRGBA:
+                glUniform4fv(uniform_loc, 1, glm::value_ptr(static_cast<ColorProperty*>(prop)->Get()));
+                break;
+            case DataType::Cubemap: {
+                auto cubemap = static_cast<ResourceProperty<Cubemap>*>(prop)->Get();
+                glUniform1i(uniform_loc, tex_counter);
+                if (cubemap != nullptr) {
+                    resource_manager_.GetGLTexture(*cubemap).Bind(GL_TEXTURE0 + tex_counter);
+                } else {
+                    glActiveTexture(GL_TEXTURE0 + tex_counter);
+                    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+                }
+                tex_counter++;
+                break; }
+            case DataType::Unsupported:
+                break;
+        }
     }
-    // Initialize other values to 0
-    for (auto i = dir_lights_.size(); i < NUM_LIGHTS; i++) {
-        direction[arr_index] = 0;
-        direction[arr_index+1] = 0;
-        direction[arr_index+2] = 0;
-        ambient[arr_index] = 0;
-        ambient[arr_index+1] = 0;
-        ambient[arr_index+2] = 0;
-        intensity[arr_index] = 0;
-        intensity[arr_index+1] = 0;
-        intensity[arr_index+2] = 0;
-        arr_index += 3;
+
+    // Set the Builtin Light Uniforms for shaders that don't use the LightBlock
+    for (int member = 0; member < GL_LIGHT_MEMBER_COUNT; member++) {
+        GLint loc = table.light_locations[member];
+        if (loc < 0) continue;
+        if (GetLightMemberSize(member) == 3) glUniform3fv(loc, LIGHT_BLOCK_MAX_LIGHTS, packed_lights_[member]);
+        else glUniform1fv(loc, LIGHT_BLOCK_MAX_LIGHTS, packed_lights_[member]);
     }
 
-    GLint loc = shader.GetUniformLocation("dir_light_intensity");
-    if (loc >= 0) glUniform3fv(loc, NUM_LIGHTS, intensity);
-    loc = shader.GetUniformLocation("dir_light_ambient");
-    if (loc >= 0) glUniform3fv(loc, NUM_LIGHTS, ambient);
-    loc = shader.GetUniformLocation("dir_light_direction");
-    if (loc >= 0) glUniform3fv(loc, NUM_LIGHTS, direction);
-
-    // Point Lights
-    float* position = new float[NUM_LIGHTS * 3];
-    float* attenA = new float[NUM_LIGHTS];
-    float* attenB = new float[NUM_LIGHTS];
-    float* attenC = new float[NUM_LIGHTS];
-
-    arr_index = 0;
-    for (size_t i = 0; i < point_lights_.size(); i++) {
-        SceneObject* lightnode = point_lights_[i].first;
-        glm::mat4 model_matrix = point_lights_[i].second;
-        if (!lightnode->IsEnabled()) continue;
-        // Calculate the position of the light in eye space
-        glm::vec3 vals(0, 0, 0);
-        glm::vec4 worldspace_pos = model_matrix * glm::vec4(vals, 1.0);
-        position[arr_index] = worldspace_pos.x;
-        position[arr_index+1] = worldspace_pos.y;
-        position[arr_index+2] = worldspace_pos.z;
-        // Set the light properties
-        PointLight* light = lightnode->GetComponent<Light>()->as<PointLight>();
-        vals = light->Ambient.Get();
-        ambient[arr_index] = vals.x;
-        ambient[arr_index+1] = vals.y;
-        ambient[arr_index+2] = vals.z;
-        vals = light->GetIntensity();
-        intensity[arr_index] = vals.x;
-        intensity[arr_index+1] = vals.y;
-        intensity[arr_index+2] = vals.z;
-        attenA[i] = light->AttenA.Get();
-        attenB[i] = light->AttenB.Get();
-        attenC[i] = light->AttenC.Get();
-
-        EnvironmentMap* envmap = lightnode->GetComponent<EnvironmentMap>();
-        if (envmap && lightnode != ignored_node_) {
+    // Shadow maps take texture units after the material's, so they are bound per draw
+    if (table.point_light_shadowmap >= 0) {
+        int shadowmaps[LIGHT_BLOCK_MAX_LIGHTS] = {0};
+        for (unsigned int i = 0; i < shadowed_point_lights_.size(); i++) {
+            SceneObject* lightnode = shadowed_point_lights_[i];
+            if (lightnode == nullptr || lightnode == ignored_node_) continue;
+            EnvironmentMap* envmap = lightnode->GetComponent<EnvironmentMap>();
             resource_manager_.GetGLTexture(envmap->GetCubemap()).Bind(GL_TEXTURE0 + tex_counter);
             shadowmaps[i] = tex_counter;
             tex_counter++;
-        } else {
-            shadowmaps[i] = 0;
         }
-        arr_index += 3;
+        glUniform1iv(table.point_light_shadowmap, LIGHT_BLOCK_MAX_LIGHTS, shadowmaps);
     }
-
-    // Initialize other values to 0
-    for (auto i = point_lights_.size(); i < NUM_LIGHTS; i++) {
-        position[arr_index] = 0;
-        position[arr_index+1] = 0;
-        position[arr_index+2] = 0;
-        ambient[arr_index] = 0;
-        ambient[arr_index+1] = 0;
-        ambient[arr_index+2] = 0;
-        intensity[arr_index] = 0;
-        intensity[arr_index+1] = 0;
-        intensity[arr_index+2] = 0;
-        attenA[i] = 0;
-        attenB[i] = 0;
-        attenC[i] = 0;
-        shadowmaps[i] = 0;
-        arr_index += 3;
-    }
-
-    //for (GLuint freetex = tex_counter; freetex<last_highest_tex; freetex++) {
-     //   glActiveTexture(GL_TEXTURE0+freetex);
-     //   glBindTexture(GL_TEXTURE_2D, 0);
-      //  glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-
-    //}
     last_highest_tex = tex_counter;
 
-    loc = shader.GetUniformLocation("point_light_intensity");
-    if (loc >= 0) glUniform3fv(loc, NUM_LIGHTS, intensity);
-    loc = shader.GetUniformLocation("point_light_ambient");
-    if (loc >= 0) glUniform3fv(loc, NUM_LIGHTS, ambient);
-    loc = shader.GetUniformLocation("point_light_position");
-    if (loc >= 0) glUniform3fv(loc, NUM_LIGHTS, position);
-    loc = shader.GetUniformLocation("point_light_atten_const");
-    if (loc >= 0) glUniform1fv(loc, NUM_LIGHTS, attenC);
-    loc = shader.GetUniformLocation("point_light_atten_linear");
-    if (loc >= 0) glUniform1fv(loc, NUM_LIGHTS, attenB);
-    loc = shader.GetUniformLocation("point_light_atten_quad");
-    if (loc >= 0) glUniform1fv(loc, NUM_LIGHTS, attenA);
-    loc = shader.GetUniformLocation("point_light_shadowmap");
-    if (loc >= 0) glUniform1iv(loc, NUM_LIGHTS, shadowmaps);
-
-
-    // area light (in scene-view, renders just like point light)
-    arr_index = 0;
-    for (size_t i = 0; i < area_lights_.size(); i++) {
-        SceneObject* lightnode = area_lights_[i].first;
-        glm::mat4 model_matrix = area_lights_[i].second;
-        if (!lightnode->IsEnabled()) continue;
-        // Calculate the position of the light in eye space
-        glm::vec3 vals(0, 0, 0);
-        glm::vec4 worldspace_pos = model_matrix * glm::vec4(vals, 1.0);
-        position[arr_index] = worldspace_pos.x;
-        position[arr_index+1] = worldspace_pos.y;
-        position[arr_index+2] = worldspace_pos.z;
-        // Set the light properties
-        AreaLight* light = lightnode->GetComponent<Light>()->as<AreaLight>();
-        vals = light->Ambient.Get();
-        ambient[arr_index] = vals.x;
-        ambient[arr_index+1] = vals.y;
-        ambient[arr_index+2] = vals.z;
-        vals = light->GetIntensity();
-        intensity[arr_index] = vals.x;
-        intensity[arr_index+1] = vals.y;
-        intensity[arr_index+2] = vals.z;
-        attenA[i] = light->AttenA.Get();
-        attenB[i] = light->AttenB.Get();
-        attenC[i] = light->AttenC.Get();
-        arr_index += 3;
+    GLCheckError();
+}
 
+void GLRenderer::SetModelMatrix(GLShaderProgram& shader, Material& material) {
+    if (shader.HasInstanceModelMatrix()) {
+        GLMesh::SetModelMatrixAttribute(model_matrix_);
+        return;
     }
-
-    for (auto i = area_lights_.size(); i < NUM_LIGHTS; i++) {
-        position[arr_index] = 0;
-        position[arr_index+1] = 0;
-        position[arr_index+2] = 0;
-        ambient[arr_index] = 0;
-        ambient[arr_index+1] = 0;
-        ambient[arr_index+2] = 0;
-        intensity[arr_index] = 0;
-        intensity[arr_index+1] = 0;
-        intensity[arr_index+2] = 0;
-        attenA[i] = 0;
-        attenB[i] = 0;
-        attenC[i] = 0;
-        arr_index += 3;
+    for (const UniformBinding& binding : GetUniformBindings(shader, material).uniforms) {
+        if (binding.builtin == BuiltinUniform::ModelMatrix) glUniformMatrix4fv(binding.location, 1, GL_FALSE, glm::value_ptr(model_matrix_));
     }
-
-    loc = shader.GetUniformLocation("area_light_intensity");
-    if (loc >= 0) glUniform3fv(loc, NUM_LIGHTS, intensity);
-    loc = shader.GetUniformLocation("area_light_ambient");
-    if (loc >= 0) glUniform3fv(loc, NUM_LIGHTS, ambient);
-    loc = shader.GetUniformLocation("area_light_position");
-    if (loc >= 0) glUniform3fv(loc, NUM_LIGHTS, position);
-    loc = shader.GetUniformLocation("area_light_atten_const");
-    if (loc >= 0) glUniform1fv(loc, NUM_LIGHTS, attenC);
-    loc = shader.GetUniformLocation("area_light_atten_linear");
-    if (loc >= 0) glUniform1fv(loc, NUM_LIGHTS, attenB);
-    loc = shader.GetUniformLocation("area_light_atten_quad");
-    if (loc >= 0) glUniform1fv(loc, NUM_LIGHTS, attenA);
-
-    delete[] intensity;
-    delete[] ambient;
-    delete[] position;
-    delete[] direction;
-    delete[] attenA;
-    delete[] attenB;
-    delete[] attenC;
-    delete[] shadowmaps;
-
-    GLCheckError();
 }
@@ -15,11 +15,17 @@
 #include <opengl/glerror.h>
 #include <opengl/glshaderprogram.h>
 #include <opengl/glresourcemanager.h>
+#include <opengl/gluniformblocks.h>
+#include <opengl/gllightclusters.h>
+#include <opengl/glmesh.h>
+#include <scene/frustum.h>
 
 // See: https://www.khronos.org/opengl/wiki/Vertex_Specification_Best_Practices
 class GLRenderer : public Renderer {
 public:
     GLRenderer();
+    // Frees the renderer's own GL objects, so the context they were made in has to be current
+    ~GLRenderer();
 
     static void GlobalInitialize();
     virtual void Initialize() override;
@@ -27,9 +33,102 @@ public:
     virtual void Setup(Scene& scene) override;
     virtual void RenderNode(SceneObject& node, const glm::mat4& view_matrix, const glm::mat4& proj_matrix, const glm::vec2& screen_size) override;
 
-    void ContextChanged() { resource_manager_ = GLResourceManager(); }
+    // Geometry drawn and skipped by frustum culling
+    struct CullingStats {
+        unsigned int drawn = 0;
+        unsigned int culled = 0;
+    };
+    // Of the last RenderNode call
+    const CullingStats& GetPassStats() const { return pass_stats_; }
+    // Of every RenderNode call since Setup, including environment and shadow maps
+    const CullingStats& GetFrameStats() const { return frame_stats_; }
+
+    // Work done drawing the queued geometry and particle systems
+    struct RenderQueueStats {
+        unsigned int draw_calls = 0;
+        unsigned int state_changes = 0; // Switches to another shader or material
+        unsigned int instances = 0; // Objects drawn, more than draw_calls when copies of a mesh were batched
+    };
+    // Of every RenderNode call since Setup
+    const RenderQueueStats& GetQueueStats() const { return queue_stats_; }
+
+    // Meshes and textures over this many bytes are freed, least recently used first
+    void SetMemoryBudget(size_t bytes) { resource_manager_.SetMemoryBudget(bytes); }
+    GLResourceManager::MemoryStats GetMemoryStats() const { return resource_manager_.GetMemoryStats(); }
+
+    // Frees the buffers and textures the renderer made itself, rather than through the resource manager.
+    // Call it while the context they were made in is still current. Does nothing when there are none.
+    void ReleaseGLObjects();
+
+    void ContextChanged() {
+        // Nothing is left to free if the old context was cleaned up before it went away
+        ReleaseGLObjects();
+        size_t memory_budget = resource_manager_.GetMemoryBudget();
+        resource_manager_ = GLResourceManager();
+        resource_manager_.SetMemoryBudget(memory_budget);
+        uniform_bindings_.clear();
+        clustered_lights_version_ = 0;
+    }
 protected:
+    enum class BuiltinUniform {
+        None,
+        ModelMatrix,
+        ViewMatrix,
+        ProjectionMatrix,
+        ScreenWidth,
+        ScreenHeight,
+        ObjectId,
+        EnvironmentMap,
+        LightData,
+        LightGrid,
+        LightIndices,
+        ParticleBillboard
+    };
+
+    struct GLTextureBuffer {
+        GLuint buffer = 0;
+        GLuint texture = 0;
+    };
+
+    // One uniform of a shader, with the material property or builtin value that feeds it
+    struct UniformBinding {
+        GLint location;
+        DataType type;
+        BuiltinUniform builtin;
+        Property* property; // Checked against type when resolved, nullptr if it didn't match
+    };
+
+    // Everything SetUniforms needs for one (shader, material) pair, resolved once.
+    // Stale once either the shader relinks or the material's uniforms are recreated.
+    struct UniformBindingTable {
+        uint64_t shader_version;
+        uint64_t material_version;
+        uint64_t last_used; // Setup call
+        std::vector<UniformBinding> uniforms;
+        GLint light_locations[GL_LIGHT_MEMBER_COUNT]; // Plain uniform light arrays, -1 when absent
+        GLint point_light_shadowmap;
+        bool node_uniforms; // Reads the object id or environment map, so it has to be set again for every node
+    };
+
+    // Geometry and particle systems are queued while walking the scene, then sorted and drawn at the end of RenderNode
+    struct DrawItem {
+        SceneObject* node;
+        Material* material;
+        GLShaderProgram* shader;
+        GLMesh* mesh;
+        ParticleSystem* particles; // Drawn with Render(node, particles) when set
+        bool transparent;
+        glm::mat4 model_matrix;
+    };
+    // Sorted in place of the items. From the most significant bits the key holds the pass, opaque before transparent,
+    // then shader, material, mesh and front to back depth for opaque draws, or back to front depth first for transparent ones.
+    struct DrawPacket {
+        uint64_t key;
+        uint32_t item;
+    };
+
     AssetManager* asset_manager_;
+    Scene* scene_;
     GLResourceManager resource_manager_;
     std::stack<glm::mat4> matrix_stack_; // There's not really a reason to use this stack other than to be explicit, since we could use the callstack instead
     glm::mat4 model_matrix_;
@@ -42,6 +141,66 @@ protected:
     std::vector<std::pair<SceneObject*, glm::mat4>> area_lights_;
     std::vector<std::pair<SceneObject*, glm::mat4>> env_maps_;
 
+    // By shader and material UID, since a deleted material's address can be reused. GL shader programs live until
+    // ContextChanged, but materials come and go with their scenes, so tables not used for a while are dropped.
+    std::map<std::pair<GLShaderProgram*, uint64_t>, UniformBindingTable> uniform_bindings_;
+    uint64_t setup_count_ = 0;
+    // Per-frame data, in block layout for the uniform buffers and packed for plain uniform arrays
+    GLLightBlock light_block_;
+    float packed_lights_[GL_LIGHT_MEMBER_COUNT][LIGHT_BLOCK_MAX_LIGHTS * 3];
+    std::vector<SceneObject*> shadowed_point_lights_; // Index i is point light i of the light arrays
+    GLuint camera_block_buffer_ = 0;
+    GLuint light_block_buffer_ = 0;
+
+    // Clustered lights. Binned again whenever the lights or the camera change.
+    std::vector<glm::vec4> light_data_;
+    std::vector<ClusterLight> cluster_lights_;
+    GLLightClusters light_clusters_;
+    GLClusterBlock cluster_block_;
+    uint64_t lights_version_ = 0;
+    uint64_t clustered_lights_version_ = 0;
+    glm::mat4 clustered_view_;
+    glm::mat4 clustered_proj_;
+    GLuint cluster_block_buffer_ = 0;
+    GLTextureBuffer light_data_buffer_;
+    GLTextureBuffer light_grid_buffer_;
+    GLTextureBuffer light_index_buffer_;
+
+    // Particle instances, refilled for every particle system drawn
+    std::vector<GLMeshInstance> particle_instances_;
+    std::vector<std::pair<float, unsigned int>> particle_order_; // View depth, slot
+    GLuint particle_instance_buffer_ = 0;
+    bool particle_billboard_ = false;
+
+    // Frustum culling. A Geometry proxy is visible in the current pass when its entry equals cull_pass_.
+    std::vector<uint32_t> visible_pass_;
+    uint32_t cull_pass_ = 0;
+    bool culling_pass_ = false;
+    CullingStats pass_stats_;
+    CullingStats frame_stats_;
+
+    // Render queue, emptied by every RenderNode call
+    std::vector<DrawItem> draw_items_;
+    std::vector<DrawPacket> draw_packets_;
+    std::unordered_map<const void*, uint32_t> shader_ids_; // Dense ids for the sort keys
+    std::unordered_map<const void*, uint32_t> material_ids_;
+    std::unordered_map<const void*, uint32_t> mesh_ids_;
+    std::vector<glm::mat4> batch_matrices_;
+    GLuint batch_matrix_buffer_ = 0;
+    RenderQueueStats queue_stats_;
+
+    void QueueDraw(const DrawItem& item);
+    void FlushDraws();
+    void CullGeometry(SceneObject& node);
+    bool IsCulled(SceneObject& node);
+    void UpdateLightBlock();
+    void UploadCameraBlock();
+    void UpdateLightClusters();
+    void UploadTextureBuffer(GLTextureBuffer& target, GLenum format, const void* data, size_t size);
+    const UniformBindingTable& GetUniformBindings(GLShaderProgram& shader, Material& material);
+    // Drops the binding tables of materials and shaders that haven't been drawn with for a while, e.g. deleted ones
+    void PruneUniformBindings();
+
     virtual void RenderEnvMaps(SceneObject& root);
 
     void Render(SceneObject& node);
@@ -56,6 +215,8 @@ protected:
     void Render(SceneObject& node, ParticleSystem& particles);
     void RenderDeformedMesh(SceneObject& node, std::vector<glm::vec3> points);
     void SetUniforms(GLShaderProgram& shader, Material& material, SceneObject& node);
+    // Sets just model_matrix_, for another draw with the uniforms SetUniforms last set
+    void SetModelMatrix(GLShaderProgram& shader, Material& material);
 };
 
 #endif // OPENGLRENDERER_H
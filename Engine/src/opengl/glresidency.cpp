@@ -0,0 +1,49 @@
+#include "glresidency.h"
+#include <algorithm>
+#include <utility>
+
+GLResidency::GLResidency(size_t budget) :
+    frame_(0),
+    budget_(budget),
+    total_(0),
+    evictions_(0)
+{
+}
+
+std::vector<uint64_t> GLResidency::BeginFrame() {
+    frame_++;
+    std::vector<uint64_t> evicted;
+    if (budget_ == 0 || total_ <= budget_) return evicted;
+
+    // (last used, uid), so ties go the same way every time
+    std::vector<std::pair<uint64_t, uint64_t>> unused;
+    for (auto& kv : entries_) {
+        if (kv.second.last_used < frame_ - 1 && !kv.second.pinned) unused.push_back(std::make_pair(kv.second.last_used, kv.first));
+    }
+    std::sort(unused.begin(), unused.end());
+    for (auto& entry : unused) {
+        if (total_ <= budget_) break;
+        uint64_t uid = entry.second;
+        total_ -= entries_[uid].bytes;
+        entries_.erase(uid);
+        evicted.push_back(uid);
+        evictions_++;
+    }
+    return evicted;
+}
+
+bool GLResidency::Use(uint64_t uid) {
+    auto it = entries_.find(uid);
+    if (it == entries_.end()) return false;
+    it->second.last_used = frame_;
+    return true;
+}
+
+void GLResidency::Add(uint64_t uid, size_t bytes, bool pinned) {
+    Entry& entry = entries_[uid];
+    // A new entry starts out zeroed
+    total_ += bytes - entry.bytes;
+    entry.bytes = bytes;
+    entry.last_used = frame_;
+    entry.pinned = pinned;
+}
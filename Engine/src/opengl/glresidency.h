@@ -0,0 +1,49 @@
+#ifndef GLRESIDENCY_H
+#define GLRESIDENCY_H
+
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// The bookkeeping behind GLResourceManager's memory budget, kept free of OpenGL so it can be tested on its own.
+// Tracks how much video memory each resident resource takes and the frame it was last used in, by asset UID,
+// and picks the least recently used ones to free once together they take more than the budget.
+class GLResidency
+{
+public:
+    explicit GLResidency(size_t budget);
+
+    // 0 for no limit
+    void SetBudget(size_t bytes) { budget_ = bytes; }
+    size_t GetBudget() const { return budget_; }
+
+    // Starts the next frame. If over budget, returns what to free, oldest first, and forgets it, until back under.
+    // Nothing the last frame used is picked, so a scene that needs more than the budget doesn't upload every frame.
+    std::vector<uint64_t> BeginFrame();
+    // Records a use in the current frame. Returns false if the resource isn't resident, because it's new or was
+    // evicted, and has to be uploaded and added first.
+    bool Use(uint64_t uid);
+    // After uploading a resource, or changing its size. Pinned resources, like render targets, are never picked.
+    void Add(uint64_t uid, size_t bytes, bool pinned = false);
+
+    uint64_t GetFrame() const { return frame_; }
+    // Memory taken by everything resident, pinned resources included
+    size_t GetTotal() const { return total_; }
+    unsigned int GetEvictions() const { return evictions_; }
+
+private:
+    struct Entry {
+        size_t bytes;
+        uint64_t last_used; // Frame
+        bool pinned;
+    };
+
+    uint64_t frame_;
+    size_t budget_;
+    size_t total_;
+    unsigned int evictions_;
+    std::unordered_map<uint64_t, Entry> entries_;
+};
+
+#endif // GLRESIDENCY_H
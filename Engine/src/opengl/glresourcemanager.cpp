@@ -12,70 +12,105 @@
 #include <opengl/glrenderablecubemap.h>
 #include <opengl/gltexture2d.h>
 #include <opengl/glrenderabletexture.h>
+#include <algorithm>
 
-GLResourceManager::GLResourceManager() {
+GLResourceManager::GLResourceManager() :
+    residency_(DEFAULT_MEMORY_BUDGET)
+{
 
 }
 
+// Render targets hold what was drawn into them, which can't be uploaded again
+static bool IsRenderTarget(const GLTextureBase& texture) {
+    return dynamic_cast<const GLRenderableTexture*>(&texture) != nullptr || dynamic_cast<const GLRenderableCubeMap*>(&texture) != nullptr;
+}
+
+void GLResourceManager::BeginFrame() {
+    // UIDs are unique across assets, so an evicted one is in one of the two
+    for (uint64_t uid : residency_.BeginFrame()) {
+        meshes_.erase(uid);
+        textures_.erase(uid);
+    }
+}
+
+GLResourceManager::MemoryStats GLResourceManager::GetMemoryStats() const {
+    MemoryStats stats;
+    for (auto& kv : meshes_) stats.meshes += kv.second->GetMemorySize();
+    for (auto& kv : textures_) {
+        const GLTextureBase& texture = *kv.second;
+        if (IsRenderTarget(texture)) stats.render_targets += texture.GetMemorySize();
+        else if (dynamic_cast<const GLCubeMap*>(&texture) != nullptr) stats.cubemaps += texture.GetMemorySize();
+        else stats.textures += texture.GetMemorySize();
+    }
+    stats.evictions = residency_.GetEvictions();
+    return stats;
+}
+
 GLMesh& GLResourceManager::GetGLMesh(Mesh &mesh) {
     uint64_t uid = mesh.GetUID();
-    if (meshes_.count(uid) < 1) {
-        meshes_[uid] = std::make_unique<GLMesh>(mesh);
-        meshes_[uid]->MarkUpdated();
-    } else if (meshes_[uid]->IsDirty()) {
-        meshes_[uid]->SetMeshData(mesh);
-        meshes_[uid]->MarkUpdated();
+    std::unique_ptr<GLMesh>& glmesh = meshes_[uid];
+    if (!residency_.Use(uid)) {
+        glmesh = std::make_unique<GLMesh>(mesh);
+        glmesh->MarkUpdated();
+        residency_.Add(uid, glmesh->GetMemorySize());
+    } else if (glmesh->IsDirty()) {
+        glmesh->SetMeshData(mesh);
+        glmesh->MarkUpdated();
+        residency_.Add(uid, glmesh->GetMemorySize());
     }
-    return *meshes_[uid];
+    return *glmesh;
 }
 
 GLTextureBase& GLResourceManager::GetGLTexture(Asset &asset) {
     uint64_t uid = asset.GetUID();
-    // TODO: Check if the texture is dirty (not possible atm)
-    if (textures_.count(uid) < 1) {
+    std::unique_ptr<GLTextureBase>& gltexture = textures_[uid];
+    if (!residency_.Use(uid)) {
         switch (asset.GetType()) {
             case AssetType::Texture:
-                textures_[uid] = std::make_unique<GLTexture2D>(dynamic_cast<Texture&>(asset));
+                gltexture = std::make_unique<GLTexture2D>(dynamic_cast<Texture&>(asset));
                 break;
             case AssetType::RenderableTexture:
-                textures_[uid] = std::make_unique<GLRenderableTexture>(dynamic_cast<RenderableTexture&>(asset));
+                gltexture = std::make_unique<GLRenderableTexture>(dynamic_cast<RenderableTexture&>(asset));
                 break;
             case AssetType::Cubemap:
-                textures_[uid] = std::make_unique<GLCubeMap>(dynamic_cast<Cubemap&>(asset));
+                gltexture = std::make_unique<GLCubeMap>(dynamic_cast<Cubemap&>(asset));
                 break;
             case AssetType::RenderableCubemap:
-                textures_[uid] = std::make_unique<GLRenderableCubeMap>(dynamic_cast<RenderableCubemap&>(asset));
+                gltexture = std::make_unique<GLRenderableCubeMap>(dynamic_cast<RenderableCubemap&>(asset));
                 break;
             default:
                 // Other types don't have direct opengl representations
                 break;
         }
-        textures_[uid]->MarkUpdated();
-    } else if (textures_[uid]->IsDirty()) {
+        gltexture->MarkUpdated();
+        residency_.Add(uid, gltexture->GetMemorySize(), IsRenderTarget(*gltexture));
+    } else if (gltexture->IsDirty()) {
+        // The asset changed since it was uploaded, e.g. its image was replaced
         switch (asset.GetType()) {
             case AssetType::Texture: {
-                GLTexture2D* gltex = dynamic_cast<GLTexture2D*>(textures_[uid].get());
+                GLTexture2D* gltex = dynamic_cast<GLTexture2D*>(gltexture.get());
                 gltex->SetTextureData(dynamic_cast<Texture&>(asset));
                 break; }
             case AssetType::RenderableTexture: {
-                GLRenderableTexture* gltex = dynamic_cast<GLRenderableTexture*>(textures_[uid].get());
+                GLRenderableTexture* gltex = dynamic_cast<GLRenderableTexture*>(gltexture.get());
                 gltex->SetResolution(dynamic_cast<RenderableTexture&>(asset).GetResolution());
                 break; }
             case AssetType::Cubemap: {
-                GLCubeMap* glcubemap = dynamic_cast<GLCubeMap*>(textures_[uid].get());
+                GLCubeMap* glcubemap = dynamic_cast<GLCubeMap*>(gltexture.get());
                 glcubemap->SetData(dynamic_cast<Cubemap&>(asset));
                 break; }
             case AssetType::RenderableCubemap: {
-                GLRenderableCubeMap* glcubemap = dynamic_cast<GLRenderableCubeMap*>(textures_[uid].get());
+                GLRenderableCubeMap* glcubemap = dynamic_cast<GLRenderableCubeMap*>(gltexture.get());
                 glcubemap->SetResolution(dynamic_cast<RenderableCubemap&>(asset).GetResolution());
                 break; }
             default:
                 // Other types don't have direct opengl representations
                 break;
         }
-        textures_[uid]->MarkUpdated();
+        gltexture->MarkUpdated();
+        residency_.Add(uid, gltexture->GetMemorySize(), IsRenderTarget(*gltexture));
     }
-    return *textures_[uid];
+    return *gltexture;
 }
 
 GLShaderProgram& GLResourceManager::GetGLShaderProgram(ShaderProgram& program) {
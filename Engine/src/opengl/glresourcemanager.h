@@ -14,19 +14,43 @@
 #include <opengl/gltexturebase.h>
 #include <opengl/glmesh.h>
 #include <opengl/glshaderprogram.h>
+#include <opengl/glresidency.h>
 #include <resources.h>
 
-// TODO: Have a limited size cache depending on the GPU Memory Size
+// Keeps the OpenGL copies of assets, uploading them again when the asset changes.
+// Meshes and textures are freed, least recently used first, once they take more memory than the budget,
+// and are uploaded again on their next use.
 class GLResourceManager {
 public:
+    // Resident video memory in bytes, by type of resource
+    struct MemoryStats {
+        size_t meshes = 0;
+        size_t textures = 0;
+        size_t cubemaps = 0;
+        size_t render_targets = 0; // Renderable textures and cubemaps, which are never evicted
+        unsigned int evictions = 0; // Since the manager was created
+        size_t GetTotal() const { return meshes + textures + cubemaps + render_targets; }
+    };
+
+    static const size_t DEFAULT_MEMORY_BUDGET = size_t(512) << 20;
+
     GLResourceManager();
 
+    // Call before drawing a frame. If over budget, evicts what the last frame didn't use, oldest first.
+    // Everything the last frame used stays, so a scene that needs more than the budget doesn't upload every frame.
+    void BeginFrame();
+    // 0 for no limit
+    void SetMemoryBudget(size_t bytes) { residency_.SetBudget(bytes); }
+    size_t GetMemoryBudget() const { return residency_.GetBudget(); }
+    MemoryStats GetMemoryStats() const;
+
     GLMesh& GetGLMesh(Mesh& mesh);
     GLShaderProgram& GetGLShaderProgram(ShaderProgram& program);
     GLTextureBase& GetGLTexture(Asset& asset);
 
-    // TODO: Every X Render cycles we can cull the cache of unused objects
 protected:
+    // Meshes and textures, which are only here while residency_ has them
+    GLResidency residency_;
     // UID instead of name as key because name of assets might not be unique if we have two scenes loaded at once for instance.
     std::unordered_map<uint64_t, std::unique_ptr<GLMesh>> meshes_;
     std::unordered_map<uint64_t, std::unique_ptr<GLShaderProgram>> shader_programs_;
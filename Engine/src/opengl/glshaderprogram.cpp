@@ -13,6 +13,9 @@
 #include <fileio.h>
 #include <algorithm>
 #include <opengl/glerror.h>
+#include <opengl/gluniformblocks.h>
+
+uint64_t GLShaderProgram::uniforms_version_counter_ = 0;
 
 GLSLShader::GLSLShader(const std::string &source, GLenum GL_shader_type) {
     // Ask OpenGL to allocate a Shader object
@@ -27,7 +30,10 @@ GLSLShader::~GLSLShader() { glDeleteShader(shader_); }
 GLint GLSLShader::GetID() { return shader_; }
 
 GLShaderProgram::GLShaderProgram(const std::string& name) :
-    ShaderProgram(name)
+    ShaderProgram(name),
+    uniforms_version_(++uniforms_version_counter_),
+    instanced_(false),
+    instance_model_matrix_(false)
 {
     program_ = glCreateProgram();
 
@@ -38,7 +44,10 @@ GLShaderProgram::GLShaderProgram(const std::string& name) :
 }
 
 GLShaderProgram::GLShaderProgram(const ShaderProgram& program) :
-    ShaderProgram(program.GetName(), &program)
+    ShaderProgram(program.GetName(), &program),
+    uniforms_version_(++uniforms_version_counter_),
+    instanced_(false),
+    instance_model_matrix_(false)
 {
     program_ = glCreateProgram();
     VertexShader.ValueSet.Connect(this, &GLShaderProgram::OnSetVertexShader);
@@ -253,6 +262,17 @@ GLint GLShaderProgram::GetUniformLocation(const std::string &name) {
 void GLShaderProgram::QueryUniforms(GLuint shader_program) {
     uniform_locations_.clear();
     uniforms_list_.clear();
+    uniforms_version_ = ++uniforms_version_counter_;
+    instanced_ = glGetAttribLocation(shader_program, "instance_position") >= 0;
+    instance_model_matrix_ = glGetAttribLocation(shader_program, "instance_model_matrix") >= 0;
+
+    // Attach the per-frame blocks, if declared, to the buffers the renderer binds
+    GLuint block_index = glGetUniformBlockIndex(shader_program, GL_CAMERA_BLOCK_NAME);
+    if (block_index != GL_INVALID_INDEX) glUniformBlockBinding(shader_program, block_index, GL_CAMERA_BLOCK_BINDING);
+    block_index = glGetUniformBlockIndex(shader_program, GL_LIGHT_BLOCK_NAME);
+    if (block_index != GL_INVALID_INDEX) glUniformBlockBinding(shader_program, block_index, GL_LIGHT_BLOCK_BINDING);
+    block_index = glGetUniformBlockIndex(shader_program, GL_CLUSTER_BLOCK_NAME);
+    if (block_index != GL_INVALID_INDEX) glUniformBlockBinding(shader_program, block_index, GL_CLUSTER_BLOCK_BINDING);
 
     GLCheckError();
     GLint num_uniforms = 0;
@@ -270,6 +290,8 @@ void GLShaderProgram::QueryUniforms(GLuint shader_program) {
         std::string name((char*)&name_data[0], name_length);
         GLint location = glGetUniformLocation(shader_program, &name_data[0]);
         GLCheckError();
+        // Members of uniform blocks have no location, their values come from buffers
+        if (location < 0) continue;
 
         // If it's an array, remove the suffixed [0]
         if (array_size > 1) name = name.substr(0, name.size() - 3);
@@ -279,8 +301,8 @@ void GLShaderProgram::QueryUniforms(GLuint shader_program) {
         uniform_locations_[name] = std::make_pair(location, type);
         uniforms_list_.push_back(std::make_pair(name, type));
     }
-    assert(uniforms_list_.size() == (unsigned int) num_uniforms);
-    assert(uniform_locations_.size() == (unsigned int) num_uniforms);
+    assert(uniforms_list_.size() <= (unsigned int) num_uniforms);
+    assert(uniform_locations_.size() == uniforms_list_.size());
     GLCheckError();
 }
 
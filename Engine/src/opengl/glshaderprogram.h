@@ -32,7 +32,14 @@ public:
             {"color", 2},
             {"texcoord", 3},
             {"binormal", 4},
-            {"tangent", 5}
+            {"tangent", 5},
+            // Per-instance, see GLMesh::RenderInstanced
+            {"instance_position", 6},
+            {"instance_rotation", 7},
+            {"instance_color", 8},
+            {"instance_age", 9},
+            // A mat4, takes locations 10 to 13. See GLMesh::RenderInstancedMatrices.
+            {"instance_model_matrix", 10}
         };
         return attribute_locations;
     }
@@ -46,6 +53,13 @@ public:
     virtual std::vector<std::pair<std::string, DataType>> GetShaderInputs() const override;
     std::map<std::string, std::pair<GLint, DataType>> GetUniformLocations() const;
     GLint GetUniformLocation(const std::string& name);
+    // Changes every time the program is relinked, so anything holding locations knows to look them up again
+    uint64_t GetUniformsVersion() const { return uniforms_version_; }
+    // Whether the vertex shader reads per-instance attributes, so one instanced draw can render many copies
+    bool IsInstanced() const { return instanced_; }
+    // Whether the vertex shader takes its model matrix from the instance_model_matrix attribute instead of
+    // the model_matrix uniform, so copies of a mesh with different transforms can be drawn in one call
+    bool HasInstanceModelMatrix() const { return instance_model_matrix_; }
 protected:
     const std::string vert_source_ =
         "#version 150\n"
@@ -70,6 +84,10 @@ protected:
     GLuint program_;
     std::map<std::string, std::pair<GLint, DataType>> uniform_locations_;
     std::vector<std::pair<std::string, DataType>> uniforms_list_;
+    uint64_t uniforms_version_;
+    static uint64_t uniforms_version_counter_;
+    bool instanced_;
+    bool instance_model_matrix_;
     std::map<GLenum, std::unique_ptr<GLSLShader>> attached_shaders_;
     // Internal calls that actually do the work
     void OnSetVertexShader(std::string path);
@@ -42,6 +42,7 @@ void GLTexture2D::SetTextureData(const Texture& tex) {
     // Load the data from the image buffer to define the GLTexture
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, flipped);
     delete[] flipped;
+    memory_size_ = size_t(width) * height * CHANNELS * 4 / 3; // The mipmaps add a third
 
     // Set texture additional properties
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -12,7 +12,8 @@
 
 GLTextureBase::GLTextureBase(const Cacheable& cacheable, GLuint texture_type)
     : Cacheable(&cacheable),
-      texture_type_(texture_type)
+      texture_type_(texture_type),
+      memory_size_(0)
 {
     glGenTextures(1, &texture_);
 }
@@ -19,11 +19,14 @@ public:
     virtual ~GLTextureBase();
 
     GLuint GetTextureId() const { return texture_; }
+    // Bytes of video memory the texture and any buffers rendered with it take
+    size_t GetMemorySize() const { return memory_size_; }
     void Bind(GLenum texture_unit) const;
     void Unbind(GLenum texture_unit) const;
 protected:
     GLuint texture_;
     GLuint texture_type_;
+    size_t memory_size_;
 };
 
 #endif // GLTEXTUREBASE_H
@@ -0,0 +1,118 @@
+#ifndef GLUNIFORMBLOCKS_H
+#define GLUNIFORMBLOCKS_H
+
+#include <vectors.h>
+#include <glinclude.h>
+
+// Per-frame data shared by every draw, uploaded once into uniform buffers and bound to fixed binding points.
+// A shader opts in by declaring the blocks below, it keeps using the member names as before:
+//
+//   layout(std140) uniform CameraBlock {
+//       mat4 view_matrix;
+//       mat4 projection_matrix;
+//       float screen_width;
+//       float screen_height;
+//   };
+//
+//   layout(std140) uniform LightBlock {
+//       vec3 dir_light_ambient[4];     vec3 dir_light_intensity[4];     vec3 dir_light_direction[4];
+//       vec3 point_light_ambient[4];   vec3 point_light_intensity[4];   vec3 point_light_position[4];
+//       float point_light_atten_const[4]; float point_light_atten_linear[4]; float point_light_atten_quad[4];
+//       vec3 area_light_ambient[4];    vec3 area_light_intensity[4];    vec3 area_light_position[4];
+//       float area_light_atten_const[4];  float area_light_atten_linear[4];  float area_light_atten_quad[4];
+//   };
+//
+// Shaders declaring plain uniforms with those names still get them set per draw.
+//
+// LightBlock holds at most LIGHT_BLOCK_MAX_LIGHTS lights of each kind. Shaders that need every light use
+// the clustered lights instead: all lights in texture buffers, and per view frustum cluster lists of the
+// point and area lights reaching into it (see GLLightClusters).
+//
+//   layout(std140) uniform ClusterBlock {
+//       uvec4 cluster_dims;    // Clusters in x, y and z, then the number of directional lights
+//       vec4 cluster_slicing;  // Near depth, scale and bias of the depth slices
+//       vec4 light_ambient;    // Ambient of all lights summed
+//   };
+//   uniform samplerBuffer light_data;      // 3 texels per light, directional lights first:
+//                                          // (direction, 0) (intensity, 0) (ambient, 0) or
+//                                          // (position, atten_const) (intensity, atten_linear) (ambient, atten_quad)
+//   uniform usamplerBuffer light_grid;     // Per cluster, offset and count in light_indices
+//   uniform usamplerBuffer light_indices;  // Point and area light numbers, counted after the directional lights
+
+#define GL_CAMERA_BLOCK_NAME "CameraBlock"
+#define GL_LIGHT_BLOCK_NAME "LightBlock"
+#define GL_CAMERA_BLOCK_BINDING 0
+#define GL_LIGHT_BLOCK_BINDING 1
+#define GL_CLUSTER_BLOCK_NAME "ClusterBlock"
+#define GL_CLUSTER_BLOCK_BINDING 2
+
+#define LIGHT_BLOCK_MAX_LIGHTS 4
+
+// std140 layout of CameraBlock
+struct GLCameraBlock {
+    glm::mat4 view_matrix;
+    glm::mat4 projection_matrix;
+    float screen_width;
+    float screen_height;
+    float pad[2];
+};
+
+// Members of LightBlock, in block order
+enum GLLightMember {
+    DirLightAmbient,
+    DirLightIntensity,
+    DirLightDirection,
+    PointLightAmbient,
+    PointLightIntensity,
+    PointLightPosition,
+    PointLightAttenConst,
+    PointLightAttenLinear,
+    PointLightAttenQuad,
+    AreaLightAmbient,
+    AreaLightIntensity,
+    AreaLightPosition,
+    AreaLightAttenConst,
+    AreaLightAttenLinear,
+    AreaLightAttenQuad,
+    GL_LIGHT_MEMBER_COUNT
+};
+
+inline const char* GetLightMemberName(int member) {
+    static const char* const names[GL_LIGHT_MEMBER_COUNT] = {
+        "dir_light_ambient", "dir_light_intensity", "dir_light_direction",
+        "point_light_ambient", "point_light_intensity", "point_light_position",
+        "point_light_atten_const", "point_light_atten_linear", "point_light_atten_quad",
+        "area_light_ambient", "area_light_intensity", "area_light_position",
+        "area_light_atten_const", "area_light_atten_linear", "area_light_atten_quad"
+    };
+    return names[member];
+}
+
+// 3 for vec3 members, 1 for float members
+inline int GetLightMemberSize(int member) {
+    switch (member) {
+        case PointLightAttenConst:
+        case PointLightAttenLinear:
+        case PointLightAttenQuad:
+        case AreaLightAttenConst:
+        case AreaLightAttenLinear:
+        case AreaLightAttenQuad:
+            return 1;
+        default:
+            return 3;
+    }
+}
+
+// std140 layout of LightBlock, every array element takes a vec4 whether it is a vec3 or a float
+struct GLLightBlock {
+    glm::vec4 members[GL_LIGHT_MEMBER_COUNT][LIGHT_BLOCK_MAX_LIGHTS];
+};
+
+// std140 layout of ClusterBlock
+struct GLClusterBlock {
+    glm::uvec4 cluster_dims;
+    glm::vec4 cluster_slicing;
+    glm::vec4 light_ambient;
+};
+
+#endif // GLUNIFORMBLOCKS_H
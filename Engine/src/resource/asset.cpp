@@ -9,4 +9,4 @@
  ****************************************************************************/
 #include "asset.h"
 
-uint64_t Asset::uid_counter_ = 0;
+std::atomic<uint64_t> Asset::uid_counter_(0);
@@ -13,6 +13,7 @@
 #include <animator.h>
 
 #include <properties/property.h>
+#include <atomic>
 
 
 // Asset represents things like Textures, Shaders, Materials, that are used by the Scene and SceneObjects.
@@ -48,7 +49,8 @@ public:
     Signal0<void> Deleted;
 
 protected:
-    static uint64_t uid_counter_; // Program might break if you make more than 9223372036854775807 objects
+    // Atomic as the asset loader's threads create assets too
+    static std::atomic<uint64_t> uid_counter_; // Program might break if you make more than 9223372036854775807 objects
     uint64_t uid_; // Unique identifier among Assets
     std::string name_;
     bool internal_;
@@ -0,0 +1,185 @@
+#include "assetloader.h"
+
+#include <resource/importers.h>
+#include <QRunnable>
+#include <algorithm>
+
+typedef std::chrono::high_resolution_clock Clock;
+
+namespace {
+
+double MillisecondsBetween(Clock::time_point start, Clock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+class TextureJob : public QRunnable {
+public:
+    TextureJob(AssetLoader& loader, AssetLoad* load) : loader_(loader), load_(load) {}
+    void run() override {
+        Clock::time_point start = Clock::now();
+        load_->wait_ms = MillisecondsBetween(load_->submitted, start);
+        try {
+            load_->texture = Importers::ImportTexture(load_->name, load_->path);
+        } catch (const FileIOException& e) {
+            load_->error = e.what();
+        }
+        load_->import_ms = MillisecondsBetween(start, Clock::now());
+        loader_.Finish(load_);
+    }
+private:
+    AssetLoader& loader_;
+    AssetLoad* load_;
+};
+
+class MeshJob : public QRunnable {
+public:
+    MeshJob(AssetLoader& loader, AssetLoad* load) : loader_(loader), load_(load) {}
+    void run() override {
+        Clock::time_point start = Clock::now();
+        load_->wait_ms = MillisecondsBetween(load_->submitted, start);
+        try {
+            Importers::MeshImportInfo info;
+            load_->mesh = Importers::ImportMesh(load_->name, load_->path, &info);
+            // Found here rather than on the GUI thread when the mesh is first drawn
+            load_->mesh->CalculateBinormalsAndTangents();
+            load_->from_cache = info.from_cache;
+            load_->warning = info.warning;
+        } catch (const FileIOException& e) {
+            load_->error = e.what();
+        }
+        load_->import_ms = MillisecondsBetween(start, Clock::now());
+        loader_.Finish(load_);
+    }
+private:
+    AssetLoader& loader_;
+    AssetLoad* load_;
+};
+
+// Shared by the jobs of one cubemap's faces, the last of them to finish deletes it
+struct CubemapFaces {
+    AssetLoad* load;
+    std::unique_ptr<Texture> faces[6];
+    std::string errors[6];
+    Clock::time_point starts[6];
+    double import_ms[6];
+    QAtomicInt remaining;
+};
+
+class CubemapFaceJob : public QRunnable {
+public:
+    CubemapFaceJob(AssetLoader& loader, CubemapFaces* faces, int face) : loader_(loader), faces_(faces), face_(face) {}
+    void run() override {
+        Clock::time_point start = Clock::now();
+        faces_->starts[face_] = start;
+        try {
+            faces_->faces[face_] = Importers::ImportTexture(faces_->load->name, Importers::GetCubemapFacePath(faces_->load->path, face_));
+        } catch (const FileIOException& e) {
+            faces_->errors[face_] = e.what();
+        }
+        faces_->import_ms[face_] = MillisecondsBetween(start, Clock::now());
+        // Ordered so the last face sees what the others wrote
+        if (faces_->remaining.fetchAndAddOrdered(-1) == 1) Assemble();
+    }
+private:
+    AssetLoader& loader_;
+    CubemapFaces* faces_;
+    int face_;
+
+    void Assemble() {
+        AssetLoad* load = faces_->load;
+        Clock::time_point first_start = *std::min_element(faces_->starts, faces_->starts + Cubemap::NUM_CUBEMAP_FACES);
+        load->wait_ms = MillisecondsBetween(load->submitted, first_start);
+        load->import_ms = 0.0;
+        const unsigned char* images[6];
+        unsigned int resolution = 0;
+        for (int i = 0; i < Cubemap::NUM_CUBEMAP_FACES; i++) {
+            load->import_ms += faces_->import_ms[i];
+            if (!load->error.empty()) continue;
+            Texture* face = faces_->faces[i].get();
+            if (face == nullptr) {
+                load->error = faces_->errors[i];
+            } else if (face->GetWidth() != face->GetHeight() || (i > 0 && face->GetWidth() != resolution)) {
+                load->error = "Cubemap faces of \"" + load->path + "\" are not squares of the same size";
+            } else {
+                resolution = face->GetWidth();
+                images[i] = face->GetImage();
+            }
+        }
+        if (load->error.empty()) {
+            load->cubemap = std::make_unique<Cubemap>(load->name, resolution, images);
+            load->cubemap->Get<FileProperty>("Path")->Set(load->path);
+        }
+        delete faces_;
+        loader_.Finish(load);
+    }
+};
+
+}
+
+AssetLoader::AssetLoader() :
+    finished_(nullptr),
+    pending_(0)
+{
+}
+
+AssetLoader::~AssetLoader() {
+    pool_.waitForDone(-1);
+    TakeFinished();
+}
+
+void AssetLoader::Start(std::unique_ptr<AssetLoad> load) {
+    AssetLoad* job_load = load.release();
+    job_load->from_cache = false;
+    job_load->wait_ms = 0.0;
+    job_load->import_ms = 0.0;
+    job_load->next = nullptr;
+    job_load->submitted = Clock::now();
+    pending_.fetchAndAddOrdered(1);
+
+    switch (job_load->type) {
+        case AssetType::Texture:
+            pool_.start(new TextureJob(*this, job_load));
+            break;
+        case AssetType::Cubemap: {
+            CubemapFaces* faces = new CubemapFaces();
+            faces->load = job_load;
+            faces->remaining.store(Cubemap::NUM_CUBEMAP_FACES);
+            for (int i = 0; i < Cubemap::NUM_CUBEMAP_FACES; i++) pool_.start(new CubemapFaceJob(*this, faces, i));
+            break; }
+        case AssetType::Mesh:
+            pool_.start(new MeshJob(*this, job_load));
+            break;
+        default:
+            job_load->error = "Assets of this type can't be loaded from \"" + job_load->path + "\"";
+            Finish(job_load);
+            break;
+    }
+}
+
+void AssetLoader::Finish(AssetLoad* load) {
+    // Push onto the front of the list, retrying if another worker got there in between
+    AssetLoad* head;
+    do {
+        head = finished_.loadAcquire();
+        load->next = head;
+    } while (!finished_.testAndSetRelease(head, load));
+}
+
+std::vector<std::unique_ptr<AssetLoad>> AssetLoader::TakeFinished() {
+    // Taking the whole list at once leaves nothing for a concurrent push to race with
+    AssetLoad* load = finished_.fetchAndStoreAcquire(nullptr);
+    std::vector<std::unique_ptr<AssetLoad>> finished;
+    while (load != nullptr) {
+        AssetLoad* next = load->next;
+        load->next = nullptr;
+        finished.emplace_back(load);
+        load = next;
+    }
+    std::reverse(finished.begin(), finished.end());
+    pending_.fetchAndAddOrdered(-(int)finished.size());
+    return finished;
+}
+
+void AssetLoader::WaitForDone() {
+    pool_.waitForDone(-1);
+}
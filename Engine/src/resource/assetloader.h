@@ -0,0 +1,63 @@
+#ifndef ASSETLOADER_H
+#define ASSETLOADER_H
+
+#include <animator.h>
+#include <resource/texture.h>
+#include <resource/cubemap.h>
+#include <resource/mesh.h>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <chrono>
+
+// One asset being imported off the GUI thread, and what became of it
+struct AssetLoad {
+    AssetType type;
+    std::string name;
+    std::string path;
+    uint64_t placeholder_uid; // The asset standing in until this one is published
+    unsigned int group;
+
+    // Exactly one of these is set once the import succeeded
+    std::unique_ptr<Texture> texture;
+    std::unique_ptr<Cubemap> cubemap;
+    std::unique_ptr<Mesh> mesh;
+    std::string error; // Set instead if it failed
+    std::string warning;
+    bool from_cache;
+
+    std::chrono::high_resolution_clock::time_point submitted;
+    double wait_ms; // Queued before a worker took it up
+    double import_ms; // Reading and decoding on the workers, summed over a cubemap's faces
+
+    AssetLoad* next; // Link in the loader's list of finished loads
+};
+
+// Imports textures, cubemaps and meshes on a thread pool.
+// Workers push finished loads onto a lock-free list that the GUI thread takes whole, so neither ever waits on the other.
+// A cubemap's six faces are decoded as separate jobs, and whichever face finishes last puts the cubemap together.
+class AssetLoader {
+public:
+    AssetLoader();
+    // Waits for the loads in progress and drops any that were never taken
+    ~AssetLoader();
+
+    // Starts importing load->path as load->type
+    void Start(std::unique_ptr<AssetLoad> load);
+    // Every load finished since the last call, in the order they finished
+    std::vector<std::unique_ptr<AssetLoad>> TakeFinished();
+    // Blocks until every load started has finished
+    void WaitForDone();
+    // Loads started and not yet taken
+    int GetPendingCount() const { return pending_.load(); }
+
+    // Called by the jobs from the pool's threads
+    void Finish(AssetLoad* load);
+
+private:
+    QThreadPool pool_;
+    QAtomicPointer<AssetLoad> finished_; // Most recently finished first
+    QAtomicInt pending_;
+};
+
+#endif // ASSETLOADER_H
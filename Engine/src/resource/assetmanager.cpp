@@ -11,7 +11,6 @@
 #include <meshprocessing.h>
 #include <glm/gtx/transform.hpp>
 #include <resource/assetmanager.h>
-#include <resource/importers.h>
 #include <resource/cubemap.h>
 #include <resource/texture.h>
 #include <resource/material.h>
@@ -25,7 +24,9 @@ template<> AssetManager* Singleton<AssetManager>::_instance_ = nullptr;
 
 AssetManager::AssetManager(ShaderFactory& shader_factory) :
     Singleton<AssetManager>(),
-    shader_factory_(&shader_factory)
+    shader_factory_(&shader_factory),
+    open_load_group_(0),
+    next_load_group_(1)
 {
     // Setup default assets
     static const unsigned char texture_data[16] = {
@@ -88,6 +89,7 @@ AssetManager::AssetManager(ShaderFactory& shader_factory) :
     arrow_mesh->Append(*pyramid_mesh, arrowhead_transform.GetMatrix());
 
     // Import standard meshes
+    default_load_group_ = BeginLoadGroup("Default assets");
     LoadMesh("Teapot", "assets/teapot.obj", true);
     LoadMesh("Spikey", "assets/spikey.obj", true);
     LoadMesh("Bunny", "assets/bunny.obj", true);
@@ -103,6 +105,7 @@ AssetManager::AssetManager(ShaderFactory& shader_factory) :
     Material* textured_material = CreateMaterial("Textured Material", false);
     textured_material->Shader.Set(tex_shader);
     LoadTexture("Checkers Texture", "assets/checkers.png");
+    EndLoadGroup();
     auto texture = GetTexture("Checkers Texture");
     textured_material->Uniforms.Get<TextureProperty>("DiffuseMap")->Set(texture);
 
@@ -126,6 +129,14 @@ AssetManager::AssetManager(ShaderFactory& shader_factory) :
     blinn_phong_mat->Uniforms.Get<DoubleProperty>("Shininess")->Set(20.0f);
     blinn_phong_mat->Uniforms.Get<TextureProperty>("Diffuse")->SetColor(glm::vec3(0.75f, 0.0f, 0.0f));
 
+    // Particle Shader and material
+    ShaderProgram* particle_shader = CreateShaderProgram("Particle Shader", false);
+    particle_shader->SetShader("Particle Vert", particle_vert_src_, ShaderType::Vertex);
+    particle_shader->SetShader("Particle Frag", particle_frag_src_, ShaderType::Fragment);
+    Material* particle_mat = CreateMaterial("Particle Material", false);
+    particle_mat->Shader.Set(particle_shader);
+    particle_mat->Uniforms.Get<DoubleProperty>("Shininess")->Set(20.0f);
+
     // Toon Shader and material
     ShaderProgram* toon_shader = CreateShaderProgram("Toon Shader", false);
     toon_shader->SetShader("Toon Vert", blinn_phong_vert_src_, ShaderType::Vertex);
@@ -212,36 +223,157 @@ AssetManager::~AssetManager() {
 }
 
 void AssetManager::LoadTexture(const std::string& name, const std::string& path) {
-    try {
-        if (textures_.count(name) > 0) UnloadTexture(name);
-        textures_.emplace(std::make_pair(name, Importers::ImportTexture(name, path)));
-        AssetCreated.Emit(*textures_[name]);
-    } catch (const FileIOException& e) {
-        Debug::Log.WriteLine(e.what(), Priority::Error);
-    }
+    if (textures_.count(name) > 0) UnloadTexture(name);
+    textures_[name] = std::make_unique<Texture>(name, default_texture_->GetWidth(), default_texture_->GetHeight(), default_texture_->GetImage());
+    textures_[name]->Get<FileProperty>("Path")->Set(path);
+    AssetCreated.Emit(*textures_[name]);
+    StartLoad(AssetType::Texture, *textures_[name], path);
 }
 
 void AssetManager::LoadCubemap(const std::string& name, const std::string& path) {
-    try {
-        if (cubemaps_.count(name) > 0) UnloadCubemap(name);
-        cubemaps_.emplace(std::make_pair(name, Importers::ImportCubemap(name, path)));
-        AssetCreated.Emit(*cubemaps_[name]);
-    } catch (const FileIOException& e) {
-        Debug::Log.WriteLine(e.what(), Priority::Error);
-    }
+    if (cubemaps_.count(name) > 0) UnloadCubemap(name);
+    const unsigned char* faces[6];
+    for (int i = 0; i < Cubemap::NUM_CUBEMAP_FACES; i++) faces[i] = default_cubemap_->GetFace(i);
+    cubemaps_[name] = std::make_unique<Cubemap>(name, default_cubemap_->GetResolution(), faces);
+    cubemaps_[name]->Get<FileProperty>("Path")->Set(path);
+    AssetCreated.Emit(*cubemaps_[name]);
+    StartLoad(AssetType::Cubemap, *cubemaps_[name], path);
 }
 
 void AssetManager::LoadMesh(const std::string& name, const std::string& path, bool internal) {
-    try {
-        if (meshes_.count(name) > 0) UnloadMesh(name);
-        meshes_.emplace(std::make_pair(name, Importers::ImportMesh(name, path)));
-        if (internal) {
-            meshes_[name]->MakeInternal();
+    if (meshes_.count(name) > 0) UnloadMesh(name);
+    std::unique_ptr<Mesh> placeholder = std::make_unique<Mesh>(name);
+    if (meshes_.count("Cube") > 0) placeholder->Append(*meshes_["Cube"]);
+    placeholder->Get<FileProperty>("Path")->Set(path);
+    if (internal) {
+        placeholder->MakeInternal();
+    }
+    meshes_[name] = std::move(placeholder);
+    AssetCreated.Emit(*meshes_[name]);
+    StartLoad(AssetType::Mesh, *meshes_[name], path);
+}
+
+void AssetManager::StartLoad(AssetType type, Asset& placeholder, const std::string& path) {
+    std::unique_ptr<AssetLoad> load = std::make_unique<AssetLoad>();
+    load->type = type;
+    load->name = placeholder.GetName();
+    load->path = path;
+    load->placeholder_uid = placeholder.GetUID();
+    load->group = open_load_group_;
+    if (open_load_group_ != 0) {
+        load_groups_[open_load_group_].pending++;
+        load_groups_[open_load_group_].loads++;
+    }
+    loader_.Start(std::move(load));
+}
+
+Asset* AssetManager::GetPlaceholder(const AssetLoad& load) {
+    Asset* asset = nullptr;
+    switch (load.type) {
+        case AssetType::Texture:
+            if (textures_.count(load.name) > 0) asset = textures_[load.name].get();
+            break;
+        case AssetType::Cubemap:
+            if (cubemaps_.count(load.name) > 0) asset = cubemaps_[load.name].get();
+            break;
+        case AssetType::Mesh:
+            if (meshes_.count(load.name) > 0) asset = meshes_[load.name].get();
+            break;
+        default:
+            break;
+    }
+    if (asset == nullptr || asset->GetUID() != load.placeholder_uid) return nullptr;
+    return asset;
+}
+
+int AssetManager::PublishLoads() {
+    std::vector<std::unique_ptr<AssetLoad>> finished = loader_.TakeFinished();
+    for (auto& load : finished) {
+        auto publish_start = std::chrono::high_resolution_clock::now();
+        Asset* placeholder = GetPlaceholder(*load);
+        if (placeholder == nullptr) {
+            // Unloaded or replaced since the load started, nothing wants it now
+        } else if (!load->error.empty()) {
+            Debug::Log.WriteLine(load->error, Priority::Error);
+            if (load->type == AssetType::Texture) UnloadTexture(load->name);
+            else if (load->type == AssetType::Cubemap) UnloadCubemap(load->name);
+            else UnloadMesh(load->name);
+        } else {
+            std::string type_name;
+            if (load->type == AssetType::Texture) {
+                static_cast<Texture*>(placeholder)->TakeData(*load->texture);
+                type_name = "texture";
+            } else if (load->type == AssetType::Cubemap) {
+                static_cast<Cubemap*>(placeholder)->TakeData(*load->cubemap);
+                type_name = "cubemap";
+            } else {
+                static_cast<Mesh*>(placeholder)->TakeData(*load->mesh);
+                type_name = "mesh";
+            }
+            if (!load->warning.empty()) Debug::Log.WriteLine(load->warning, Priority::Warning);
+            AssetLoaded.Emit(*placeholder);
+
+            auto published = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double, std::milli> publish_time = published - publish_start;
+            std::chrono::duration<double, std::milli> total_time = published - load->submitted;
+            Debug::Log.WriteLine("Loaded " + type_name + " \"" + load->name + "\" in " + std::to_string(total_time.count()) + " ms: " +
+                                 std::to_string(load->wait_ms) + " ms queued, " +
+                                 std::to_string(load->import_ms) + " ms importing" + (load->from_cache ? " from cache, " : ", ") +
+                                 std::to_string(publish_time.count()) + " ms publishing");
         }
-        AssetCreated.Emit(*meshes_[name]);
-    } catch (const FileIOException& e) {
-        Debug::Log.WriteLine(e.what(), Priority::Error);
+        FinishLoadInGroup(load->group);
+    }
+    return (int)finished.size();
+}
+
+void AssetManager::FinishLoads() {
+    loader_.WaitForDone();
+    PublishLoads();
+}
+
+unsigned int AssetManager::BeginLoadGroup(const std::string& name) {
+    if (open_load_group_ != 0) EndLoadGroup();
+    open_load_group_ = next_load_group_++;
+    LoadGroup& group = load_groups_[open_load_group_];
+    group.name = name;
+    group.pending = 0;
+    group.loads = 0;
+    group.open = true;
+    group.started = std::chrono::high_resolution_clock::now();
+    return open_load_group_;
+}
+
+void AssetManager::EndLoadGroup() {
+    unsigned int group = open_load_group_;
+    open_load_group_ = 0;
+    if (load_groups_.count(group) < 1) return;
+    load_groups_[group].open = false;
+    ResolveLoadGroup(group);
+}
+
+void AssetManager::WaitForLoadGroup(unsigned int group) {
+    if (IsLoadGroupResident(group)) return;
+    // The pool can't wait on only some of its jobs, so this waits for every load
+    FinishLoads();
+}
+
+void AssetManager::FinishLoadInGroup(unsigned int group) {
+    if (load_groups_.count(group) < 1) return;
+    load_groups_[group].pending--;
+    ResolveLoadGroup(group);
+}
+
+void AssetManager::ResolveLoadGroup(unsigned int group) {
+    auto it = load_groups_.find(group);
+    if (it == load_groups_.end() || it->second.pending > 0 || it->second.open) return;
+
+    if (it->second.loads > 0) {
+        std::chrono::duration<double, std::milli> load_time = std::chrono::high_resolution_clock::now() - it->second.started;
+        Debug::Log.WriteLine(it->second.name + ": " + std::to_string(it->second.loads) + " assets resident after " +
+                             std::to_string(load_time.count()) + " ms", Priority::Status);
     }
+    load_groups_.erase(it);
+    LoadGroupResident.Emit(group);
 }
 
 Mesh* AssetManager::CreateMesh(const std::string &name, MeshType meshtype, bool internal, bool hidden) {
@@ -13,6 +13,7 @@
 #include <animator.h>
 
 #include <singleton.h>
+#include <resource/assetloader.h>
 
 class ShaderFactory;
 class Asset;
@@ -30,12 +31,31 @@ public:
     AssetManager(ShaderFactory &shader_factory);
     ~AssetManager();
 
-    // Load from Disk. If failed, has no effect and writes a log message.
+    // Load from Disk on the asset loader's threads. The asset is created right away as a placeholder, a copy of the
+    // default texture or cubemap or of the Cube mesh, and filled in by PublishLoads once it has been imported.
+    // If failed, the placeholder is unloaded and a log message written.
     // If the name already exists, replaces the pre-existing asset.
     void LoadTexture(const std::string& name, const std::string& path);
     void LoadCubemap(const std::string& name, const std::string& path);
     void LoadMesh(const std::string& name, const std::string& path, bool internal=false);
 
+    // Fills in the placeholders of the loads finished so far, call it regularly from the GUI thread.
+    // Returns the number of loads taken.
+    int PublishLoads();
+    // Blocks until every load started has finished, then publishes them
+    void FinishLoads();
+    bool IsLoading() const { return loader_.GetPendingCount() > 0; }
+
+    // Loads started between these belong to one group, which is resident once all of them have been published.
+    // Groups don't nest, beginning one ends any still open. Returns the group's id, never 0.
+    unsigned int BeginLoadGroup(const std::string& name);
+    void EndLoadGroup();
+    bool IsLoadGroupResident(unsigned int group) const { return load_groups_.count(group) == 0; }
+    // Blocks until the group is resident
+    void WaitForLoadGroup(unsigned int group);
+    // The group of the standard assets loaded on construction
+    unsigned int GetDefaultLoadGroup() const { return default_load_group_; }
+
     // Creates an asset in-memory. If the name already exists, returns a nullptr.
     // Internal indicates this asset is not to be serialized (as it is created in the code).
     Mesh* CreateMesh(const std::string& name, MeshType meshtype = MeshType::Triangles, bool internal = true, bool hidden = true); // Returns an empty Mesh
@@ -63,6 +83,8 @@ public:
     // Signals
     Signal1<Asset&> AssetCreated;
     Signal1<uint64_t> AssetDeleted;
+    Signal1<Asset&> AssetLoaded; // Its placeholder was filled in
+    Signal1<unsigned int> LoadGroupResident;
 
     // Used for serialization and UI
     std::vector<Texture*> GetTextures() const;
@@ -95,41 +117,45 @@ protected:
         "out vec3 world_vertex;"
         "out vec3 world_eye;"
         "out vec2 UV;"
-        "uniform mat4 model_matrix;"
-        "uniform mat4 view_matrix;"
-        "uniform mat4 projection_matrix;"
+        // Per-instance so the renderer can batch copies of a mesh, set as a constant attribute for single draws
+        "in mat4 instance_model_matrix;"
+        "layout(std140) uniform CameraBlock {"
+        "	mat4 view_matrix;"
+        "	mat4 projection_matrix;"
+        "	float screen_width;"
+        "	float screen_height;"
+        "};"
         "void main() {"
-        "	mat4 modelview_matrix = view_matrix * model_matrix;"
-        "   mat3 normal_matrix = transpose(inverse(mat3(model_matrix)));"
-        "	world_vertex = vec3(model_matrix * vec4(position, 1.0));"
+        "	mat4 modelview_matrix = view_matrix * instance_model_matrix;"
+        "   mat3 normal_matrix = transpose(inverse(mat3(instance_model_matrix)));"
+        "	world_vertex = vec3(instance_model_matrix * vec4(position, 1.0));"
         "   world_normal = normalize(normal_matrix * normal);"
         "	world_eye = vec3(inverse(view_matrix) * vec4(0.f,0.f,0.f,1.f));"
         "	UV = texcoord;"
         "	gl_Position = projection_matrix * modelview_matrix * vec4(position, 1.0);"
         "}";
 
-    const std::string blinn_phong_frag_src_ =
-        "#version 400\n"
+    // Lights come from the clustered light buffers, so there is no limit on the number of lights
+    const std::string blinn_phong_lighting_src_ =
         "in vec3 world_normal;"
         "in vec3 world_vertex;"
         "in vec3 world_eye;"
         "in vec2 UV;"
         "out vec4 frag_color;"
-        "uniform vec3 point_light_ambient[4];"
-        "uniform vec3 point_light_intensity[4];"
-        "uniform vec3 point_light_position[4];"
-        "uniform float point_light_atten_quad[4];"
-        "uniform float point_light_atten_linear[4];"
-        "uniform float point_light_atten_const[4];"
-        "uniform vec3 dir_light_ambient[4];"
-        "uniform vec3 dir_light_intensity[4];"
-        "uniform vec3 dir_light_direction[4];"
-        "uniform vec3 area_light_intensity[4];"
-        "uniform vec3 area_light_ambient[4];"
-        "uniform vec3 area_light_position[4];"
-        "uniform float area_light_atten_quad[4];"
-        "uniform float area_light_atten_linear[4];"
-        "uniform float area_light_atten_const[4];"
+        "layout(std140) uniform CameraBlock {"
+        "	mat4 view_matrix;"
+        "	mat4 projection_matrix;"
+        "	float screen_width;"
+        "	float screen_height;"
+        "};"
+        "layout(std140) uniform ClusterBlock {"
+        "	uvec4 cluster_dims;"
+        "	vec4 cluster_slicing;"
+        "	vec4 light_ambient;"
+        "};"
+        "uniform samplerBuffer light_data;"
+        "uniform usamplerBuffer light_grid;"
+        "uniform usamplerBuffer light_indices;"
         "uniform sampler2D Emissive;"
         "uniform sampler2D Diffuse;"
         "uniform sampler2D Specular;"
@@ -137,72 +163,111 @@ protected:
         "vec3 EmissiveColor;"
         "vec3 DiffuseColor;"
         "vec3 SpecularColor;"
-        "vec3 DirLightContribution(int light_num) {"
-        "	vec3 N = normalize(world_normal);"
-        "	vec3 V = normalize(world_eye - world_vertex);"
-        "	vec3 L = -normalize(dir_light_direction[light_num]);"
+        "vec3 N;"
+        "vec3 V;"
+        "vec3 Shade(vec3 L, vec3 intensity) {"
         "	vec3 H = normalize(V+L);"
         "	float B = 1.0;"
         "	if (dot(N, L) < 0.00001) { B = 0.0; }"
         "	float diffuseShade = max(dot(N, L), 0.0);"
         "	float shininess = Shininess > 0 ? Shininess : 0.00001;"
         "	float specularShade = B * pow(max(dot(H, N), 0.0), shininess);"
-        "	vec3 ambient = DiffuseColor * dir_light_ambient[light_num];"
-        "	vec3 diffuse = diffuseShade * DiffuseColor * dir_light_intensity[light_num];"
-        "	vec3 specular = specularShade * SpecularColor * dir_light_intensity[light_num];"
-        "	return ambient + diffuse + specular;"
+        "	return (diffuseShade * DiffuseColor + specularShade * SpecularColor) * intensity;"
         "}"
-        "vec3 PointLightContribution(int light_num) {"
-        "	vec3 N = normalize(world_normal);"
-        "	vec3 V = normalize(world_eye - world_vertex);"
-        "	vec3 light_vector = point_light_position[light_num] - world_vertex;"
-        "	vec3 L = normalize(light_vector);"
-        "	vec3 H = normalize(V+L);"
-        "	float r = length(light_vector);"
-        "	float attenuation = point_light_atten_const[light_num] + point_light_atten_linear[light_num] * r + point_light_atten_quad[light_num] * r * r;"
-        "	float luminosity = 0;"
-        "	if (attenuation > 0) { luminosity = 1.0 / attenuation; }"
-        "	float B = 1.0;"
-        "	if (dot(N, L) < 0.00001) { B = 0.0; }"
-        "	float diffuseShade = max(dot(N, L), 0.0);"
-        "	float shininess = Shininess > 0 ? Shininess : 0.00001;"
-        "	float specularShade = B * pow(max(dot(H, N), 0.0), shininess);"
-        "	vec3 ambient = DiffuseColor * point_light_ambient[light_num];"
-        "	vec3 diffuse = diffuseShade * DiffuseColor * point_light_intensity[light_num] * luminosity;"
-        "	vec3 specular = specularShade * SpecularColor * point_light_intensity[light_num] * luminosity;"
-        "	return ambient + diffuse + specular;"
+        "vec3 DirLightContribution(int light_num) {"
+        "	vec3 direction = texelFetch(light_data, light_num * 3).xyz;"
+        "	vec3 intensity = texelFetch(light_data, light_num * 3 + 1).xyz;"
+        "	return Shade(-normalize(direction), intensity);"
         "}"
-        "vec3 AreaLightContribution(int light_num) {"
-        "	vec3 N = normalize(world_normal);"
-        "	vec3 V = normalize(world_eye - world_vertex);"
-        "	vec3 light_vector = area_light_position[light_num] - world_vertex;"
-        "	vec3 L = normalize(light_vector);"
-        "	vec3 H = normalize(V+L);"
+        "vec3 LocalLightContribution(int light_num) {"
+        "	vec4 position = texelFetch(light_data, light_num * 3);"
+        "	vec4 intensity = texelFetch(light_data, light_num * 3 + 1);"
+        "	float atten_quad = texelFetch(light_data, light_num * 3 + 2).w;"
+        "	vec3 light_vector = position.xyz - world_vertex;"
         "	float r = length(light_vector);"
-        "	float attenuation = 1 + area_light_atten_const[light_num] + area_light_atten_linear[light_num] * r + area_light_atten_quad[light_num] * r * r;"
+        "	float attenuation = position.w + intensity.w * r + atten_quad * r * r;"
         "	float luminosity = 0;"
         "	if (attenuation > 0) { luminosity = 1.0 / attenuation; }"
-        "	float B = 1.0;"
-        "	if (dot(N, L) < 0.00001) { B = 0.0; }"
-        "	float diffuseShade = max(dot(N, L), 0.0);"
-        "	float shininess = Shininess > 0 ? Shininess : 0.00001;"
-        "	float specularShade = B * pow(max(dot(H, N), 0.0), shininess);"
-        "	vec3 ambient = DiffuseColor * area_light_ambient[light_num];"
-        "	vec3 diffuse = diffuseShade * DiffuseColor * area_light_intensity[light_num] * luminosity;"
-        "	vec3 specular = specularShade * SpecularColor * area_light_intensity[light_num] * luminosity;"
-        "	return ambient + diffuse + specular;"
+        "	return Shade(normalize(light_vector), intensity.xyz * luminosity);"
+        "}"
+        "int ClusterIndex() {"
+        "	vec4 view_vertex = view_matrix * vec4(world_vertex, 1.0);"
+        "	vec4 clip = projection_matrix * view_vertex;"
+        "	vec2 tile = (clip.xy / clip.w * 0.5 + 0.5) * vec2(cluster_dims.xy);"
+        "	float slice = log(max(-view_vertex.z, cluster_slicing.x)) * cluster_slicing.y + cluster_slicing.z;"
+        "	ivec3 cell = clamp(ivec3(floor(vec3(tile, slice))), ivec3(0), ivec3(cluster_dims.xyz) - 1);"
+        "	return (cell.z * int(cluster_dims.y) + cell.y) * int(cluster_dims.x) + cell.x;"
         "}"
+        "vec3 Lighting() {"
+        "	N = normalize(world_normal);"
+        "	V = normalize(world_eye - world_vertex);"
+        "	vec3 lighting = DiffuseColor * light_ambient.xyz;"
+        "	int dir_count = int(cluster_dims.w);"
+        "	for (int i = 0; i < dir_count; i++) lighting += DirLightContribution(i);"
+        "	uvec2 cluster = texelFetch(light_grid, ClusterIndex()).xy;"
+        "	for (uint i = cluster.x; i < cluster.x + cluster.y; i++) {"
+        "		lighting += LocalLightContribution(dir_count + int(texelFetch(light_indices, int(i)).x));"
+        "	}"
+        "	return lighting;"
+        "}";
+
+    const std::string blinn_phong_frag_src_ = "#version 400\n" + blinn_phong_lighting_src_ +
         "void main() {"
         "   EmissiveColor = texture(Emissive, UV).xyz;"
         "   DiffuseColor = texture(Diffuse, UV).xyz;"
         "   SpecularColor = texture(Specular, UV).xyz;"
-        "	vec3 dirlight_contribution = vec3(0, 0, 0);"
-        "	for (int i = 0; i < 4; i++) dirlight_contribution += DirLightContribution(i);"
-        "	vec3 pointlight_contribution = vec3(0, 0, 0);"
-        "	for (int i = 0; i < 4; i++) pointlight_contribution += PointLightContribution(i);"
-        "   vec3 arealight_contribution = vec3(0, 0, 0);"
-        "   for (int i = 0; i < 4; i++) arealight_contribution += AreaLightContribution(i);"
-        "	frag_color = vec4(dirlight_contribution + pointlight_contribution + arealight_contribution + EmissiveColor, 1.0);"
+        "	frag_color = vec4(Lighting() + EmissiveColor, 1.0);"
+        "}";
+
+    // Draws every particle of a system in one instanced draw, see GLMesh::RenderInstanced
+    const std::string particle_vert_src_ =
+        "#version 400\n"
+        "in vec3 position;"
+        "in vec3 normal;"
+        "in vec2 texcoord;"
+        "in vec4 instance_position;"
+        "in vec4 instance_rotation;"
+        "in vec4 instance_color;"
+        "in float instance_age;"
+        "out vec3 world_normal;"
+        "out vec3 world_vertex;"
+        "out vec3 world_eye;"
+        "out vec2 UV;"
+        "out vec4 particle_color;"
+        "out float particle_age;"
+        "uniform bool particle_billboard;"
+        "layout(std140) uniform CameraBlock {"
+        "	mat4 view_matrix;"
+        "	mat4 projection_matrix;"
+        "	float screen_width;"
+        "	float screen_height;"
+        "};"
+        "vec3 Rotate(vec4 q, vec3 v) {"
+        "	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);"
+        "}"
+        "void main() {"
+        "	vec3 local_vertex = Rotate(instance_rotation, position * instance_position.w);"
+        "	vec3 local_normal = Rotate(instance_rotation, normal);"
+        "	if (particle_billboard) {"
+        "		mat3 camera_rotation = transpose(mat3(view_matrix));"
+        "		local_vertex = camera_rotation * local_vertex;"
+        "		local_normal = camera_rotation * local_normal;"
+        "	}"
+        "	world_vertex = instance_position.xyz + local_vertex;"
+        "	world_normal = normalize(local_normal);"
+        "	world_eye = vec3(inverse(view_matrix) * vec4(0.f,0.f,0.f,1.f));"
+        "	UV = texcoord;"
+        "	particle_color = instance_color;"
+        "	particle_age = instance_age;"
+        "	gl_Position = projection_matrix * view_matrix * vec4(world_vertex, 1.0);"
+        "}";
+
+    const std::string particle_frag_src_ = "#version 400\n" "in vec4 particle_color;" + blinn_phong_lighting_src_ +
+        "void main() {"
+        "   EmissiveColor = texture(Emissive, UV).xyz * particle_color.rgb;"
+        "   DiffuseColor = texture(Diffuse, UV).xyz * particle_color.rgb;"
+        "   SpecularColor = texture(Specular, UV).xyz;"
+        "	frag_color = vec4(Lighting() + EmissiveColor, particle_color.a);"
         "}";
 
     const std::string toon_frag_src_ =
@@ -295,6 +360,27 @@ protected:
     std::map<std::string, std::unique_ptr<ShaderProgram>> shader_programs_;
 
     std::map<unsigned int, std::unique_ptr<Texture>> solid_textures_;
+
+    // Asynchronous loading
+    struct LoadGroup {
+        std::string name;
+        unsigned int pending;
+        unsigned int loads;
+        bool open; // Still between BeginLoadGroup and EndLoadGroup
+        std::chrono::high_resolution_clock::time_point started;
+    };
+    AssetLoader loader_;
+    std::map<unsigned int, LoadGroup> load_groups_;
+    unsigned int open_load_group_; // 0 if none
+    unsigned int next_load_group_;
+    unsigned int default_load_group_;
+
+    void StartLoad(AssetType type, Asset& placeholder, const std::string& path);
+    // Returns nullptr if the asset was unloaded or replaced while loading
+    Asset* GetPlaceholder(const AssetLoad& load);
+    void FinishLoadInGroup(unsigned int group);
+    // Once the group is closed and has nothing pending, reports it and signals it's resident
+    void ResolveLoadGroup(unsigned int group);
 };
 
 #endif // ASSETMANAGER_H
@@ -46,3 +46,10 @@ Cubemap::~Cubemap() {
         if (image_[i]) delete [] image_[i];
     }
 }
+
+void Cubemap::TakeData(Cubemap& other) {
+    std::swap(resolution_, other.resolution_);
+    for (int i = 0; i < NUM_CUBEMAP_FACES; i++) std::swap(image_[i], other.image_[i]);
+    MarkDirty();
+    other.MarkDirty();
+}
@@ -26,6 +26,8 @@ public:
     virtual AssetType GetType() const override { return AssetType::Cubemap; }
     unsigned int GetResolution() const { return resolution_; }
     const unsigned char* GetFace(int face) const { return image_[face]; }
+    // Swaps in other's faces without copying them, e.g. to fill in a placeholder once the real cubemap has loaded
+    void TakeData(Cubemap& other);
 
 protected:
     unsigned int resolution_;
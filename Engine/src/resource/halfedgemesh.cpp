@@ -0,0 +1,157 @@
+#include "halfedgemesh.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Packs a directed edge between two welded vertices into one key
+uint64_t EdgeKey(unsigned int from, unsigned int to) {
+    return (uint64_t(from) << 32) | to;
+}
+
+struct PositionKey {
+    uint32_t bits[3];
+    bool operator==(const PositionKey& other) const {
+        return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2];
+    }
+};
+
+struct PositionKeyHash {
+    size_t operator()(const PositionKey& key) const {
+        uint64_t hash = 14695981039346656037ULL;
+        for (uint32_t bits : key.bits) {
+            hash ^= bits;
+            hash *= 1099511628211ULL;
+        }
+        return (size_t)hash;
+    }
+};
+
+// Sorts (vertex, neighbor) pairs and packs the neighbors of each vertex, each once, after its offset in starts
+void PackNeighbors(std::vector<std::pair<unsigned int, unsigned int>>& pairs, unsigned int vertex_count,
+                   std::vector<unsigned int>& starts, std::vector<unsigned int>& neighbors) {
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+    starts.assign(vertex_count + 1, 0);
+    neighbors.resize(pairs.size());
+    for (size_t i = 0; i < pairs.size(); i++) {
+        starts[pairs[i].first + 1]++;
+        neighbors[i] = pairs[i].second;
+    }
+    for (unsigned int v = 0; v < vertex_count; v++) starts[v + 1] += starts[v];
+}
+
+}
+
+const unsigned int HalfEdgeMesh::NONE;
+
+HalfEdgeMesh::HalfEdgeMesh(const std::vector<float>& positions, const std::vector<unsigned int>& triangles) :
+    edge_count_(0),
+    boundary_edge_count_(0),
+    non_manifold_edge_count_(0),
+    non_manifold_vertex_count_(0)
+{
+    Weld(positions);
+    corners_.resize(triangles.size() - triangles.size() % 3);
+    for (size_t i = 0; i < corners_.size(); i++) corners_[i] = welded_[triangles[i]];
+    FindTwins();
+    FindNeighbors();
+    CountFans();
+}
+
+void HalfEdgeMesh::Weld(const std::vector<float>& positions) {
+    unsigned int mesh_vertex_count = (unsigned int)positions.size() / 3;
+    std::unordered_map<PositionKey, unsigned int, PositionKeyHash> vertices;
+    vertices.reserve(mesh_vertex_count);
+    welded_.resize(mesh_vertex_count);
+    for (unsigned int i = 0; i < mesh_vertex_count; i++) {
+        PositionKey key;
+        for (int j = 0; j < 3; j++) {
+            // Adding zero turns -0 into +0, so the two weld
+            float value = positions[3 * i + j] + 0.f;
+            std::memcpy(&key.bits[j], &value, sizeof(float));
+        }
+        auto inserted = vertices.emplace(key, (unsigned int)first_copies_.size());
+        if (inserted.second) first_copies_.push_back(i);
+        welded_[i] = inserted.first->second;
+    }
+}
+
+void HalfEdgeMesh::FindTwins() {
+    unsigned int half_edge_count = GetHalfEdgeCount();
+    twins_.assign(half_edge_count, NONE);
+    // A half-edge and how many times its direction shows up, more than once means more than two faces
+    // share the edge, or two of them wind opposite ways
+    std::unordered_map<uint64_t, std::pair<unsigned int, unsigned int>> directed;
+    directed.reserve(half_edge_count);
+    for (unsigned int h = 0; h < half_edge_count; h++) {
+        if (Origin(h) == Target(h)) continue;
+        auto inserted = directed.emplace(EdgeKey(Origin(h), Target(h)), std::make_pair(h, 0u));
+        inserted.first->second.second++;
+    }
+    auto count = [&directed](unsigned int from, unsigned int to) {
+        auto found = directed.find(EdgeKey(from, to));
+        return found == directed.end() ? 0u : found->second.second;
+    };
+
+    for (unsigned int h = 0; h < half_edge_count; h++) {
+        unsigned int from = Origin(h);
+        unsigned int to = Target(h);
+        if (from == to) continue;
+        if (count(from, to) == 1 && count(to, from) == 1) twins_[h] = directed[EdgeKey(to, from)].first;
+        if (IsBoundary(h)) boundary_edge_count_++;
+    }
+
+    // Each edge counted once, from its lower vertex unless it only runs the other way
+    for (const auto& entry : directed) {
+        unsigned int from = entry.first >> 32;
+        unsigned int to = entry.first & 0xffffffff;
+        unsigned int backward = count(to, from);
+        if (from > to && backward > 0) continue;
+        edge_count_++;
+        if (entry.second.second > 1 || backward > 1) non_manifold_edge_count_++;
+    }
+}
+
+void HalfEdgeMesh::FindNeighbors() {
+    std::vector<std::pair<unsigned int, unsigned int>> pairs;
+    std::vector<std::pair<unsigned int, unsigned int>> boundary_pairs;
+    pairs.reserve(2 * GetHalfEdgeCount());
+    for (unsigned int h = 0; h < GetHalfEdgeCount(); h++) {
+        unsigned int from = Origin(h);
+        unsigned int to = Target(h);
+        if (from == to) continue;
+        pairs.push_back(std::make_pair(from, to));
+        pairs.push_back(std::make_pair(to, from));
+        if (IsBoundary(h)) {
+            boundary_pairs.push_back(std::make_pair(from, to));
+            boundary_pairs.push_back(std::make_pair(to, from));
+        }
+    }
+    PackNeighbors(pairs, GetVertexCount(), neighbor_starts_, neighbors_);
+    PackNeighbors(boundary_pairs, GetVertexCount(), boundary_starts_, boundary_neighbors_);
+}
+
+void HalfEdgeMesh::CountFans() {
+    // Count the faces at each vertex, and pick an outgoing half-edge to turn around it from. On a boundary that has
+    // to be one with no twin, so turning one way reaches every face before running off the other side.
+    std::vector<unsigned int> face_counts(GetVertexCount(), 0);
+    std::vector<unsigned int> starts(GetVertexCount(), NONE);
+    for (unsigned int h = 0; h < GetHalfEdgeCount(); h++) {
+        unsigned int vertex = Origin(h);
+        face_counts[vertex]++;
+        if (starts[vertex] == NONE || IsBoundary(h)) starts[vertex] = h;
+    }
+
+    for (unsigned int vertex = 0; vertex < GetVertexCount(); vertex++) {
+        if (starts[vertex] == NONE) continue;
+        unsigned int reached = 0;
+        unsigned int h = starts[vertex];
+        do {
+            reached++;
+            h = Twin(Prev(h));
+        } while (h != NONE && h != starts[vertex] && reached <= face_counts[vertex]);
+        if (reached != face_counts[vertex]) non_manifold_vertex_count_++;
+    }
+}
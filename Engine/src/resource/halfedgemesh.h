@@ -0,0 +1,74 @@
+#ifndef HALFEDGEMESH_H
+#define HALFEDGEMESH_H
+
+#include <animator.h>
+
+// Connectivity of a triangle mesh, for walking from a vertex or edge to its neighbors.
+// Vertices at exactly the same position, e.g. the copies made along UV seams, are welded into one, so seams
+// aren't taken for boundaries. Face f owns half-edges 3f, 3f+1 and 3f+2, the one at corner i running from that
+// corner to the next. Edges shared by more than two faces, or by two that disagree on winding, get no twins and
+// are treated as boundaries, i.e. creases.
+class HalfEdgeMesh {
+public:
+    static const unsigned int NONE = 0xffffffff;
+
+    HalfEdgeMesh(const std::vector<float>& positions, const std::vector<unsigned int>& triangles);
+
+    // Welded vertices
+    unsigned int GetVertexCount() const { return (unsigned int)first_copies_.size(); }
+    unsigned int GetFaceCount() const { return (unsigned int)corners_.size() / 3; }
+    unsigned int GetHalfEdgeCount() const { return (unsigned int)corners_.size(); }
+    // Edges counted once, whether or not they have two faces
+    unsigned int GetEdgeCount() const { return edge_count_; }
+
+    // The welded vertex a vertex of the mesh belongs to, and one of the mesh vertices welded into it
+    unsigned int GetVertex(unsigned int mesh_vertex) const { return welded_[mesh_vertex]; }
+    unsigned int GetMeshVertex(unsigned int vertex) const { return first_copies_[vertex]; }
+
+    static unsigned int Face(unsigned int half_edge) { return half_edge / 3; }
+    static unsigned int Next(unsigned int half_edge) { return half_edge % 3 == 2 ? half_edge - 2 : half_edge + 1; }
+    static unsigned int Prev(unsigned int half_edge) { return half_edge % 3 == 0 ? half_edge + 2 : half_edge - 1; }
+    // The same edge in the neighboring face, NONE on a boundary
+    unsigned int Twin(unsigned int half_edge) const { return twins_[half_edge]; }
+    bool IsBoundary(unsigned int half_edge) const { return twins_[half_edge] == NONE; }
+    // Welded vertices the half-edge runs between
+    unsigned int Origin(unsigned int half_edge) const { return corners_[half_edge]; }
+    unsigned int Target(unsigned int half_edge) const { return corners_[Next(half_edge)]; }
+    // The corner across the face from the half-edge
+    unsigned int Opposite(unsigned int half_edge) const { return corners_[Prev(half_edge)]; }
+
+    // Vertices sharing an edge with the vertex, each once
+    unsigned int GetValence(unsigned int vertex) const { return neighbor_starts_[vertex + 1] - neighbor_starts_[vertex]; }
+    const unsigned int* GetNeighbors(unsigned int vertex) const { return neighbors_.data() + neighbor_starts_[vertex]; }
+    // Of those, the ones across a boundary edge. A manifold boundary vertex has two, more make it a corner.
+    unsigned int GetBoundaryValence(unsigned int vertex) const { return boundary_starts_[vertex + 1] - boundary_starts_[vertex]; }
+    const unsigned int* GetBoundaryNeighbors(unsigned int vertex) const { return boundary_neighbors_.data() + boundary_starts_[vertex]; }
+    bool IsBoundaryVertex(unsigned int vertex) const { return GetBoundaryValence(vertex) > 0; }
+
+    // No boundary edges
+    bool IsClosed() const { return boundary_edge_count_ == 0; }
+    // Every edge has one or two faces that agree on winding, and the faces around every vertex form a single fan
+    bool IsManifold() const { return non_manifold_edge_count_ == 0 && non_manifold_vertex_count_ == 0; }
+
+private:
+    std::vector<unsigned int> welded_; // Per mesh vertex
+    std::vector<unsigned int> first_copies_; // Per welded vertex
+    std::vector<unsigned int> corners_; // Welded vertex at each corner, indexed like the half-edges
+    std::vector<unsigned int> twins_;
+    // Both kinds of neighbor lists are packed into one array, with each vertex's list starting at its offset
+    std::vector<unsigned int> neighbor_starts_;
+    std::vector<unsigned int> neighbors_;
+    std::vector<unsigned int> boundary_starts_;
+    std::vector<unsigned int> boundary_neighbors_;
+    unsigned int edge_count_;
+    unsigned int boundary_edge_count_;
+    unsigned int non_manifold_edge_count_;
+    unsigned int non_manifold_vertex_count_;
+
+    void Weld(const std::vector<float>& positions);
+    void FindTwins();
+    void FindNeighbors();
+    void CountFans();
+};
+
+#endif // HALFEDGEMESH_H
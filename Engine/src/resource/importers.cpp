@@ -11,6 +11,7 @@
 #include <resource/cubemap.h>
 #include <resource/texture.h>
 #include <resource/importers.h>
+#include <resource/meshcache.h>
 #include <SOIL.h>
 #include <assimp/cimport.h>
 #include <assimp/scene.h>
@@ -37,18 +38,13 @@ std::unique_ptr<Texture> Importers::ImportTexture(const std::string& name, const
 }
 
 std::unique_ptr<Cubemap> Importers::ImportCubemap(const std::string& name, const std::string& path) {
-    static std::string suffixes[] = { "ft","bk","up","dn","rt","lf" };
-    auto base_filename_length = path.rfind(".");
-    std::string extension = path.substr(base_filename_length);
-    std::string base_filename = path.substr(0, base_filename_length-2);
-
     int resolution = 0;
 
 
     unsigned char** images = new unsigned char*[Cubemap::NUM_CUBEMAP_FACES];
 
     for (int i = 0; i < Cubemap::NUM_CUBEMAP_FACES; i++) {
-        std::string filepath = base_filename + suffixes[i] + extension;
+        std::string filepath = GetCubemapFacePath(path, i);
 
         int width, height, channels;
         unsigned char* image = SOIL_load_image(filepath.c_str(), &width, &height, &channels, SOIL_LOAD_RGBA);
@@ -78,7 +74,16 @@ std::unique_ptr<Cubemap> Importers::ImportCubemap(const std::string& name, const
     return std::move(cubemap);
 }
 
+std::string Importers::GetCubemapFacePath(const std::string& path, int face) {
+    static std::string suffixes[] = { "ft","bk","up","dn","rt","lf" };
+    auto base_filename_length = path.rfind(".");
+    std::string extension = path.substr(base_filename_length);
+    std::string base_filename = path.substr(0, base_filename_length-2);
+    return base_filename + suffixes[face] + extension;
+}
+
 void assimp2vector(const aiVector3D* a, unsigned int count, std::vector<float>& v, int dim=3) {
+    v.reserve(v.size() + count * dim);
     for (unsigned int i = 0; i < count; i++) {
         v.push_back(a[i].x);
         if (dim > 1) v.push_back(a[i].y);
@@ -86,6 +91,7 @@ void assimp2vector(const aiVector3D* a, unsigned int count, std::vector<float>&
     }
 }
 void assimp2vector(const aiColor4D* a, unsigned int count, std::vector<float>& v, int dim=3) {
+    v.reserve(v.size() + count * dim);
     for (unsigned int i = 0; i < count; i++) {
         v.push_back(a[i].r);
         if (dim > 1) v.push_back(a[i].g);
@@ -94,8 +100,15 @@ void assimp2vector(const aiColor4D* a, unsigned int count, std::vector<float>& v
     }
 }
 
-// Uses assimp to load the mesh found at path
-std::unique_ptr<Mesh> Importers::ImportMesh(const std::string& name, const std::string& path) {
+// Uses assimp to load the mesh found at path, or the binary cache of it made the first time it was imported
+std::unique_ptr<Mesh> Importers::ImportMesh(const std::string& name, const std::string& path, MeshImportInfo* info) {
+    std::unique_ptr<Mesh> cached = MeshCache::Load(name, path);
+    if (info != nullptr) info->from_cache = cached != nullptr;
+    if (cached != nullptr) {
+        cached->Get<FileProperty>("Path")->Set(path);
+        return cached;
+    }
+
     const struct aiScene* scene = aiImportFile(path.c_str(), aiProcessPreset_TargetRealtime_MaxQuality);
     if (scene == nullptr) {
         throw FileIOException("Failed to import mesh \"" + path + "\"");
@@ -118,29 +131,31 @@ std::unique_ptr<Mesh> Importers::ImportMesh(const std::string& name, const std::
     if (aimesh->HasPositions() && aimesh->HasFaces()) {
         std::unique_ptr<Mesh> mesh = std::make_unique<Mesh>(name);
         mesh->Get<FileProperty>("Path")->Set(path);
-        std::vector<unsigned int> triangles;
-        std::vector<float> positions, colors, uvs, normals;
-        assimp2vector(aimesh->mVertices, aimesh->mNumVertices, positions);
+        MeshData data;
+        assimp2vector(aimesh->mVertices, aimesh->mNumVertices, data.positions);
+        data.triangles.reserve(aimesh->mNumFaces * 3);
         for (unsigned int i = 0; i < aimesh->mNumFaces; i++) {
             for (int j = 0; j < 3; j++) {
-                triangles.push_back(aimesh->mFaces[i].mIndices[j]);
+                data.triangles.push_back(aimesh->mFaces[i].mIndices[j]);
             }
         }
-        mesh->SetPositions(positions);
-        mesh->SetTriangles(triangles);
         if (aimesh->HasVertexColors(0)) {
-            assimp2vector(aimesh->mColors[0], aimesh->mNumVertices, colors);
-            mesh->SetColors(colors);
+            assimp2vector(aimesh->mColors[0], aimesh->mNumVertices, data.colors);
         }
         if (aimesh->HasTextureCoords(0)) {
-            assimp2vector(aimesh->mTextureCoords[0], aimesh->mNumVertices, uvs, 2);
-            mesh->SetUVs(uvs);
+            assimp2vector(aimesh->mTextureCoords[0], aimesh->mNumVertices, data.UVs, 2);
         }
         if (aimesh->HasNormals()) {
-            assimp2vector(aimesh->mNormals, aimesh->mNumVertices, normals);
-            mesh->SetNormals(normals);
+            assimp2vector(aimesh->mNormals, aimesh->mNumVertices, data.normals);
         }
+        // Set together so the tangents are found once, when something first asks for them
+        mesh->SetData(std::move(data));
         aiReleaseImport(scene);
+        if (!MeshCache::Save(*mesh, path)) {
+            std::string warning = "Could not write the mesh cache for \"" + path + "\"";
+            if (info != nullptr) info->warning = warning;
+            else Debug::Log.WriteLine(warning, Priority::Warning);
+        }
         return std::move(mesh);
     } else {
         throw FileIOException("Invalid mesh \"" + path + "\"");
@@ -37,8 +37,16 @@ public:
     // for the 6 faces. This function assumes that any one of these files was selected
     // as the path, and imports all of them.
     static std::unique_ptr<Cubemap> ImportCubemap(const std::string& name, const std::string& path);
+    // The file of one of the 6 faces, given any one of them as the path
+    static std::string GetCubemapFacePath(const std::string& path, int face);
 
-    static std::unique_ptr<Mesh> ImportMesh(const std::string& name, const std::string& path);
+    // What ImportMesh did besides importing, for callers off the GUI thread that can't write to the log
+    struct MeshImportInfo {
+        bool from_cache;
+        std::string warning; // Empty unless something went wrong that didn't stop the import
+    };
+    // Warnings are logged unless info is given
+    static std::unique_ptr<Mesh> ImportMesh(const std::string& name, const std::string& path, MeshImportInfo* info = nullptr);
 };
 
 #endif // IMPORTERS_H
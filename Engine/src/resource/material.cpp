@@ -9,12 +9,17 @@
  ****************************************************************************/
 #include <resource/material.h>
 
+uint64_t Material::uniforms_version_counter_ = 0;
+
 Material::Material(const std::string &name, ShaderProgram* shader_program) :
     Asset(name),
     Shader(AssetType::ShaderProgram, shader_program),
-    Uniforms()
+    Transparent(false),
+    Uniforms(),
+    uniforms_version_(++uniforms_version_counter_)
 {
     AddProperty("Shader", &Shader);
+    AddProperty("Transparent", &Transparent);
     AddProperty("Uniforms", &Uniforms);
 
     Shader.ValueSet.Connect(this, &Material::OnShaderSet);
@@ -159,6 +164,7 @@ void Material::OnShaderSet(Asset *asset) {
         delete it.second;
     }
 
+    uniforms_version_ = ++uniforms_version_counter_;
     Uniforms.PropertiesChanged();
 }
 
@@ -21,6 +21,8 @@
 class Material : public Asset {
 public:
     ResourceProperty<ShaderProgram> Shader;
+    // Drawn after the opaque geometry, back to front
+    BooleanProperty Transparent;
     PropertyGroup Uniforms;
 
     Material(const std::string& name, ShaderProgram* shader_program);
@@ -36,10 +38,14 @@ public:
     void OnShaderSet(Asset* shader);
     void OnShaderProgramChanged();
 
+    // Changes whenever OnShaderSet replaces the uniform properties, so renderers can cache bindings to them
+    uint64_t GetUniformsVersion() const { return uniforms_version_; }
+
     //This is to make sure shader is loaded BEFORE uniforms
     virtual void LoadFromYAML(const YAML::Node& node) {
        assert(node.IsMap());
        Shader.LoadFromYAML(node["Shader"]);
+       if (node["Transparent"]) Transparent.LoadFromYAML(node["Transparent"]);
        Uniforms.LoadFromYAML(node["Uniforms"]);
     }
 
@@ -68,6 +74,10 @@ public:
     Texture* Transmittence;
     double Shininess;
     double IndexOfRefraction;
+
+private:
+    uint64_t uniforms_version_;
+    static uint64_t uniforms_version_counter_;
 };
 
 #endif // MATERIAL_H
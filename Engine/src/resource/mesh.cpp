@@ -13,52 +13,99 @@
 Mesh::Mesh(const std::string& name, MeshType type) :
     Asset(name),
     ExternalPath(FileType::Mesh),
-    mesh_type_(type)
+    mesh_type_(type),
+    tangents_stale_(0),
+    tangent_find_count_(0),
+    bounds_version_(UINT64_MAX),
+    shape_version_(0),
+    half_edges_version_(UINT64_MAX)
 {
     AddProperty("Path", &ExternalPath);
     ExternalPath.SetHidden(true);
 }
 
-void Mesh::SetPositions(const std::vector<float>& positions) {
-    positions_ = std::vector<float>(positions);
-    CalculateBinormalsAndTangents();
+void Mesh::SetPositions(std::vector<float> positions) {
+    positions_ = std::move(positions);
+    tangents_stale_.storeRelease(1);
+    shape_version_++;
     MarkDirty();
 }
 
-void Mesh::SetUVs(const std::vector<float>& UVs) {
-    UVs_ = std::vector<float>(UVs);
-    CalculateBinormalsAndTangents();
+void Mesh::SetUVs(std::vector<float> UVs) {
+    UVs_ = std::move(UVs);
+    tangents_stale_.storeRelease(1);
     MarkDirty();
 }
 
-void Mesh::SetColors(const std::vector<float>& colors) {
-    colors_ = std::vector<float>(colors);
+void Mesh::SetColors(std::vector<float> colors) {
+    colors_ = std::move(colors);
     MarkDirty();
 }
 
-void Mesh::SetNormals(const std::vector<float>& normals) {
-    normals_ = std::vector<float>(normals);
-    CalculateBinormalsAndTangents();
+void Mesh::SetNormals(std::vector<float> normals) {
+    normals_ = std::move(normals);
+    tangents_stale_.storeRelease(1);
     MarkDirty();
 }
 
-void Mesh::SetBinormals(const std::vector<float>& binormals) {
-    binormals_ = std::vector<float>(binormals);
+void Mesh::SetBinormals(std::vector<float> binormals) {
+    binormals_ = std::move(binormals);
+    tangents_stale_.storeRelease(0);
     MarkDirty();
 }
 
-void Mesh::SetTangents(const std::vector<float>& tangents) {
-    tangents_ = std::vector<float>(tangents);
+void Mesh::SetTangents(std::vector<float> tangents) {
+    tangents_ = std::move(tangents);
+    tangents_stale_.storeRelease(0);
     MarkDirty();
 }
 
-void Mesh::SetTriangles(const std::vector<unsigned int>& triangles) {
-    triangles_ = std::vector<unsigned int>(triangles);
-    CalculateBinormalsAndTangents();
+void Mesh::SetTriangles(std::vector<unsigned int> triangles) {
+    triangles_ = std::move(triangles);
+    tangents_stale_.storeRelease(1);
+    shape_version_++;
+    MarkDirty();
+}
+
+void Mesh::SetData(MeshData&& data) {
+    positions_ = std::move(data.positions);
+    colors_ = std::move(data.colors);
+    UVs_ = std::move(data.UVs);
+    normals_ = std::move(data.normals);
+    triangles_ = std::move(data.triangles);
+    bool found = !data.binormals.empty() || !data.tangents.empty();
+    binormals_ = std::move(data.binormals);
+    tangents_ = std::move(data.tangents);
+    tangents_stale_.storeRelease(found ? 0 : 1);
+    shape_version_++;
     MarkDirty();
 }
 
+void Mesh::TakeData(Mesh& other) {
+    bool bounds_found = other.bounds_version_ == other.GetVersion();
+    std::swap(mesh_type_, other.mesh_type_);
+    std::swap(positions_, other.positions_);
+    std::swap(colors_, other.colors_);
+    std::swap(UVs_, other.UVs_);
+    std::swap(normals_, other.normals_);
+    std::swap(binormals_, other.binormals_);
+    std::swap(tangents_, other.tangents_);
+    std::swap(triangles_, other.triangles_);
+    int stale = tangents_stale_.loadAcquire();
+    tangents_stale_.storeRelease(other.tangents_stale_.loadAcquire());
+    other.tangents_stale_.storeRelease(stale);
+    std::swap(bounds_, other.bounds_);
+    shape_version_++;
+    other.shape_version_++;
+    MarkDirty();
+    other.MarkDirty();
+    if (bounds_found) bounds_version_ = GetVersion();
+}
+
 void Mesh::Append(Mesh& other, glm::mat4 transform) {
+    // Both are made current first, the appended ones are then transformed along with the normals
+    CalculateBinormalsAndTangents();
+    other.CalculateBinormalsAndTangents();
     unsigned int sz1 = positions_.size()/3;
     unsigned int sz2 = other.positions_.size()/3;
 
@@ -127,10 +174,12 @@ void Mesh::Append(Mesh& other, glm::mat4 transform) {
     std::vector<unsigned int> remapped_tris(other.triangles_.size());
     std::transform(other.triangles_.begin(), other.triangles_.end(), remapped_tris.begin(), [sz1](unsigned int x) { return x + sz1; });
     triangles_.insert(triangles_.end(), remapped_tris.begin(), remapped_tris.end());
+    shape_version_++;
     MarkDirty();
 }
 
 unsigned short Mesh::GetVertexFormat() const {
+    CalculateBinormalsAndTangents();
     unsigned short vertex_format = 0;
     if (positions_.size() > 0) vertex_format |= VF_POS;
     if (colors_.size() > 0) vertex_format |= VF_COL;
@@ -158,10 +207,12 @@ const std::vector<float>& Mesh::GetNormals() const {
 }
 
 const std::vector<float>& Mesh::GetBinormals() const {
+    CalculateBinormalsAndTangents();
     return binormals_;
 }
 
 const std::vector<float>& Mesh::GetTangents() const {
+    CalculateBinormalsAndTangents();
     return tangents_;
 }
 
@@ -169,7 +220,48 @@ const std::vector<unsigned int>& Mesh::GetTriangles() const {
     return triangles_;
 }
 
-void Mesh::CalculateBinormalsAndTangents() {
+const BoundingBox& Mesh::GetBounds() {
+    if (bounds_version_ != GetVersion()) {
+        glm::vec3 min(0.f), max(0.f);
+        if (positions_.size() >= 3) {
+            min = max = glm::vec3(positions_[0], positions_[1], positions_[2]);
+            for (size_t i = 3; i + 2 < positions_.size(); i += 3) {
+                glm::vec3 position(positions_[i], positions_[i + 1], positions_[i + 2]);
+                min = glm::min(min, position);
+                max = glm::max(max, position);
+            }
+        }
+        bounds_ = BoundingBox(min, max);
+        bounds_version_ = GetVersion();
+    }
+    return bounds_;
+}
+
+void Mesh::SetBounds(const BoundingBox& bounds) {
+    bounds_ = bounds;
+    bounds_version_ = GetVersion();
+}
+
+const HalfEdgeMesh& Mesh::GetHalfEdges() const {
+    QMutexLocker lock(&half_edges_lock_);
+    if (half_edges_version_ != shape_version_) {
+        half_edges_ = std::make_unique<HalfEdgeMesh>(positions_, triangles_);
+        half_edges_version_ = shape_version_;
+    }
+    return *half_edges_;
+}
+
+void Mesh::CalculateBinormalsAndTangents() const {
+    if (!tangents_stale_.loadAcquire()) return;
+    QMutexLocker lock(&tangents_lock_);
+    // Another thread may have found them while this one waited
+    if (!tangents_stale_.loadAcquire()) return;
+    FindBinormalsAndTangents();
+    tangent_find_count_++;
+    tangents_stale_.storeRelease(0);
+}
+
+void Mesh::FindBinormalsAndTangents() const {
     if (UVs_.size()==0 || triangles_.size()==0 || (normals_.size()*2 != UVs_.size()*3) || (normals_.size() != positions_.size())) {
         return;
     }
@@ -253,6 +345,6 @@ void Mesh::CalculateBinormalsAndTangents() {
         tans[i+2] = tan.z;
     }
 
-    SetBinormals(binorms);
-    SetTangents(tans);
+    binormals_ = std::move(binorms);
+    tangents_ = std::move(tans);
 }
@@ -14,6 +14,21 @@
 #include <resource/asset.h>
 #include <properties.h>
 #include <resource/cacheable.h>
+#include <scene/boundingbox.h>
+#include <resource/halfedgemesh.h>
+#include <QAtomicInt>
+#include <QMutex>
+
+// Every array of a Mesh, to build up and then hand over in one go with Mesh::SetData
+struct MeshData {
+    std::vector<float> positions;
+    std::vector<float> colors;
+    std::vector<float> UVs;
+    std::vector<float> normals;
+    std::vector<float> binormals; // Leave these two empty to have them found from the others
+    std::vector<float> tangents;
+    std::vector<unsigned int> triangles;
+};
 
 // Mesh consists of triangles arranged in 3D space to create the impression of a solid object.
 // A triangle is defined by its three corner points or vertices.
@@ -26,16 +41,29 @@ public:
     FileProperty ExternalPath;
 
     Mesh(const std::string& name, MeshType type = MeshType::Triangles);
-    void SetPositions(const std::vector<float>& positions);
-    void SetUVs(const std::vector<float>& UVs);
-    void SetColors(const std::vector<float>& colors);
-    void SetNormals(const std::vector<float>& normals);
-    void SetBinormals(const std::vector<float>& binormals);
-    void SetTangents(const std::vector<float>& tangents);
-    void SetTriangles(const std::vector<unsigned int>& triangles);
-    void CalculateBinormalsAndTangents();
+    // The setters take their arrays by value, so pass temporaries or std::move them in to save a copy.
+    // Binormals and tangents are found from the other arrays the first time they're asked for after those
+    // change, instead of after every setter. Setting either directly keeps both until the other arrays change.
+    void SetPositions(std::vector<float> positions);
+    void SetUVs(std::vector<float> UVs);
+    void SetColors(std::vector<float> colors);
+    void SetNormals(std::vector<float> normals);
+    void SetBinormals(std::vector<float> binormals);
+    void SetTangents(std::vector<float> tangents);
+    void SetTriangles(std::vector<unsigned int> triangles);
+    // Replaces every array at once
+    void SetData(MeshData&& data);
+    // Finds the binormals and tangents now if they're out of date. The getters call this, call it
+    // ahead of them to do the work on another thread.
+    void CalculateBinormalsAndTangents() const;
+    // False while the binormals and tangents still have to be found from the other arrays
+    bool HasBinormalsAndTangents() const { return !tangents_stale_.loadAcquire(); }
+    // Times the binormals and tangents have been found, to check they aren't found more often than needed
+    int GetTangentFindCount() const { return tangent_find_count_; }
 
     void Append(Mesh& other, glm::mat4 transform=glm::mat4());
+    // Swaps in other's arrays and bounds, e.g. to fill in a placeholder once the real mesh has loaded
+    void TakeData(Mesh& other);
 
     unsigned short GetVertexFormat() const;
     virtual AssetType GetType() const override { return AssetType::Mesh; }
@@ -48,6 +76,16 @@ public:
     const std::vector<float>& GetBinormals() const;
     const std::vector<float>& GetTangents() const;
     const std::vector<unsigned int>& GetTriangles() const;
+
+    // Box around the positions, found again after they change
+    const BoundingBox& GetBounds();
+    // For loaders that stored the bounds along with the positions, call after setting them
+    void SetBounds(const BoundingBox& bounds);
+
+    // Connectivity for mesh processing, built the first time it's asked for after the positions or triangles change
+    const HalfEdgeMesh& GetHalfEdges() const;
+    // Bumped when the positions or triangles change, for anything else built from them
+    uint64_t GetShapeVersion() const { return shape_version_; }
 private:
     // Triangle mesh, quad mesh, or other
     MeshType mesh_type_;
@@ -65,9 +103,23 @@ private:
     std::vector<float> colors_;
     std::vector<float> UVs_;
     std::vector<float> normals_;
-    std::vector<float> binormals_;
-    std::vector<float> tangents_;
+    mutable std::vector<float> binormals_;
+    mutable std::vector<float> tangents_;
     std::vector<unsigned int> triangles_;
+    // Set when the arrays the binormals and tangents come from change, the lock is held while finding them
+    // so meshes can be read from several threads
+    mutable QAtomicInt tangents_stale_;
+    mutable QMutex tangents_lock_;
+    mutable int tangent_find_count_;
+    void FindBinormalsAndTangents() const;
+
+    BoundingBox bounds_;
+    uint64_t bounds_version_; // Version the bounds were found at
+
+    uint64_t shape_version_; // Bumped when the positions or triangles change
+    mutable std::unique_ptr<HalfEdgeMesh> half_edges_;
+    mutable uint64_t half_edges_version_; // Shape version the half-edges were built at
+    mutable QMutex half_edges_lock_;
 };
 
 #endif // MESH_H
@@ -0,0 +1,163 @@
+#include "meshcache.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <cstring>
+
+namespace {
+
+const uint32_t MAGIC = 0x48534D41; // "AMSH"
+
+// The file starts with this, then each array the flags name in the order of ARRAYS, in the machine's byte order
+struct MeshCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_hash;
+    uint64_t source_size;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint32_t vertex_format; // VF_ flags of the arrays stored
+    uint32_t mesh_type;
+    float bounds_min[3];
+    float bounds_max[3];
+};
+
+struct CachedArray {
+    unsigned short flag;
+    unsigned int components;
+};
+const CachedArray ARRAYS[] = {
+    { VF_POS, 3 },
+    { VF_NRM, 3 },
+    { VF_COL, 3 },
+    { VF_TEX, 2 },
+    { VF_BNM, 3 },
+    { VF_TAN, 3 }
+};
+
+const std::vector<float>& GetArray(const Mesh& mesh, unsigned short flag) {
+    switch (flag) {
+        case VF_POS: return mesh.GetPositions();
+        case VF_NRM: return mesh.GetNormals();
+        case VF_COL: return mesh.GetColors();
+        case VF_TEX: return mesh.GetUVs();
+        case VF_BNM: return mesh.GetBinormals();
+        default: return mesh.GetTangents();
+    }
+}
+
+std::vector<float>& GetArray(MeshData& data, unsigned short flag) {
+    switch (flag) {
+        case VF_POS: return data.positions;
+        case VF_NRM: return data.normals;
+        case VF_COL: return data.colors;
+        case VF_TEX: return data.UVs;
+        case VF_BNM: return data.binormals;
+        default: return data.tangents;
+    }
+}
+
+}
+
+std::string MeshCache::GetCachePath(const std::string& source_path) {
+    return source_path + ".meshcache";
+}
+
+bool MeshCache::HashFile(const std::string& path, uint64_t& hash) {
+    QFile file(QString::fromStdString(path));
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    hash = 14695981039346656037ULL;
+    qint64 size = file.size();
+    if (size == 0) return true;
+    const uchar* data = file.map(0, size);
+    if (data == nullptr) return false;
+    for (qint64 i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    file.unmap(const_cast<uchar*>(data));
+    return true;
+}
+
+std::unique_ptr<Mesh> MeshCache::Load(const std::string& name, const std::string& source_path) {
+    QFile file(QString::fromStdString(GetCachePath(source_path)));
+    if (!file.open(QIODevice::ReadOnly) || file.size() < (qint64)sizeof(MeshCacheHeader)) return nullptr;
+    // Mapped rather than read, the arrays are copied straight out of the page cache
+    const uchar* data = file.map(0, file.size());
+    if (data == nullptr) return nullptr;
+
+    MeshCacheHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != MAGIC || header.version != VERSION) return nullptr;
+
+    // The size is a cheap check before hashing the whole source
+    QFileInfo source(QString::fromStdString(source_path));
+    if (!source.exists() || (uint64_t)source.size() != header.source_size) return nullptr;
+    uint64_t source_hash;
+    if (!HashFile(source_path, source_hash) || source_hash != header.source_hash) return nullptr;
+
+    uint64_t expected_size = sizeof(header) + uint64_t(header.index_count) * sizeof(uint32_t);
+    for (const CachedArray& array : ARRAYS) {
+        if (header.vertex_format & array.flag) expected_size += uint64_t(header.vertex_count) * array.components * sizeof(float);
+    }
+    if ((uint64_t)file.size() != expected_size) return nullptr;
+
+    MeshData mesh_data;
+    const uchar* cursor = data + sizeof(header);
+    for (const CachedArray& array : ARRAYS) {
+        if (!(header.vertex_format & array.flag)) continue;
+        const float* values = reinterpret_cast<const float*>(cursor);
+        size_t count = size_t(header.vertex_count) * array.components;
+        cursor += count * sizeof(float);
+        GetArray(mesh_data, array.flag).assign(values, values + count);
+    }
+    const unsigned int* triangles = reinterpret_cast<const unsigned int*>(cursor);
+    mesh_data.triangles.assign(triangles, triangles + header.index_count);
+    // The cached binormals and tangents come along, so they aren't found again
+    std::unique_ptr<Mesh> mesh = std::make_unique<Mesh>(name, (MeshType)header.mesh_type);
+    mesh->SetData(std::move(mesh_data));
+    mesh->SetBounds(BoundingBox(glm::vec3(header.bounds_min[0], header.bounds_min[1], header.bounds_min[2]),
+                                glm::vec3(header.bounds_max[0], header.bounds_max[1], header.bounds_max[2])));
+    // Closing the file unmaps it
+    return mesh;
+}
+
+bool MeshCache::Save(Mesh& mesh, const std::string& source_path) {
+    MeshCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = MAGIC;
+    header.version = VERSION;
+    if (!HashFile(source_path, header.source_hash)) return false;
+    header.source_size = QFileInfo(QString::fromStdString(source_path)).size();
+    header.vertex_count = mesh.GetPositions().size() / 3;
+    header.index_count = mesh.GetTriangles().size();
+    header.mesh_type = (uint32_t)mesh.GetMeshType();
+    for (const CachedArray& array : ARRAYS) {
+        // Binormals and tangents are only stored once something has asked for them, saving doesn't find them
+        if ((array.flag == VF_BNM || array.flag == VF_TAN) && !mesh.HasBinormalsAndTangents()) continue;
+        const std::vector<float>& values = GetArray(mesh, array.flag);
+        if (values.empty()) continue;
+        // Arrays that don't match the positions can't be laid out per vertex, leave them to be found again
+        if (values.size() != size_t(header.vertex_count) * array.components) continue;
+        header.vertex_format |= array.flag;
+    }
+    const BoundingBox& bounds = mesh.GetBounds();
+    for (int i = 0; i < 3; i++) {
+        header.bounds_min[i] = bounds.min[i];
+        header.bounds_max[i] = bounds.max[i];
+    }
+
+    // Written to a temporary file that replaces the cache once complete, so a failed write leaves no partial cache
+    QSaveFile file(QString::fromStdString(GetCachePath(source_path)));
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const CachedArray& array : ARRAYS) {
+        if (!(header.vertex_format & array.flag)) continue;
+        const std::vector<float>& values = GetArray(mesh, array.flag);
+        file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(float));
+    }
+    const std::vector<unsigned int>& triangles = mesh.GetTriangles();
+    file.write(reinterpret_cast<const char*>(triangles.data()), triangles.size() * sizeof(unsigned int));
+    return file.commit();
+}
@@ -0,0 +1,26 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <animator.h>
+#include <resource/mesh.h>
+
+// Binary copies of imported meshes, so loading them again skips assimp.
+// The cache sits next to the source file, as <source>.meshcache, and is memory-mapped to load. It stores the
+// vertex arrays, triangles and bounds, and a hash of the source file so it's ignored once the source changes.
+class MeshCache {
+public:
+    // Bumped whenever the layout changes, older caches are then ignored and written again
+    static const uint32_t VERSION = 1;
+
+    static std::string GetCachePath(const std::string& source_path);
+
+    // Returns nullptr if there is no cache for the source, or it's out of date
+    static std::unique_ptr<Mesh> Load(const std::string& name, const std::string& source_path);
+    // Returns false if the cache couldn't be written, e.g. the source's folder is read-only
+    static bool Save(Mesh& mesh, const std::string& source_path);
+
+    // 64-bit FNV-1a of the file's contents, false if it couldn't be read
+    static bool HashFile(const std::string& path, uint64_t& hash);
+};
+
+#endif // MESHCACHE_H
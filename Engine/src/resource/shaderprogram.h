@@ -60,6 +60,12 @@ public:
             "area_light_atten_const",
             "area_light_atten_linear",
             "area_light_atten_quad",
+            // Clustered Lights
+            "light_data",
+            "light_grid",
+            "light_indices",
+            // Particles
+            "particle_billboard",
         };
         return uniforms;
     }
@@ -35,6 +35,24 @@ Texture::Texture(const std::string &name, unsigned int width, unsigned int heigh
     }
 }
 
+void Texture::SetImage(unsigned int width, unsigned int height, const unsigned char* image) {
+    const unsigned int CHANNELS = 4; // RGBA
+    delete [] image_;
+    width_ = width;
+    height_ = height;
+    image_ = new unsigned char[width * height * CHANNELS];
+    std::copy(image, image + width * height * CHANNELS, image_);
+    MarkDirty();
+}
+
+void Texture::TakeData(Texture& other) {
+    std::swap(width_, other.width_);
+    std::swap(height_, other.height_);
+    std::swap(image_, other.image_);
+    MarkDirty();
+    other.MarkDirty();
+}
+
 void Texture::OnChangeBilinear(bool use) {
     MarkDirty();
 }
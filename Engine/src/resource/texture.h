@@ -30,6 +30,10 @@ public:
     unsigned int GetWidth() const { return width_; }
     unsigned int GetHeight() const { return height_; }
     const unsigned char* GetImage() const { return image_; }
+    // Replaces the image with a copy of an RGBA one. Renderers upload it again the next time they use the texture.
+    void SetImage(unsigned int width, unsigned int height, const unsigned char* image);
+    // Swaps in other's image without copying it, e.g. to fill in a placeholder once the real texture has loaded
+    void TakeData(Texture& other);
     const glm::vec4 GetColor(unsigned int x,unsigned int y) {
         assert(x < width_);
         assert(y < height_);
@@ -0,0 +1,205 @@
+#include "aabbtree.h"
+
+#include <algorithm>
+#include <cassert>
+
+static BoundingBox Union(const BoundingBox& a, const BoundingBox& b) {
+    return BoundingBox(glm::min(a.min, b.min), glm::max(a.max, b.max));
+}
+
+static bool Contains(const BoundingBox& outer, const BoundingBox& inner) {
+    return glm::all(glm::lessThanEqual(outer.min, inner.min)) && glm::all(glm::greaterThanEqual(outer.max, inner.max));
+}
+
+AABBTree::AABBTree(float margin) :
+    margin_(margin),
+    root_(NULL_NODE),
+    free_list_(NULL_NODE),
+    proxy_count_(0)
+{
+}
+
+int AABBTree::AllocateNode() {
+    if (free_list_ == NULL_NODE) {
+        nodes_.push_back(Node());
+        nodes_.back().parent = NULL_NODE;
+        free_list_ = (int)nodes_.size() - 1;
+    }
+    int index = free_list_;
+    Node& node = nodes_[index];
+    free_list_ = node.parent;
+    node.user_data = nullptr;
+    node.parent = NULL_NODE;
+    node.child1 = NULL_NODE;
+    node.child2 = NULL_NODE;
+    node.height = 0;
+    return index;
+}
+
+void AABBTree::FreeNode(int index) {
+    nodes_[index].parent = free_list_;
+    nodes_[index].height = -1;
+    free_list_ = index;
+}
+
+int AABBTree::CreateProxy(const BoundingBox& box, void* user_data) {
+    int proxy = AllocateNode();
+    glm::vec3 margin(margin_);
+    nodes_[proxy].box = BoundingBox(box.min - margin, box.max + margin);
+    nodes_[proxy].user_data = user_data;
+    InsertLeaf(proxy);
+    proxy_count_++;
+    return proxy;
+}
+
+void AABBTree::DestroyProxy(int proxy) {
+    assert(proxy >= 0 && proxy < (int)nodes_.size() && nodes_[proxy].IsLeaf() && nodes_[proxy].height == 0);
+    RemoveLeaf(proxy);
+    FreeNode(proxy);
+    proxy_count_--;
+}
+
+bool AABBTree::MoveProxy(int proxy, const BoundingBox& box) {
+    assert(proxy >= 0 && proxy < (int)nodes_.size() && nodes_[proxy].IsLeaf() && nodes_[proxy].height == 0);
+    glm::vec3 margin(margin_);
+    BoundingBox fat(box.min - margin, box.max + margin);
+    // Still inside the old fat box, and that isn't much bigger than it needs to be
+    const BoundingBox& old_fat = nodes_[proxy].box;
+    BoundingBox loose(fat.min - 4.f * margin, fat.max + 4.f * margin);
+    if (Contains(old_fat, box) && Contains(loose, old_fat)) return false;
+
+    RemoveLeaf(proxy);
+    nodes_[proxy].box = fat;
+    InsertLeaf(proxy);
+    return true;
+}
+
+void AABBTree::InsertLeaf(int leaf) {
+    if (root_ == NULL_NODE) {
+        root_ = leaf;
+        nodes_[root_].parent = NULL_NODE;
+        return;
+    }
+
+    // Go down to the sibling that grows the total surface area of the tree least
+    BoundingBox leaf_box = nodes_[leaf].box;
+    int index = root_;
+    while (!nodes_[index].IsLeaf()) {
+        const Node& node = nodes_[index];
+        float area = node.box.GetSurfaceArea();
+        float combined_area = Union(node.box, leaf_box).GetSurfaceArea();
+        // Cost of making a new parent for this node and the leaf
+        float cost = 2.f * combined_area;
+        // Every ancestor grows by this much if the leaf goes further down
+        float inheritance_cost = 2.f * (combined_area - area);
+        auto descend_cost = [&](int child) {
+            const BoundingBox& child_box = nodes_[child].box;
+            float grown = Union(child_box, leaf_box).GetSurfaceArea();
+            if (nodes_[child].IsLeaf()) return grown + inheritance_cost;
+            return grown - child_box.GetSurfaceArea() + inheritance_cost;
+        };
+        float cost1 = descend_cost(node.child1);
+        float cost2 = descend_cost(node.child2);
+        if (cost < cost1 && cost < cost2) break;
+        index = cost1 < cost2 ? node.child1 : node.child2;
+    }
+    int sibling = index;
+
+    // Join the leaf and its sibling under a new parent
+    int old_parent = nodes_[sibling].parent;
+    int new_parent = AllocateNode();
+    nodes_[new_parent].parent = old_parent;
+    nodes_[new_parent].box = Union(leaf_box, nodes_[sibling].box);
+    nodes_[new_parent].height = nodes_[sibling].height + 1;
+    nodes_[new_parent].child1 = sibling;
+    nodes_[new_parent].child2 = leaf;
+    nodes_[sibling].parent = new_parent;
+    nodes_[leaf].parent = new_parent;
+    if (old_parent == NULL_NODE) {
+        root_ = new_parent;
+    } else if (nodes_[old_parent].child1 == sibling) {
+        nodes_[old_parent].child1 = new_parent;
+    } else {
+        nodes_[old_parent].child2 = new_parent;
+    }
+
+    FixUpwards(nodes_[leaf].parent);
+}
+
+void AABBTree::RemoveLeaf(int leaf) {
+    if (leaf == root_) {
+        root_ = NULL_NODE;
+        return;
+    }
+
+    // The sibling takes the parent's place
+    int parent = nodes_[leaf].parent;
+    int grand_parent = nodes_[parent].parent;
+    int sibling = nodes_[parent].child1 == leaf ? nodes_[parent].child2 : nodes_[parent].child1;
+    FreeNode(parent);
+    nodes_[sibling].parent = grand_parent;
+    if (grand_parent == NULL_NODE) {
+        root_ = sibling;
+        return;
+    }
+    if (nodes_[grand_parent].child1 == parent) {
+        nodes_[grand_parent].child1 = sibling;
+    } else {
+        nodes_[grand_parent].child2 = sibling;
+    }
+    FixUpwards(grand_parent);
+}
+
+void AABBTree::FixUpwards(int index) {
+    while (index != NULL_NODE) {
+        index = Balance(index);
+        Node& node = nodes_[index];
+        const Node& child1 = nodes_[node.child1];
+        const Node& child2 = nodes_[node.child2];
+        node.height = 1 + std::max(child1.height, child2.height);
+        node.box = Union(child1.box, child2.box);
+        index = node.parent;
+    }
+}
+
+int AABBTree::Balance(int a) {
+    if (nodes_[a].IsLeaf() || nodes_[a].height < 2) return a;
+
+    int b = nodes_[a].child1;
+    int c = nodes_[a].child2;
+    int balance = nodes_[c].height - nodes_[b].height;
+    if (balance >= -1 && balance <= 1) return a;
+
+    // Rotate the taller child up into a's place. Of its children, the taller stays with it and the other goes to a.
+    int up = balance > 1 ? c : b;
+    int other = balance > 1 ? b : c;
+    int f = nodes_[up].child1;
+    int g = nodes_[up].child2;
+
+    nodes_[up].child1 = a;
+    nodes_[up].parent = nodes_[a].parent;
+    nodes_[a].parent = up;
+    if (nodes_[up].parent == NULL_NODE) {
+        root_ = up;
+    } else if (nodes_[nodes_[up].parent].child1 == a) {
+        nodes_[nodes_[up].parent].child1 = up;
+    } else {
+        nodes_[nodes_[up].parent].child2 = up;
+    }
+
+    int keep = nodes_[f].height > nodes_[g].height ? f : g;
+    int give = keep == f ? g : f;
+    nodes_[up].child2 = keep;
+    if (balance > 1) {
+        nodes_[a].child2 = give;
+    } else {
+        nodes_[a].child1 = give;
+    }
+    nodes_[give].parent = a;
+
+    nodes_[a].box = Union(nodes_[other].box, nodes_[give].box);
+    nodes_[a].height = 1 + std::max(nodes_[other].height, nodes_[give].height);
+    nodes_[up].box = Union(nodes_[a].box, nodes_[keep].box);
+    nodes_[up].height = 1 + std::max(nodes_[a].height, nodes_[keep].height);
+    return up;
+}
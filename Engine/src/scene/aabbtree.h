@@ -0,0 +1,89 @@
+#ifndef AABBTREE_H
+#define AABBTREE_H
+
+#include <scene/boundingbox.h>
+#include <scene/frustum.h>
+#include <vector>
+#include <utility>
+
+// Bounding volume hierarchy over boxes that come, go and move, after Box2D's b2DynamicTree.
+// Every proxy keeps its box grown by a margin, so it only has to move in the tree once the real box
+// leaves that, and the tree is kept balanced with rotations as proxies are inserted and removed.
+class AABBTree
+{
+public:
+    static const int NULL_NODE = -1;
+
+    explicit AABBTree(float margin = 0.1f);
+
+    // Returns the proxy id, which stays the same until it's destroyed
+    int CreateProxy(const BoundingBox& box, void* user_data);
+    void DestroyProxy(int proxy);
+    // Returns true if the proxy had to be reinserted
+    bool MoveProxy(int proxy, const BoundingBox& box);
+
+    void* GetUserData(int proxy) const { return nodes_[proxy].user_data; }
+    const BoundingBox& GetFatBox(int proxy) const { return nodes_[proxy].box; }
+    int GetProxyCount() const { return proxy_count_; }
+    // Every proxy id is below this
+    int GetNodeCapacity() const { return (int)nodes_.size(); }
+    int GetHeight() const { return root_ == NULL_NODE ? 0 : nodes_[root_].height; }
+
+    // Calls f(proxy) for every proxy whose fat box is inside or touches the frustum.
+    // Subtrees entirely inside are reported without testing their boxes.
+    template<typename F>
+    void Query(const Frustum& frustum, F f) const;
+
+private:
+    struct Node {
+        BoundingBox box;
+        void* user_data;
+        int parent; // Next free node while on the free list
+        int child1;
+        int child2;
+        int height; // 0 for leaves, -1 while free
+        bool IsLeaf() const { return child1 == NULL_NODE; }
+    };
+
+    float margin_;
+    int root_;
+    int free_list_;
+    int proxy_count_;
+    std::vector<Node> nodes_;
+    mutable std::vector<std::pair<int, bool>> query_stack_; // (node, known to be inside)
+
+    int AllocateNode();
+    void FreeNode(int node);
+    void InsertLeaf(int leaf);
+    void RemoveLeaf(int leaf);
+    // Refits boxes and heights from node up to the root, rebalancing on the way
+    void FixUpwards(int node);
+    // Rotates node's taller child up if its children's heights differ by more than one, returns the subtree's new root
+    int Balance(int node);
+};
+
+template<typename F>
+void AABBTree::Query(const Frustum& frustum, F f) const {
+    if (root_ == NULL_NODE) return;
+    query_stack_.clear();
+    query_stack_.push_back(std::make_pair(root_, false));
+    while (!query_stack_.empty()) {
+        int index = query_stack_.back().first;
+        bool inside = query_stack_.back().second;
+        query_stack_.pop_back();
+        const Node& node = nodes_[index];
+        if (!inside) {
+            Frustum::Containment containment = frustum.Classify(node.box);
+            if (containment == Frustum::Outside) continue;
+            inside = containment == Frustum::Inside;
+        }
+        if (node.IsLeaf()) {
+            f(index);
+        } else {
+            query_stack_.push_back(std::make_pair(node.child1, inside));
+            query_stack_.push_back(std::make_pair(node.child2, inside));
+        }
+    }
+}
+
+#endif // AABBTREE_H
@@ -24,7 +24,7 @@ Camera::Camera(double fov, int render_width, int render_height, double near_plan
     Width(width < 0 ? 5.0 : width),
     TraceSettings(),
 
-    TraceRandomMode({"Off", "Uniform Random", "Stratified Random"}, 0),
+    TraceRandomMode({"Off", "Uniform Random", "Stratified Random", "Halton (Scrambled)", "Sobol (Owen Scrambled)"}, 0),
     TraceDiffuseReflection(true),
     TraceCaustics(true),
     TraceRandomBranching(true),
@@ -40,10 +40,17 @@ Camera::Camera(double fov, int render_width, int render_height, double near_plan
     TraceApertureSize(0.0),
     TraceMaxDepth(true, 5),
     TraceEnableAcceleration(true),
+    TraceKernel({"Scalar (double)", "SIMD (float, watertight)"}, 0),
     TraceShadows({"No Shadows", "Opaque Shadows Only", "Translucent Shadows"}, 2),
     TraceEnableReflection(true),
     TraceEnableRefraction(true),
 
+    TraceProgressivePasses(true, 1),
+    TraceToneMapping({"Clamp", "Reinhard", "ACES (fitted)"}, 0),
+    TraceSRGBOutput(false),
+    TraceSaveHDR(false),
+    TraceShowSampleHeatmap(false),
+
     TraceDebugger()
 {
     IsPerspective.Set(true);
@@ -72,9 +79,15 @@ Camera::Camera(double fov, int render_width, int render_height, double near_plan
 
         TraceSettings.AddProperty("Maximum Recursion Depth", &TraceMaxDepth);
         TraceSettings.AddProperty("Enable BVH Acceleration", &TraceEnableAcceleration);
+        TraceSettings.AddProperty("Intersection Kernel", &TraceKernel);
         TraceSettings.AddProperty("Shadows", &TraceShadows);
         TraceSettings.AddProperty("Reflections", &TraceEnableReflection);
         TraceSettings.AddProperty("Refractions", &TraceEnableRefraction);
+        TraceSettings.AddProperty("Progressive Passes", &TraceProgressivePasses);
+        TraceSettings.AddProperty("Tone Mapping", &TraceToneMapping);
+        TraceSettings.AddProperty("sRGB Output", &TraceSRGBOutput);
+        TraceSettings.AddProperty("Save HDR (.pfm)", &TraceSaveHDR);
+        TraceSettings.AddProperty("Show Sample Heatmap", &TraceShowSampleHeatmap);
         //TraceSettings.AddProperty("Flares Only", &TraceFlaresOnly);
 
     AddProperty("Trace Debugger", &TraceDebugger);
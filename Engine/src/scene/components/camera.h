@@ -42,6 +42,8 @@ public:
 
         static const int TRACERANDOM_UNIFORM = 1;
         static const int TRACERANDOM_STRATIFIED = 2;
+        static const int TRACERANDOM_HALTON = 3;
+        static const int TRACERANDOM_SOBOL = 4;
         BooleanProperty TraceDiffuseReflection;
         BooleanProperty TraceCaustics;
         BooleanProperty TraceRandomBranching;
@@ -62,6 +64,9 @@ public:
     //BooleanProperty TraceFlaresOnly;
     IntProperty TraceMaxDepth;
     BooleanProperty TraceEnableAcceleration;
+    ChoiceProperty TraceKernel;
+        static const int TRACEKERNEL_SCALAR = 0;
+        static const int TRACEKERNEL_SIMD = 1;
     static const int TRACESHADOWS_NONE = 0;
     static const int TRACESHADOWS_OPAQUE = 1;
     static const int TRACESHADOWS_COLORED = 2;
@@ -69,6 +74,15 @@ public:
     BooleanProperty TraceEnableReflection;
     BooleanProperty TraceEnableRefraction;
 
+    IntProperty TraceProgressivePasses;
+    ChoiceProperty TraceToneMapping;
+        static const int TRACETONEMAP_CLAMP = 0;
+        static const int TRACETONEMAP_REINHARD = 1;
+        static const int TRACETONEMAP_ACES = 2;
+    BooleanProperty TraceSRGBOutput;
+    BooleanProperty TraceSaveHDR;
+    BooleanProperty TraceShowSampleHeatmap;
+
     std::map<int, std::unique_ptr<BooleanProperty>> trace_debug_views;
 
     Camera(double fov = 50.0f, int render_width = 1280, int render_height = 720, double near_plane = 0.1f, double far_plane = 100.0f, double width = 5.0f);
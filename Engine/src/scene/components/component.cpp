@@ -14,6 +14,7 @@
 
 std::map<std::string, MetaComponent*>* Component::typename_registry_ = nullptr;
 std::map<std::type_index, MetaComponent*>* Component::typeinfo_registry_ = nullptr;
+std::map<std::type_index, int>* Component::typeid_registry_ = nullptr;
 
 bool Component::IsDefined(std::string const classname) {
     return typename_registry_->find(classname) != typename_registry_->end();
@@ -27,6 +28,16 @@ std::type_index Component::GetBaseType() const {
     return GetMetaComponent()->BaseType;
 }
 
+int Component::GetTypeId() const {
+    return GetMetaComponent()->TypeId;
+}
+
+int Component::FindTypeId(std::type_index base_type) {
+    if (typeid_registry_ == nullptr) return -1;
+    auto it = typeid_registry_->find(base_type);
+    return it == typeid_registry_->end() ? -1 : it->second;
+}
+
 MetaComponent const* Component::GetMetaComponent() const {
     MetaComponent* meta = (*typeinfo_registry_)[std::type_index(typeid(*this))];
     assert(meta != nullptr);
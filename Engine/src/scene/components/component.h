@@ -16,6 +16,7 @@
 #include <scene/scenemanager.h>
 
 #include <QDebug>
+#include <atomic>
 
 class MetaComponent {
   public:
@@ -25,10 +26,15 @@ class MetaComponent {
     std::string const TypeName;
     std::type_index const BaseType;
     std::string const BaseTypeName;
+    int TypeId = -1; // Id of BaseType, set on registration
 };
 
 class Component : public ObjectWithProperties {
 public:
+    // Each base type gets a small id when its first component type registers, so scene objects
+    // and the scene can keep components in slots indexed by it instead of looking up type_index maps
+    static const int MAX_COMPONENT_TYPES = 32;
+
     virtual ~Component() {}
 
     std::string GetTypeName() const;
@@ -38,12 +44,35 @@ public:
 
     std::type_index GetBaseType() const;
     template<typename T> static std::type_index const GetBaseType() {
-        if (typeinfo_registry_->find(std::type_index(typeid(T))) == typeinfo_registry_->end()) {
+        if (typeinfo_registry_ == nullptr || typeinfo_registry_->find(std::type_index(typeid(T))) == typeinfo_registry_->end()) {
             return std::type_index(typeid(T)); // it is a virtual type, so it is the base type
         }
         return GetMetaComponent<T>()->BaseType;
     }
 
+    int GetTypeId() const;
+    // Returns -1 if no component type with that base type is registered. Only a found id is cached,
+    // so asking before T registers, e.g. from another static initializer, doesn't leave it -1 for good.
+    template<typename T> static int GetTypeId() {
+        static std::atomic<int> cached_id(-1);
+        int id = cached_id.load(std::memory_order_relaxed);
+        if (id < 0) {
+            id = FindTypeId(GetBaseType<T>());
+            if (id >= 0) cached_id.store(id, std::memory_order_relaxed);
+        }
+        return id;
+    }
+    // Whether every component in T's slot is a T, so no dynamic_cast is needed. Cached once T has an id.
+    template<typename T> static bool IsBaseType() {
+        static std::atomic<int> cached_is_base(-1);
+        int is_base = cached_is_base.load(std::memory_order_relaxed);
+        if (is_base < 0) {
+            is_base = GetBaseType<T>() == std::type_index(typeid(T)) ? 1 : 0;
+            if (GetTypeId<T>() >= 0) cached_is_base.store(is_base, std::memory_order_relaxed);
+        }
+        return is_base == 1;
+    }
+
     static Component* Create(std::string const ClassName);
     template<typename T> static Component* Create() {
         return GetMetaComponent<T>()->Create();
@@ -55,9 +84,16 @@ public:
         if (typename_registry_ == nullptr) {
             typename_registry_ = new std::map<std::string, MetaComponent*>();
             typeinfo_registry_ = new std::map<std::type_index, MetaComponent*>();
+            typeid_registry_ = new std::map<std::type_index, int>();
         }
         (*typename_registry_)[meta->TypeName] = meta;
         (*typeinfo_registry_)[std::type_index(typeid(T))] = meta;
+        if (typeid_registry_->find(meta->BaseType) == typeid_registry_->end()) {
+            int id = (int)typeid_registry_->size();
+            assert(id < MAX_COMPONENT_TYPES);
+            (*typeid_registry_)[meta->BaseType] = id;
+        }
+        meta->TypeId = (*typeid_registry_)[meta->BaseType];
     }
 
     template<typename T>
@@ -66,6 +102,9 @@ public:
 protected:
     static std::map<std::string, MetaComponent*>* typename_registry_;
     static std::map<std::type_index, MetaComponent*>* typeinfo_registry_;
+    static std::map<std::type_index, int>* typeid_registry_;
+
+    static int FindTypeId(std::type_index base_type);
 
     MetaComponent const* GetMetaComponent() const;
     static MetaComponent const* GetMetaComponent(std::string const ClassName);
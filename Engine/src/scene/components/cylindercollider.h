@@ -17,6 +17,7 @@ public:
     DoubleProperty Diameter;
     DoubleProperty Height;
     DoubleProperty Restitution;
+    DoubleProperty Friction;
 
     CylinderCollider();
 
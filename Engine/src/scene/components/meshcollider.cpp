@@ -0,0 +1,11 @@
+#include "meshcollider.h"
+
+REGISTER_COMPONENT(MeshCollider, MeshCollider)
+
+MeshCollider::MeshCollider() :
+    Restitution(0.5f, 0.0f, 1.0f, 0.1f),
+    Friction(0.0f, 0.0f, 1.0f, 0.1f)
+{
+    AddProperty("Restitution", &Restitution);
+    AddProperty("Friction", &Friction);
+}
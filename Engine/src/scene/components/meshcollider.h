@@ -0,0 +1,16 @@
+#ifndef MESHCOLLIDER_H
+#define MESHCOLLIDER_H
+
+#include <scene/components/component.h>
+
+// Collides particles with the triangles of the render mesh of the object's Geometry
+class MeshCollider : public Component {
+public:
+    DoubleProperty Restitution;
+    DoubleProperty Friction;
+
+    MeshCollider();
+
+};
+
+#endif // MESHCOLLIDER_H
@@ -9,44 +9,73 @@
  ****************************************************************************/
 #include "particlesystem.h"
 #include <scene/sceneobject.h>
+#include <QRunnable>
+#include <functional>
+#include <limits>
 
 REGISTER_COMPONENT(ParticleSystem, ParticleSystem)
 
-static glm::vec3 ReflectVec(glm::vec3 V, glm::vec3 N, double restitution);
+// Smallest range of particles worth handing to another thread
+static const size_t PARTICLE_CHUNK_SIZE = 8192;
+
+namespace {
+class ParticleJob : public QRunnable {
+public:
+    ParticleJob(const std::function<void(size_t, size_t)>& f, size_t begin, size_t end) : f_(f), begin_(begin), end_(end) {}
+    void run() override { f_(begin_, end_); }
+private:
+    const std::function<void(size_t, size_t)>& f_;
+    size_t begin_;
+    size_t end_;
+};
+}
 
 ParticleSystem::ParticleSystem() :
     ParticleGeometry({"Sphere"}, 0),
     ParticleMaterial(AssetType::Material),
+    ParticleScale(1.0f, 0.01f, 10.0f, 0.01f),
+    ParticleColor(true),
+    Billboards(false),
+    SortBackToFront(false),
     InitialVelocity(glm::vec3(5.0f, 5.0f, 0.0f)),
     Mass(0.1f, 0.0f, 10.0f, 0.1f),
     Period(0.5f, 0.0f, 1.0f, 0.01f),
+    ParticlesPerPeriod(true, 1),
+    MaxParticles(true, 1000),
     ConstantF(glm::vec3(0.0f, -9.8f, 0.0f)),
     DragF(0.0f, 0.0f, 10.0f, 0.01f),
+    Integrator({"Semi-Implicit Euler", "Verlet"}, 0),
+    CollisionRadius(0.5f, 0.0f, 10.0f, 0.01f),
+    ParticleCollisions(false),
+    ParticleRestitution(0.5f, 0.0f, 1.0f, 0.01f),
     constant_force_(ConstantF.Get()),
-    // REQUIREMENT:
-    // init drag force with DragF -- refer to how we deal with constant_force_
-    // remember  (f = -k_d * v), where DragF represents k_d
     drag_force_(DragF.Get()),
-    num_particles_(0),
-    particle_index_(0),
+    time_to_emit_(0.0),
     simulating_(false)
 {
     AddProperty("Geometry", &ParticleGeometry);
     AddProperty("Material", &ParticleMaterial);
+    AddProperty("Scale", &ParticleScale);
+    AddProperty("Color", &ParticleColor);
+    AddProperty("Billboards", &Billboards);
+    AddProperty("Sort Back to Front", &SortBackToFront);
     AddProperty("Initial Velocity", &InitialVelocity);
     AddProperty("Mass", &Mass);
     AddProperty("Period (s)", &Period);
+    AddProperty("Particles per Period", &ParticlesPerPeriod);
+    AddProperty("Max Particles", &MaxParticles);
     AddProperty("Constant Force", &ConstantF);
     AddProperty("Drag Coefficient", &DragF);
+    AddProperty("Integrator", &Integrator);
+    AddProperty("Collision Radius", &CollisionRadius);
+    AddProperty("Particle Collisions", &ParticleCollisions);
+    AddProperty("Particle Restitution", &ParticleRestitution);
 
     ParticleGeometry.ValueSet.Connect(this, &ParticleSystem::OnGeometrySet);
 
-    forces_.push_back(std::shared_ptr<Force>(&constant_force_));
-
-    // REQUIREMENT: 
-    //    add viscous drag force into forces_ array if your drag force also inherit from class Force
-    //    If not, you could use your own way to prepare your drag force
-    forces_.push_back(std::shared_ptr<Force>(&drag_force_)); // Assuming this works like the one for constant_force_ might need to review smart pointers.
+    forces_.push_back(&constant_force_);
+    forces_.push_back(&drag_force_);
+    particles_.Reset(MaxParticles.Get());
 }
 
 void ParticleSystem::UpdateModelMatrix(glm::mat4 model_matrix) {
@@ -56,51 +85,304 @@ void ParticleSystem::UpdateModelMatrix(glm::mat4 model_matrix) {
 void ParticleSystem::EmitParticles() {
     if (!simulating_) return;
 
-    // REQUIREMENT:
-    // Create some particles!
-    //    - We have designed a class Particle for you
-    //    - We've provided some UI controls for you
-    //          -- Mass.Get() defines particle mass, and
-    //          -- InitialVelocity.Get() defines particle init velocity in local object space
-    //    - Notice particles should be created in world space. (use model_matrix_ to transform particles from local object space to world space)
-    // Store particles in the member variable particles_
-    // For performance reasons, limit the amount of particles that exist at the same time
-    // to some finite amount (MAX_PARTICLES). Either delete or recycle old particles as needed.
-
-    // Not sure if I'm supposed to be creating "MAX_PARTICLES" particles all at once here or not
-    // Also not sure if there's sopme case here I'm not accounting for, like how would I check if I even need to "delete or recycle old particles as needed."
-    if (num_particles_ == MAX_PARTICLES) {
-        delete particles_.front().release();
-        particles_.pop_front();
-        num_particles_--;
-    }
-    glm::vec3 position = glm::vec3(model_matrix_*glm::vec4(0,0,0,1.f)); // I suppose the local position should be (0,0,0)?
+    // Particles are created in world space. Once MaxParticles exist the oldest are recycled.
+    glm::vec3 position = glm::vec3(model_matrix_*glm::vec4(0,0,0,1.f));
     glm::vec3 velocity = glm::vec3(model_matrix_*glm::vec4(InitialVelocity.Get(), 0.f));
-    glm::vec3 rotation = glm::vec3(model_matrix_*glm::vec4(0,0,0,1.f)); // I don't think we're passed in any info for angle at this point?
-
-    particles_.push_back(std::unique_ptr<Particle>(new Particle(Mass.Get(), position, velocity, rotation)));
-    num_particles_++;
+    glm::vec3 rotation = glm::vec3(model_matrix_*glm::vec4(0,0,0,1.f));
+    int count = std::max(1, ParticlesPerPeriod.Get());
+    for (int i = 0; i < count; i++) {
+        size_t slot = particles_.Emit();
+        particles_.mass[slot] = Mass.Get();
+        particles_.position[slot] = position;
+        particles_.previous_position[slot] = position;
+        particles_.velocity[slot] = velocity;
+        particles_.rotation[slot] = rotation;
+        particles_.color[slot] = ParticleColor.Get();
+        particles_.age[slot] = 0.f;
+    }
 
     // Reset the time
     time_to_emit_ = Period.Get();
 }
 
-std::vector<Particle*> ParticleSystem::GetParticles() {
-    // Return a vector of particles (used by renderer to draw them)
-    std::vector<Particle*> particles;
-    for (auto& particle : particles_) particles.push_back(particle.get());
-    return particles;
-}
-
 void ParticleSystem::StartSimulation() {
     simulating_ = true;
     constant_force_.SetForce(ConstantF.Get());
-    // REQUIREMENT:
-    // Set your added drag force as DragF.Get() -- Refer to what we did on constact_force_
     drag_force_.SetForce(DragF.Get());
     ResetSimulation();
 }
 
+template<typename F>
+void ParticleSystem::ParallelForParticles(F f) {
+    size_t begin[2], end[2];
+    int ranges = particles_.GetRanges(begin, end);
+    const std::function<void(size_t, size_t)> job = f;
+    for (int r = 0; r < ranges; r++) {
+        size_t count = end[r] - begin[r];
+        // With a single thread allowed everything runs here, rather than beside one pool thread
+        size_t threads = (size_t)std::max(1, thread_pool_.maxThreadCount());
+        size_t chunks = threads == 1 ? 1 : std::min((count + PARTICLE_CHUNK_SIZE - 1) / PARTICLE_CHUNK_SIZE, threads * 4);
+        if (chunks <= 1) {
+            f(begin[r], end[r]);
+            continue;
+        }
+        // This thread takes the first chunk while the pool takes the rest
+        size_t chunk = (count + chunks - 1) / chunks;
+        for (size_t b = begin[r] + chunk; b < end[r]; b += chunk) {
+            thread_pool_.start(new ParticleJob(job, b, std::min(b + chunk, end[r])));
+        }
+        f(begin[r], begin[r] + chunk);
+        thread_pool_.waitForDone();
+    }
+}
+
+void ParticleSystem::PrepareColliders(const std::vector<std::pair<SceneObject*, glm::mat4>>& colliders) {
+    collider_states_.clear();
+    for (auto& kv : mesh_collider_shapes_) kv.second.used = false;
+    for (auto& kv : colliders) {
+        SceneObject* collider_object = kv.first;
+        ColliderState state;
+        state.model_matrix = kv.second;
+        state.inverse_model_matrix = collider_object->GetInverseModelMatrix();
+        state.normal_matrix = glm::transpose(glm::mat3(state.inverse_model_matrix));
+        // How much longer each local axis direction is in local space than in world space
+        glm::vec3 axis_scale(glm::length(state.normal_matrix[0]), glm::length(state.normal_matrix[1]), glm::length(state.normal_matrix[2]));
+        state.radius_scale = glm::max(axis_scale.x, glm::max(axis_scale.y, axis_scale.z));
+        state.radius = state.width = state.height = 0.f;
+        state.mesh = nullptr;
+        if (SphereCollider* sphere_collider = collider_object->GetComponent<SphereCollider>()) {
+            state.type = ColliderState::Sphere;
+            state.radius = sphere_collider->Radius.Get();
+            state.restitution = sphere_collider->Restitution.Get();
+            state.friction = sphere_collider->Friction.Get();
+        } else if (PlaneCollider* plane_collider = collider_object->GetComponent<PlaneCollider>()) {
+            state.type = ColliderState::Plane;
+            state.width = plane_collider->Width.Get();
+            state.height = plane_collider->Height.Get();
+            state.restitution = plane_collider->Restitution.Get();
+            state.friction = plane_collider->Friction.Get();
+            // Only the distance along the normal matters
+            state.radius_scale = axis_scale.z;
+        } else if (CylinderCollider* cylinder_collider = collider_object->GetComponent<CylinderCollider>()) {
+            state.type = ColliderState::Cylinder;
+            state.radius = cylinder_collider->Diameter.Get() / 2.f;
+            state.height = cylinder_collider->Height.Get();
+            state.restitution = cylinder_collider->Restitution.Get();
+            state.friction = cylinder_collider->Friction.Get();
+        } else if (MeshCollider* mesh_collider = collider_object->GetComponent<MeshCollider>()) {
+            Geometry* geometry = collider_object->GetComponent<Geometry>();
+            Mesh* mesh = geometry ? geometry->GetRenderMesh() : nullptr;
+            if (!mesh) continue;
+            state.type = ColliderState::Mesh;
+            state.restitution = mesh_collider->Restitution.Get();
+            state.friction = mesh_collider->Friction.Get();
+            state.mesh = &GetMeshColliderShape(*mesh);
+            if (state.mesh->tree.IsEmpty()) continue;
+            // The largest stretch in any direction, sheared ones included
+            state.radius_scale = glm::length(axis_scale);
+        } else {
+            continue;
+        }
+        collider_states_.push_back(state);
+    }
+    // Meshes no longer colliding, or deleted
+    for (auto it = mesh_collider_shapes_.begin(); it != mesh_collider_shapes_.end();) {
+        if (it->second.used) ++it;
+        else it = mesh_collider_shapes_.erase(it);
+    }
+}
+
+const ParticleSystem::MeshColliderShape& ParticleSystem::GetMeshColliderShape(const Mesh& mesh) {
+    MeshColliderShape& shape = mesh_collider_shapes_[mesh.GetUID()];
+    shape.used = true;
+    if (shape.shape_version == mesh.GetShapeVersion()) return shape;
+
+    const std::vector<float>& positions = mesh.GetPositions();
+    const std::vector<unsigned int>& triangles = mesh.GetTriangles();
+    shape.corners.clear();
+    shape.corners.reserve(triangles.size());
+    std::vector<BoundingBox> bounds;
+    bounds.reserve(triangles.size() / 3);
+    for (size_t i = 0; i + 2 < triangles.size(); i += 3) {
+        BoundingBox box(glm::vec3(std::numeric_limits<float>::max()), glm::vec3(-std::numeric_limits<float>::max()));
+        for (size_t k = 0; k < 3; k++) {
+            unsigned int index = triangles[i + k];
+            glm::vec3 corner(positions[3 * index], positions[3 * index + 1], positions[3 * index + 2]);
+            shape.corners.push_back(corner);
+            box.min = glm::min(box.min, corner);
+            box.max = glm::max(box.max, corner);
+        }
+        bounds.push_back(box);
+    }
+    shape.tree.Build(bounds);
+    shape.shape_version = mesh.GetShapeVersion();
+    return shape;
+}
+
+void ParticleSystem::Integrate(size_t begin, size_t end, float delta_t) {
+    glm::vec3* forces = net_forces_.data();
+    for (size_t i = begin; i < end; i++) forces[i] = glm::vec3(0.f);
+    for (Force* force : forces_) force->AddForces(particles_, begin, end, forces);
+
+    for (size_t i = begin; i < end; i++) step_start_[i] = particles_.position[i];
+
+    if (Integrator.Get() == (int)ParticleIntegrator::Verlet) {
+        for (size_t i = begin; i < end; i++) {
+            float mass = particles_.mass[i];
+            glm::vec3 acceleration = mass > 0.f ? forces[i] / mass : glm::vec3(0.f);
+            glm::vec3 position = particles_.position[i];
+            // New particles start from their emission velocity
+            glm::vec3 previous = particles_.age[i] == 0.f ? position - particles_.velocity[i] * delta_t : particles_.previous_position[i];
+            glm::vec3 next = 2.f * position - previous + acceleration * delta_t * delta_t;
+            particles_.previous_position[i] = position;
+            particles_.position[i] = next;
+            particles_.velocity[i] = (next - position) / delta_t;
+        }
+    } else {
+        for (size_t i = begin; i < end; i++) {
+            float mass = particles_.mass[i];
+            glm::vec3 acceleration = mass > 0.f ? forces[i] / mass : glm::vec3(0.f);
+            particles_.velocity[i] += acceleration * delta_t;
+            particles_.position[i] += particles_.velocity[i] * delta_t;
+        }
+    }
+
+    for (size_t i = begin; i < end; i++) {
+        CollideWithColliders(i, delta_t);
+        particles_.age[i] += delta_t;
+    }
+}
+
+bool ParticleSystem::SweepCollider(const ColliderState& collider, const glm::vec3& from, const glm::vec3& to, float radius, ParticleSweepHit& hit) const {
+    glm::vec3 local_from = glm::vec3(collider.inverse_model_matrix * glm::vec4(from, 1.f));
+    glm::vec3 local_to = glm::vec3(collider.inverse_model_matrix * glm::vec4(to, 1.f));
+    float local_radius = radius * collider.radius_scale;
+
+    if (collider.type == ColliderState::Mesh) {
+        // Find the triangles to test in local space, then test them in world space, where the particle is round.
+        // The fraction of the way along the step is the same in both.
+        const glm::mat4& model_matrix = collider.model_matrix;
+        const glm::vec3* corners = collider.mesh->corners.data();
+        ParticleSweepHit triangle_hit;
+        return collider.mesh->tree.Sweep(local_from, local_to, local_radius, [&](uint32_t triangle, float& t) {
+            const glm::vec3* triangle_corners = corners + 3 * triangle;
+            glm::vec3 a = glm::vec3(model_matrix * glm::vec4(triangle_corners[0], 1.f));
+            glm::vec3 b = glm::vec3(model_matrix * glm::vec4(triangle_corners[1], 1.f));
+            glm::vec3 c = glm::vec3(model_matrix * glm::vec4(triangle_corners[2], 1.f));
+            if (!SweepParticleTriangle(from, to, radius, a, b, c, triangle_hit) || triangle_hit.t >= t) return false;
+            hit = triangle_hit;
+            t = triangle_hit.t;
+            return true;
+        });
+    }
+
+    bool found = false;
+    switch (collider.type) {
+    case ColliderState::Sphere:
+        found = SweepParticleSphere(local_from, local_to, local_radius, collider.radius, hit);
+        break;
+    case ColliderState::Plane:
+        found = SweepParticlePlane(local_from, local_to, local_radius, collider.width, collider.height, hit);
+        break;
+    case ColliderState::Cylinder:
+        found = SweepParticleCylinder(local_from, local_to, local_radius, collider.radius, collider.height, hit);
+        break;
+    case ColliderState::Mesh:
+        break;
+    }
+    if (!found) return false;
+    // Normals go by the inverse transpose, so they stay perpendicular to non-uniformly scaled surfaces
+    hit.point = glm::vec3(collider.model_matrix * glm::vec4(hit.point, 1.f));
+    hit.normal = glm::normalize(collider.normal_matrix * hit.normal);
+    return true;
+}
+
+void ParticleSystem::CollideWithColliders(size_t slot, float delta_t) {
+    // A particle caught between colliders stops where it is after this many bounces in a step
+    static const int MAX_BOUNCES = 4;
+    // Distance left between a particle and a surface it bounced off, so the rest of the step starts outside
+    static const float SKIN = 1e-4f;
+    if (collider_states_.empty()) return;
+
+    float particle_radius = CollisionRadius.Get();
+    glm::vec3& velocity = particles_.velocity[slot];
+    glm::vec3 from = step_start_[slot];
+    glm::vec3 to = particles_.position[slot];
+    float time_left = delta_t;
+    bool collided = false;
+
+    for (int bounce = 0; bounce <= MAX_BOUNCES; bounce++) {
+        // Find the first collider on the way
+        const ColliderState* first = nullptr;
+        ParticleSweepHit first_hit, hit;
+        for (const ColliderState& collider : collider_states_) {
+            if (SweepCollider(collider, from, to, particle_radius, hit) && (!first || hit.t < first_hit.t)) {
+                first = &collider;
+                first_hit = hit;
+            }
+        }
+        if (!first) break;
+        collided = true;
+        glm::vec3 contact = first_hit.point + first_hit.normal * SKIN;
+        if (bounce == MAX_BOUNCES) {
+            to = contact;
+            break;
+        }
+
+        // Bounce at the contact and spend the rest of the step moving away from it
+        velocity = ParticleCollisionResponse(velocity, first_hit.normal, first->restitution, first->friction);
+        time_left *= 1.f - first_hit.t;
+        from = contact;
+        to = contact + velocity * time_left;
+    }
+    particles_.position[slot] = to;
+    // Keep Verlet going with the bounced velocity
+    if (collided) particles_.previous_position[slot] = to - velocity * delta_t;
+}
+
+void ParticleSystem::CollideParticles(float delta_t) {
+    float radius = CollisionRadius.Get();
+    if (radius <= 0.f) return;
+    float restitution = ParticleRestitution.Get();
+    spatial_hash_.Build(particles_, 2.f * radius);
+
+    // Every particle works out its own correction from the state before any is applied,
+    // so the result doesn't depend on the order or the threads
+    ParallelForParticles([&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            glm::vec3 position = particles_.position[i];
+            glm::vec3 velocity = particles_.velocity[i];
+            float inverse_mass = particles_.mass[i] > 0.f ? 1.f / particles_.mass[i] : 0.f;
+            glm::vec3 position_correction(0.f);
+            glm::vec3 velocity_correction(0.f);
+            spatial_hash_.ForEachNear(position, [&](uint32_t j) {
+                if (j == i) return;
+                glm::vec3 offset = position - particles_.position[j];
+                float distance2 = glm::dot(offset, offset);
+                if (distance2 >= 4.f * radius * radius || distance2 == 0.f) return;
+                float other_inverse_mass = particles_.mass[j] > 0.f ? 1.f / particles_.mass[j] : 0.f;
+                if (inverse_mass + other_inverse_mass == 0.f) return;
+                // This particle's share of the response, by inverse mass
+                float share = inverse_mass / (inverse_mass + other_inverse_mass);
+                float distance = std::sqrt(distance2);
+                glm::vec3 normal = offset / distance;
+                position_correction += normal * (2.f * radius - distance) * share;
+                float approach = glm::dot(velocity - particles_.velocity[j], normal);
+                if (approach < 0.f) velocity_correction -= (1.f + restitution) * approach * share * normal;
+            });
+            position_corrections_[i] = position_correction;
+            velocity_corrections_[i] = velocity_correction;
+        }
+    });
+    ParallelForParticles([&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            particles_.position[i] += position_corrections_[i];
+            particles_.velocity[i] += velocity_corrections_[i];
+            particles_.previous_position[i] = particles_.position[i] - particles_.velocity[i] * delta_t;
+        }
+    });
+}
+
 void ParticleSystem::UpdateSimulation(float delta_t, const std::vector<std::pair<SceneObject*, glm::mat4>>& colliders) {
     if (!simulating_) return;
 
@@ -108,69 +390,18 @@ void ParticleSystem::UpdateSimulation(float delta_t, const std::vector<std::pair
     time_to_emit_ -= delta_t;
     if (time_to_emit_ <= 0.0) EmitParticles();
 
-    // REQUIREMENT:
-    // For each particle ...
-    //      Calculate forces
-    //      Solve the system of forces using Euler's method
-    //      Update the particle
-    //      Check for and handle collisions
-    Particle *p;
-    std::list<std::unique_ptr<Particle>>::iterator iter;
-    for (iter = particles_.begin(); iter != particles_.end(); iter++) {
-        p = iter->get();
-
-        // I think this is how we get these?
-        glm::vec3 gravity = constant_force_.GetForce(*p),
-                  drag = drag_force_.GetForce(*p),
-                  net_force = gravity + drag;
-        p->Velocity += net_force/p->Mass * delta_t;
-        p->Position = p->Position + p->Velocity*delta_t;
-
-        // Collision code might look something like this:
-        for (auto& kv : colliders) {
-            SceneObject* collider_object = kv.first;
-            glm::mat4 collider_model_matrix = kv.second;
-
-            static const double EPSILON = 0.1;
-            float particle_radius = 0.5f;
-
-            // When checking collisions, remember to bring particles from world space to collider local object space
-            // The trasformation matrix can be derived by taking invese of collider_model_matrix
-            glm::mat4 inverse = glm::inverse(collider_model_matrix);
-            glm::vec3 local_position = glm::vec3(inverse * glm::vec4(p->Position, 1.f)); // update p->Position to local coords, is currently world coords
-            glm::vec3 local_vel = glm::vec3(inverse * glm::vec4(p->Velocity, 0.f));
-
-            if (SphereCollider* sphere_collider = collider_object->GetComponent<SphereCollider>()) {
-                 // Check for Sphere Collision
-                 double sphere_radius = sphere_collider->Radius.Get();
-                 double mag = sqrt(local_position.x*local_position.x + local_position.y*local_position.y + local_position.z*local_position.z);
-                 if (mag <= particle_radius + sphere_radius + EPSILON) {
-                     // collision
-                     glm::vec3 norm = glm::normalize(local_position);
-                     glm::vec3 bounce = ReflectVec(local_vel, norm, sphere_collider->Restitution.Get());
-                     p->Velocity = glm::vec3(collider_model_matrix * glm::vec4(bounce, 0.f));
-                     p->Position = p->Position + p->Velocity*delta_t + p->Velocity*static_cast<float>(EPSILON);
-
-                 }
-            } else if (PlaneCollider* plane_collider = collider_object->GetComponent<PlaneCollider>()) {
-                 // Check for Plane Collision
-                 // plane stretches across X-Y plane, centered at origin
-                 // Width is the size of its x range
-                 // Height is the size of its y range
-                 glm::vec3 plane_norm(0.f, 0.f, 1.f);
-                 if (glm::dot(local_position, plane_norm) <= particle_radius + EPSILON &&
-                        abs(local_position.x) < plane_collider->Width.Get()/2.f &&
-                        abs(local_position.y) < plane_collider->Height.Get()/2.f &&
-                        local_vel.z < 0) {
-                     glm::vec3 bounce = ReflectVec(local_vel, plane_norm, plane_collider->Restitution.Get());
-                     p->Velocity = glm::vec3(collider_model_matrix * glm::vec4(bounce, 0.f));
-                     p->Position = p->Position + p->Velocity*delta_t + p->Velocity*static_cast<float>(EPSILON);
-                 }
-            }
-            // one of the above should always be true in the current version, I suppose.
-            // Even though there's also a cylindercollider
-        }
+    // Collider transforms and parameters only need looking up once per step
+    PrepareColliders(colliders);
+    if (net_forces_.size() != particles_.Capacity()) {
+        net_forces_.resize(particles_.Capacity());
+        step_start_.resize(particles_.Capacity());
+        position_corrections_.resize(particles_.Capacity());
+        velocity_corrections_.resize(particles_.Capacity());
     }
+
+    // Calculate forces, integrate and handle collisions, in parallel over contiguous ranges of particles
+    ParallelForParticles([&](size_t begin, size_t end) { Integrate(begin, end, delta_t); });
+    if (ParticleCollisions.Get()) CollideParticles(delta_t);
 }
 
 void ParticleSystem::StopSimulation() {
@@ -179,12 +410,7 @@ void ParticleSystem::StopSimulation() {
 
 void ParticleSystem::ResetSimulation() {
     // Clear all particles
-    std::list<std::unique_ptr<Particle>>::iterator iter;
-    for (iter = particles_.begin(); iter != particles_.end(); iter++) {
-        delete iter->release();
-    }
-    particles_.clear();
-    num_particles_ = 0;
+    particles_.Reset(std::max(1, MaxParticles.Get()));
     time_to_emit_ = Period.Get();
 }
 
@@ -196,10 +422,3 @@ bool ParticleSystem::IsSimulating() {
 void ParticleSystem::OnGeometrySet(int c) {
     GeomChanged.Emit(ParticleGeometry.GetChoices()[c]);
 }
-
-static glm::vec3 ReflectVec(glm::vec3 V, glm::vec3 N, double restitution) {
-    glm::vec3 Vn, Vt;
-    Vn = glm::dot(N, V)*N;
-    Vt = V-Vn;
-    return Vt - glm::vec3(restitution*glm::dvec3(Vn));
-}
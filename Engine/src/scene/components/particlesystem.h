@@ -12,93 +12,151 @@
 
 #include <signal.h>
 #include <scene/components/component.h>
+#include <scene/particlebuffer.h>
+#include <scene/particlecollision.h>
 #include <resource/material.h>
+#include <trace/bvh.h>
+#include <QThreadPool>
+#include <map>
 
-struct Particle {
-public:
-    float Mass;
-    glm::vec3 Position;
-    glm::vec3 Velocity;
-    glm::vec3 Rotation;
-
-    Particle(float mass_ = 1.0f, glm::vec3 position_ = glm::vec3(0,0,0), glm::vec3 velocity_ = glm::vec3(0,0,0), glm::vec3 rotation_ = glm::vec3(0,0,0)) :
-        Mass(mass_), Position(position_), Velocity(velocity_), Rotation(rotation_) { }
-};
-
+// Forces act on a contiguous range of particle slots at a time
 class Force {
 public:
-    virtual glm::vec3 GetForce(Particle& p) const = 0;
+    virtual ~Force() {}
+    // Adds the force on each slot in [begin, end) of particles into forces[slot]
+    virtual void AddForces(const ParticleBuffer& particles, size_t begin, size_t end, glm::vec3* forces) const = 0;
 };
 
 class ConstantForce : public Force {
 public:
     ConstantForce(glm::vec3 force) : force_(force) { }
     void SetForce(glm::vec3 f) { force_ = f; }
-    virtual glm::vec3 GetForce(Particle &p) const override {
-        return p.Mass * force_;
+    virtual void AddForces(const ParticleBuffer& particles, size_t begin, size_t end, glm::vec3* forces) const override {
+        for (size_t i = begin; i < end; i++) forces[i] += particles.mass[i] * force_;
     }
 private:
     glm::vec3 force_;
 };
 
-// REQUIREMENT:
-// Add viscous drag force (f = -k_d * v)
-// You might want to refer to class ConstantForce as template, and create an new class DragForce
-// Note this is optional. You could design your own way to represent DragForce, for sure.
+// Viscous drag force (f = -k_d * v)
 class DragForce : public Force {
 public:
     DragForce(float k_d) { k_d_ = k_d; }
     void SetForce(float k_d) { k_d_ = k_d; }
-    virtual glm::vec3 GetForce(Particle &p) const override {
-        return p.Velocity * -k_d_;
+    virtual void AddForces(const ParticleBuffer& particles, size_t begin, size_t end, glm::vec3* forces) const override {
+        for (size_t i = begin; i < end; i++) forces[i] -= particles.velocity[i] * k_d_;
     }
 
 private:
     float k_d_;
 };
 
+enum class ParticleIntegrator {
+    SemiImplicitEuler,
+    Verlet
+};
+
 class ParticleSystem : public Component {
 public:
     ChoiceProperty ParticleGeometry;
     ResourceProperty<Material> ParticleMaterial;
     DoubleProperty ParticleScale;
+    ColorProperty ParticleColor;
     DoubleProperty Mass;
     DoubleProperty Period;
+    IntProperty ParticlesPerPeriod;
+    IntProperty MaxParticles;
     Vec3Property InitialVelocity;
     Vec3Property ConstantF;
     DoubleProperty DragF;   // Use this for k_d in viscous drag force
+    ChoiceProperty Integrator;
+    DoubleProperty CollisionRadius;
+    // Collide particles with each other as well as with colliders
+    BooleanProperty ParticleCollisions;
+    DoubleProperty ParticleRestitution;
 
-    // EXTRA CREDIT: Allow the user to enable billboards. See glRenderer::Render(SceneObject&, ParticleSystem).
-    // BooleanProperty Billboards;
+    // Rotate the particles to face the camera. See glRenderer::Render(SceneObject&, ParticleSystem).
+    BooleanProperty Billboards;
+    // Draw the particles farthest from the camera first, for materials that blend
+    BooleanProperty SortBackToFront;
 
     ParticleSystem();
 
     void UpdateModelMatrix(glm::mat4 model_matrix);
     void EmitParticles();
-    std::vector<Particle*> GetParticles();
+    // Live particles, used by the renderer to draw them
+    const ParticleBuffer& GetParticles() const { return particles_; }
     void StartSimulation();
     void UpdateSimulation(float delta_t, const std::vector<std::pair<SceneObject*, glm::mat4>>& colliders);
     void StopSimulation();
     void ResetSimulation();
     bool IsSimulating();
 
+    // Threads used to integrate large systems. Results don't depend on the count.
+    void SetMaxThreads(int threads) { thread_pool_.setMaxThreadCount(threads); }
+
     Signal1<std::string> GeomChanged;
 
 protected:
-    static const unsigned int MAX_PARTICLES = 100;
-    unsigned int num_particles_;
-    unsigned int particle_index_;
+    // Triangles of a mesh collider in its local space and a tree over them, kept until the mesh's shape changes
+    struct MeshColliderShape {
+        uint64_t shape_version = UINT64_MAX; // None yet
+        bool used = false; // By a collider in the current step
+        std::vector<glm::vec3> corners; // Three per triangle
+        BVH tree;
+    };
+
+    // A collider as of the start of a step, so particles don't look up its components or transforms
+    struct ColliderState {
+        enum Type { Sphere, Plane, Cylinder, Mesh } type;
+        glm::mat4 model_matrix;
+        glm::mat4 inverse_model_matrix;
+        glm::mat3 normal_matrix; // Local normals to world space
+        // Particle radius to local space. Exact under uniform scale, under non-uniform scale it's the largest
+        // so particles stay at least their radius off the surface. Mesh colliders are swept in world space and
+        // only use it to find triangles to test, so for them it's an upper bound in any direction.
+        float radius_scale;
+        float radius;
+        float width;
+        float height;
+        float restitution;
+        float friction;
+        const MeshColliderShape* mesh;
+    };
+
     ConstantForce constant_force_;
-    // REQUIREMENT:
-    // Add a drag force member
     DragForce drag_force_;
     glm::mat4 model_matrix_;
     double time_to_emit_;
     bool simulating_;
-    std::list<std::unique_ptr<Particle>> particles_;
-    std::vector<std::shared_ptr<Force>> forces_;
+    ParticleBuffer particles_;
+    std::vector<Force*> forces_;
+
+    // Per step scratch, indexed by slot
+    std::vector<glm::vec3> net_forces_;
+    std::vector<glm::vec3> step_start_;
+    std::vector<glm::vec3> position_corrections_;
+    std::vector<glm::vec3> velocity_corrections_;
+    std::vector<ColliderState> collider_states_;
+    std::map<uint64_t, MeshColliderShape> mesh_collider_shapes_; // By mesh UID, only the ones in use
+    ParticleSpatialHash spatial_hash_;
+    QThreadPool thread_pool_;
 
     void OnGeometrySet(int);
+
+    void PrepareColliders(const std::vector<std::pair<SceneObject*, glm::mat4>>& colliders);
+    // Triangles and tree for a mesh collider, built again only when the mesh's shape has changed
+    const MeshColliderShape& GetMeshColliderShape(const Mesh& mesh);
+    // Forces, integration and collider response for slots [begin, end)
+    void Integrate(size_t begin, size_t end, float delta_t);
+    // Moves a particle along its path over the step, bouncing off whatever it hits first on the way
+    void CollideWithColliders(size_t slot, float delta_t);
+    // Earliest hit of a particle of radius moving from -> to, all in world space
+    bool SweepCollider(const ColliderState& collider, const glm::vec3& from, const glm::vec3& to, float radius, ParticleSweepHit& hit) const;
+    void CollideParticles(float delta_t);
+    // Runs f(begin, end) over chunks of every live range, spread over thread_pool_
+    template<typename F>
+    void ParallelForParticles(F f);
 };
 
 
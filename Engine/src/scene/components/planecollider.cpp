@@ -14,9 +14,11 @@ REGISTER_COMPONENT(PlaneCollider, PlaneCollider)
 PlaneCollider::PlaneCollider() :
     Width(1.0f, 0.01f, 10.0f, 0.1f),
     Height(1.0f, 0.01f, 10.0f, 0.1f),
-    Restitution(0.5f, 0.0f, 1.0f, 0.1f)
+    Restitution(0.5f, 0.0f, 1.0f, 0.1f),
+    Friction(0.0f, 0.0f, 1.0f, 0.1f)
 {
     AddProperty("Width", &Width);
     AddProperty("Height", &Height);
     AddProperty("Restitution", &Restitution);
+    AddProperty("Friction", &Friction);
 }
@@ -17,6 +17,7 @@ public:
     DoubleProperty Width;
     DoubleProperty Height;
     DoubleProperty Restitution;
+    DoubleProperty Friction;
 
     PlaneCollider();
 
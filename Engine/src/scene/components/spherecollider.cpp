@@ -13,8 +13,10 @@ REGISTER_COMPONENT(SphereCollider, SphereCollider)
 
 SphereCollider::SphereCollider() :
     Radius(0.5f, 0.01f, 10.0f, 0.1f),
-    Restitution(0.5f, 0.0f, 1.0f, 0.1f)
+    Restitution(0.5f, 0.0f, 1.0f, 0.1f),
+    Friction(0.0f, 0.0f, 1.0f, 0.1f)
 {
     AddProperty("Radius", &Radius);
     AddProperty("Restitution", &Restitution);
+    AddProperty("Friction", &Friction);
 }
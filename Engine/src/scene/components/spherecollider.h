@@ -16,6 +16,7 @@ class SphereCollider : public Component {
 public:
     DoubleProperty Radius;
     DoubleProperty Restitution;
+    DoubleProperty Friction;
 
     SphereCollider();
 
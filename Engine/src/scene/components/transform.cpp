@@ -13,11 +13,14 @@
 
 REGISTER_COMPONENT(Transform, Transform)
 
+std::atomic<uint64_t> Transform::global_version_(1);
+
 Transform::Transform() :
     Translation(),
     Rotation(),
     Scale(glm::vec3(1.0f, 1.0f, 1.0f)),
     matrix_override_(false),
+    version_(1),
     tracking_vertex_of_(nullptr),
     tracking_vertex_id_(0)
 {
@@ -49,6 +52,8 @@ void Transform::SetFromMatrix(glm::mat4 m) {
 void Transform::ForceMatrix(glm::mat4 m) {
     matrix_override_ = true;
     matrix_ = m;
+    version_++;
+    BumpGlobalVersion();
 }
 
 glm::mat4 Transform::GetMatrix() const {
@@ -63,6 +68,8 @@ void Transform::Update(glm::vec3) {
     rotation_ = glm::quat_cast(rotate);
     glm::mat4 scale = glm::scale(glm::mat4(), Scale.Get());
     cached_ = translate * rotate * scale;
+    version_++;
+    BumpGlobalVersion();
 
     //Ensure mesh is valid?
     if (tracking_vertex_of_) {
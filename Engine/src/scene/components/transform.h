@@ -13,6 +13,7 @@
 #include <animator.h>
 #include <scene/components/component.h>
 #include <glm/gtx/quaternion.hpp>
+#include <atomic>
 
 class Mesh;
 
@@ -32,6 +33,14 @@ public:
     // Returns the post-multiplied transformation matrix
     glm::mat4 GetMatrix() const;
 
+    // Changes whenever GetMatrix does
+    uint64_t GetVersion() const { return version_; }
+    // Changes whenever any transform or the scene hierarchy does, so cached world matrices
+    // can tell in O(1) that nothing needs to be checked. Atomic since every scene shares it, but the
+    // transforms and world matrix caches themselves are only for the GUI thread.
+    static uint64_t GetGlobalVersion() { return global_version_; }
+    static void BumpGlobalVersion() { global_version_++; }
+
     // Applies a translation <X, Y, Z> relative to either Local Space or World Space
     void Translate(glm::vec3 translation, Space relative_frame = Space::Local);
     // Applies a rotation of angle degrees about the axis <X, Y, Z>
@@ -60,6 +69,8 @@ private:
     glm::mat4 matrix_;
     glm::mat4 cached_;
     bool matrix_override_;
+    uint64_t version_;
+    static std::atomic<uint64_t> global_version_;
 
     Mesh* tracking_vertex_of_;
     int tracking_vertex_id_;
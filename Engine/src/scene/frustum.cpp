@@ -0,0 +1,38 @@
+#include "frustum.h"
+
+#include <cmath>
+
+Frustum::Frustum() {
+    // Contains everything
+    for (glm::vec4& plane : planes_) plane = glm::vec4(0.f, 0.f, 0.f, 1.f);
+}
+
+Frustum::Frustum(const glm::mat4& view_proj) {
+    // Gribb and Hartmann, "Fast Extraction of Viewing Frustum Planes from the World-View-Projection Matrix"
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; i++) row[i] = glm::vec4(view_proj[0][i], view_proj[1][i], view_proj[2][i], view_proj[3][i]);
+    planes_[0] = row[3] + row[0]; // Left
+    planes_[1] = row[3] - row[0]; // Right
+    planes_[2] = row[3] + row[1]; // Bottom
+    planes_[3] = row[3] - row[1]; // Top
+    planes_[4] = row[3] + row[2]; // Near
+    planes_[5] = row[3] - row[2]; // Far
+    for (glm::vec4& plane : planes_) {
+        float length = glm::length(glm::vec3(plane));
+        if (length > 0.f) plane /= length;
+    }
+}
+
+Frustum::Containment Frustum::Classify(const BoundingBox& box) const {
+    glm::vec3 center = (box.min + box.max) * 0.5f;
+    glm::vec3 extent = (box.max - box.min) * 0.5f;
+    Containment result = Inside;
+    for (const glm::vec4& plane : planes_) {
+        glm::vec3 normal(plane);
+        float distance = glm::dot(normal, center) + plane.w;
+        float radius = glm::dot(glm::abs(normal), extent);
+        if (distance < -radius) return Outside;
+        if (distance < radius) result = Intersects;
+    }
+    return result;
+}
@@ -0,0 +1,28 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <vectors.h>
+#include <scene/boundingbox.h>
+
+// The volume a camera sees, as six inward facing planes
+class Frustum
+{
+public:
+    enum Containment {
+        Outside,
+        Intersects,
+        Inside
+    };
+
+    Frustum();
+    // From a world to clip space matrix, projection * view. Works for perspective and orthographic projections.
+    explicit Frustum(const glm::mat4& view_proj);
+
+    // Conservative: boxes near a corner of the frustum can be reported as intersecting while outside it
+    Containment Classify(const BoundingBox& box) const;
+
+private:
+    glm::vec4 planes_[6]; // (normal, d), a point p is inside when dot(normal, p) + d >= 0
+};
+
+#endif // FRUSTUM_H
@@ -0,0 +1,93 @@
+#include "particlebuffer.h"
+
+#include <cmath>
+
+void ParticleBuffer::Reset(size_t capacity) {
+    head_ = 0;
+    count_ = 0;
+    if (capacity == Capacity()) {
+        return;
+    }
+    mass.assign(capacity, 0.f);
+    position.assign(capacity, glm::vec3(0.f));
+    previous_position.assign(capacity, glm::vec3(0.f));
+    velocity.assign(capacity, glm::vec3(0.f));
+    rotation.assign(capacity, glm::vec3(0.f));
+    color.assign(capacity, glm::vec4(1.f));
+    age.assign(capacity, 0.f);
+}
+
+size_t ParticleBuffer::Emit() {
+    if (count_ < Capacity()) {
+        return Slot(count_++);
+    }
+    // Full, the oldest slot becomes the newest
+    size_t slot = head_;
+    head_ = (head_ + 1) % Capacity();
+    return slot;
+}
+
+int ParticleBuffer::GetRanges(size_t begin[2], size_t end[2]) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    begin[0] = head_;
+    if (head_ + count_ <= Capacity()) {
+        end[0] = head_ + count_;
+        return 1;
+    }
+    end[0] = Capacity();
+    begin[1] = 0;
+    end[1] = head_ + count_ - Capacity();
+    return 2;
+}
+
+glm::ivec3 ParticleSpatialHash::Cell(const glm::vec3& point) const {
+    return glm::ivec3(glm::floor(point / cell_size_));
+}
+
+uint32_t ParticleSpatialHash::Bucket(const glm::ivec3& cell) const {
+    // Teschner et al., "Optimized Spatial Hashing for Collision Detection of Deformable Objects"
+    uint32_t h = ((uint32_t)cell.x * 73856093u) ^ ((uint32_t)cell.y * 19349663u) ^ ((uint32_t)cell.z * 83492791u);
+    return h & table_mask_;
+}
+
+void ParticleSpatialHash::Build(const ParticleBuffer& particles, float cell_size) {
+    cell_size_ = cell_size;
+    slots_.clear();
+    size_t count = particles.Count();
+    if (count == 0) {
+        return;
+    }
+
+    // About two buckets per particle keeps unrelated cells from sharing buckets
+    uint32_t table_size = 1;
+    while (table_size < 2 * count) {
+        table_size <<= 1;
+    }
+    table_mask_ = table_size - 1;
+
+    // Counting sort of the slots by bucket, in slot order within a bucket
+    bucket_start_.assign(table_size + 1, 0);
+    particle_bucket_.resize(particles.Capacity());
+    size_t begin[2], end[2];
+    int ranges = particles.GetRanges(begin, end);
+    for (int r = 0; r < ranges; r++) {
+        for (size_t slot = begin[r]; slot < end[r]; slot++) {
+            uint32_t bucket = Bucket(Cell(particles.position[slot]));
+            particle_bucket_[slot] = bucket;
+            bucket_start_[bucket + 1]++;
+        }
+    }
+    for (uint32_t b = 0; b < table_size; b++) {
+        bucket_start_[b + 1] += bucket_start_[b];
+    }
+    slots_.resize(count);
+    bucket_fill_.assign(bucket_start_.begin(), bucket_start_.end() - 1);
+    // Lower slots first so each bucket lists its slots in increasing order
+    for (int r = ranges - 1; r >= 0; r--) {
+        for (size_t slot = begin[r]; slot < end[r]; slot++) {
+            slots_[bucket_fill_[particle_bucket_[slot]]++] = (uint32_t)slot;
+        }
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef PARTICLEBUFFER_H
+#define PARTICLEBUFFER_H
+
+#include <vectors.h>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Particle state as one array per attribute, in a fixed capacity ring.
+// The live particles are the count slots starting at head, wrapping around the end, oldest first.
+// Emitting into a full buffer recycles the oldest particle.
+class ParticleBuffer
+{
+public:
+    std::vector<float> mass;
+    std::vector<glm::vec3> position;
+    std::vector<glm::vec3> previous_position; // Only kept up to date by the Verlet integrator
+    std::vector<glm::vec3> velocity;
+    std::vector<glm::vec3> rotation;
+    std::vector<glm::vec4> color;
+    std::vector<float> age; // Seconds since emission
+
+    ParticleBuffer() : head_(0), count_(0) {}
+
+    // Drops every particle, and reallocates if capacity changed
+    void Reset(size_t capacity);
+    // Returns the slot for a new particle, the caller fills in every attribute
+    size_t Emit();
+
+    size_t Capacity() const { return mass.size(); }
+    size_t Count() const { return count_; }
+    // Slot of the i-th oldest live particle
+    size_t Slot(size_t i) const { return (head_ + i) % Capacity(); }
+
+    // The live slots as up to two contiguous [begin, end) ranges. Returns how many there are.
+    int GetRanges(size_t begin[2], size_t end[2]) const;
+
+private:
+    size_t head_;
+    size_t count_;
+};
+
+// Uniform grid over particle positions, hashed into a table so it needs no bounds.
+// Particles closer than the cell size are always in neighbouring cells.
+class ParticleSpatialHash
+{
+public:
+    ParticleSpatialHash() : cell_size_(1.f), table_mask_(0) {}
+
+    // Buckets the live particles of particles by cells of edge cell_size
+    void Build(const ParticleBuffer& particles, float cell_size);
+
+    // Calls f(slot) for every particle in the 27 cells around point, including ones further away
+    // that share a bucket. Visits slots in increasing order within a bucket.
+    template<typename F>
+    void ForEachNear(const glm::vec3& point, F f) const;
+
+private:
+    float cell_size_;
+    uint32_t table_mask_;
+    std::vector<uint32_t> bucket_start_; // Size table + 1, bucket b is [bucket_start_[b], bucket_start_[b + 1]) of slots_
+    std::vector<uint32_t> slots_;
+    std::vector<uint32_t> particle_bucket_;
+    std::vector<uint32_t> bucket_fill_;
+
+    glm::ivec3 Cell(const glm::vec3& point) const;
+    uint32_t Bucket(const glm::ivec3& cell) const;
+};
+
+template<typename F>
+void ParticleSpatialHash::ForEachNear(const glm::vec3& point, F f) const {
+    if (slots_.empty()) {
+        return;
+    }
+    glm::ivec3 center = Cell(point);
+    // Neighbouring cells can share a bucket, visit each bucket once
+    uint32_t visited[27];
+    int visited_count = 0;
+    for (int z = -1; z <= 1; z++) {
+        for (int y = -1; y <= 1; y++) {
+            for (int x = -1; x <= 1; x++) {
+                uint32_t bucket = Bucket(center + glm::ivec3(x, y, z));
+                bool seen = false;
+                for (int v = 0; v < visited_count; v++) {
+                    seen = seen || visited[v] == bucket;
+                }
+                if (seen) {
+                    continue;
+                }
+                visited[visited_count++] = bucket;
+                for (uint32_t k = bucket_start_[bucket]; k < bucket_start_[bucket + 1]; k++) {
+                    f(slots_[k]);
+                }
+            }
+        }
+    }
+}
+
+#endif // PARTICLEBUFFER_H
@@ -0,0 +1,158 @@
+#include "particlecollision.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+bool SweepParticleSphere(const glm::vec3& from, const glm::vec3& to, float radius, float sphere_radius, ParticleSweepHit& hit) {
+    float r = sphere_radius + radius;
+    glm::vec3 d = to - from;
+    float c = glm::dot(from, from) - r * r;
+    if (c <= 0.f) {
+        float distance = glm::length(from);
+        glm::vec3 normal = distance > 0.f ? from / distance : glm::vec3(0.f, 1.f, 0.f);
+        if (glm::dot(d, normal) >= 0.f) return false;
+        hit.t = 0.f;
+        hit.point = normal * r;
+        hit.normal = normal;
+        return true;
+    }
+
+    // |from + t*d| = r, solved from the closest approach so long steps don't lose precision
+    float a = glm::dot(d, d);
+    float b = glm::dot(from, d);
+    if (a == 0.f || b >= 0.f) return false;
+    float t_closest = -b / a;
+    glm::vec3 closest = from + t_closest * d;
+    float miss2 = glm::dot(closest, closest);
+    if (miss2 > r * r) return false;
+    float t = t_closest - std::sqrt((r * r - miss2) / a);
+    if (t > 1.f) return false;
+    hit.t = std::max(t, 0.f);
+    hit.point = from + hit.t * d;
+    hit.normal = glm::normalize(hit.point);
+    return true;
+}
+
+bool SweepParticlePlane(const glm::vec3& from, const glm::vec3& to, float radius, float width, float height, ParticleSweepHit& hit) {
+    // Collide with the face on the side the particle starts on
+    float side = from.z >= 0.f ? 1.f : -1.f;
+    float start = side * from.z;
+    float end = side * to.z;
+    if (end >= radius || end >= start) return false;
+
+    float t = start >= radius ? (start - radius) / (start - end) : 0.f;
+    glm::vec3 point = from + t * (to - from);
+    if (std::abs(point.x) > width / 2.f || std::abs(point.y) > height / 2.f) return false;
+    point.z = side * radius;
+    hit.t = t;
+    hit.point = point;
+    hit.normal = glm::vec3(0.f, 0.f, side);
+    return true;
+}
+
+bool SweepParticleCylinder(const glm::vec3& from, const glm::vec3& to, float radius, float cylinder_radius, float height, ParticleSweepHit& hit) {
+    float r = cylinder_radius + radius;
+    float h = height / 2.f + radius;
+    glm::vec3 d = to - from;
+    float from_r2 = from.x * from.x + from.z * from.z;
+
+    if (from_r2 < r * r && std::abs(from.y) < h) {
+        // Starts inside, leave through the closest face
+        float from_r = std::sqrt(from_r2);
+        float side_depth = r - from_r;
+        float cap_depth = h - std::abs(from.y);
+        glm::vec3 point = from;
+        glm::vec3 normal;
+        if (side_depth < cap_depth && from_r > 0.f) {
+            normal = glm::vec3(from.x / from_r, 0.f, from.z / from_r);
+            point.x = normal.x * r;
+            point.z = normal.z * r;
+        } else {
+            normal = glm::vec3(0.f, from.y >= 0.f ? 1.f : -1.f, 0.f);
+            point.y = normal.y * h;
+        }
+        if (glm::dot(d, normal) >= 0.f) return false;
+        hit.t = 0.f;
+        hit.point = point;
+        hit.normal = normal;
+        return true;
+    }
+
+    // Intersect the times inside the infinite cylinder with the times between the caps
+    const float infinity = std::numeric_limits<float>::infinity();
+    float side_in = -infinity, side_out = infinity;
+    float a = d.x * d.x + d.z * d.z;
+    if (a > 0.f) {
+        // Solved from the closest approach so long steps don't lose precision
+        float t_closest = -(from.x * d.x + from.z * d.z) / a;
+        float closest_x = from.x + t_closest * d.x;
+        float closest_z = from.z + t_closest * d.z;
+        float miss2 = closest_x * closest_x + closest_z * closest_z;
+        if (miss2 > r * r) return false;
+        float half_chord = std::sqrt((r * r - miss2) / a);
+        side_in = t_closest - half_chord;
+        side_out = t_closest + half_chord;
+    } else if (from_r2 >= r * r) {
+        return false;
+    }
+    float cap_in = -infinity, cap_out = infinity;
+    if (d.y != 0.f) {
+        cap_in = (-h - from.y) / d.y;
+        cap_out = (h - from.y) / d.y;
+        if (cap_in > cap_out) std::swap(cap_in, cap_out);
+    } else if (std::abs(from.y) >= h) {
+        return false;
+    }
+
+    float t = std::max(side_in, cap_in);
+    if (t > std::min(side_out, cap_out) || t > 1.f || std::min(side_out, cap_out) < 0.f) return false;
+    hit.t = std::max(t, 0.f);
+    hit.point = from + hit.t * d;
+    if (side_in > cap_in) {
+        hit.normal = glm::normalize(glm::vec3(hit.point.x, 0.f, hit.point.z));
+    } else {
+        hit.normal = glm::vec3(0.f, d.y < 0.f ? 1.f : -1.f, 0.f);
+    }
+    return true;
+}
+
+bool SweepParticleTriangle(const glm::vec3& from, const glm::vec3& to, float radius,
+                           const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, ParticleSweepHit& hit) {
+    glm::vec3 normal = glm::cross(b - a, c - a);
+    float area = glm::length(normal);
+    if (area == 0.f) return false;
+    normal /= area;
+
+    // Collide with the face on the side the particle starts on
+    float distance = glm::dot(from - a, normal);
+    float side = distance >= 0.f ? 1.f : -1.f;
+    float start = side * distance;
+    float end = side * glm::dot(to - a, normal);
+    if (end >= radius || end >= start) return false;
+
+    float t = start >= radius ? (start - radius) / (start - end) : 0.f;
+    glm::vec3 point = from + t * (to - from);
+    glm::vec3 projected = point - glm::dot(point - a, normal) * normal;
+    if (glm::dot(glm::cross(b - a, projected - a), normal) < 0.f ||
+        glm::dot(glm::cross(c - b, projected - b), normal) < 0.f ||
+        glm::dot(glm::cross(a - c, projected - c), normal) < 0.f) {
+        return false;
+    }
+    hit.t = t;
+    hit.normal = side * normal;
+    hit.point = projected + radius * hit.normal;
+    return true;
+}
+
+glm::vec3 ParticleCollisionResponse(const glm::vec3& velocity, const glm::vec3& normal, float restitution, float friction) {
+    float normal_speed = glm::dot(velocity, normal);
+    if (normal_speed >= 0.f) return velocity;
+    glm::vec3 tangent = velocity - normal_speed * normal;
+    float tangent_speed = glm::length(tangent);
+    if (tangent_speed > 0.f) {
+        float normal_impulse = -(1.f + restitution) * normal_speed;
+        tangent *= std::max(0.f, 1.f - friction * normal_impulse / tangent_speed);
+    }
+    return tangent - restitution * normal_speed * normal;
+}
@@ -0,0 +1,33 @@
+#ifndef PARTICLECOLLISION_H
+#define PARTICLECOLLISION_H
+
+#include <vectors.h>
+
+// Continuous collision of a moving particle against collider shapes, in the collider's local space.
+// The particle moves in a straight line from `from` to `to` over a step and is a sphere of `radius`,
+// so each test sweeps a point against the shape grown by that radius.
+//
+// A test reports the earliest hit along the way. A particle that starts the step overlapping the shape
+// only hits it if it's moving further in, at t = 0, and is pushed back out to the surface.
+struct ParticleSweepHit {
+    float t;          // Fraction of the step, in [0, 1]
+    glm::vec3 point;  // Where the particle's center touches the grown shape
+    glm::vec3 normal; // Outward surface normal there
+};
+
+// Sphere of radius sphere_radius around the origin
+bool SweepParticleSphere(const glm::vec3& from, const glm::vec3& to, float radius, float sphere_radius, ParticleSweepHit& hit);
+// Two-sided rectangle width by height in the X-Y plane, centered at the origin
+bool SweepParticlePlane(const glm::vec3& from, const glm::vec3& to, float radius, float width, float height, ParticleSweepHit& hit);
+// Capped cylinder along Y, centered at the origin
+bool SweepParticleCylinder(const glm::vec3& from, const glm::vec3& to, float radius, float cylinder_radius, float height, ParticleSweepHit& hit);
+// Two-sided triangle, thickened by radius along its normal. The edges aren't rounded, so a particle
+// grazing an edge from the side can pass through up to radius of it.
+bool SweepParticleTriangle(const glm::vec3& from, const glm::vec3& to, float radius,
+                           const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, ParticleSweepHit& hit);
+
+// Velocity after hitting a surface with the given normal. The normal part bounces back scaled by restitution,
+// and Coulomb friction takes up to friction times the normal impulse off the tangential part.
+glm::vec3 ParticleCollisionResponse(const glm::vec3& velocity, const glm::vec3& normal, float restitution, float friction);
+
+#endif // PARTICLECOLLISION_H
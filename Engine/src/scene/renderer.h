@@ -29,7 +29,8 @@ public:
         draw_lights_(true),
         draw_camera_(true),
         draw_colliders_(true),
-        rendering_selection_(false)
+        rendering_selection_(false),
+        frustum_culling_(true)
     {}
 
     // Initialize renderer resources (Must only be called once)
@@ -85,6 +86,8 @@ public:
     void SetNodePrefix(std::string prefix="") { node_prefix_ = prefix; }
 
     void SetVertexEditing(bool edit) { vertex_editing_ = edit; }
+    // Skips drawing geometry whose bounds are outside the view
+    void SetFrustumCulling(bool cull) { frustum_culling_ = cull; }
 protected:
     RenderingMode rendering_mode_;
     std::string node_prefix_;
@@ -96,6 +99,7 @@ protected:
     bool draw_colliders_;
     bool rendering_selection_;
     bool vertex_editing_;
+    bool frustum_culling_;
 
     // Do not render this node or its children; used for environment mapping
     void SetIgnoredNode(const SceneObject* ignored) { ignored_node_ = ignored; }
@@ -18,12 +18,23 @@ Scene::Scene(std::string name, ShaderFactory& shader_factory) :
     Singleton<Scene>(),
     name_(name),
     asset_manager_(shader_factory),
+    load_group_(0),
     scene_root_(std::make_unique<SceneObject>("Root")),
     render_cam_(nullptr),
     animation_length_(0),
     fps_(0),
     signal_lock_(false)
 {
+    scene_root_->SetScene(this);
+}
+
+bool Scene::IsLoaded() const {
+    return asset_manager_.IsLoadGroupResident(asset_manager_.GetDefaultLoadGroup()) && asset_manager_.IsLoadGroupResident(load_group_);
+}
+
+void Scene::WaitUntilLoaded() {
+    asset_manager_.WaitForLoadGroup(asset_manager_.GetDefaultLoadGroup());
+    asset_manager_.WaitForLoadGroup(load_group_);
 }
 
 SceneObject* Scene::FindSceneObject(uint64_t UID) {
@@ -35,8 +46,7 @@ SceneObject* Scene::FindSceneObject(uint64_t UID) {
 // Only used for SceneObjects that are not the root
 SceneObject& Scene::CreateSceneObject(const std::string& name, int flag) {
     std::unique_ptr<SceneObject> node = std::make_unique<SceneObject>(name, flag);
-    node->LightSourceAdded.Connect(this, &Scene::RegisterLightSource);
-    node->ParticleSystemAdded.Connect(this, &Scene::RegisterParticleSystem);
+    node->SetScene(this);
     uint64_t uid = node->GetUID();
     assert(scene_objects_.count(uid) == 0); // It's not a "unique" id if it exists already
     // Set the parent to be the root
@@ -63,7 +73,7 @@ void Scene::DeleteSceneObject(uint64_t uid) {
     }
 
     // Remove references to this object
-    if (light_sources_.count(uid) > 0) light_sources_.erase(uid);
+    obj->SetScene(nullptr);
     obj->GetParent()->RemoveChild(uid);
 
     // Notify the UI of the deletion first, before the pointer is invalidated
@@ -97,107 +107,143 @@ SceneObject* Scene::DuplicateSceneObject(uint64_t uid) {
     return &newObj;
 }
 
+void Scene::RegisterComponent(SceneObject& object, int type_id) {
+    std::vector<ComponentEntry>& entries = components_by_type_[type_id];
+    object.scene_slots_[type_id] = (uint32_t)entries.size();
+    entries.push_back(ComponentEntry{&object, object.components_[type_id]});
+}
+
+void Scene::UnregisterComponent(SceneObject& object, int type_id) {
+    if (type_id == Component::GetTypeId<Geometry>()) {
+        auto it = geometry_entries_.find(&object);
+        if (it != geometry_entries_.end()) {
+            if (it->second.proxy != AABBTree::NULL_NODE) geometry_bounds_.DestroyProxy(it->second.proxy);
+            geometry_entries_.erase(it);
+        }
+    }
+
+    // Swap the last entry into the removed one's slot
+    std::vector<ComponentEntry>& entries = components_by_type_[type_id];
+    uint32_t slot = object.scene_slots_[type_id];
+    assert(slot < entries.size() && entries[slot].object == &object);
+    entries[slot] = entries.back();
+    entries[slot].object->scene_slots_[type_id] = slot;
+    entries.pop_back();
+}
+
+template<typename T>
+void Scene::CollectEnabled(std::vector<std::pair<SceneObject*, glm::mat4>>& out) {
+    for (const ComponentEntry& entry : GetComponentsOfType<T>()) {
+        if (entry.object->IsEnabledInHierarchy()) out.push_back(std::make_pair(entry.object, entry.object->GetModelMatrix()));
+    }
+}
+
 void Scene::RenderPrepass() {
     lights_.clear();
     envmaps_.clear();
-    RenderPrepass(GetSceneRoot(), glm::mat4());
+    // Save the lights and envmaps
+    CollectEnabled<Light>(lights_);
+    CollectEnabled<EnvironmentMap>(envmaps_);
+    UpdateGeometryBounds();
+}
+
+void Scene::UpdateGeometryBounds() {
+    for (const ComponentEntry& entry : GetComponentsOfType<Geometry>()) {
+        SceneObject* object = entry.object;
+        auto inserted = geometry_entries_.insert(std::make_pair(object, GeometryBounds{AABBTree::NULL_NODE, 0, nullptr, 0, BoundingBox()}));
+        GeometryBounds& bounds = inserted.first->second;
+
+        // Disabled objects aren't drawn, and objects without a mesh are always drawn
+        Mesh* mesh = object->IsEnabledInHierarchy() ? static_cast<Geometry*>(entry.component)->GetRenderMesh() : nullptr;
+        if (mesh == nullptr || mesh->GetPositions().size() < 3) {
+            if (bounds.proxy != AABBTree::NULL_NODE) geometry_bounds_.DestroyProxy(bounds.proxy);
+            bounds.proxy = AABBTree::NULL_NODE;
+            bounds.mesh = nullptr;
+            continue;
+        }
+
+        bool mesh_changed = mesh != bounds.mesh || mesh->GetVersion() != bounds.mesh_version;
+        if (!mesh_changed && bounds.proxy != AABBTree::NULL_NODE && object->GetWorldVersion() == bounds.world_version) continue;
+        if (mesh_changed) {
+            bounds.local_bounds = mesh->GetBounds();
+            bounds.mesh = mesh;
+            bounds.mesh_version = mesh->GetVersion();
+        }
+        bounds.world_version = object->GetWorldVersion();
+
+        // Transform the box's center and half extents, Arvo's method
+        const glm::mat4& model = object->GetModelMatrix();
+        glm::vec3 center = glm::vec3(model * glm::vec4((bounds.local_bounds.min + bounds.local_bounds.max) * 0.5f, 1.f));
+        glm::vec3 half = (bounds.local_bounds.max - bounds.local_bounds.min) * 0.5f;
+        glm::mat3 abs_linear(glm::abs(glm::vec3(model[0])), glm::abs(glm::vec3(model[1])), glm::abs(glm::vec3(model[2])));
+        glm::vec3 extent = abs_linear * half;
+        BoundingBox world(center - extent, center + extent);
+        if (bounds.proxy == AABBTree::NULL_NODE) {
+            bounds.proxy = geometry_bounds_.CreateProxy(world, object);
+        } else {
+            geometry_bounds_.MoveProxy(bounds.proxy, world);
+        }
+    }
+}
+
+int Scene::GetGeometryProxy(SceneObject& object) const {
+    auto it = geometry_entries_.find(&object);
+    return it != geometry_entries_.end() ? it->second.proxy : AABBTree::NULL_NODE;
 }
 
 void Scene::Start() {
     // Start all particle systems
-    for (auto& kv : particle_systems_) {
-        // If we can't find the scene object, it's been deleted
-        // TODO: Remove it
-        if (FindSceneObject(kv.first) == nullptr) continue;
-        if (ParticleSystem* ps = kv.second->GetComponent<ParticleSystem>()) {
-            ps->StartSimulation();
-        }
+    for (const ComponentEntry& entry : GetComponentsOfType<ParticleSystem>()) {
+        static_cast<ParticleSystem*>(entry.component)->StartSimulation();
     }
 }
 
 void Scene::Stop() {
     // Stop all particle systems
-    for (auto& kv : particle_systems_) {
-        // If we can't find the scene object, it's been deleted
-        // TODO: Remove it
-        if (FindSceneObject(kv.first) == nullptr) continue;
-        if (ParticleSystem* ps = kv.second->GetComponent<ParticleSystem>()) {
-             ps->StopSimulation();
-        }
+    for (const ComponentEntry& entry : GetComponentsOfType<ParticleSystem>()) {
+        static_cast<ParticleSystem*>(entry.component)->StopSimulation();
     }
 }
 
 void Scene::Reset() {
     // Reset all particle systems
-    for (auto& kv : particle_systems_) {
-        // If we can't find the scene object, it's been deleted
-        // TODO: Remove it
-        if (FindSceneObject(kv.first) == nullptr) continue;
-        if (ParticleSystem* ps = kv.second->GetComponent<ParticleSystem>()) {
-             ps->ResetSimulation();
-        }
+    for (const ComponentEntry& entry : GetComponentsOfType<ParticleSystem>()) {
+        static_cast<ParticleSystem*>(entry.component)->ResetSimulation();
     }
 }
 
-void Scene::UpdatePrepass(SceneObject& node, glm::mat4 model_matrix) {
-    model_matrix = model_matrix * node.GetTransform().GetMatrix();
-
+void Scene::UpdatePrepass() {
     // Update Particle Simulations
-    if (ParticleSystem* ps = node.GetComponent<ParticleSystem>()) {
+    for (const ComponentEntry& entry : GetComponentsOfType<ParticleSystem>()) {
         // Store the model matrix in the Particle System so it can use World coordinates
-        ps->UpdateModelMatrix(model_matrix);
+        if (entry.object->IsEnabledInHierarchy()) static_cast<ParticleSystem*>(entry.component)->UpdateModelMatrix(entry.object->GetModelMatrix());
     }
 
     // Save the colliders
-    SphereCollider* sphere = node.GetComponent<SphereCollider>();
-    if (sphere != nullptr) colliders_.push_back(std::make_pair(&node, model_matrix));
-    PlaneCollider* plane = node.GetComponent<PlaneCollider>();
-    if (plane != nullptr) colliders_.push_back(std::make_pair(&node, model_matrix));
-    CylinderCollider* cylinder = node.GetComponent<CylinderCollider>();
-    if (cylinder != nullptr) colliders_.push_back(std::make_pair(&node, model_matrix));
-
-    // Recurse into children
-    auto children = node.GetChildren();
-    for (auto& child : children) {
-        if (child->IsEnabled()) UpdatePrepass(*child, model_matrix);
-    }
-}
-
-void Scene::RenderPrepass(SceneObject& node, glm::mat4 model_matrix) {
-    model_matrix = model_matrix * node.GetTransform().GetMatrix();
-
-    // Save the lights
-    Light* light = node.GetComponent<Light>();
-    if (light != nullptr) lights_.push_back(std::make_pair(&node, model_matrix));
-
-    // Save the envmaps
-    EnvironmentMap* envmap = node.GetComponent<EnvironmentMap>();
-    if (envmap != nullptr) envmaps_.push_back(std::make_pair(&node, model_matrix));
-
-    // Recurse into children
-    auto children = node.GetChildren();
-    for (auto& child : children) {
-        if (child->IsEnabled()) RenderPrepass(*child, model_matrix);
-    }
+    CollectEnabled<SphereCollider>(colliders_);
+    CollectEnabled<PlaneCollider>(colliders_);
+    CollectEnabled<CylinderCollider>(colliders_);
+    CollectEnabled<MeshCollider>(colliders_);
 }
 
 void Scene::Update(float t, float delta_t) {
 
     colliders_.clear();
-    UpdatePrepass(GetSceneRoot(), glm::mat4());
+    UpdatePrepass();
 
-    // Find all animatable properties and particle systems
-    for (auto& kv : scene_objects_) {
-        // Update Particle Simulation
-        if (delta_t > 0) {
-            if (ParticleSystem* ps = kv.second->GetComponent<ParticleSystem>()) {
-                if (realtime_)
-                    ps->UpdateSimulation(delta_t, colliders_);
-                else
-                    ps->UpdateSimulation(1.0f / fps_, colliders_);
-            }
+    // Update Particle Simulations
+    if (delta_t > 0) {
+        for (const ComponentEntry& entry : GetComponentsOfType<ParticleSystem>()) {
+            ParticleSystem* ps = static_cast<ParticleSystem*>(entry.component);
+            if (realtime_)
+                ps->UpdateSimulation(delta_t, colliders_);
+            else
+                ps->UpdateSimulation(1.0f / fps_, colliders_);
         }
+    }
 
+    // Find all animatable properties
+    for (auto& kv : scene_objects_) {
         // Find animatable properties
         for (auto& component : kv.second->GetComponents()) {
                 SetAnimationTime(t, component);
@@ -225,12 +271,8 @@ SceneObject &Scene::GetSceneRoot() {
 
 SceneObject* Scene::GetOrCreateRenderCam() {
     if (render_cam_ == nullptr) {
-        for (auto& kv : scene_objects_) {
-            if (kv.second->GetComponent<Camera>()) {
-                render_cam_ = kv.second.get();
-                break;
-            }
-        }
+        const std::vector<ComponentEntry>& cameras = GetComponentsOfType<Camera>();
+        if (!cameras.empty()) render_cam_ = cameras.front().object;
     }
     if (render_cam_ == nullptr) {
         render_cam_ = &CreateCamera("Render Camera");
@@ -241,10 +283,8 @@ SceneObject* Scene::GetOrCreateRenderCam() {
 
 std::vector<SceneObject*> Scene::GetRenderCams() {
     std::vector<SceneObject*> cams;
-    for (auto& kv : scene_objects_) {
-        if (kv.second->GetComponent<Camera>()) {
-            cams.push_back(kv.second.get());
-        }
+    for (const ComponentEntry& entry : GetComponentsOfType<Camera>()) {
+        cams.push_back(entry.object);
     }
     return cams;
 }
@@ -387,7 +427,7 @@ SceneObject& Scene::CreateParticleSystem(const std::string &name) {
     SceneObject& ps = CreateSceneObject(name);
     ps.AddComponent<Sphere>();
     ps.AddComponent<ParticleSystem>();
-    auto material = asset_manager_.GetMaterial("Blinn-Phong Material");
+    auto material = asset_manager_.GetMaterial("Particle Material");
     assert(material != nullptr);
     ParticleSystem *sys = ps.GetComponent<ParticleSystem>();
     sys->ParticleMaterial.Set(material);
@@ -484,6 +524,7 @@ void Scene::LoadFromYAML(const YAML::Node &node)
     SetAnimationLength(node["Animation Length"].as<unsigned int>());
     SetFPS(node["Animation FPS"].as<unsigned int>());
 
+    load_group_ = asset_manager_.BeginLoadGroup(name_);
     YAML::Node assetnode = node["Textures"];
     for (auto it = assetnode.begin(); it != assetnode.end(); it++) {
         asset_manager_.LoadTexture(it->first.as<std::string>(), it->second["Path"].as<std::string>());
@@ -499,6 +540,7 @@ void Scene::LoadFromYAML(const YAML::Node &node)
         std::string name = it->first.as<std::string>();
         asset_manager_.LoadMesh(name, it->second["Path"].as<std::string>());
     }
+    asset_manager_.EndLoadGroup();
 
     assetnode = node["ShaderPrograms"];
     for (auto it = assetnode.begin(); it != assetnode.end(); it++) {
@@ -14,6 +14,7 @@
 #include <scene/sceneobject.h>
 #include <resource/assetmanager.h>
 #include <scene/scenecamera.h>
+#include <scene/aabbtree.h>
 #include <components.h>
 #include <serializable.h>
 #include <singleton.h>
@@ -31,6 +32,28 @@ public:
     SceneCamera& GetSceneCamera() { return scene_camera_; }
     AssetManager& GetAssetManager() { return asset_manager_; }
 
+    // Assets load in the background, so a scene is only loaded once the assets it was saved with
+    // and the standard ones are resident. Until then they are placeholders.
+    bool IsLoaded() const;
+    void WaitUntilLoaded();
+
+    // Every component with one base type in the scene, packed densely so systems can go through
+    // e.g. all Lights or ParticleSystems without walking the hierarchy. Order is not meaningful.
+    struct ComponentEntry {
+        SceneObject* object;
+        Component* component;
+    };
+    template<typename T, typename std::enable_if<std::is_base_of<Component, T>::value>::type* = nullptr>
+    const std::vector<ComponentEntry>& GetComponentsOfType() const {
+        static const std::vector<ComponentEntry> none;
+        int type_id = Component::GetTypeId<T>();
+        return type_id >= 0 ? components_by_type_[type_id] : none;
+    }
+
+    // Called by SceneObject when it gains or loses a component while in this scene
+    void RegisterComponent(SceneObject& object, int type_id);
+    void UnregisterComponent(SceneObject& object, int type_id);
+
     // Returns the first render cam or makes it
     SceneObject* GetOrCreateRenderCam();
     std::vector<SceneObject*> GetRenderCams();
@@ -47,6 +70,13 @@ public:
     // Updated whenever RenderPrepass is called.
     std::vector<std::pair<SceneObject*, glm::mat4>> GetEnvMaps();
 
+    // World space bounds of the render mesh of every enabled Geometry, for culling.
+    // A proxy's user data is its SceneObject. Updated whenever RenderPrepass is called, for the objects whose
+    // transform or mesh changed since.
+    const AABBTree& GetGeometryBounds() const { return geometry_bounds_; }
+    // The object's proxy in GetGeometryBounds(), AABBTree::NULL_NODE if it isn't in there
+    int GetGeometryProxy(SceneObject& object) const;
+
     // Animation Properties
     unsigned int GetAnimationLength() const { return animation_length_; }
     void SetAnimationLength(unsigned int animation_length) { animation_length_ = animation_length; }
@@ -104,18 +134,29 @@ public:
 protected:
     std::string name_;
     AssetManager asset_manager_;
+    unsigned int load_group_; // Assets loaded by LoadFromYAML
     std::unique_ptr<SceneObject> scene_root_;
     std::unordered_map<uint64_t, std::unique_ptr<SceneObject>> scene_objects_;
-    std::unordered_map<uint64_t, SceneObject*> light_sources_;
-    std::unordered_map<uint64_t, SceneObject*> particle_systems_;
+    std::array<std::vector<ComponentEntry>, Component::MAX_COMPONENT_TYPES> components_by_type_;
     SceneCamera scene_camera_;
 
     std::vector<std::pair<SceneObject*, glm::mat4>> colliders_;
-    void UpdatePrepass(SceneObject& node, glm::mat4 model_matrix);
+    void UpdatePrepass();
+    template<typename T> void CollectEnabled(std::vector<std::pair<SceneObject*, glm::mat4>>& out);
     void SetAnimationTime(float t, ObjectWithProperties* o);
     std::vector<std::pair<SceneObject*, glm::mat4>> lights_;
     std::vector<std::pair<SceneObject*, glm::mat4>> envmaps_;
-    void RenderPrepass(SceneObject& node, glm::mat4 model_matrix);
+
+    struct GeometryBounds {
+        int proxy;
+        uint64_t world_version;
+        Mesh* mesh;
+        uint64_t mesh_version;
+        BoundingBox local_bounds;
+    };
+    std::unordered_map<SceneObject*, GeometryBounds> geometry_entries_;
+    AABBTree geometry_bounds_;
+    void UpdateGeometryBounds();
     SceneObject* render_cam_;
 
     // Animation Properties
@@ -127,9 +168,6 @@ protected:
     // Unsignalled object creation queue
     std::vector<SceneObject*> signalqueue;
 
-    void RegisterLightSource(SceneObject& light) { light_sources_[light.GetUID()] = &light; }
-    void RegisterParticleSystem(SceneObject& ps) { particle_systems_[ps.GetUID()] = &ps; }
-
     // Serializable interface
 public:
     void SaveToYAML(YAML::Emitter &out) const;
@@ -16,11 +16,20 @@
 SceneObject::SceneObject(const std::string& name, int flag) :
     uid_(SceneObject::uid_counter_++),
     name_(name),
+    component_mask_(0),
     parent_(nullptr),
+    scene_(nullptr),
     enabled_(true),
-    flag_(flag)
+    flag_(flag),
+    inverse_world_valid_(false),
+    world_version_(0),
+    local_version_(0),
+    parent_world_version_(0),
+    world_parent_(nullptr),
+    checked_global_version_(0)
 {
-    AddComponent<Transform>();
+    components_.fill(nullptr);
+    transform_ = &AddComponent<Transform>();
 }
 
 SceneObject::~SceneObject() {
@@ -44,11 +53,55 @@ void SceneObject::AddComponent(Component* component) {
     if (dynamic_cast<PointLight*>(component) || dynamic_cast<DirectionalLight*>(component)) LightSourceAdded.Emit(*this);
     // Let whomever know that this object is now a particle system
     if (dynamic_cast<ParticleSystem*>(component)) ParticleSystemAdded.Emit(*this);
-    assert(components_.find(component->GetBaseType()) == components_.end());
-    components_[component->GetBaseType()] = component;
+    int type_id = component->GetTypeId();
+    assert(type_id >= 0 && components_[type_id] == nullptr);
+    components_[type_id] = component;
+    component_mask_ |= 1u << type_id;
+    if (scene_ != nullptr) scene_->RegisterComponent(*this, type_id);
     ComponentAdded.Emit(*component);
 }
 
+void SceneObject::RemoveComponent(int type_id) {
+    Component* component = components_[type_id];
+    if (component == nullptr) return;
+    if (scene_ != nullptr) scene_->UnregisterComponent(*this, type_id);
+    std::string name = component->GetTypeName();
+    components_[type_id] = nullptr;
+    component_mask_ &= ~(1u << type_id);
+    delete component;
+    ComponentRemoved.Emit(name);
+}
+
+void SceneObject::SetScene(Scene* scene) {
+    if (scene_ == scene) return;
+    for (int type_id = 0; type_id < Component::MAX_COMPONENT_TYPES; type_id++) {
+        if (components_[type_id] == nullptr) continue;
+        if (scene_ != nullptr) scene_->UnregisterComponent(*this, type_id);
+        if (scene != nullptr) scene->RegisterComponent(*this, type_id);
+    }
+    scene_ = scene;
+}
+
+
+void SceneObject::UpdateWorldMatrix() {
+    // Nothing anywhere changed since we last checked
+    const uint64_t global_version = Transform::GetGlobalVersion();
+    if (world_version_ != 0 && checked_global_version_ == global_version) return;
+
+    uint64_t parent_version = 0;
+    if (parent_ != nullptr) parent_version = parent_->GetWorldVersion();
+
+    if (world_version_ == 0 || local_version_ != transform_->GetVersion() ||
+            world_parent_ != parent_ || parent_world_version_ != parent_version) {
+        world_matrix_ = parent_ != nullptr ? parent_->world_matrix_ * transform_->GetMatrix() : transform_->GetMatrix();
+        inverse_world_valid_ = false;
+        local_version_ = transform_->GetVersion();
+        world_parent_ = parent_;
+        parent_world_version_ = parent_version;
+        world_version_ = ++world_version_counter_;
+    }
+    checked_global_version_ = global_version;
+}
 
 void SceneObject::SetParticleGeom(std::string name) {
     if (GetComponent<Sphere>() != nullptr) {
@@ -85,9 +138,9 @@ void SceneObject::SaveToYAML(YAML::Emitter &out) const
     out << YAML::Key << "Enabled" << YAML::Value << enabled_;
 
     out << YAML::Key << "Components" << YAML::Value << YAML::BeginMap;
-    for(auto it = components_.begin(); it!=components_.end(); it++) {
-        out << YAML::Key << it->second->GetTypeName() << YAML::Value;
-        it->second->SaveToYAML(out);
+    for (Component* component : GetComponents()) {
+        out << YAML::Key << component->GetTypeName() << YAML::Value;
+        component->SaveToYAML(out);
     }
     out << YAML::EndMap;
 
@@ -133,3 +186,4 @@ void SceneObject::LoadFromYAML(const YAML::Node &node)
 }
 
 uint64_t SceneObject::uid_counter_ = 0;
+std::atomic<uint64_t> SceneObject::world_version_counter_(0);
@@ -14,6 +14,7 @@
 #include <scene/components/component.h>
 #include <scene/components/transform.h>
 #include <functional>
+#include <atomic>
 
 #include <QDebug>
 #include <serializable.h>
@@ -43,23 +44,34 @@ public:
     template<typename T, typename std::enable_if<std::is_base_of<Component, T>::value>::type* = nullptr>
     void RemoveComponent() {
         assert(Component::GetTypeName<T>() != "Transform");
-        std::type_index type = Component::GetBaseType<T>();
-        if (components_.count(type) > 0) {
-            delete components_[type];
-            components_.erase(type);
-            ComponentRemoved.Emit(Component::GetTypeName<T>());
-        }
+        int type_id = Component::GetTypeId<T>();
+        if (type_id >= 0) RemoveComponent(type_id);
     }
 
+    // O(1), components are kept in slots indexed by their base type id
     template<typename T, typename std::enable_if<std::is_base_of<Component, T>::value>::type* = nullptr>
     T* GetComponent() {
-        std::type_index type = Component::GetBaseType<T>();
-        if (components_.find(type) == components_.end()) return nullptr;
-        else return components_[type]->as<T>();
+        int type_id = Component::GetTypeId<T>();
+        if (type_id < 0 || components_[type_id] == nullptr) return nullptr;
+        if (Component::IsBaseType<T>()) return static_cast<T*>(components_[type_id]);
+        else return components_[type_id]->as<T>();
+    }
+
+    template<typename T, typename std::enable_if<std::is_base_of<Component, T>::value>::type* = nullptr>
+    bool HasComponent() {
+        int type_id = Component::GetTypeId<T>();
+        return type_id >= 0 && (component_mask_ & (1u << type_id)) != 0 && (Component::IsBaseType<T>() || GetComponent<T>() != nullptr);
     }
 
     // Whether or not this object should be renderered
     bool IsEnabled() { return enabled_; }
+    // Whether this object and all of its ancestors are enabled
+    bool IsEnabledInHierarchy() {
+        for (SceneObject* obj = this; obj != nullptr; obj = obj->parent_) {
+            if (!obj->enabled_) return false;
+        }
+        return true;
+    }
     void SetEnabled(bool enabled)  { SetEnabled(enabled, true); }
     void SetEnabled(bool enabled, bool signal) {
         if (enabled_ == enabled) return;
@@ -88,9 +100,8 @@ public:
 
     uint64_t GetUID() const { return uid_; }
     Transform& GetTransform() {
-        Transform* xform = GetComponent<Transform>();
-        assert(xform != nullptr); // SceneObjects should always has a Transform component!
-        return *xform;
+        assert(transform_ != nullptr); // SceneObjects should always has a Transform component!
+        return *transform_;
     }
     // Used for traversing a scene graph
     // TODO: The best way to do this would actually be to return a custom iterator... but for now this will do at a performance cost.
@@ -140,26 +151,44 @@ public:
     // Used for serialization and UI
     std::vector<Component*> GetComponents() const {
         std::vector<Component*> ret;
-        for (auto& kv : components_) {
-            assert(kv.second != nullptr); // A child should never be null
-            ret.push_back(kv.second);
+        for (int type_id = 0; type_id < Component::MAX_COMPONENT_TYPES; type_id++) {
+            if (components_[type_id] != nullptr) ret.push_back(components_[type_id]);
         }
         return ret;
     }
 
-    // LocalToWorldMatrix - O(log(n)) operation
-    glm::mat4 GetModelMatrix() {
-        return GetParentModelMatrix() * GetTransform().GetMatrix();
+    // The scene indexes our components by type while we belong to it.
+    // Setting another scene, or nullptr, removes them from the previous one.
+    Scene* GetScene() { return scene_; }
+    void SetScene(Scene* scene);
+
+    // LocalToWorldMatrix - cached, O(1) while no transform in the scene changed,
+    // otherwise only the ancestors' versions are checked and changed matrices recomputed.
+    // Reading it updates the cache in place, so it's for the GUI thread only, like the rest of the scene.
+    // Other threads work from copies taken there, e.g. TraceScene::Snapshot.
+    const glm::mat4& GetModelMatrix() {
+        UpdateWorldMatrix();
+        return world_matrix_;
     }
 
-    glm::mat4 GetParentModelMatrix() {
-        glm::mat4 model_matrix;
-        SceneObject* parent = GetParent();
-        while(parent != nullptr) {
-            model_matrix = parent->GetTransform().GetMatrix() * model_matrix;
-            parent = parent->GetParent();
+    // WorldToLocalMatrix - cached with the model matrix
+    const glm::mat4& GetInverseModelMatrix() {
+        UpdateWorldMatrix();
+        if (!inverse_world_valid_) {
+            inverse_world_matrix_ = glm::inverse(world_matrix_);
+            inverse_world_valid_ = true;
         }
-        return model_matrix;
+        return inverse_world_matrix_;
+    }
+
+    glm::mat4 GetParentModelMatrix() {
+        return parent_ != nullptr ? parent_->GetModelMatrix() : glm::mat4();
+    }
+
+    // Changes whenever GetModelMatrix does
+    uint64_t GetWorldVersion() {
+        UpdateWorldMatrix();
+        return world_version_;
     }
 
     // Sets the parent
@@ -230,14 +259,26 @@ protected:
         // Set the parent relationship and notify the parent of its new child.
         parent_ = &parent;
         parent_->RegisterChild(*this);
+        // Every world matrix under us depends on the new parent's
+        Transform::BumpGlobalVersion();
     }
 
+    // Recomputes the cached world matrix if our transform, parent or any ancestor's transform changed
+    void UpdateWorldMatrix();
+
+    void RemoveComponent(int type_id);
+
     static uint64_t uid_counter_; // Program might break if you make 9223372036854775807 objects
     uint64_t uid_; // Unique identifier for this scene object
     // TODO: Maybe name, enabled should be BooleanProperty and TextProperty rather than raw as they are now.
     std::string name_;
 
-    std::map<std::type_index, Component*> components_;
+    std::array<Component*, Component::MAX_COMPONENT_TYPES> components_; // Indexed by base type id
+    uint32_t component_mask_; // Bit i set when components_[i] is
+    Transform* transform_; // Never removed
+    // Where each of our components sits in the scene's list of its type, owned by Scene
+    std::array<uint32_t, Component::MAX_COMPONENT_TYPES> scene_slots_;
+    friend class Scene;
     SceneObject* parent_; // Nullptr if this node is the root
     Scene* scene_; // Can't be a ref cause refs must be initialized
     std::map<uint64_t, SceneObject*> children_;
@@ -246,6 +287,17 @@ protected:
     // TODO: Make UI responsive to this change (signal)
     bool enabled_; // Whether or not the components in this object are active
     int flag_;
+
+    // World matrix cache, and what it was computed from
+    glm::mat4 world_matrix_;
+    glm::mat4 inverse_world_matrix_;
+    bool inverse_world_valid_;
+    uint64_t world_version_; // 0 until first computed
+    uint64_t local_version_;
+    uint64_t parent_world_version_;
+    SceneObject* world_parent_;
+    uint64_t checked_global_version_;
+    static std::atomic<uint64_t> world_version_counter_; // Shared by every scene
 };
 
 #endif // SCENEOBJECT_H
@@ -0,0 +1,236 @@
+#include "bvh.h"
+
+#include <cassert>
+
+// Relative costs used by the surface area heuristic
+const float SAH_TRAVERSAL_COST = 1.0f;
+const float SAH_INTERSECT_COST = 1.0f;
+
+BVH::BVH() :
+    nodes_(nullptr), node_count_(0), build_sah_cost_(0.f)
+{
+}
+
+BoundingBox BVH::GetBounds() const {
+    if (node_count_ == 0) {
+        return BoundingBox(glm::vec3(0,0,0), glm::vec3(0,0,0));
+    }
+    return BoundingBox(nodes_[0].min, nodes_[0].max);
+}
+
+void BVH::Build(const std::vector<BoundingBox>& prim_bounds) {
+    node_storage_.reset();
+    nodes_ = nullptr;
+    node_count_ = 0;
+    prim_indices_.clear();
+    build_sah_cost_ = 0.f;
+
+    if (prim_bounds.empty()) {
+        return;
+    }
+
+    std::vector<BuildPrim> prims(prim_bounds.size());
+    for (size_t p = 0; p < prim_bounds.size(); p++) {
+        prims[p].bounds = prim_bounds[p];
+        prims[p].centroid = prim_bounds[p].GetMid();
+        prims[p].index = (uint32_t)p;
+    }
+
+    std::vector<BVHNode> out;
+    out.reserve(2 * prims.size());
+    BuildRecursive(out, prims, 0, prims.size(), 0);
+
+    prim_indices_.resize(prims.size());
+    for (size_t p = 0; p < prims.size(); p++) {
+        prim_indices_[p] = prims[p].index;
+    }
+
+    // Copy into a cache line aligned block, std::vector doesn't honor the node alignment pre C++17
+    node_count_ = out.size();
+    node_storage_.reset(new uint8_t[node_count_ * sizeof(BVHNode) + alignof(BVHNode)]);
+    uintptr_t address = reinterpret_cast<uintptr_t>(node_storage_.get());
+    address = (address + alignof(BVHNode) - 1) & ~(uintptr_t)(alignof(BVHNode) - 1);
+    nodes_ = reinterpret_cast<BVHNode*>(address);
+    std::copy(out.begin(), out.end(), nodes_);
+
+    build_sah_cost_ = GetSAHCost();
+}
+
+void BVH::Refit(const std::vector<BoundingBox>& prim_bounds) {
+    assert(prim_bounds.size() == prim_indices_.size());
+
+    // Children always come after their parent in the array, so one backwards pass is bottom-up
+    for (size_t n = node_count_; n-- > 0; ) {
+        BVHNode& node = nodes_[n];
+        if (node.IsLeaf()) {
+            BoundingBox bounds = prim_bounds[prim_indices_[node.offset]];
+            for (uint32_t p = node.offset + 1; p < node.offset + node.count; p++) {
+                bounds += prim_bounds[prim_indices_[p]];
+            }
+            node.min = bounds.min;
+            node.max = bounds.max;
+        } else {
+            const BVHNode& left = nodes_[n + 1];
+            const BVHNode& right = nodes_[node.offset];
+            node.min = glm::min(left.min, right.min);
+            node.max = glm::max(left.max, right.max);
+        }
+    }
+}
+
+float BVH::GetSAHCost() const {
+    if (node_count_ == 0) {
+        return 0.f;
+    }
+
+    float root_area = BoundingBox(nodes_[0].min, nodes_[0].max).GetSurfaceArea();
+    if (root_area <= 0.f) {
+        return 0.f;
+    }
+
+    float cost = 0.f;
+    for (size_t n = 0; n < node_count_; n++) {
+        const BVHNode& node = nodes_[n];
+        float area = BoundingBox(node.min, node.max).GetSurfaceArea();
+        cost += (area / root_area) * (node.IsLeaf() ? SAH_INTERSECT_COST * node.count : SAH_TRAVERSAL_COST);
+    }
+    return cost;
+}
+
+void BVH::BuildRecursive(std::vector<BVHNode>& out, std::vector<BuildPrim>& prims, size_t begin, size_t end, int depth) {
+    size_t node_index = out.size();
+    out.push_back(BVHNode());
+
+    BoundingBox bounds = prims[begin].bounds;
+    BoundingBox centroid_bounds(prims[begin].centroid, prims[begin].centroid);
+    for (size_t p = begin + 1; p < end; p++) {
+        bounds += prims[p].bounds;
+        centroid_bounds.min = glm::min(centroid_bounds.min, prims[p].centroid);
+        centroid_bounds.max = glm::max(centroid_bounds.max, prims[p].centroid);
+    }
+
+    out[node_index].min = bounds.min;
+    out[node_index].max = bounds.max;
+    out[node_index].count = 0;
+    out[node_index].axis = 0;
+    out[node_index].pad = 0;
+
+    size_t count = end - begin;
+    auto make_leaf = [&]() {
+        out[node_index].offset = (uint32_t)begin;
+        out[node_index].count = (uint16_t)count;
+    };
+
+    if (count == 1) {
+        make_leaf();
+        return;
+    }
+
+    // Find the best binned SAH split over all three axes
+    int best_axis = -1;
+    int best_bin = -1;
+    float best_cost = std::numeric_limits<float>::max();
+    glm::vec3 extent = centroid_bounds.max - centroid_bounds.min;
+
+    for (int axis = 0; axis < 3; axis++) {
+        if (extent[axis] <= 0.f) {
+            continue;
+        }
+
+        struct Bin {
+            BoundingBox bounds;
+            size_t count = 0;
+        };
+        Bin bins[BVH_NUM_BINS];
+        float scale = BVH_NUM_BINS / extent[axis];
+
+        for (size_t p = begin; p < end; p++) {
+            int b = std::min(BVH_NUM_BINS - 1, (int)((prims[p].centroid[axis] - centroid_bounds.min[axis]) * scale));
+            if (bins[b].count == 0) {
+                bins[b].bounds = prims[p].bounds;
+            } else {
+                bins[b].bounds += prims[p].bounds;
+            }
+            bins[b].count++;
+        }
+
+        // Sweep from the right to get the area and count right of each plane
+        float right_area[BVH_NUM_BINS - 1];
+        size_t right_count[BVH_NUM_BINS - 1];
+        BoundingBox right_bounds;
+        size_t running = 0;
+        for (int b = BVH_NUM_BINS - 1; b > 0; b--) {
+            if (bins[b].count > 0) {
+                if (running == 0) {
+                    right_bounds = bins[b].bounds;
+                } else {
+                    right_bounds += bins[b].bounds;
+                }
+                running += bins[b].count;
+            }
+            right_area[b - 1] = running > 0 ? right_bounds.GetSurfaceArea() : 0.f;
+            right_count[b - 1] = running;
+        }
+
+        BoundingBox left_bounds;
+        running = 0;
+        for (int b = 0; b < BVH_NUM_BINS - 1; b++) {
+            if (bins[b].count > 0) {
+                if (running == 0) {
+                    left_bounds = bins[b].bounds;
+                } else {
+                    left_bounds += bins[b].bounds;
+                }
+                running += bins[b].count;
+            }
+            if (running == 0 || right_count[b] == 0) {
+                continue;
+            }
+            float cost = running * left_bounds.GetSurfaceArea() + right_count[b] * right_area[b];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_bin = b;
+            }
+        }
+    }
+
+    float area = bounds.GetSurfaceArea();
+    float leaf_cost = SAH_INTERSECT_COST * count;
+    float split_cost = best_axis < 0 ? std::numeric_limits<float>::max() :
+            SAH_TRAVERSAL_COST + SAH_INTERSECT_COST * (area > 0.f ? best_cost / area : (float)count);
+
+    size_t mid;
+    if (best_axis >= 0 && depth < BVH_MAX_DEPTH) {
+        if (count <= BVH_MAX_LEAF_SIZE && leaf_cost <= split_cost) {
+            make_leaf();
+            return;
+        }
+        float scale = BVH_NUM_BINS / extent[best_axis];
+        float min_axis = centroid_bounds.min[best_axis];
+        auto it = std::partition(prims.begin() + begin, prims.begin() + end, [=](const BuildPrim& p) {
+            return std::min(BVH_NUM_BINS - 1, (int)((p.centroid[best_axis] - min_axis) * scale)) <= best_bin;
+        });
+        mid = it - prims.begin();
+        if (mid == begin || mid == end) {
+            mid = begin + count / 2;
+        }
+    } else {
+        if (count <= std::numeric_limits<uint16_t>::max() && (best_axis < 0 || count <= BVH_MAX_LEAF_SIZE)) {
+            make_leaf();
+            return;
+        }
+        // Coincident centroids, or the tree got too deep for binning to be trusted: split by count
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        mid = begin + count / 2;
+        std::nth_element(prims.begin() + begin, prims.begin() + mid, prims.begin() + end, [axis](const BuildPrim& a, const BuildPrim& b) {
+            return a.centroid[axis] < b.centroid[axis];
+        });
+        best_axis = axis;
+    }
+
+    out[node_index].axis = (uint8_t)best_axis;
+    BuildRecursive(out, prims, begin, mid, depth + 1);
+    out[node_index].offset = (uint32_t)out.size();
+    BuildRecursive(out, prims, mid, end, depth + 1);
+}
@@ -0,0 +1,367 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <scene/boundingbox.h>
+#include <trace/ray.h>
+#include <trace/simd.h>
+
+#include <vector>
+#include <memory>
+#include <limits>
+#include <algorithm>
+#include <cassert>
+
+#define BVH_NUM_BINS 16
+#define BVH_MAX_LEAF_SIZE 4
+#define BVH_MAX_DEPTH 64
+#define BVH_STACK_SIZE 128
+
+// One node of the flattened tree, sized and aligned so two nodes share a cache line.
+// Interior nodes store their left child directly after themselves and the right child at offset.
+// Leaf nodes (count > 0) reference count primitives starting at offset in the primitive order.
+struct alignas(32) BVHNode {
+    glm::vec3 min;
+    uint32_t offset;
+    glm::vec3 max;
+    uint16_t count;
+    uint8_t axis;
+    uint8_t pad;
+
+    bool IsLeaf() const { return count > 0; }
+};
+
+// Bounding volume hierarchy built with binned SAH and traversed iteratively.
+// It only knows about primitive bounds; the caller supplies the primitive intersection test
+// and gets back the index it used when building.
+class BVH
+{
+public:
+    BVH();
+
+    // Builds the tree over the given primitive bounds, replacing any previous tree
+    void Build(const std::vector<BoundingBox>& prim_bounds);
+
+    // Recomputes node bounds bottom-up for primitives that moved, keeping the topology.
+    // prim_bounds must be indexed the same way as in the last Build.
+    void Refit(const std::vector<BoundingBox>& prim_bounds);
+
+    // Expected cost of a random ray by the surface area heuristic.
+    // Refitting lets this drift from the value right after the build as the tree loosens.
+    float GetSAHCost() const;
+    float GetBuildSAHCost() const { return build_sah_cost_; }
+
+    bool IsEmpty() const { return node_count_ == 0; }
+    size_t GetNodeCount() const { return node_count_; }
+    BoundingBox GetBounds() const;
+    const BVHNode* GetNodes() const { return nodes_; }
+    // Primitive indices in leaf order, leaves reference ranges of this
+    const std::vector<uint32_t>& GetPrimIndices() const { return prim_indices_; }
+
+    // Finds the closest hit. intersect_prim(index, ray, isect) must behave like TraceSceneObject::Intersect
+    template<typename F>
+    bool Intersect(const Ray& r, Intersection& i, F intersect_prim) const;
+
+    // Finds the closest hits of four rays at once, testing nodes against all of them in single precision.
+    // Meant for coherent rays like neighboring camera rays, which mostly visit the same nodes.
+    // Returns a mask with bit k set if rays[k] hit something, and only those isects are filled in.
+    template<typename F>
+    int IntersectPacket(const Ray* rays, Intersection* isects, F intersect_prim) const;
+
+    // Finds the earliest hit of a sphere of radius moving in a straight line from -> to, for collision.
+    // sweep_prim(index, t) is called for primitives the sphere may touch on the way, and must return true and
+    // lower t to the fraction of the way it hits at if that's before t. Nodes entered after that are skipped.
+    template<typename F>
+    bool Sweep(const glm::vec3& from, const glm::vec3& to, float radius, F sweep_prim) const;
+
+private:
+    std::unique_ptr<uint8_t[]> node_storage_;
+    BVHNode* nodes_;
+    size_t node_count_;
+    std::vector<uint32_t> prim_indices_;
+    float build_sah_cost_;
+
+    struct BuildPrim {
+        BoundingBox bounds;
+        glm::vec3 centroid;
+        uint32_t index;
+    };
+
+    void BuildRecursive(std::vector<BVHNode>& out, std::vector<BuildPrim>& prims, size_t begin, size_t end, int depth);
+
+    // Slab test against a node, returns the entry distance in t_near
+    static bool IntersectNode(const BVHNode& node, const glm::dvec3& pos, const glm::dvec3& inv_dir, double t_max, double& t_near);
+    // Slab test of the segment from + t * delta, t in [0, 1], against a node grown by radius
+    static bool SweepNode(const BVHNode& node, const glm::vec3& from, const glm::vec3& inv_delta, float radius, float t_max, float& t_near);
+};
+
+// Reciprocal of a ray direction component for the float kernels. Clamping instead of letting it reach infinity
+// keeps (bound - origin) * inverse from ever being 0 * inf = NaN.
+inline float SafeInverse(double d) {
+    double inv = d == 0.0 ? std::numeric_limits<double>::max() : 1.0 / d;
+    return (float)std::max(-(double)std::numeric_limits<float>::max(), std::min(inv, (double)std::numeric_limits<float>::max()));
+}
+
+inline bool BVH::IntersectNode(const BVHNode& node, const glm::dvec3& pos, const glm::dvec3& inv_dir, double t_max, double& t_near) {
+    double tx1 = (node.min.x - pos.x) * inv_dir.x;
+    double tx2 = (node.max.x - pos.x) * inv_dir.x;
+    double t0 = std::min(tx1, tx2);
+    double t1 = std::max(tx1, tx2);
+
+    double ty1 = (node.min.y - pos.y) * inv_dir.y;
+    double ty2 = (node.max.y - pos.y) * inv_dir.y;
+    t0 = std::max(t0, std::min(ty1, ty2));
+    t1 = std::min(t1, std::max(ty1, ty2));
+
+    double tz1 = (node.min.z - pos.z) * inv_dir.z;
+    double tz2 = (node.max.z - pos.z) * inv_dir.z;
+    t0 = std::max(t0, std::min(tz1, tz2));
+    t1 = std::min(t1, std::max(tz1, tz2));
+
+    t_near = t0;
+    return t0 <= t1 && t1 >= RAY_EPSILON && t0 <= t_max;
+}
+
+inline bool BVH::SweepNode(const BVHNode& node, const glm::vec3& from, const glm::vec3& inv_delta, float radius, float t_max, float& t_near) {
+    glm::vec3 t1 = (node.min - radius - from) * inv_delta;
+    glm::vec3 t2 = (node.max + radius - from) * inv_delta;
+    glm::vec3 enter = glm::min(t1, t2);
+    glm::vec3 exit = glm::max(t1, t2);
+    float t0 = std::max(std::max(enter.x, enter.y), std::max(enter.z, 0.f));
+    float t_exit = std::min(std::min(exit.x, exit.y), std::min(exit.z, 1.f));
+    t_near = t0;
+    return t0 <= t_exit && t0 <= t_max;
+}
+
+template<typename F>
+bool BVH::Sweep(const glm::vec3& from, const glm::vec3& to, float radius, F sweep_prim) const {
+    if (node_count_ == 0) {
+        return false;
+    }
+
+    glm::vec3 delta = to - from;
+    const glm::vec3 inv_delta(SafeInverse(delta.x), SafeInverse(delta.y), SafeInverse(delta.z));
+    bool hit = false;
+    float closest = std::numeric_limits<float>::max();
+
+    struct StackEntry {
+        uint32_t node;
+        float t_near;
+    };
+    StackEntry stack[BVH_STACK_SIZE];
+    int stack_size = 0;
+    uint32_t node_index = 0;
+
+    float t_near;
+    if (!SweepNode(nodes_[0], from, inv_delta, radius, closest, t_near)) {
+        return false;
+    }
+
+    while (true) {
+        const BVHNode& node = nodes_[node_index];
+        if (node.IsLeaf()) {
+            for (uint32_t p = node.offset; p < node.offset + node.count; p++) {
+                if (sweep_prim(prim_indices_[p], closest)) {
+                    hit = true;
+                }
+            }
+        } else {
+            uint32_t near_child = node_index + 1;
+            uint32_t far_child = node.offset;
+            float t_far_child;
+            bool near_hit = SweepNode(nodes_[near_child], from, inv_delta, radius, closest, t_near);
+            bool far_hit = SweepNode(nodes_[far_child], from, inv_delta, radius, closest, t_far_child);
+
+            if (near_hit && far_hit) {
+                if (t_far_child < t_near) {
+                    std::swap(near_child, far_child);
+                    std::swap(t_near, t_far_child);
+                }
+                stack[stack_size++] = StackEntry{far_child, t_far_child};
+                node_index = near_child;
+                continue;
+            } else if (near_hit) {
+                node_index = near_child;
+                continue;
+            } else if (far_hit) {
+                node_index = far_child;
+                continue;
+            }
+        }
+
+        while (stack_size > 0 && stack[stack_size - 1].t_near > closest) {
+            stack_size--;
+        }
+        if (stack_size == 0) {
+            break;
+        }
+        node_index = stack[--stack_size].node;
+    }
+
+    return hit;
+}
+
+template<typename F>
+bool BVH::Intersect(const Ray& r, Intersection& i, F intersect_prim) const {
+    if (node_count_ == 0) {
+        return false;
+    }
+
+    // A zero component would give 0*inf = NaN for rays starting on a slab, so nudge it instead
+    glm::dvec3 inv_dir;
+    for (int axis = 0; axis < 3; axis++) {
+        double d = r.direction[axis];
+        if (d == 0.0) {
+            d = 1e-300;
+        }
+        inv_dir[axis] = 1.0 / d;
+    }
+    const bool dir_negative[3] = { inv_dir.x < 0, inv_dir.y < 0, inv_dir.z < 0 };
+
+    bool hit = false;
+    double closest = std::numeric_limits<double>::max();
+    Intersection cur;
+
+    // Deferred far children, with their entry distance so they can be skipped once a closer hit is found
+    struct StackEntry {
+        uint32_t node;
+        double t_near;
+    };
+    StackEntry stack[BVH_STACK_SIZE];
+    int stack_size = 0;
+    uint32_t node_index = 0;
+
+    double t_near;
+    if (!IntersectNode(nodes_[0], r.position, inv_dir, closest, t_near)) {
+        return false;
+    }
+
+    while (true) {
+        const BVHNode& node = nodes_[node_index];
+        if (node.IsLeaf()) {
+            for (uint32_t p = node.offset; p < node.offset + node.count; p++) {
+                if (intersect_prim(prim_indices_[p], r, cur) && cur.t < closest) {
+                    closest = cur.t;
+                    i = cur;
+                    hit = true;
+                }
+            }
+        } else {
+            // Visit the child on the near side of the split first
+            uint32_t near_child = node_index + 1;
+            uint32_t far_child = node.offset;
+            if (dir_negative[node.axis]) {
+                std::swap(near_child, far_child);
+            }
+
+            double t_far_child;
+            bool near_hit = IntersectNode(nodes_[near_child], r.position, inv_dir, closest, t_near);
+            bool far_hit = IntersectNode(nodes_[far_child], r.position, inv_dir, closest, t_far_child);
+
+            if (near_hit && far_hit) {
+                if (t_far_child < t_near) {
+                    std::swap(near_child, far_child);
+                }
+                assert(stack_size < BVH_STACK_SIZE);
+                stack[stack_size++] = StackEntry{far_child, std::max(t_near, t_far_child)};
+                node_index = near_child;
+                continue;
+            } else if (near_hit) {
+                node_index = near_child;
+                continue;
+            } else if (far_hit) {
+                node_index = far_child;
+                continue;
+            }
+        }
+
+        while (stack_size > 0 && stack[stack_size - 1].t_near > closest) {
+            stack_size--;
+        }
+        if (stack_size == 0) {
+            break;
+        }
+        node_index = stack[--stack_size].node;
+    }
+
+    return hit;
+}
+
+template<typename F>
+int BVH::IntersectPacket(const Ray* rays, Intersection* isects, F intersect_prim) const {
+    if (node_count_ == 0) {
+        return 0;
+    }
+
+    // One ray per lane
+    const float4 org_x((float)rays[0].position.x, (float)rays[1].position.x, (float)rays[2].position.x, (float)rays[3].position.x);
+    const float4 org_y((float)rays[0].position.y, (float)rays[1].position.y, (float)rays[2].position.y, (float)rays[3].position.y);
+    const float4 org_z((float)rays[0].position.z, (float)rays[1].position.z, (float)rays[2].position.z, (float)rays[3].position.z);
+    const float4 inv_x(SafeInverse(rays[0].direction.x), SafeInverse(rays[1].direction.x), SafeInverse(rays[2].direction.x), SafeInverse(rays[3].direction.x));
+    const float4 inv_y(SafeInverse(rays[0].direction.y), SafeInverse(rays[1].direction.y), SafeInverse(rays[2].direction.y), SafeInverse(rays[3].direction.y));
+    const float4 inv_z(SafeInverse(rays[0].direction.z), SafeInverse(rays[1].direction.z), SafeInverse(rays[2].direction.z), SafeInverse(rays[3].direction.z));
+    const float4 t_min_bound((float)RAY_EPSILON);
+
+    double closest[4];
+    float closest_f[4];
+    for (int k = 0; k < 4; k++) {
+        closest[k] = std::numeric_limits<double>::max();
+        closest_f[k] = std::numeric_limits<float>::max();
+    }
+    float4 t_max_bound = float4::Load(closest_f);
+    int hit_mask = 0;
+    Intersection cur;
+
+    // The packet takes the near child by the first ray's direction, which coherent rays mostly share
+    const bool dir_negative[3] = { rays[0].direction.x < 0, rays[0].direction.y < 0, rays[0].direction.z < 0 };
+
+    uint32_t stack[BVH_STACK_SIZE];
+    int stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0) {
+        const BVHNode& node = nodes_[stack[--stack_size]];
+
+        float4 tx0 = (float4(node.min.x) - org_x) * inv_x;
+        float4 tx1 = (float4(node.max.x) - org_x) * inv_x;
+        float4 ty0 = (float4(node.min.y) - org_y) * inv_y;
+        float4 ty1 = (float4(node.max.y) - org_y) * inv_y;
+        float4 tz0 = (float4(node.min.z) - org_z) * inv_z;
+        float4 tz1 = (float4(node.max.z) - org_z) * inv_z;
+        float4 t_near = Max(Max(Min(tx0, tx1), Min(ty0, ty1)), Max(Min(tz0, tz1), t_min_bound));
+        float4 t_far = Min(Min(Max(tx0, tx1), Max(ty0, ty1)), Min(Max(tz0, tz1), t_max_bound)) * float4(SIMD_ROBUST_FACTOR);
+        int mask = LessEqualMask(t_near, t_far);
+        if (mask == 0) {
+            continue;
+        }
+
+        if (node.IsLeaf()) {
+            for (int k = 0; k < 4; k++) {
+                if (!(mask & (1 << k))) {
+                    continue;
+                }
+                for (uint32_t p = node.offset; p < node.offset + node.count; p++) {
+                    if (intersect_prim(prim_indices_[p], rays[k], cur) && cur.t < closest[k]) {
+                        closest[k] = cur.t;
+                        closest_f[k] = (float)cur.t;
+                        isects[k] = cur;
+                        hit_mask |= 1 << k;
+                    }
+                }
+            }
+            t_max_bound = float4::Load(closest_f);
+        } else {
+            uint32_t near_child = &node - nodes_ + 1;
+            uint32_t far_child = node.offset;
+            if (dir_negative[node.axis]) {
+                std::swap(near_child, far_child);
+            }
+            assert(stack_size + 2 <= BVH_STACK_SIZE);
+            stack[stack_size++] = far_child;
+            stack[stack_size++] = near_child;
+        }
+    }
+
+    return hit_mask;
+}
+
+#endif // BVH_H
@@ -0,0 +1,77 @@
+#include "bvh4.h"
+
+#include <cmath>
+
+void BVH4::Build(const BVH& bvh) {
+    nodes_.clear();
+    prim_indices_ = bvh.GetPrimIndices();
+    if (bvh.IsEmpty()) {
+        return;
+    }
+    nodes_.reserve(bvh.GetNodeCount() / 2 + 1);
+    CollapseNode(bvh.GetNodes(), 0);
+}
+
+uint32_t BVH4::CollapseNode(const BVHNode* binary_nodes, uint32_t binary_index) {
+    // Open up the largest interior candidate until there are four children, or only leaves are left
+    uint32_t candidates[4] = { binary_index, 0, 0, 0 };
+    int candidate_count = 1;
+    if (!binary_nodes[binary_index].IsLeaf()) {
+        while (candidate_count < 4) {
+            int largest = -1;
+            float largest_area = -1.f;
+            for (int c = 0; c < candidate_count; c++) {
+                const BVHNode& node = binary_nodes[candidates[c]];
+                if (node.IsLeaf()) {
+                    continue;
+                }
+                float area = BoundingBox(node.min, node.max).GetSurfaceArea();
+                if (area > largest_area) {
+                    largest_area = area;
+                    largest = c;
+                }
+            }
+            if (largest < 0) {
+                break;
+            }
+            const BVHNode& node = binary_nodes[candidates[largest]];
+            uint32_t left = candidates[largest] + 1;
+            candidates[largest] = left;
+            candidates[candidate_count++] = node.offset;
+        }
+    }
+
+    uint32_t index = (uint32_t)nodes_.size();
+    nodes_.push_back(BVH4Node());
+    nodes_[index].lane_mask = (1 << candidate_count) - 1;
+
+    for (int c = 0; c < 4; c++) {
+        glm::vec3 min(0.f), max(0.f);
+        uint32_t child = 0, count = 0;
+        if (c < candidate_count) {
+            const BVHNode& node = binary_nodes[candidates[c]];
+            // Pad by a few ulps of the coordinates so origins rounded to float can't miss the box
+            glm::vec3 pad = (glm::abs(node.min) + glm::abs(node.max)) * 1e-6f;
+            min = node.min - pad;
+            max = node.max + pad;
+            if (node.IsLeaf()) {
+                child = node.offset;
+                count = node.count;
+            } else {
+                child = CollapseNode(binary_nodes, candidates[c]);
+            }
+        }
+        // nodes_ may have grown, so index it again
+        BVH4Node& out = nodes_[index];
+        out.min_x[c] = min.x;
+        out.min_y[c] = min.y;
+        out.min_z[c] = min.z;
+        out.max_x[c] = max.x;
+        out.max_y[c] = max.y;
+        out.max_z[c] = max.z;
+        out.child[c] = child;
+        out.count[c] = count;
+    }
+
+    return index;
+}
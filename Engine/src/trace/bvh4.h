@@ -0,0 +1,134 @@
+#ifndef BVH4_H
+#define BVH4_H
+
+#include "bvh.h"
+
+#define BVH4_STACK_SIZE 256
+
+// Four children's boxes laid out so one SIMD slab test covers all of them.
+// A child with count > 0 is a leaf referencing count primitives from child in the primitive order,
+// otherwise child is the index of another node. Lanes not in lane_mask are unused.
+struct BVH4Node {
+    float min_x[4];
+    float min_y[4];
+    float min_z[4];
+    float max_x[4];
+    float max_y[4];
+    float max_z[4];
+    uint32_t child[4];
+    uint32_t count[4];
+    int lane_mask;
+};
+
+// Four wide BVH made by collapsing a binary BVH, for single rays in single precision.
+// It halves the tree depth, which pays off most for incoherent rays that share little traversal work.
+class BVH4
+{
+public:
+    BVH4() {}
+
+    // Rebuilds from the current state of bvh, keeping its primitive indices.
+    // Call again after the binary tree is rebuilt or refit.
+    void Build(const BVH& bvh);
+
+    bool IsEmpty() const { return nodes_.empty(); }
+    size_t GetNodeCount() const { return nodes_.size(); }
+
+    // Same contract as BVH::Intersect
+    template<typename F>
+    bool Intersect(const Ray& r, Intersection& i, F intersect_prim) const;
+
+private:
+    std::vector<BVH4Node> nodes_;
+    std::vector<uint32_t> prim_indices_;
+
+    uint32_t CollapseNode(const BVHNode* binary_nodes, uint32_t binary_index);
+};
+
+template<typename F>
+bool BVH4::Intersect(const Ray& r, Intersection& i, F intersect_prim) const {
+    if (nodes_.empty()) {
+        return false;
+    }
+
+    const float4 org_x((float)r.position.x);
+    const float4 org_y((float)r.position.y);
+    const float4 org_z((float)r.position.z);
+    const float4 inv_x(SafeInverse(r.direction.x));
+    const float4 inv_y(SafeInverse(r.direction.y));
+    const float4 inv_z(SafeInverse(r.direction.z));
+    const float4 t_min_bound((float)RAY_EPSILON);
+
+    bool hit = false;
+    double closest = std::numeric_limits<double>::max();
+    float4 t_max_bound(std::numeric_limits<float>::max());
+    Intersection cur;
+
+    // Entries are nodes, or leaf ranges when count > 0, with the distance the ray enters them
+    struct StackEntry {
+        uint32_t index;
+        uint32_t count;
+        float t_near;
+    };
+    StackEntry stack[BVH4_STACK_SIZE];
+    int stack_size = 0;
+    stack[stack_size++] = StackEntry{0, 0, 0.f};
+
+    while (stack_size > 0) {
+        const StackEntry entry = stack[--stack_size];
+        if (entry.t_near > closest * SIMD_ROBUST_FACTOR) {
+            continue;
+        }
+
+        if (entry.count > 0) {
+            for (uint32_t p = entry.index; p < entry.index + entry.count; p++) {
+                if (intersect_prim(prim_indices_[p], r, cur) && cur.t < closest) {
+                    closest = cur.t;
+                    i = cur;
+                    hit = true;
+                }
+            }
+            t_max_bound = float4((float)closest);
+            continue;
+        }
+
+        const BVH4Node& node = nodes_[entry.index];
+        float4 tx0 = (float4::Load(node.min_x) - org_x) * inv_x;
+        float4 tx1 = (float4::Load(node.max_x) - org_x) * inv_x;
+        float4 ty0 = (float4::Load(node.min_y) - org_y) * inv_y;
+        float4 ty1 = (float4::Load(node.max_y) - org_y) * inv_y;
+        float4 tz0 = (float4::Load(node.min_z) - org_z) * inv_z;
+        float4 tz1 = (float4::Load(node.max_z) - org_z) * inv_z;
+        float4 t_near = Max(Max(Min(tx0, tx1), Min(ty0, ty1)), Max(Min(tz0, tz1), t_min_bound));
+        float4 t_far = Min(Min(Max(tx0, tx1), Max(ty0, ty1)), Min(Max(tz0, tz1), t_max_bound)) * float4(SIMD_ROBUST_FACTOR);
+        int mask = LessEqualMask(t_near, t_far) & node.lane_mask;
+        if (mask == 0) {
+            continue;
+        }
+
+        // Push far to near so the nearest child is popped first
+        float distances[4];
+        t_near.Store(distances);
+        int order[4];
+        int hits = 0;
+        for (int c = 0; c < 4; c++) {
+            if (mask & (1 << c)) {
+                int k = hits++;
+                while (k > 0 && distances[order[k - 1]] < distances[c]) {
+                    order[k] = order[k - 1];
+                    k--;
+                }
+                order[k] = c;
+            }
+        }
+        assert(stack_size + hits <= BVH4_STACK_SIZE);
+        for (int k = 0; k < hits; k++) {
+            int c = order[k];
+            stack[stack_size++] = StackEntry{node.child[c], node.count[c], distances[c]};
+        }
+    }
+
+    return hit;
+}
+
+#endif // BVH4_H
@@ -1,3 +1,211 @@
 #include "randomsampler.h"
+#include <scene/components/camera.h>
+#include <algorithm>
+#include <cmath>
 
+namespace {
 
+// Largest float below one, samples are kept in [0,1)
+const float ONE_MINUS_EPSILON = 0.99999994f;
+
+const uint32_t PRIMES[] = {
+    2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53,
+    59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131
+};
+const uint32_t NUM_PRIMES = sizeof(PRIMES) / sizeof(PRIMES[0]);
+
+uint32_t MixBits(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+float ToUnitFloat(uint32_t bits) {
+    return std::min(bits * 2.3283064365386963e-10f, ONE_MINUS_EPSILON);
+}
+
+uint32_t ReverseBits(uint32_t x) {
+    x = (x << 16) | (x >> 16);
+    x = ((x & 0x00ff00ffU) << 8) | ((x & 0xff00ff00U) >> 8);
+    x = ((x & 0x0f0f0f0fU) << 4) | ((x & 0xf0f0f0f0U) >> 4);
+    x = ((x & 0x33333333U) << 2) | ((x & 0xccccccccU) >> 2);
+    x = ((x & 0x55555555U) << 1) | ((x & 0xaaaaaaaaU) >> 1);
+    return x;
+}
+
+// Laine and Karras' hash, each bit only depends on the bits below it
+uint32_t LaineKarrasPermutation(uint32_t x, uint32_t seed) {
+    x += seed;
+    x ^= x * 0x6c50b47cU;
+    x ^= x * 0xb82f1e52U;
+    x ^= x * 0xc7afe638U;
+    x ^= x * 0x8d22f6e6U;
+    return x;
+}
+
+// Owen scrambling of a 0.32 fixed point value (Burley 2020)
+uint32_t NestedUniformScramble(uint32_t x, uint32_t seed) {
+    return ReverseBits(LaineKarrasPermutation(ReverseBits(x), seed));
+}
+
+// Second dimension of the Sobol sequence, the first is just the bit reversed index
+uint32_t Sobol2(uint32_t index) {
+    uint32_t result = 0;
+    for (uint32_t v = 1U << 31; index; index >>= 1, v ^= v >> 1) {
+        if (index & 1) {
+            result ^= v;
+        }
+    }
+    return result;
+}
+
+// Random permutation of [0, n) picked by seed (Kensler 2013, "Correlated Multi-Jittered Sampling")
+uint32_t PermuteIndex(uint32_t i, uint32_t n, uint32_t seed) {
+    if (n <= 1) {
+        return 0;
+    }
+    uint32_t w = n - 1;
+    w |= w >> 1;
+    w |= w >> 2;
+    w |= w >> 4;
+    w |= w >> 8;
+    w |= w >> 16;
+    do {
+        i ^= seed;
+        i *= 0xe170893dU;
+        i ^= seed >> 16;
+        i ^= (i & w) >> 4;
+        i ^= seed >> 8;
+        i *= 0x0929eb3fU;
+        i ^= seed >> 23;
+        i ^= (i & w) >> 1;
+        i *= 1 | seed >> 27;
+        i *= 0x6935fa69U;
+        i ^= (i & w) >> 11;
+        i *= 0x74dcb303U;
+        i ^= (i & w) >> 2;
+        i *= 0x9e501cc3U;
+        i ^= (i & w) >> 2;
+        i *= 0xc860a3dfU;
+        i &= w;
+        i ^= i >> 5;
+    } while (i >= n);
+    return (i + seed) % n;
+}
+
+}
+
+void Sampler::StartPixel(uint32_t x, uint32_t y, uint32_t first_index) {
+    pixel_seed_ = MixBits(x * 0x8da6b343U ^ MixBits(y * 0xd8163841U + 0x9e3779b9U));
+    next_index_ = first_index;
+    index_ = first_index;
+    dimension_ = 0;
+}
+
+void Sampler::StartNextSample() {
+    index_ = next_index_++;
+    dimension_ = 0;
+}
+
+uint32_t Sampler::Hash(uint32_t a, uint32_t b) const {
+    return MixBits(pixel_seed_ ^ MixBits(a * 0x9e3779b9U ^ MixBits(b + 0x632be5abU)));
+}
+
+std::unique_ptr<Sampler> Sampler::Create(int random_mode, unsigned int samples_per_pixel) {
+    switch (random_mode) {
+        case Camera::TRACERANDOM_UNIFORM:
+            return std::unique_ptr<Sampler>(new IndependentSampler());
+        case Camera::TRACERANDOM_STRATIFIED:
+            return std::unique_ptr<Sampler>(new StratifiedSampler(samples_per_pixel));
+        case Camera::TRACERANDOM_HALTON:
+            return std::unique_ptr<Sampler>(new HaltonSampler());
+        case Camera::TRACERANDOM_SOBOL:
+            return std::unique_ptr<Sampler>(new SobolSampler());
+        default:
+            return nullptr;
+    }
+}
+
+
+float IndependentSampler::Get1D() {
+    return ToUnitFloat(Hash(index_, dimension_++));
+}
+
+glm::vec2 IndependentSampler::Get2D() {
+    float u = Get1D();
+    return glm::vec2(u, Get1D());
+}
+
+
+StratifiedSampler::StratifiedSampler(unsigned int samples_per_pixel) {
+    side_ = std::max(1u, (uint32_t)std::sqrt((double)std::max(samples_per_pixel, 1u)));
+    count_ = side_ * side_;
+}
+
+float StratifiedSampler::Get1D() {
+    // Every count_ samples is a new round with its own permutation
+    uint32_t round = index_ / count_;
+    uint32_t seed = Hash(dimension_, round);
+    uint32_t stratum = PermuteIndex(index_ % count_, count_, seed);
+    float jitter = ToUnitFloat(Hash(index_, dimension_ + 0x10000U));
+    dimension_++;
+    return std::min((stratum + jitter) / count_, ONE_MINUS_EPSILON);
+}
+
+glm::vec2 StratifiedSampler::Get2D() {
+    uint32_t round = index_ / count_;
+    uint32_t seed = Hash(dimension_, round);
+    uint32_t stratum = PermuteIndex(index_ % count_, count_, seed);
+    glm::vec2 jitter(ToUnitFloat(Hash(index_, dimension_ + 0x10000U)), ToUnitFloat(Hash(index_, dimension_ + 0x20000U)));
+    dimension_ += 2;
+    glm::vec2 cell((float)(stratum % side_), (float)(stratum / side_));
+    return glm::min((cell + jitter) / (float)side_, glm::vec2(ONE_MINUS_EPSILON));
+}
+
+
+float HaltonSampler::ScrambledRadicalInverse(uint32_t index, uint32_t dimension) const {
+    const uint32_t base = PRIMES[dimension % NUM_PRIMES];
+    const uint32_t seed = Hash(dimension, 0x48414cU);
+    const double inv_base = 1.0 / base;
+
+    // Shift every digit by a per pixel random amount, including the leading zeros,
+    // until the digits fall below float precision
+    double result = 0.0;
+    double scale = inv_base;
+    for (uint32_t digit_index = 0; scale > 1e-9; digit_index++) {
+        uint32_t digit = index % base;
+        index /= base;
+        uint32_t shift = MixBits(seed ^ (digit_index * 0x9e3779b9U)) % base;
+        result += ((digit + shift) % base) * scale;
+        scale *= inv_base;
+    }
+    return std::min((float)result, ONE_MINUS_EPSILON);
+}
+
+float HaltonSampler::Get1D() {
+    return ScrambledRadicalInverse(index_, dimension_++);
+}
+
+glm::vec2 HaltonSampler::Get2D() {
+    float u = Get1D();
+    return glm::vec2(u, Get1D());
+}
+
+
+float SobolSampler::Get1D() {
+    return Get2D().x;
+}
+
+glm::vec2 SobolSampler::Get2D() {
+    uint32_t pair = dimension_ / 2;
+    dimension_ += 2;
+
+    // The first pair uses the sequence in order so the samples of a pixel stay well stratified
+    uint32_t index = pair == 0 ? index_ : NestedUniformScramble(index_, Hash(pair, 0x534f42U));
+    uint32_t x = NestedUniformScramble(ReverseBits(index), Hash(pair, 0));
+    uint32_t y = NestedUniformScramble(Sobol2(index), Hash(pair, 1));
+    return glm::vec2(ToUnitFloat(x), ToUnitFloat(y));
+}
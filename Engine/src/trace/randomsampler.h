@@ -1,12 +1,80 @@
 #ifndef RANDOMSAMPLER_H
 #define RANDOMSAMPLER_H
 
-#include <glm/glm.hpp>
+#include <vectors.h>
 #include <random>
+#include <memory>
+#include <cstdint>
 
 #ifndef M_PI
     #define M_PI 3.14159265359
 #endif
 
+// Source of sample points in [0,1) for the Monte Carlo parts of the tracer.
+// Every value is a pure function of (pixel, sample index, dimension), so a render
+// comes out the same no matter how many threads traced it or in which order.
+class Sampler {
+public:
+    virtual ~Sampler() {}
 
-#endif // RANDOMSAMPLER_H
\ No newline at end of file
+    // Begins a pixel. first_index is the number of samples the pixel already has,
+    // so later progressive passes continue the sequence instead of repeating it.
+    void StartPixel(uint32_t x, uint32_t y, uint32_t first_index);
+    // Moves to the next sample of the pixel and back to its first dimension
+    void StartNextSample();
+
+    // Consume the next one or two dimensions of the current sample
+    virtual float Get1D() = 0;
+    virtual glm::vec2 Get2D() = 0;
+
+    // Sampler for a Camera::TRACERANDOM_* mode, or nullptr when sampling is deterministic.
+    // samples_per_pixel is the expected count, the stratified sampler sizes its grid by it.
+    static std::unique_ptr<Sampler> Create(int random_mode, unsigned int samples_per_pixel);
+
+protected:
+    uint32_t pixel_seed_ = 0;
+    uint32_t index_ = 0;
+    uint32_t next_index_ = 0;
+    uint32_t dimension_ = 0;
+
+    // Well mixed 32 bit hash of the pixel and the given values
+    uint32_t Hash(uint32_t a, uint32_t b = 0) const;
+};
+
+// Uncorrelated uniform random numbers
+class IndependentSampler : public Sampler {
+public:
+    float Get1D() override;
+    glm::vec2 Get2D() override;
+};
+
+// Jittered samples, one per stratum of an n x n grid (n strata in 1D).
+// Each dimension visits the strata in its own shuffled order.
+class StratifiedSampler : public Sampler {
+public:
+    StratifiedSampler(unsigned int samples_per_pixel);
+    float Get1D() override;
+    glm::vec2 Get2D() override;
+private:
+    uint32_t count_;
+    uint32_t side_;
+};
+
+// Halton sequence with a prime base per dimension and random digit scrambling per pixel
+class HaltonSampler : public Sampler {
+public:
+    float Get1D() override;
+    glm::vec2 Get2D() override;
+private:
+    float ScrambledRadicalInverse(uint32_t index, uint32_t dimension) const;
+};
+
+// Sobol (0,2) sequence pairs with hash based Owen scrambling. Higher dimensions reuse the
+// pair on a shuffled index so they stay decorrelated from the first ones.
+class SobolSampler : public Sampler {
+public:
+    float Get1D() override;
+    glm::vec2 Get2D() override;
+};
+
+#endif // RANDOMSAMPLER_H
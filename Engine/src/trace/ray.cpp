@@ -9,12 +9,16 @@
  ****************************************************************************/
 #include "ray.h"
 #include "tracesceneobject.h"
+#include "tracemesh.h"
 
 #include <scene/components/triangleface.h>
 
 Material* Intersection::GetMaterial()
 {
    assert(obj != nullptr);
+   if (TraceMeshInstance* instance = dynamic_cast<TraceMeshInstance*>(obj)) {
+       return instance->material;
+   }
    TraceGeometry* geo = dynamic_cast<TraceGeometry*>(obj);
    assert(geo != nullptr);
    return geo->geometry->RenderMaterial.Get();
@@ -23,6 +27,9 @@ Material* Intersection::GetMaterial()
 glm::vec3 Intersection::GetTrueNormal()
 {
     assert(obj != nullptr);
+    if (TraceMeshInstance* instance = dynamic_cast<TraceMeshInstance*>(obj)) {
+        return instance->GetFaceNormal(face);
+    }
     TraceGeometry* geo = dynamic_cast<TraceGeometry*>(obj);
     assert(geo != nullptr);
     Geometry* geo2 = geo->geometry;
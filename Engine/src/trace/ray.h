@@ -68,6 +68,7 @@ class Intersection {
     double t;
     glm::vec3 normal;
     glm::vec2 uv;
+    uint32_t face; // Triangle that was hit, only set by objects made of many triangles
     Material* GetMaterial();
     glm::vec3 GetTrueNormal();
 };
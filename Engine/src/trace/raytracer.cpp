@@ -18,6 +18,7 @@
 #include <scene/components/triangleface.h>
 #include <glm/gtx/string_cast.hpp>
 #include "components.h"
+#include "tonemapping.h"
 
 unsigned int pow4(unsigned int e) {
     unsigned int i = 1;
@@ -28,11 +29,19 @@ unsigned int pow4(unsigned int e) {
     return i;
 }
 
-RayTracer::RayTracer(Scene& scene, SceneObject& camobj) :
-    trace_scene(&scene, camobj.GetComponent<Camera>()->TraceEnableAcceleration.Get()), next_render_index(0), cancelling(false), first_pass_buffer(nullptr)
+RayTracer::RayTracer(Scene& scene, SceneObject& camobj, std::shared_ptr<TraceScene> previous_trace_scene) :
+    first_pass_buffer(nullptr), cancelling(false), num_threads_(0), scene_ready_(0), finished_(0), trace_scene(previous_trace_scene), reported_time_(false)
 {
     Camera* cam = camobj.GetComponent<Camera>();
 
+    // Only the snapshot reads the scene here, building it happens on the pipeline thread
+    if (!trace_scene) {
+        trace_scene = std::make_shared<TraceScene>();
+    }
+    trace_scene->Snapshot(&scene, cam->TraceEnableAcceleration.Get());
+    trace_scene->SetKernel(cam->TraceKernel.Get());
+    trace_start_ = std::chrono::high_resolution_clock::now();
+
     settings.width = cam->RenderWidth.Get();
     settings.height = cam->RenderHeight.Get();
     settings.pixel_size_x = 1.0/double(settings.width);
@@ -43,6 +52,11 @@ RayTracer::RayTracer(Scene& scene, SceneObject& camobj) :
     settings.reflections = cam->TraceEnableReflection.Get();
     settings.refractions = cam->TraceEnableRefraction.Get();
 
+    settings.progressive_passes = std::max(cam->TraceProgressivePasses.Get(), 1);
+    settings.tone_mapping = cam->TraceToneMapping.Get();
+    settings.srgb_output = cam->TraceSRGBOutput.Get();
+
+    settings.kernel = cam->TraceKernel.Get();
     settings.random_mode = cam->TraceRandomMode.Get();
     settings.diffuse_reflection = cam->TraceEnableReflection.Get() && cam->TraceDiffuseReflection.Get() && settings.random_mode != Camera::TRACERANDOM_DETERMINISTIC;
     settings.caustics = settings.diffuse_reflection && settings.shadows && cam->TraceCaustics.Get();
@@ -56,6 +70,9 @@ RayTracer::RayTracer(Scene& scene, SceneObject& camobj) :
     settings.adaptive_max_diff_squared = cam->TraceAdaptiveSamplingMaxDiff.Get();
     settings.adaptive_max_diff_squared *= settings.adaptive_max_diff_squared;
     settings.max_stderr = cam->TraceStdErrorSamplingCutoff.Get();
+    settings.expected_samples_per_pixel = settings.samplecount_mode == Camera::TRACESAMPLING_CONSTANT ?
+            settings.constant_samples_per_pixel : pow4(settings.dynamic_sampling_min_depth);
+    settings.expected_samples_per_pixel *= settings.progressive_passes;
 
     if (settings.samplecount_mode == Camera::TRACESAMPLING_RECURSIVE && settings.random_mode!=Camera::TRACERANDOM_DETERMINISTIC) {
         qDebug() << "Adaptive Recursive Supersampling does not work with Monte Carlo!";
@@ -91,40 +108,115 @@ RayTracer::RayTracer(Scene& scene, SceneObject& camobj) :
     settings.aperture_radius = aperture_radius;
 
     buffer = new uint8_t[settings.width * settings.height * 3]();
+    hdr_buffer = new float[settings.width * settings.height * 3]();
+    sample_count_buffer = new uint32_t[settings.width * settings.height]();
+
+    SetThreadCount(0);
+}
+
+void RayTracer::SetThreadCount(unsigned int num_threads) {
+    if (num_threads == 0) {
+        num_threads = std::max(QThread::idealThreadCount(), 1);
+        if (num_threads > 1) {
+            num_threads -= 1; //leave a free thread so the computer doesn't totally die
+        }
+    }
+    num_threads_ = num_threads;
+}
+
+void RayTracer::Start() {
+    // RunPipeline runs on its own thread
+    finished_.store(0);
+    pipeline_pool_.setMaxThreadCount(1);
+    pipeline_pool_.start(new RTPipeline(*this));
+}
+
+void RayTracer::RunWorkers(unsigned int passes, bool preview, bool report_passes) {
+    scheduler.Reset(settings.width, settings.height, num_threads_, passes);
+    thread_pool.setMaxThreadCount(num_threads_);
+    for (unsigned int i = 0; i < num_threads_; i++) {
+        thread_pool.start(new RTWorker(*this, i, preview));
+    }
 
-    int num_threads = QThread::idealThreadCount();
-    if (num_threads > 1) {
-        num_threads -= 1; //leave a free thread so the computer doesn't totally die
+    unsigned int reported = 0;
+    while (!thread_pool.waitForDone(10)) {
+        for (; report_passes && reported < scheduler.CurrentPass(); reported++) {
+            PassFinished.Emit(reported);
+        }
     }
-    thread_pool.setMaxThreadCount(num_threads);
+    for (; report_passes && !cancelling && reported < passes; reported++) {
+        PassFinished.Emit(reported);
+    }
+}
 
-    if (settings.samplecount_mode!=Camera::TRACESAMPLING_CONSTANT && settings.dynamic_sampling_min_depth==0) {
+void RayTracer::RunPipeline() {
+    trace_scene->Prepare();
+    scene_ready_.store(1);
+    ScenePrepared.Emit();
+
+    // A coarse image right away, real passes overwrite it pixel by pixel
+    if (!cancelling) {
+        RunWorkers(1, true, false);
+        if (!cancelling) {
+            PreviewFinished.Emit();
+        }
+    }
+
+    if (!cancelling && settings.samplecount_mode!=Camera::TRACESAMPLING_CONSTANT && settings.dynamic_sampling_min_depth==0) {
         int orig = settings.samplecount_mode;
+        unsigned int orig_samples = settings.constant_samples_per_pixel;
         settings.samplecount_mode = Camera::TRACESAMPLING_CONSTANT;
         settings.constant_samples_per_pixel = 1;
 
-        //TODO make it not hang here
-        for (unsigned int i = 0; i < num_threads; i++) {
-            thread_pool.start(new RTWorker(*this));
-        }
-        thread_pool.waitForDone(-1);
-        next_render_index.store(0);
+        // Only there to guide the sampling, the progressive passes are the ones numbered from 0
+        RunWorkers(1, false, false);
 
         settings.samplecount_mode = orig;
-        first_pass_buffer = buffer;
-        buffer = new uint8_t[settings.width * settings.height * 3]();
+        settings.constant_samples_per_pixel = orig_samples;
+        if (!cancelling) {
+            // Keep showing the first pass until the real one covers it
+            first_pass_buffer = new uint8_t[settings.width * settings.height * 3];
+            std::copy(buffer, buffer + settings.width * settings.height * 3, first_pass_buffer);
+            std::fill(hdr_buffer, hdr_buffer + settings.width * settings.height * 3, 0.0f);
+            std::fill(sample_count_buffer, sample_count_buffer + settings.width * settings.height, 0);
+        }
     }
 
-    // Spin off threads
-    for (unsigned int i = 0; i < num_threads; i++) {
-        thread_pool.start(new RTWorker(*this));
+    if (!cancelling) {
+        RunWorkers(settings.progressive_passes, false, true);
     }
+
+    finished_.store(1);
+    RenderFinished.Emit();
 }
 
-RayTracer::~RayTracer() {
-    cancelling=true;
+void RayTracer::Cancel() {
+    cancelling = true;
+    pipeline_pool_.waitForDone(-1);
     thread_pool.waitForDone(-1);
+}
+
+void RayTracer::Restart() {
+    Cancel();
+    cancelling = false;
+
+    std::fill(buffer, buffer + settings.width * settings.height * 3, 0);
+    std::fill(hdr_buffer, hdr_buffer + settings.width * settings.height * 3, 0.0f);
+    std::fill(sample_count_buffer, sample_count_buffer + settings.width * settings.height, 0);
+    if (first_pass_buffer != nullptr) {
+        delete[] first_pass_buffer;
+        first_pass_buffer = nullptr;
+    }
+
+    reported_time_ = false;
+    trace_start_ = std::chrono::high_resolution_clock::now();
+}
+
+RayTracer::~RayTracer() {
+    Cancel();
     delete[] buffer;
+    delete[] hdr_buffer;
+    delete[] sample_count_buffer;
     if (first_pass_buffer != nullptr) {
         delete[] first_pass_buffer;
     }
@@ -134,22 +226,57 @@ RayTracer::~RayTracer() {
 }
 
 int RayTracer::GetProgress() {
-    if (thread_pool.waitForDone(1)) {
+    if (finished_.load() != 0) {
+        pipeline_pool_.waitForDone(-1);
+        if (!reported_time_) {
+            reported_time_ = true;
+            std::chrono::duration<double, std::milli> trace_time = std::chrono::high_resolution_clock::now() - trace_start_;
+            uint64_t total_samples = 0;
+            for (unsigned int p = 0; p < settings.width * settings.height; p++) {
+                total_samples += sample_count_buffer[p];
+            }
+            Debug::Log.WriteLine("Frame: " + std::string(trace_scene->last_update_rebuilt ? "build " : "refit ") + std::to_string(trace_scene->last_update_ms) +
+                                 " ms, trace " + std::to_string(trace_time.count()) + " ms on " + std::to_string(num_threads_) + " threads (" +
+                                 std::to_string(scheduler.TileSize()) + "px tiles), " + std::to_string(total_samples) + " camera samples (" +
+                                 std::to_string((double)total_samples / (settings.width * settings.height)) + " per pixel)");
+        }
         return 100;
     }
 
-    const unsigned int wc = (settings.width+THREAD_CHUNKSIZE-1)/THREAD_CHUNKSIZE;
-    const unsigned int hc = (settings.height+THREAD_CHUNKSIZE-1)/THREAD_CHUNKSIZE;
-    int complete = (100*next_render_index.fetchAndAddRelaxed(0))/(wc*hc);
+    if (!IsSceneReady()) {
+        return 0;
+    }
+    int complete = (int)((100LL*scheduler.CompletedTiles())/std::max(scheduler.TileCount()*scheduler.PassCount(), 1u));
     return std::min(complete,99);
 }
 
+bool RayTracer::SaveHDR(const std::string& filename) const {
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) {
+        return false;
+    }
+    // Negative scale marks little endian data. Rows go bottom to top, same as our buffers.
+    out << "PF\n" << settings.width << " " << settings.height << "\n-1.0\n";
+    std::vector<float> row(settings.width * 3);
+    for (unsigned int j = 0; j < settings.height; j++) {
+        for (unsigned int i = 0; i < settings.width; i++) {
+            unsigned int index = i + j * settings.width;
+            float inv_count = sample_count_buffer[index] > 0 ? 1.0f / sample_count_buffer[index] : 0.0f;
+            row[3*i] = hdr_buffer[3*index] * inv_count;
+            row[3*i+1] = hdr_buffer[3*index+1] * inv_count;
+            row[3*i+2] = hdr_buffer[3*index+2] * inv_count;
+        }
+        out.write(reinterpret_cast<const char*>(row.data()), row.size() * sizeof(float));
+    }
+    return out.good();
+}
+
 double RayTracer::AspectRatio() {
     return ((double)settings.width)/((double)settings.height);
 }
 
 
-void RayTracer::ComputePixel(int i, int j, Camera* debug_camera) {
+void RayTracer::ComputePixel(int i, int j, Camera* debug_camera, Sampler* sampler) {
     // Calculate the normalized coordinates [0, 1]
     double x_corner = i * settings.pixel_size_x;
     double y_corner = j * settings.pixel_size_y;
@@ -159,68 +286,330 @@ void RayTracer::ComputePixel(int i, int j, Camera* debug_camera) {
             debug_camera_used_->ClearDebugRays();
         }
         debug_camera_used_ = debug_camera;
-        SampleCamera(x_corner, y_corner, settings.pixel_size_x, settings.pixel_size_y, debug_camera);
+        SampleCamera(x_corner, y_corner, settings.pixel_size_x, settings.pixel_size_y, nullptr, debug_camera);
         return;
     }
 
+    // Seeded by pixel and by how many samples it already has, so passes continue the sequence
+    unsigned int index = i + j * settings.width;
+    std::unique_ptr<Sampler> own_sampler;
+    if (!sampler) {
+        own_sampler = Sampler::Create(settings.random_mode, settings.expected_samples_per_pixel);
+        sampler = own_sampler.get();
+    }
+    if (sampler) {
+        sampler->StartPixel(i, j, sample_count_buffer[index]);
+    }
+
     // Trace the ray!
     glm::vec3 color(0,0,0);
+    unsigned int samples = 0;
 
     switch (settings.samplecount_mode) {
         case Camera::TRACESAMPLING_CONSTANT:
-            color = SampleCamera(x_corner, y_corner, settings.pixel_size_x, settings.pixel_size_y, debug_camera);
+            color = SampleConstant(x_corner, y_corner, sampler, samples);
+            break;
+        case Camera::TRACESAMPLING_RECURSIVE:
+            color = SampleAdaptive(i, j, samples);
+            break;
+        case Camera::TRACESAMPLING_STDERROR:
+            color = SampleStdError(i, j, sampler, samples);
             break;
         default:
             break;
     }
 
-    color = glm::clamp(color, 0.0f, 1.0f);
+    // Accumulate, then show the running average through the tone mapper
+    float* hdr_pixel = hdr_buffer + index * 3;
+    hdr_pixel[0] += color[0] * samples;
+    hdr_pixel[1] += color[1] * samples;
+    hdr_pixel[2] += color[2] * samples;
+    sample_count_buffer[index] += samples;
+
+    glm::vec3 average = glm::vec3(hdr_pixel[0], hdr_pixel[1], hdr_pixel[2]) / (float)std::max(sample_count_buffer[index], 1u);
+    color = ToneMapping::Apply(average, settings.tone_mapping, settings.srgb_output);
 
     // Set the pixel in the render buffer
-    uint8_t* pixel = buffer + (i + j * settings.width) * 3;
+    uint8_t* pixel = buffer + index * 3;
     pixel[0] = (uint8_t)( 255.0f * color[0]);
     pixel[1] = (uint8_t)( 255.0f * color[1]);
     pixel[2] = (uint8_t)( 255.0f * color[2]);
 }
 
 
-glm::vec3 RayTracer::SampleCamera(double x_corner, double y_corner, double pixel_size_x, double pixel_size_y, Camera* debug_camera)
+void RayTracer::ComputePreview(const Tile& tile)
+{
+    for (unsigned int by = tile.y; by < tile.max_y && !cancelling; by += PREVIEW_BLOCK_SIZE) {
+        for (unsigned int bx = tile.x; bx < tile.max_x && !cancelling; bx += PREVIEW_BLOCK_SIZE) {
+            unsigned int max_x = std::min(bx + PREVIEW_BLOCK_SIZE, tile.max_x);
+            unsigned int max_y = std::min(by + PREVIEW_BLOCK_SIZE, tile.max_y);
+            glm::vec3 color = SampleCamera(bx * settings.pixel_size_x, by * settings.pixel_size_y,
+                                           (max_x - bx) * settings.pixel_size_x, (max_y - by) * settings.pixel_size_y);
+            color = ToneMapping::Apply(color, settings.tone_mapping, settings.srgb_output);
+
+            for (unsigned int y = by; y < max_y; y++) {
+                for (unsigned int x = bx; x < max_x; x++) {
+                    uint8_t* pixel = buffer + (x + y * settings.width) * 3;
+                    pixel[0] = (uint8_t)( 255.0f * color[0]);
+                    pixel[1] = (uint8_t)( 255.0f * color[1]);
+                    pixel[2] = (uint8_t)( 255.0f * color[2]);
+                }
+            }
+        }
+    }
+}
+
+glm::vec3 RayTracer::SampleConstant(double x_corner, double y_corner, Sampler* sampler, unsigned int& samples)
+{
+    // Regular grid of square sub-pixels, the sample count is always a power of 4
+    unsigned int side = (unsigned int)std::lround(std::sqrt((double)settings.constant_samples_per_pixel));
+    side = std::max(side, 1u);
+    double sub_x = settings.pixel_size_x / side;
+    double sub_y = settings.pixel_size_y / side;
+
+    glm::vec3 color(0,0,0);
+    if (settings.kernel == Camera::TRACEKERNEL_SIMD && side >= 2) {
+        // Generated in the same order as below so the sampler hands out the same samples,
+        // then traced in 2x2 packets of neighboring sub-pixels
+        std::vector<Ray> rays;
+        rays.reserve(side * side);
+        for (unsigned int sy = 0; sy < side; sy++) {
+            for (unsigned int sx = 0; sx < side; sx++) {
+                rays.push_back(GenerateCameraRay(x_corner + sx * sub_x, y_corner + sy * sub_y, sub_x, sub_y, sampler));
+            }
+        }
+        for (unsigned int sy = 0; sy < side; sy += 2) {
+            for (unsigned int sx = 0; sx < side; sx += 2) {
+                const Ray packet[4] = { rays[sx + sy * side], rays[sx + 1 + sy * side], rays[sx + (sy + 1) * side], rays[sx + 1 + (sy + 1) * side] };
+                Intersection isects[4];
+                trace_scene->IntersectPacket(packet, isects);
+                for (int k = 0; k < 4; k++) {
+                    color += TraceRay(packet[k], 0, RayType::camera, nullptr, &isects[k]);
+                }
+            }
+        }
+    } else {
+        for (unsigned int sy = 0; sy < side; sy++) {
+            for (unsigned int sx = 0; sx < side; sx++) {
+                color += SampleCamera(x_corner + sx * sub_x, y_corner + sy * sub_y, sub_x, sub_y, sampler);
+            }
+        }
+    }
+    samples += side * side;
+    return color / (float)(side * side);
+}
+
+bool RayTracer::FirstPassIsSmooth(int i, int j)
+{
+    if (first_pass_buffer == nullptr) {
+        return false;
+    }
+    glm::vec3 c = FirstPassColor(i, j);
+    const int offsets[4][2] = { {-1,0}, {1,0}, {0,-1}, {0,1} };
+    for (int n = 0; n < 4; n++) {
+        int x = i + offsets[n][0];
+        int y = j + offsets[n][1];
+        if (x < 0 || y < 0 || x >= (int)settings.width || y >= (int)settings.height) {
+            continue;
+        }
+        glm::vec3 d = FirstPassColor(x, y) - c;
+        if (glm::dot(d, d) > settings.adaptive_max_diff_squared) {
+            return false;
+        }
+    }
+    return true;
+}
+
+glm::vec3 RayTracer::SampleAdaptive(int i, int j, unsigned int& samples)
+{
+    double x = i * settings.pixel_size_x;
+    double y = j * settings.pixel_size_y;
+    double w = settings.pixel_size_x;
+    double h = settings.pixel_size_y;
+
+    // A single sample is allowed, so flat regions of the first pass keep their one center sample
+    if (settings.dynamic_sampling_min_depth == 0 && FirstPassIsSmooth(i, j)) {
+        samples += 1;
+        return SampleCamera(x, y, w, h);
+    }
+
+    glm::vec3 corners[4] = {
+        SampleCamera(x, y, 0, 0),
+        SampleCamera(x + w, y, 0, 0),
+        SampleCamera(x, y + h, 0, 0),
+        SampleCamera(x + w, y + h, 0, 0)
+    };
+    samples += 4;
+    return SampleQuad(x, y, w, h, corners, 0, samples);
+}
+
+glm::vec3 RayTracer::SampleQuad(double x, double y, double w, double h, const glm::vec3 corners[4], unsigned int depth, unsigned int& samples)
+{
+    // corners are ordered (x,y), (x+w,y), (x,y+h), (x+w,y+h)
+    bool split = depth < settings.dynamic_sampling_min_depth;
+    if (!split && depth < settings.dynamic_sampling_max_depth) {
+        for (int a = 0; a < 4 && !split; a++) {
+            for (int b = a + 1; b < 4; b++) {
+                glm::vec3 d = corners[a] - corners[b];
+                if (glm::dot(d, d) > settings.adaptive_max_diff_squared) {
+                    split = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (!split) {
+        return (corners[0] + corners[1] + corners[2] + corners[3]) * 0.25f;
+    }
+
+    // The center and edge midpoints are shared between the four sub-quads
+    double hw = w * 0.5;
+    double hh = h * 0.5;
+    glm::vec3 bottom = SampleCamera(x + hw, y, 0, 0);
+    glm::vec3 left = SampleCamera(x, y + hh, 0, 0);
+    glm::vec3 center = SampleCamera(x + hw, y + hh, 0, 0);
+    glm::vec3 right = SampleCamera(x + w, y + hh, 0, 0);
+    glm::vec3 top = SampleCamera(x + hw, y + h, 0, 0);
+    samples += 5;
+
+    const glm::vec3 q0[4] = { corners[0], bottom, left, center };
+    const glm::vec3 q1[4] = { bottom, corners[1], center, right };
+    const glm::vec3 q2[4] = { left, center, corners[2], top };
+    const glm::vec3 q3[4] = { center, right, top, corners[3] };
+
+    glm::vec3 color = SampleQuad(x, y, hw, hh, q0, depth + 1, samples);
+    color += SampleQuad(x + hw, y, hw, hh, q1, depth + 1, samples);
+    color += SampleQuad(x, y + hh, hw, hh, q2, depth + 1, samples);
+    color += SampleQuad(x + hw, y + hh, hw, hh, q3, depth + 1, samples);
+    return color * 0.25f;
+}
+
+glm::vec3 RayTracer::SampleStdError(int i, int j, Sampler* sampler, unsigned int& samples)
+{
+    double x_corner = i * settings.pixel_size_x;
+    double y_corner = j * settings.pixel_size_y;
+
+    if (settings.dynamic_sampling_min_depth == 0 && FirstPassIsSmooth(i, j)) {
+        samples += 1;
+        return SampleCamera(x_corner, y_corner, settings.pixel_size_x, settings.pixel_size_y, sampler);
+    }
+
+    // Each round samples a finer sub-pixel grid, the mean and variance run over every sample taken so far
+    glm::dvec3 mean(0,0,0);
+    glm::dvec3 m2(0,0,0);
+    unsigned int n = 0;
+    const unsigned int max_samples = pow4(settings.dynamic_sampling_max_depth);
+
+    for (unsigned int depth = settings.dynamic_sampling_min_depth; depth <= settings.dynamic_sampling_max_depth && n < max_samples; depth++) {
+        unsigned int side = 1u << depth;
+        double sub_x = settings.pixel_size_x / side;
+        double sub_y = settings.pixel_size_y / side;
+        // The earlier rounds leave less than a full grid under the cap, so the last one takes cells spread evenly over it
+        unsigned int cells = side * side;
+        unsigned int round = std::min(cells, max_samples - n);
+        for (unsigned int k = 0; k < round; k++) {
+            unsigned int cell = (unsigned int)((uint64_t)k * cells / round);
+            unsigned int sx = cell % side;
+            unsigned int sy = cell / side;
+            glm::dvec3 c = SampleCamera(x_corner + sx * sub_x, y_corner + sy * sub_y, sub_x, sub_y, sampler);
+            n++;
+            glm::dvec3 delta = c - mean;
+            mean += delta / (double)n;
+            m2 += delta * (c - mean);
+        }
+
+        if (n >= 2) {
+            glm::dvec3 std_error = glm::sqrt(m2 / (double)((n - 1) * n));
+            if (std::max(std_error.x, std::max(std_error.y, std_error.z)) <= settings.max_stderr) {
+                break;
+            }
+        }
+    }
+
+    samples += n;
+    return glm::vec3(mean);
+}
+
+std::vector<uint8_t> RayTracer::GetSampleHeatmap() const
+{
+    const unsigned int count = settings.width * settings.height;
+    uint32_t max_samples = 1;
+    for (unsigned int p = 0; p < count; p++) {
+        max_samples = std::max(max_samples, sample_count_buffer[p]);
+    }
+
+    std::vector<uint8_t> heatmap(count * 3, 0);
+    float scale = max_samples > 1 ? 1.0f / std::log2((float)max_samples) : 0.0f;
+    for (unsigned int p = 0; p < count; p++) {
+        if (sample_count_buffer[p] == 0) {
+            continue;
+        }
+        float v = std::log2((float)sample_count_buffer[p]) * scale;
+        glm::vec3 c = glm::clamp(glm::vec3(2.0f * v - 1.0f, 1.0f - std::abs(2.0f * v - 1.0f), 1.0f - 2.0f * v), 0.0f, 1.0f);
+        heatmap[3*p] = (uint8_t)(255.0f * c.r);
+        heatmap[3*p+1] = (uint8_t)(255.0f * c.g);
+        heatmap[3*p+2] = (uint8_t)(255.0f * c.b);
+    }
+    return heatmap;
+}
+
+glm::vec3 RayTracer::SampleCamera(double x_corner, double y_corner, double pixel_size_x, double pixel_size_y, Sampler* sampler, Camera* debug_camera)
 {
-    double x = x_corner + pixel_size_x * 0.5;
-    double y = y_corner + pixel_size_y * 0.5;
+    return TraceRay(GenerateCameraRay(x_corner, y_corner, pixel_size_x, pixel_size_y, sampler), 0, RayType::camera, debug_camera);
+}
+
+Ray RayTracer::GenerateCameraRay(double x_corner, double y_corner, double pixel_size_x, double pixel_size_y, Sampler* sampler)
+{
+    glm::vec2 pixel_sample(0.5f, 0.5f);
+    glm::vec2 sample(0.0f, 0.0f);
+    if (sampler) {
+        sampler->StartNextSample();
+        pixel_sample = sampler->Get2D();
+        sample = sampler->Get2D();
+    }
+
+    double x = x_corner + pixel_size_x * pixel_sample.x;
+    double y = y_corner + pixel_size_y * pixel_sample.y;
 
     glm::dvec3 point_on_focus_plane = settings.projection_origin + settings.projection_forward + (2.0*x-1.0)*settings.projection_right + (2.0*y-1.0)*settings.projection_up;
 
-    glm::vec2 sample = glm::dvec2(0,0);
-    double angle = sample.x;
+    // Uniform point on the aperture disk
+    double angle = 2.0 * M_PI * sample.x;
     double radius = sqrt(sample.y);
 
     glm::dvec3 origin = settings.projection_origin + radius * (sin(angle) * settings.aperture_up + cos(angle) * settings.aperture_right);
 
     glm::dvec3 dir = glm::normalize(point_on_focus_plane - origin);
 
-    Ray camera_ray(origin, dir);
-
-    return TraceRay(camera_ray, 0, RayType::camera, debug_camera);
+    return Ray(origin, dir);
 }
 
 // Do recursive ray tracing!  You'll want to insert a lot of code here
 // (or places called from here) to handle reflection, refraction, etc etc.
 // Depth is the number of times the ray has intersected an object.
-glm::vec3 RayTracer::TraceRay(const Ray& r, int depth, RayType ray_type, Camera* debug_camera)
+glm::vec3 RayTracer::TraceRay(const Ray& r, int depth, RayType ray_type, Camera* debug_camera, const Intersection* first_hit)
 {
     Intersection i;
 
     if (debug_camera) {
         glm::dvec3 endpoint = r.at(1000);
-        if (trace_scene.Intersect(r, i)) {
+        if (trace_scene->Intersect(r, i)) {
             endpoint = r.at(i.t);
             debug_camera->AddDebugRay(endpoint, endpoint+0.25*(glm::dvec3)i.normal, RayType::hit_normal);
         }
         debug_camera->AddDebugRay(r.position, endpoint, ray_type);
     }
 
-    if (trace_scene.Intersect(r, i)) {     
+    bool hit;
+    if (first_hit) {
+        i = *first_hit;
+        hit = i.t > 0;
+    } else {
+        hit = trace_scene->Intersect(r, i);
+    }
+
+    if (hit) {
         // TRACE: Implement Raytracing
         // You must implement (see project page for details)
         // 1. Blinn-Phong specular model
@@ -257,7 +646,7 @@ glm::vec3 RayTracer::TraceRay(const Ray& r, int depth, RayType ray_type, Camera*
         // add in contributions from reflected and refracted rays.
 
         // To iterate over all light sources in the scene, use code like this:
-        // for (auto j = trace_scene.lights.begin(); j != trace_scene.lights.end(); j++) {
+        // for (auto j = trace_scene->lights.begin(); j != trace_scene->lights.end(); j++) {
         //   TraceLight* trace_light = *j;
         //   Light* scene_light = trace_light->light;
         // }
@@ -278,27 +667,35 @@ glm::vec3 RayTracer::TraceRay(const Ray& r, int depth, RayType ray_type, Camera*
 
 
 // Multi-Threading
-RTWorker::RTWorker(RayTracer &tracer_) :
-    tracer(tracer_) { }
+RTWorker::RTWorker(RayTracer &tracer_, unsigned int worker_index_, bool preview_) :
+    tracer(tracer_), worker_index(worker_index_), preview(preview_) { }
 
 void RTWorker::run() {
-    // Dimensions, in chunks
-    const unsigned int wc = (tracer.settings.width+THREAD_CHUNKSIZE-1)/THREAD_CHUNKSIZE;
-    const unsigned int hc = (tracer.settings.height+THREAD_CHUNKSIZE-1)/THREAD_CHUNKSIZE;
+    TileScheduler& scheduler = tracer.scheduler;
+    // One sampler for all the worker's pixels, ComputePixel restarts it on each
+    std::unique_ptr<Sampler> sampler = Sampler::Create(tracer.settings.random_mode, tracer.settings.expected_samples_per_pixel);
 
-    unsigned int x, y;
     while (!tracer.cancelling) {
-        unsigned int idx = tracer.next_render_index.fetchAndAddRelaxed(1);
-        unsigned int x = (idx%wc)*THREAD_CHUNKSIZE;
-        unsigned int y = (idx/wc)*THREAD_CHUNKSIZE;
-        if (y >= tracer.settings.height) break;
-        unsigned int maxX = std::min(x + THREAD_CHUNKSIZE, tracer.settings.width);
-        unsigned int maxY = std::min(y + THREAD_CHUNKSIZE, tracer.settings.height);
-
-        for(unsigned int yy = y; yy < maxY && !tracer.cancelling; yy++) {
-            for(unsigned int xx = x; xx < maxX && !tracer.cancelling; xx++) {
-                tracer.ComputePixel(xx, yy);
+        unsigned int pass = scheduler.CurrentPass();
+        Tile tile;
+        if (!scheduler.Next(worker_index, tile)) {
+            if (!scheduler.AdvancePass(pass, tracer.cancelling)) {
+                break;
             }
+            continue;
+        }
+
+        if (preview) {
+            tracer.ComputePreview(tile);
+            scheduler.TileDone();
+            continue;
         }
+
+        for(unsigned int yy = tile.y; yy < tile.max_y && !tracer.cancelling; yy++) {
+            for(unsigned int xx = tile.x; xx < tile.max_x && !tracer.cancelling; xx++) {
+                tracer.ComputePixel(xx, yy, nullptr, sampler.get());
+            }
+        }
+        scheduler.TileDone();
     }
-}
\ No newline at end of file
+}
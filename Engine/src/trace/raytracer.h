@@ -11,14 +11,16 @@
 #define RAYTRACER_H
 
 #include "tracescene.h"
+#include "tilescheduler.h"
 
 #include <trace/ray.h>
 
 // Multi-Threading
-#define THREAD_CHUNKSIZE 16
+#define PREVIEW_BLOCK_SIZE 8
 #include <QThreadPool>
 #include <QRunnable>
 #include <QAtomicInt>
+#include <atomic>
 #include "randomsampler.h"
 
 class Scene;
@@ -42,7 +44,9 @@ class RayTracer {
         double pixel_size_y;
 
 
+        int kernel;
         int random_mode;
+        unsigned int expected_samples_per_pixel; // sizes the stratified sampler's grid
         bool diffuse_reflection;
         bool caustics;
         bool random_branching;
@@ -60,6 +64,10 @@ class RayTracer {
         bool reflections;
         bool refractions;
 
+        unsigned int progressive_passes;
+        int tone_mapping;
+        bool srgb_output;
+
 
         glm::dvec3 projection_origin;
         glm::dvec3 projection_forward; //length = focus distance
@@ -71,16 +79,30 @@ class RayTracer {
         float aperture_radius;
     };
     
-    RayTracer(Scene& scene, SceneObject& camera);
+    // Pass the TraceScene of the previous frame to update it instead of building a new one.
+    // Nothing runs until Start is called.
+    RayTracer(Scene& scene, SceneObject& camera, std::shared_ptr<TraceScene> previous_trace_scene=nullptr);
     ~RayTracer();
 
+    std::shared_ptr<TraceScene> GetTraceScene() { return trace_scene; }
+
     int GetProgress();
 
     double AspectRatio();
 
-    // computes+colors the pixel at this window coordinate
-    void ComputePixel(int i, int j, Camera* debug_camera=nullptr);
+    // computes+colors the pixel at this window coordinate. Workers pass their own sampler,
+    // which is restarted for the pixel, otherwise one is created just for this call.
+    void ComputePixel(int i, int j, Camera* debug_camera=nullptr, Sampler* sampler=nullptr);
+
+    // Traces the center of each PREVIEW_BLOCK_SIZE block of the tile and fills the whole block with it
+    void ComputePreview(const Tile& tile);
+
 
+    // Camera samples per pixel as RGB, blue for the fewest through red for the most (log scale)
+    std::vector<uint8_t> GetSampleHeatmap() const;
+
+    // Writes the averaged radiance as a little endian Portable Float Map, for regression diffing
+    bool SaveHDR(const std::string& filename) const;
 
     std::string GetErrorMessage() {
         std::string ret = errormsg_;
@@ -91,17 +113,57 @@ class RayTracer {
     RayTracerSettings settings;
     uint8_t* buffer;
     uint8_t* first_pass_buffer;
-
-    QAtomicInt next_render_index;
-    bool cancelling;
+    // Radiance summed over all camera samples and how many samples went into each pixel.
+    // buffer holds their tone mapped average.
+    float* hdr_buffer;
+    uint32_t* sample_count_buffer;
+
+    TileScheduler scheduler;
+    // Set from the GUI thread, read by the pipeline thread and the workers
+    std::atomic<bool> cancelling;
+
+    // Pipeline stages, in order. They are emitted from the tracer's pipeline thread,
+    // so slots must hand anything touching widgets or GL over to the GUI thread.
+    Signal0<> ScenePrepared;
+    Signal0<> PreviewFinished;
+    Signal1<unsigned int> PassFinished;
+    Signal0<> RenderFinished;
+
+    // True once the trace scene is built and rays can be traced, e.g. for the debugger
+    bool IsSceneReady() const { return scene_ready_.load() != 0; }
+
+    // Starts preparing the scene and rendering on other threads. The stage signals have no locking,
+    // so connect them all before calling this.
+    void Start();
+    // Stops the workers and waits for them, the partial image stays in the buffers
+    void Cancel();
+    // Cancels and clears the image, Start then renders it again from scratch with the current settings
+    void Restart();
+    // Worker count used from the next Restart on, 0 picks one less than the core count
+    void SetThreadCount(unsigned int num_threads);
+    unsigned int GetThreadCount() const { return num_threads_; }
 
 private:
+    unsigned int num_threads_;
+    QThreadPool pipeline_pool_;
+    QAtomicInt scene_ready_;
+    QAtomicInt finished_;
     int second_pass_sampling_mode;
     QThreadPool thread_pool;
-    TraceScene trace_scene;
+    std::shared_ptr<TraceScene> trace_scene;
     std::string errormsg_;
+    std::chrono::high_resolution_clock::time_point trace_start_;
+    bool reported_time_;
     Camera* debug_camera_used_ = nullptr;
 
+    // Prepares the trace scene, traces a coarse preview, the one sample first pass if the sampling mode needs it,
+    // and then every progressive pass, emitting the stage signals as it goes
+    void RunPipeline();
+    // Runs passes passes over the image on the workers and waits for them, emitting PassFinished for each if report_passes
+    void RunWorkers(unsigned int passes, bool preview, bool report_passes);
+
+    friend class RTPipeline;
+
     glm::vec3 FirstPassColor(int x, int y) {
         glm::vec3 c(first_pass_buffer[3*(x + y*settings.width)], first_pass_buffer[3*(x + y*settings.width)+1], first_pass_buffer[3*(x + y*settings.width)+2]);
         return c/255.0f;
@@ -109,18 +171,41 @@ private:
 
     // Recursively traces ray through the scene. Depth is used to end recursion.
     // Thresh is used to terminate ray tracing early if the ray contribution is too little.
-    glm::vec3 TraceRay(const Ray& r, int depth, RayType ray_type, Camera* debug_camera=nullptr);
-    glm::vec3 SampleCamera(double x_corner, double y_corner, double pixel_size_x, double pixel_size_y, Camera* debug_camera=nullptr);
+    // A known first_hit (t <= 0 for a miss) skips intersecting the ray, e.g. when it was traced in a packet.
+    glm::vec3 TraceRay(const Ray& r, int depth, RayType ray_type, Camera* debug_camera=nullptr, const Intersection* first_hit=nullptr);
+    // Traces one camera ray through the given region of the image plane. Without a sampler
+    // the ray goes through the region's center and the aperture's center.
+    glm::vec3 SampleCamera(double x_corner, double y_corner, double pixel_size_x, double pixel_size_y, Sampler* sampler=nullptr, Camera* debug_camera=nullptr);
+    Ray GenerateCameraRay(double x_corner, double y_corner, double pixel_size_x, double pixel_size_y, Sampler* sampler);
+
+    // Supersampling strategies for ComputePixel, each adds the camera samples it took to samples
+    glm::vec3 SampleConstant(double x_corner, double y_corner, Sampler* sampler, unsigned int& samples);
+    glm::vec3 SampleAdaptive(int i, int j, unsigned int& samples);
+    glm::vec3 SampleQuad(double x, double y, double w, double h, const glm::vec3 corners[4], unsigned int depth, unsigned int& samples);
+    glm::vec3 SampleStdError(int i, int j, Sampler* sampler, unsigned int& samples);
+    // True if the one sample first pass found this pixel close to its neighbors
+    bool FirstPassIsSmooth(int i, int j);
 };
 
 // Worker thread for raytracing
 class RTWorker : public QObject, public QRunnable {
     Q_OBJECT
   public:
-    RTWorker(RayTracer& tracer_);
+    RTWorker(RayTracer& tracer_, unsigned int worker_index_, bool preview_);
     virtual void run() override;
   private:
     RayTracer& tracer;
+    unsigned int worker_index;
+    bool preview;
+};
+
+// Runs the ray tracer's setup and render stages off the calling thread
+class RTPipeline : public QRunnable {
+  public:
+    RTPipeline(RayTracer& tracer_) : tracer(tracer_) { }
+    virtual void run() override { tracer.RunPipeline(); }
+  private:
+    RayTracer& tracer;
 };
 
 #endif // RAYTRACER_H
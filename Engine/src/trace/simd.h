@@ -0,0 +1,72 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cstdint>
+#include <algorithm>
+
+// Four floats processed together, with SSE when the compiler targets it and plain loops otherwise.
+// Only what the BVH traversal kernels need.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define TRACE_SIMD_SSE 1
+    #include <emmintrin.h>
+#else
+    #define TRACE_SIMD_SSE 0
+#endif
+
+// Factor to widen float slab test intervals by so rounding never culls a box that a ray touches
+// (1 + 2 * gamma(3) from Ize, "Robust BVH Ray Traversal")
+const float SIMD_ROBUST_FACTOR = 1.0000004f;
+
+#if TRACE_SIMD_SSE
+
+struct float4 {
+    __m128 v;
+
+    float4() {}
+    float4(__m128 v_) : v(v_) {}
+    explicit float4(float f) : v(_mm_set1_ps(f)) {}
+    float4(float a, float b, float c, float d) : v(_mm_setr_ps(a, b, c, d)) {}
+
+    static float4 Load(const float* p) { return float4(_mm_loadu_ps(p)); }
+    void Store(float* p) const { _mm_storeu_ps(p, v); }
+
+    float4 operator+(const float4& o) const { return float4(_mm_add_ps(v, o.v)); }
+    float4 operator-(const float4& o) const { return float4(_mm_sub_ps(v, o.v)); }
+    float4 operator*(const float4& o) const { return float4(_mm_mul_ps(v, o.v)); }
+};
+
+inline float4 Min(const float4& a, const float4& b) { return float4(_mm_min_ps(a.v, b.v)); }
+inline float4 Max(const float4& a, const float4& b) { return float4(_mm_max_ps(a.v, b.v)); }
+// Bit i of the result is set where a[i] <= b[i]
+inline int LessEqualMask(const float4& a, const float4& b) { return _mm_movemask_ps(_mm_cmple_ps(a.v, b.v)); }
+
+#else
+
+struct float4 {
+    float f[4];
+
+    float4() {}
+    explicit float4(float x) { f[0] = f[1] = f[2] = f[3] = x; }
+    float4(float a, float b, float c, float d) { f[0] = a; f[1] = b; f[2] = c; f[3] = d; }
+
+    static float4 Load(const float* p) { return float4(p[0], p[1], p[2], p[3]); }
+    void Store(float* p) const { std::copy(f, f + 4, p); }
+
+    float4 operator+(const float4& o) const { return float4(f[0] + o.f[0], f[1] + o.f[1], f[2] + o.f[2], f[3] + o.f[3]); }
+    float4 operator-(const float4& o) const { return float4(f[0] - o.f[0], f[1] - o.f[1], f[2] - o.f[2], f[3] - o.f[3]); }
+    float4 operator*(const float4& o) const { return float4(f[0] * o.f[0], f[1] * o.f[1], f[2] * o.f[2], f[3] * o.f[3]); }
+};
+
+inline float4 Min(const float4& a, const float4& b) {
+    return float4(std::min(a.f[0], b.f[0]), std::min(a.f[1], b.f[1]), std::min(a.f[2], b.f[2]), std::min(a.f[3], b.f[3]));
+}
+inline float4 Max(const float4& a, const float4& b) {
+    return float4(std::max(a.f[0], b.f[0]), std::max(a.f[1], b.f[1]), std::max(a.f[2], b.f[2]), std::max(a.f[3], b.f[3]));
+}
+inline int LessEqualMask(const float4& a, const float4& b) {
+    return (a.f[0] <= b.f[0] ? 1 : 0) | (a.f[1] <= b.f[1] ? 2 : 0) | (a.f[2] <= b.f[2] ? 4 : 0) | (a.f[3] <= b.f[3] ? 8 : 0);
+}
+
+#endif
+
+#endif // SIMD_H
@@ -0,0 +1,138 @@
+#include "tilescheduler.h"
+#include <QThread>
+#include <algorithm>
+
+TileScheduler::TileScheduler() :
+    tile_size_(TILE_MAX_SIZE), tile_count_(0), passes_(0), current_pass_(0), completed_tiles_(0)
+{
+}
+
+uint32_t TileScheduler::MortonCode(uint32_t x, uint32_t y) {
+    // Interleave the low 16 bits of x and y
+    auto spread = [](uint32_t v) {
+        v &= 0x0000ffffU;
+        v = (v | (v << 8)) & 0x00ff00ffU;
+        v = (v | (v << 4)) & 0x0f0f0f0fU;
+        v = (v | (v << 2)) & 0x33333333U;
+        v = (v | (v << 1)) & 0x55555555U;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1);
+}
+
+void TileScheduler::Reset(unsigned int width, unsigned int height, unsigned int num_workers, unsigned int passes) {
+    num_workers = std::max(num_workers, 1u);
+    // Zero tiles reads as no progress until the new counts are all in place
+    tile_count_.store(0);
+    completed_tiles_.store(0);
+
+    // Shrink tiles until there are enough of them to keep every worker busy to the end
+    tile_size_ = TILE_MAX_SIZE;
+    while (tile_size_ > TILE_MIN_SIZE) {
+        unsigned int count = ((width + tile_size_ - 1) / tile_size_) * ((height + tile_size_ - 1) / tile_size_);
+        if (count >= num_workers * TILES_PER_WORKER) {
+            break;
+        }
+        tile_size_ /= 2;
+    }
+
+    const unsigned int tiles_x = (width + tile_size_ - 1) / tile_size_;
+    const unsigned int tiles_y = (height + tile_size_ - 1) / tile_size_;
+
+    std::vector<std::pair<uint32_t, Tile>> ordered;
+    ordered.reserve(tiles_x * tiles_y);
+    for (unsigned int ty = 0; ty < tiles_y; ty++) {
+        for (unsigned int tx = 0; tx < tiles_x; tx++) {
+            Tile tile;
+            tile.x = tx * tile_size_;
+            tile.y = ty * tile_size_;
+            tile.max_x = std::min(tile.x + tile_size_, width);
+            tile.max_y = std::min(tile.y + tile_size_, height);
+            tile.pass = 0;
+            ordered.push_back(std::make_pair(MortonCode(tx, ty), tile));
+        }
+    }
+    std::sort(ordered.begin(), ordered.end(), [](const std::pair<uint32_t, Tile>& a, const std::pair<uint32_t, Tile>& b) {
+        return a.first < b.first;
+    });
+
+    tiles_.clear();
+    for (auto& entry : ordered) {
+        tiles_.push_back(entry.second);
+    }
+
+    queues_.clear();
+    for (unsigned int w = 0; w < num_workers; w++) {
+        queues_.emplace_back(new WorkerQueue());
+    }
+
+    current_pass_.store(0);
+    QueuePass(0);
+    passes_.store((int)std::max(passes, 1u));
+    tile_count_.store((int)tiles_.size());
+}
+
+void TileScheduler::QueuePass(unsigned int pass) {
+    // Contiguous runs of the curve, so each worker starts on its own compact region
+    const size_t count = tiles_.size();
+    const size_t workers = queues_.size();
+    for (size_t w = 0; w < workers; w++) {
+        QMutexLocker locker(&queues_[w]->lock);
+        queues_[w]->tiles.clear();
+        for (size_t t = (w * count) / workers; t < ((w + 1) * count) / workers; t++) {
+            tiles_[t].pass = pass;
+            queues_[w]->tiles.push_back((uint32_t)t);
+        }
+    }
+}
+
+bool TileScheduler::Next(unsigned int worker, Tile& tile) {
+    const size_t workers = queues_.size();
+    {
+        WorkerQueue& own = *queues_[worker % workers];
+        QMutexLocker locker(&own.lock);
+        if (!own.tiles.empty()) {
+            tile = tiles_[own.tiles.front()];
+            own.tiles.pop_front();
+            return true;
+        }
+    }
+
+    // Steal from the far end of the other queues, farthest from where their owner is working
+    for (size_t offset = 1; offset < workers; offset++) {
+        WorkerQueue& victim = *queues_[(worker + offset) % workers];
+        QMutexLocker locker(&victim.lock);
+        if (!victim.tiles.empty()) {
+            tile = tiles_[victim.tiles.back()];
+            victim.tiles.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void TileScheduler::TileDone() {
+    completed_tiles_.fetchAndAddOrdered(1);
+}
+
+bool TileScheduler::AdvancePass(unsigned int pass, const std::atomic<bool>& cancel) {
+    if (pass + 1 >= PassCount()) {
+        return false;
+    }
+
+    // Samples are numbered by pass, so a pixel may only start the next pass once the previous one is done everywhere
+    const unsigned int pass_end = (pass + 1) * TileCount();
+    while (CompletedTiles() < pass_end) {
+        if (cancel) {
+            return false;
+        }
+        QThread::msleep(1);
+    }
+
+    QMutexLocker locker(&pass_lock_);
+    if ((unsigned int)current_pass_.load() == pass) {
+        QueuePass(pass + 1);
+        current_pass_.store(pass + 1);
+    }
+    return !cancel;
+}
@@ -0,0 +1,74 @@
+#ifndef TILESCHEDULER_H
+#define TILESCHEDULER_H
+
+#include <QMutex>
+#include <QAtomicInt>
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <cstdint>
+#include <atomic>
+
+// Tile edge lengths are powers of two between these, picked so each worker gets about TILES_PER_WORKER tiles
+#define TILE_MIN_SIZE 8
+#define TILE_MAX_SIZE 64
+#define TILES_PER_WORKER 16
+
+struct Tile {
+    unsigned int x;
+    unsigned int y;
+    unsigned int max_x;
+    unsigned int max_y;
+    unsigned int pass;
+};
+
+// Hands out image tiles to the ray tracer's workers, one pass at a time.
+// Tiles are ordered along a Morton curve and dealt in contiguous runs to per-worker deques.
+// A worker takes from the front of its own deque and, once that is empty, steals from the back of the others.
+class TileScheduler
+{
+public:
+    TileScheduler();
+
+    // Splits the image into tiles and queues the first of passes passes for num_workers workers
+    void Reset(unsigned int width, unsigned int height, unsigned int num_workers, unsigned int passes);
+
+    // Gets the next tile for worker. Returns false when the current pass has no tiles left to hand out.
+    bool Next(unsigned int worker, Tile& tile);
+    // Must be called after every tile from Next has been rendered
+    void TileDone();
+
+    // Called by a worker that ran out of tiles in pass. Waits until every tile of that pass is done and
+    // queues the next one. Returns false when pass was the last or cancel became true while waiting.
+    bool AdvancePass(unsigned int pass, const std::atomic<bool>& cancel);
+
+    // The counts are safe to read from any thread, e.g. for progress while Reset runs between stages
+    unsigned int TileCount() const { return (unsigned int)tile_count_.load(); }
+    unsigned int TileSize() const { return tile_size_; }
+    unsigned int PassCount() const { return (unsigned int)passes_.load(); }
+    unsigned int CurrentPass() const { return (unsigned int)current_pass_.load(); }
+    // Tiles finished over all passes
+    unsigned int CompletedTiles() const { return (unsigned int)completed_tiles_.load(); }
+    bool IsFinished() const { return CompletedTiles() >= TileCount() * PassCount(); }
+
+private:
+    struct WorkerQueue {
+        QMutex lock;
+        std::deque<uint32_t> tiles;
+    };
+
+    std::vector<Tile> tiles_;
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    unsigned int tile_size_;
+    QAtomicInt tile_count_;
+    QAtomicInt passes_;
+    QAtomicInt current_pass_;
+    QAtomicInt completed_tiles_;
+    QMutex pass_lock_;
+
+    void QueuePass(unsigned int pass);
+    static uint32_t MortonCode(uint32_t x, uint32_t y);
+};
+
+#endif // TILESCHEDULER_H
@@ -0,0 +1,47 @@
+#include "tonemapping.h"
+#include <scene/components/camera.h>
+
+glm::vec3 ToneMapping::Apply(glm::vec3 color, int tone_operator, bool srgb)
+{
+    color = glm::max(color, glm::vec3(0.0f));
+
+    switch (tone_operator) {
+        case Camera::TRACETONEMAP_REINHARD:
+            color = Reinhard(color);
+            break;
+        case Camera::TRACETONEMAP_ACES:
+            color = ACESFitted(color);
+            break;
+        default:
+            break;
+    }
+    color = glm::clamp(color, 0.0f, 1.0f);
+
+    if (srgb) {
+        color = glm::vec3(LinearToSRGB(color.r), LinearToSRGB(color.g), LinearToSRGB(color.b));
+    }
+    return color;
+}
+
+glm::vec3 ToneMapping::Reinhard(glm::vec3 color)
+{
+    return color / (glm::vec3(1.0f) + color);
+}
+
+glm::vec3 ToneMapping::ACESFitted(glm::vec3 color)
+{
+    const float a = 2.51f;
+    const float b = 0.03f;
+    const float c = 2.43f;
+    const float d = 0.59f;
+    const float e = 0.14f;
+    return (color * (a * color + b)) / (color * (c * color + d) + e);
+}
+
+float ToneMapping::LinearToSRGB(float c)
+{
+    if (c <= 0.0031308f) {
+        return 12.92f * c;
+    }
+    return 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+}
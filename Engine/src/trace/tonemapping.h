@@ -0,0 +1,18 @@
+#ifndef TONEMAPPING_H
+#define TONEMAPPING_H
+
+#include <vectors.h>
+
+// Turns the tracer's high dynamic range radiance into displayable [0,1] colors
+class ToneMapping {
+public:
+    // tone_operator is one of the Camera::TRACETONEMAP_* choices
+    static glm::vec3 Apply(glm::vec3 color, int tone_operator, bool srgb);
+
+    static glm::vec3 Reinhard(glm::vec3 color);
+    // Krzysztof Narkowicz's curve fit of the ACES filmic tonemapper
+    static glm::vec3 ACESFitted(glm::vec3 color);
+    static float LinearToSRGB(float c);
+};
+
+#endif // TONEMAPPING_H
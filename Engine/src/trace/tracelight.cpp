@@ -9,3 +9,10 @@ TraceLight::~TraceLight()
 {
 }
 
+void TraceLight::SetTransform(glm::mat4 transform_)
+{
+    transform = transform_;
+    inverse_transform = glm::inverse(transform_);
+    normals_transform = glm::transpose(glm::inverse(glm::mat3(transform_)));
+}
+
@@ -10,6 +10,8 @@ public:
     TraceLight(Light* light_, glm::mat4 transform_);
     ~TraceLight();
 
+    void SetTransform(glm::mat4 transform_);
+
     Light* light;
     glm::mat4 transform; //local2world
     glm::mat4 inverse_transform;
@@ -0,0 +1,243 @@
+#include "tracemesh.h"
+
+TraceMesh::TraceMesh(const MeshData& mesh) :
+    triangles(mesh.triangles)
+{
+    const std::vector<float>& mesh_positions = mesh.positions;
+    const std::vector<float>& mesh_normals = mesh.normals;
+    const std::vector<float>& mesh_uvs = mesh.UVs;
+
+    positions.resize(mesh_positions.size() / 3);
+    for (size_t v = 0; v < positions.size(); v++) {
+        positions[v] = glm::vec3(mesh_positions[3*v], mesh_positions[3*v+1], mesh_positions[3*v+2]);
+    }
+
+    if (mesh_normals.size() == mesh_positions.size()) {
+        normals.resize(positions.size());
+        for (size_t v = 0; v < normals.size(); v++) {
+            normals[v] = glm::vec3(mesh_normals[3*v], mesh_normals[3*v+1], mesh_normals[3*v+2]);
+        }
+    }
+
+    if (mesh_uvs.size() / 2 == positions.size()) {
+        uvs.resize(positions.size());
+        for (size_t v = 0; v < uvs.size(); v++) {
+            uvs[v] = glm::vec2(mesh_uvs[2*v], mesh_uvs[2*v+1]);
+        }
+    }
+
+    std::vector<BoundingBox> bounds(GetTriangleCount());
+    for (size_t f = 0; f < bounds.size(); f++) {
+        const glm::vec3& a = positions[triangles[3*f]];
+        const glm::vec3& b = positions[triangles[3*f+1]];
+        const glm::vec3& c = positions[triangles[3*f+2]];
+        bounds[f] = BoundingBox(glm::min(a, glm::min(b, c)), glm::max(a, glm::max(b, c)));
+    }
+    bvh_.Build(bounds);
+    bvh4_.Build(bvh_);
+}
+
+bool TraceMesh::Intersect(const Ray &r, Intersection &i) const
+{
+    return bvh_.Intersect(r, i, [this](uint32_t face, const Ray& r, Intersection& i) {
+        return IntersectTriangle(face, r, i);
+    });
+}
+
+bool TraceMesh::IntersectSIMD(const Ray &r, Intersection &i) const
+{
+    WatertightRay wr(r);
+    return bvh4_.Intersect(r, i, [this, &wr](uint32_t face, const Ray&, Intersection& i) {
+        return IntersectTriangleWatertight(face, wr, i);
+    });
+}
+
+glm::vec3 TraceMesh::GetFaceNormal(uint32_t face) const
+{
+    const glm::vec3& a = positions[triangles[3*face]];
+    const glm::vec3& b = positions[triangles[3*face+1]];
+    const glm::vec3& c = positions[triangles[3*face+2]];
+    return glm::normalize(glm::cross(b - a, c - a));
+}
+
+// Moller-Trumbore ray/triangle intersection
+// The ray direction doesn't have to be normalized, t is in units of its length
+bool TraceMesh::IntersectTriangle(uint32_t face, const Ray &r, Intersection &i) const
+{
+    unsigned int ia = triangles[3*face];
+    unsigned int ib = triangles[3*face+1];
+    unsigned int ic = triangles[3*face+2];
+
+    glm::dvec3 a = positions[ia];
+    glm::dvec3 ab = glm::dvec3(positions[ib]) - a;
+    glm::dvec3 ac = glm::dvec3(positions[ic]) - a;
+
+    glm::dvec3 p = glm::cross(r.direction, ac);
+    double det = glm::dot(ab, p);
+    if (fabs(det) < EDGE_EPSILON) {
+        return false;
+    }
+    double inv_det = 1.0 / det;
+
+    glm::dvec3 s = r.position - a;
+    double u = glm::dot(s, p) * inv_det;
+    if (u < 0.0 || u > 1.0) {
+        return false;
+    }
+
+    glm::dvec3 q = glm::cross(s, ab);
+    double v = glm::dot(r.direction, q) * inv_det;
+    if (v < 0.0 || u + v > 1.0) {
+        return false;
+    }
+
+    double t = glm::dot(ac, q) * inv_det;
+    if (t < RAY_EPSILON) {
+        return false;
+    }
+
+    i.t = t;
+    FillHit(face, (float)(1.0 - u - v), (float)u, (float)v, i);
+    return true;
+}
+
+TraceMesh::WatertightRay::WatertightRay(const Ray& r)
+{
+    // Permute so z is the largest direction component, swapping x and y to keep the winding
+    glm::dvec3 abs_dir = glm::abs(r.direction);
+    kz = abs_dir.x > abs_dir.y ? (abs_dir.x > abs_dir.z ? 0 : 2) : (abs_dir.y > abs_dir.z ? 1 : 2);
+    kx = (kz + 1) % 3;
+    ky = (kx + 1) % 3;
+    if (r.direction[kz] < 0) {
+        std::swap(kx, ky);
+    }
+    sx = (float)(r.direction[kx] / r.direction[kz]);
+    sy = (float)(r.direction[ky] / r.direction[kz]);
+    sz = (float)(1.0 / r.direction[kz]);
+    origin = glm::vec3(r.position);
+}
+
+// Woop, Benthin and Wald, "Watertight Ray/Triangle Intersection"
+// Rays through a shared edge or vertex always hit one of the triangles, unlike with epsilon based tests
+bool TraceMesh::IntersectTriangleWatertight(uint32_t face, const WatertightRay& r, Intersection& i) const
+{
+    const glm::vec3 a = positions[triangles[3*face]] - r.origin;
+    const glm::vec3 b = positions[triangles[3*face+1]] - r.origin;
+    const glm::vec3 c = positions[triangles[3*face+2]] - r.origin;
+
+    // Shear so the ray runs along +z
+    const float ax = a[r.kx] - r.sx * a[r.kz];
+    const float ay = a[r.ky] - r.sy * a[r.kz];
+    const float bx = b[r.kx] - r.sx * b[r.kz];
+    const float by = b[r.ky] - r.sy * b[r.kz];
+    const float cx = c[r.kx] - r.sx * c[r.kz];
+    const float cy = c[r.ky] - r.sy * c[r.kz];
+
+    // Scaled barycentrics, redone in double when an edge passes exactly through the ray
+    float u = cx * by - cy * bx;
+    float v = ax * cy - ay * cx;
+    float w = bx * ay - by * ax;
+    if (u == 0.f || v == 0.f || w == 0.f) {
+        u = (float)((double)cx * by - (double)cy * bx);
+        v = (float)((double)ax * cy - (double)ay * cx);
+        w = (float)((double)bx * ay - (double)by * ax);
+    }
+
+    if ((u < 0.f || v < 0.f || w < 0.f) && (u > 0.f || v > 0.f || w > 0.f)) {
+        return false;
+    }
+    const float det = u + v + w;
+    if (det == 0.f) {
+        return false;
+    }
+
+    // Hit distance, still scaled by det so the range test needs no division
+    const float az = r.sz * a[r.kz];
+    const float bz = r.sz * b[r.kz];
+    const float cz = r.sz * c[r.kz];
+    const float t_scaled = u * az + v * bz + w * cz;
+    if ((det < 0.f && t_scaled > (float)RAY_EPSILON * det) || (det > 0.f && t_scaled < (float)RAY_EPSILON * det)) {
+        return false;
+    }
+
+    const float inv_det = 1.f / det;
+    i.t = t_scaled * inv_det;
+    FillHit(face, u * inv_det, v * inv_det, w * inv_det, i);
+    return true;
+}
+
+void TraceMesh::FillHit(uint32_t face, float b0, float b1, float b2, Intersection& i) const
+{
+    unsigned int ia = triangles[3*face];
+    unsigned int ib = triangles[3*face+1];
+    unsigned int ic = triangles[3*face+2];
+
+    i.face = face;
+
+    if (!normals.empty()) {
+        i.normal = glm::normalize(b0 * normals[ia] + b1 * normals[ib] + b2 * normals[ic]);
+    } else {
+        i.normal = GetFaceNormal(face);
+    }
+
+    if (!uvs.empty()) {
+        i.uv = b0 * uvs[ia] + b1 * uvs[ib] + b2 * uvs[ic];
+    } else {
+        i.uv = glm::vec2(0,0);
+    }
+}
+
+
+TraceMeshInstance::TraceMeshInstance(std::shared_ptr<TraceMesh> mesh_, Material* material_, glm::mat4 transform_) :
+    mesh(mesh_), material(material_), use_simd(false)
+{
+    world_bbox = nullptr;
+    SetTransform(transform_);
+}
+
+void TraceMeshInstance::SetTransform(glm::mat4 transform_)
+{
+    identity_transform = transform_ == glm::mat4();
+    transform = transform_;
+    inverse_transform = glm::inverse(transform_);
+    normals_transform = glm::transpose(glm::inverse(glm::mat3(transform_)));
+    if (world_bbox) {
+        delete world_bbox;
+    }
+    world_bbox = mesh->IsEmpty() ? nullptr : mesh->GetBounds().GetWorldBoundingBox(transform);
+}
+
+TraceMeshInstance::~TraceMeshInstance()
+{
+    if (world_bbox) {
+        delete world_bbox;
+    }
+}
+
+bool TraceMeshInstance::Intersect(const Ray &r, Intersection &i)
+{
+    if (identity_transform) {
+        if (use_simd ? mesh->IntersectSIMD(r, i) : mesh->Intersect(r, i)) {
+            i.obj = this;
+            return true;
+        }
+        return false;
+    }
+
+    // Leave the local direction unnormalized so t stays the same in both spaces
+    glm::dvec3 pos = glm::dvec3(inverse_transform * glm::dvec4(r.position, 1));
+    glm::dvec3 dir = glm::dvec3(inverse_transform * glm::dvec4(r.direction, 0));
+    Ray local_ray(pos, dir);
+
+    if (use_simd ? mesh->IntersectSIMD(local_ray, i) : mesh->Intersect(local_ray, i)) {
+        i.normal = glm::normalize(normals_transform * i.normal);
+        i.obj = this;
+        return true;
+    }
+    return false;
+}
+
+glm::vec3 TraceMeshInstance::GetFaceNormal(uint32_t face) const
+{
+    return glm::normalize(normals_transform * mesh->GetFaceNormal(face));
+}
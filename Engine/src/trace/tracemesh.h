@@ -0,0 +1,79 @@
+#ifndef TRACEMESH_H
+#define TRACEMESH_H
+
+#include "tracesceneobject.h"
+#include "bvh.h"
+#include "bvh4.h"
+
+#include <resource/mesh.h>
+
+// The triangles of a Mesh in its own local space, built once and shared by every object using it.
+// Vertices are kept in flat arrays, and the triangles are found through a BVH whose leaves
+// reference them by index.
+class TraceMesh
+{
+public:
+    // Only the positions, normals, UVs and triangles are used
+    TraceMesh(const MeshData& mesh);
+
+    // Fills in t, normal, uv and face of the closest hit, in local space
+    bool Intersect(const Ray& r, Intersection& i) const;
+    // Same, through the four wide BVH and the single precision watertight triangle test
+    bool IntersectSIMD(const Ray& r, Intersection& i) const;
+
+    // Plane normal of the given triangle, in local space
+    glm::vec3 GetFaceNormal(uint32_t face) const;
+
+    BoundingBox GetBounds() const { return bvh_.GetBounds(); }
+    bool IsEmpty() const { return bvh_.IsEmpty(); }
+    size_t GetTriangleCount() const { return triangles.size() / 3; }
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> uvs;
+    std::vector<unsigned int> triangles;
+
+private:
+    BVH bvh_;
+    BVH4 bvh4_;
+
+    // Ray transformed so its direction is the +z axis after shearing, set up once per ray
+    struct WatertightRay {
+        int kx, ky, kz;
+        float sx, sy, sz;
+        glm::vec3 origin;
+        WatertightRay(const Ray& r);
+    };
+
+    bool IntersectTriangle(uint32_t face, const Ray& r, Intersection& i) const;
+    bool IntersectTriangleWatertight(uint32_t face, const WatertightRay& r, Intersection& i) const;
+    // Fills in everything but t from barycentric weights of the triangle's first, second and third vertex
+    void FillHit(uint32_t face, float b0, float b1, float b2, Intersection& i) const;
+};
+
+// One placement of a shared TraceMesh in the scene.
+// Rays only get transformed into the mesh's space once the top level BVH found they enter its bounds.
+class TraceMeshInstance : public TraceSceneObject
+{
+public:
+    TraceMeshInstance(std::shared_ptr<TraceMesh> mesh_, Material* material_, glm::mat4 transform_);
+    ~TraceMeshInstance();
+
+    virtual bool Intersect(const Ray&r, Intersection&i);
+
+    // Moves the instance and recomputes its world bounds
+    void SetTransform(glm::mat4 transform_);
+
+    // Plane normal of the given triangle, in world space
+    glm::vec3 GetFaceNormal(uint32_t face) const;
+
+    std::shared_ptr<TraceMesh> mesh;
+    Material* material;
+    bool identity_transform;
+    bool use_simd; // Intersect with TraceMesh::IntersectSIMD, chosen by the TraceScene's kernel
+    glm::mat4 transform; //local2world
+    glm::mat4 inverse_transform;
+    glm::mat3 normals_transform; //local2world
+};
+
+#endif // TRACEMESH_H
@@ -1,13 +1,225 @@
 #include "tracescene.h"
+#include "tracemesh.h"
 
 #include <scene/scene.h>
 #include <scene/sceneobject.h>
+#include <QThreadPool>
+#include <scene/components/camera.h>
 
-#include <scene/components/triangleface.h>
+TraceScene::TraceScene() :
+    kernel(Camera::TRACEKERNEL_SCALAR), last_update_rebuilt(false), last_update_ms(0.0), use_acceleration_(false),
+    pending_use_acceleration_(false), has_pending_snapshot_(false), pending_kernel_(Camera::TRACEKERNEL_SCALAR)
+{
+}
+
+TraceScene::TraceScene(Scene *scene, bool use_acceleration) :
+    TraceScene()
+{
+    auto build_start = std::chrono::high_resolution_clock::now();
+
+    std::vector<SourceRecord> sources;
+    CollectSources(scene, sources);
+    Build(sources, use_acceleration);
+    ApplyKernel();
+
+    std::chrono::duration<double, std::milli> build_time = std::chrono::high_resolution_clock::now() - build_start;
+    last_update_rebuilt = true;
+    last_update_ms = build_time.count();
+}
+
+TraceScene::~TraceScene()
+{
+    Clear();
+}
+
+void TraceScene::Clear()
+{
+    for (auto obj : bounded_objects) {
+        delete obj;
+    }
+    for (auto obj : unbounded_objects) {
+        delete obj;
+    }
+    for (auto light : lights) {
+        delete light;
+    }
+    bounded_objects.clear();
+    unbounded_objects.clear();
+    lights.clear();
+    sources_.clear();
+}
+
+void TraceScene::Update(Scene *scene, bool use_acceleration)
+{
+    Snapshot(scene, use_acceleration);
+    Prepare();
+}
+
+void TraceScene::Snapshot(Scene *scene, bool use_acceleration)
+{
+    pending_sources_.clear();
+    CollectSources(scene, pending_sources_);
+    pending_use_acceleration_ = use_acceleration;
+    has_pending_snapshot_ = true;
+}
+
+void TraceScene::Prepare()
+{
+    if (!has_pending_snapshot_) {
+        return;
+    }
+    has_pending_snapshot_ = false;
 
-TraceScene::TraceScene(Scene *scene, bool use_acceleration)
+    auto update_start = std::chrono::high_resolution_clock::now();
+
+    std::vector<SourceRecord> sources;
+    std::swap(sources, pending_sources_);
+    bool use_acceleration = pending_use_acceleration_;
+
+    bool same_structure = use_acceleration == use_acceleration_ && sources.size() == sources_.size();
+    for (size_t s = 0; same_structure && s < sources.size(); s++) {
+        same_structure = sources[s].SameStructure(sources_[s]);
+    }
+
+    if (!same_structure) {
+        Clear();
+        Build(sources, use_acceleration);
+        last_update_rebuilt = true;
+    } else {
+        bool moved = false;
+        for (size_t s = 0; s < sources.size(); s++) {
+            SourceRecord& record = sources_[s];
+            const SourceRecord& snapshot = sources[s];
+            bool transform_changed = snapshot.model_matrix != record.model_matrix;
+            bool bounds_changed = snapshot.has_local_bounds &&
+                                  (snapshot.local_bounds.min != record.local_bounds.min || snapshot.local_bounds.max != record.local_bounds.max);
+            bool flare_changed = snapshot.flare_radius != record.flare_radius;
+            if (!transform_changed && !bounds_changed && !flare_changed) {
+                continue;
+            }
+            moved = true;
+            record.model_matrix = snapshot.model_matrix;
+            record.local_bounds = snapshot.local_bounds;
+            record.flare_radius = snapshot.flare_radius;
+            if (TraceGeometry* trace_geometry = dynamic_cast<TraceGeometry*>(record.trace_object)) {
+                trace_geometry->SetTransform(record.model_matrix, record.has_local_bounds ? &record.local_bounds : nullptr);
+            } else if (TraceMeshInstance* instance = dynamic_cast<TraceMeshInstance*>(record.trace_object)) {
+                instance->SetTransform(record.model_matrix);
+            }
+            if (record.trace_light) {
+                record.trace_light->SetTransform(record.model_matrix);
+            }
+            if (record.trace_flare) {
+                record.trace_flare->UpdateFromLight(record.flare_radius);
+            }
+        }
+
+        uses_blinn_phong_ambient = false;
+        for (auto trace_light : lights) {
+            if (glm::length2(trace_light->light->Ambient.GetRGB()) > 0.f) {
+                uses_blinn_phong_ambient = true;
+            }
+        }
+
+        last_update_rebuilt = false;
+        if (moved && !bounded_objects.empty()) {
+            bvh.Refit(GetBoundedObjectBounds());
+            // Objects that moved far apart leave big overlapping nodes behind, so start over once the tree got bad enough
+            if (bvh.GetSAHCost() > TRACESCENE_REFIT_MAX_SAH_RATIO * bvh.GetBuildSAHCost()) {
+                bvh.Build(GetBoundedObjectBounds());
+                last_update_rebuilt = true;
+            }
+        }
+    }
+
+    ApplyKernel();
+
+    std::chrono::duration<double, std::milli> update_time = std::chrono::high_resolution_clock::now() - update_start;
+    last_update_ms = update_time.count();
+}
+
+void TraceScene::ApplyKernel()
 {
-    AddSceneObjects(&(scene->GetSceneRoot()), glm::mat4());
+    kernel = pending_kernel_;
+    bool use_simd = kernel == Camera::TRACEKERNEL_SIMD;
+    for (auto obj : bounded_objects) {
+        if (TraceMeshInstance* instance = dynamic_cast<TraceMeshInstance*>(obj)) {
+            instance->use_simd = use_simd;
+        }
+    }
+    for (auto obj : unbounded_objects) {
+        if (TraceMeshInstance* instance = dynamic_cast<TraceMeshInstance*>(obj)) {
+            instance->use_simd = use_simd;
+        }
+    }
+
+    // Cheap next to building the binary tree, so just redo it after every build or refit
+    if (use_simd) {
+        bvh4.Build(bvh);
+    } else {
+        bvh4 = BVH4();
+    }
+}
+
+void TraceScene::Build(std::vector<SourceRecord>& sources, bool use_acceleration)
+{
+    std::unordered_map<uint64_t, MeshCacheEntry> old_meshes;
+    std::swap(old_meshes, meshes);
+
+    uses_blinn_phong_ambient = false;
+
+    // Reuse unchanged meshes and build the new ones in parallel before making any instances
+    QThreadPool pool;
+    for (SourceRecord& record : sources) {
+        if (record.geometry == nullptr || record.custom_trace || meshes.count(record.mesh_uid) > 0) {
+            continue;
+        }
+        MeshCacheEntry& entry = meshes[record.mesh_uid];
+        auto old = old_meshes.find(record.mesh_uid);
+        if (old != old_meshes.end() && old->second.version == record.mesh_version) {
+            entry = old->second;
+        } else {
+            entry.version = record.mesh_version;
+            pool.start(new MeshBuildJob(record.mesh_data, entry));
+        }
+    }
+    pool.waitForDone(-1);
+
+    for (SourceRecord& record : sources) {
+        if (record.geometry != nullptr) {
+            if (record.custom_trace) {
+                TraceGeometry* tso = new TraceGeometry(record.geometry, record.model_matrix, record.has_local_bounds ? &record.local_bounds : nullptr);
+                record.trace_object = tso;
+                if (tso->world_bbox == nullptr) {
+                    unbounded_objects.push_back(tso);
+                } else {
+                    bounded_objects.push_back(tso);
+                }
+            } else {
+                MeshCacheEntry& entry = meshes[record.mesh_uid];
+                if (!entry.mesh->IsEmpty()) {
+                    TraceMeshInstance* instance = new TraceMeshInstance(entry.mesh, record.material, record.model_matrix);
+                    record.trace_object = instance;
+                    bounded_objects.push_back(instance);
+                }
+            }
+        }
+
+        if (record.light != nullptr) {
+            TraceLight* tso = new TraceLight(record.light, record.model_matrix);
+            record.trace_light = tso;
+            lights.push_back(tso);
+
+            if (glm::length2(record.light->Ambient.GetRGB()) > 0.f) {
+                uses_blinn_phong_ambient = true;
+            }
+
+            if (dynamic_cast<DirectionalLight*>(record.light) == nullptr) {
+                record.trace_flare = new TraceFlare(tso, record.flare_radius);
+                bounded_objects.push_back(record.trace_flare);
+            }
+        }
+    }
 
     if (!use_acceleration) {
         for (auto obj : bounded_objects) {
@@ -16,77 +228,111 @@ TraceScene::TraceScene(Scene *scene, bool use_acceleration)
         bounded_objects.clear();
     }
 
-    tree = new TreeBox(bounded_objects);
+    auto build_start = std::chrono::high_resolution_clock::now();
+    bvh.Build(GetBoundedObjectBounds());
+    std::chrono::duration<double, std::milli> build_time = std::chrono::high_resolution_clock::now() - build_start;
+
+    sources_ = sources;
+    use_acceleration_ = use_acceleration;
+
+    size_t triangle_count = 0;
+    for (auto& it : meshes) {
+        triangle_count += it.second.mesh->GetTriangleCount();
+    }
+    Debug::Log.WriteLine("Built BVH over " + std::to_string(bounded_objects.size()) + " objects (" + std::to_string(bvh.GetNodeCount()) + " nodes, " +
+                         std::to_string(meshes.size()) + " unique meshes, " + std::to_string(triangle_count) + " triangles) in " + std::to_string(build_time.count()) + " ms");
 }
 
-void TraceScene::AddSceneObjects(SceneObject* obj, glm::mat4 model_matrix) {
+void TraceScene::MeshBuildJob::run()
+{
+    entry_.mesh = std::make_shared<TraceMesh>(*mesh_);
+}
+
+std::vector<BoundingBox> TraceScene::GetBoundedObjectBounds() const
+{
+    std::vector<BoundingBox> bounds;
+    bounds.reserve(bounded_objects.size());
+    for (auto obj : bounded_objects) {
+        bounds.push_back(*(obj->world_bbox));
+    }
+    return bounds;
+}
+
+void TraceScene::CollectSources(Scene* scene, std::vector<SourceRecord>& out) {
+    std::unordered_map<uint64_t, MeshSnapshot> previous_meshes;
+    std::swap(previous_meshes, snapshot_meshes_);
+    CollectSources(&(scene->GetSceneRoot()), out, previous_meshes);
+}
+
+void TraceScene::CollectSources(SceneObject* obj, std::vector<SourceRecord>& out, const std::unordered_map<uint64_t, MeshSnapshot>& previous_meshes) {
     if (obj->IsInternal() || !obj->IsEnabled()) {
         return;
     }
 
-    model_matrix = model_matrix * obj->GetTransform().GetMatrix();
+    SourceRecord record;
+    record.uid = obj->GetUID();
+    record.model_matrix = obj->GetModelMatrix();
+    record.geometry = nullptr;
+    record.material = nullptr;
+    record.custom_trace = false;
+    record.mesh_uid = 0;
+    record.mesh_version = 0;
+    record.light = obj->GetComponent<Light>();
+    record.has_local_bounds = false;
+    record.flare_radius = 0.0;
+    if (PointLight* point_light = dynamic_cast<PointLight*>(record.light)) {
+        record.flare_radius = point_light->TraceRadius.Get();
+    }
+    record.trace_object = nullptr;
+    record.trace_light = nullptr;
+    record.trace_flare = nullptr;
 
     Geometry* geo = obj->GetComponent<Geometry>();
 
     if (geo != nullptr && geo->RenderMaterial.Get() != nullptr && geo->RenderMaterial.Get()->PrepareToTrace()) {
         if (geo->UseCustomTrace()) {
-            TraceGeometry* tso = new TraceGeometry(geo, model_matrix);
-            if (tso->world_bbox == nullptr) {
-                unbounded_objects.push_back(tso);
-            } else {
-                bounded_objects.push_back(tso);
+            record.geometry = geo;
+            record.material = geo->RenderMaterial.Get();
+            record.custom_trace = true;
+            record.has_local_bounds = geo->HasBoundingBox();
+            if (record.has_local_bounds) {
+                std::unique_ptr<BoundingBox> local_bounds(geo->GetLocalBoundingBox());
+                record.local_bounds = *local_bounds;
             }
         } else {
             Mesh* mesh = geo->GetRenderMesh();
             if (mesh != nullptr) {
+                record.geometry = geo;
+                record.material = geo->RenderMaterial.Get();
+                record.mesh_uid = mesh->GetUID();
+                record.mesh_version = mesh->GetVersion();
 
-                glm::mat4 world2local = glm::inverse(model_matrix);
-                glm::mat3 normallocal2world = glm::transpose(glm::mat3(world2local));
-
-                std::vector<unsigned int> tris = mesh->GetTriangles();
-                std::vector<float> positions = mesh->GetPositions();
-                std::vector<float> uvs = mesh->GetUVs();
-                std::vector<float> normals = mesh->GetNormals();
-
-                for (size_t i=0; i<tris.size(); i+=3) {
-                    //cringe
-                    Geometry* tgeo = new TriangleFace(
-                            glm::vec3(model_matrix*glm::vec4(positions[tris[i]*3],positions[tris[i]*3+1],positions[tris[i]*3+2],1)),
-                            glm::vec3(model_matrix*glm::vec4(positions[tris[i+1]*3],positions[tris[i+1]*3+1],positions[tris[i+1]*3+2],1)),
-                            glm::vec3(model_matrix*glm::vec4(positions[tris[i+2]*3],positions[tris[i+2]*3+1],positions[tris[i+2]*3+2],1)),
-                            normals.size()>0 ? normallocal2world*glm::vec3(normals[tris[i]*3],normals[tris[i]*3+1],normals[tris[i]*3+2]) : glm::vec3(0,1,0),
-                            normals.size()>0 ? normallocal2world*glm::vec3(normals[tris[i+1]*3],normals[tris[i+1]*3+1],normals[tris[i+1]*3+2]) : glm::vec3(0,1,0),
-                            normals.size()>0 ? normallocal2world*glm::vec3(normals[tris[i+2]*3],normals[tris[i+2]*3+1],normals[tris[i+2]*3+2]) : glm::vec3(0,1,0),
-                            uvs.size()>0 ? glm::vec2(uvs[tris[i]*2],uvs[tris[i]*2+1]) : glm::vec2(0,0),
-                            uvs.size()>0 ? glm::vec2(uvs[tris[i+1]*2],uvs[tris[i+1]*2+1]) : glm::vec2(0,0),
-                            uvs.size()>0 ? glm::vec2(uvs[tris[i+2]*2],uvs[tris[i+2]*2+1]) : glm::vec2(0,0),
-                            normals.size()>0
-                    );
-                    tgeo->RenderMaterial.Set(geo->RenderMaterial.Get());
-                    bounded_objects.push_back(new TraceGeometry(tgeo));
+                MeshSnapshot& snapshot = snapshot_meshes_[record.mesh_uid];
+                if (snapshot.data == nullptr) {
+                    auto previous = previous_meshes.find(record.mesh_uid);
+                    if (previous != previous_meshes.end() && previous->second.version == record.mesh_version) {
+                        snapshot = previous->second;
+                    } else {
+                        std::shared_ptr<MeshData> data = std::make_shared<MeshData>();
+                        data->positions = mesh->GetPositions();
+                        data->normals = mesh->GetNormals();
+                        data->UVs = mesh->GetUVs();
+                        data->triangles = mesh->GetTriangles();
+                        snapshot.version = record.mesh_version;
+                        snapshot.data = data;
+                    }
                 }
-
+                record.mesh_data = snapshot.data;
             }
         }
     }
 
-    Light* light = obj->GetComponent<Light>();
-
-    if (light != nullptr) {
-        TraceLight* tso = new TraceLight(light, model_matrix);
-        lights.push_back(tso);
-
-        if (glm::length2(light->Ambient.GetRGB()) > 0.f) {
-            uses_blinn_phong_ambient = true;
-        }
-
-        if (dynamic_cast<DirectionalLight*>(light) == nullptr) {
-            bounded_objects.push_back(new TraceFlare(tso));
-        }
+    if (record.geometry != nullptr || record.light != nullptr) {
+        out.push_back(record);
     }
 
     for(SceneObject* child : obj->GetChildren()) {
-        AddSceneObjects(child, model_matrix);
+        CollectSources(child, out, previous_meshes);
     }
 }
 
@@ -105,15 +351,19 @@ bool TraceScene::Intersect(const Ray& r, Intersection& i) const {
         }
     }
 
-    // Use the BSP tree to quickly intersect the ray with bounded objects
-    if (tree->Intersect(r, cur)) {
+    // Use the BVH to quickly intersect the ray with bounded objects
+    auto intersect_bounded = [this](uint32_t index, const Ray& r, Intersection& i) {
+        return bounded_objects[index]->Intersect(r, i);
+    };
+    bool bounded_hit = kernel == Camera::TRACEKERNEL_SIMD ? bvh4.Intersect(r, cur, intersect_bounded) : bvh.Intersect(r, cur, intersect_bounded);
+    if (bounded_hit) {
         if (!intersect_found || (cur.t < i.t) ) {
             i = cur;
             intersect_found = true;
         }
     }
 
-    // go over the BSP tree's objects without using the BSP tree to do so (SLOW)
+    // go over the BVH's objects without using the BVH to do so (SLOW)
       /*  for (auto j = bounded_objects.begin(); j != bounded_objects.end(); j++) {
             Intersection cur;
             if( (*j)->Intersect( r, cur ) && cur.t>0 ) {
@@ -146,3 +396,26 @@ bool TraceScene::Intersect(const Ray& r, Intersection& i) const {
 
     return intersect_found;
 }
+
+int TraceScene::IntersectPacket(const Ray* rays, Intersection* isects) const {
+    auto intersect_bounded = [this](uint32_t index, const Ray& r, Intersection& i) {
+        return bounded_objects[index]->Intersect(r, i);
+    };
+    int hit_mask = bvh.IntersectPacket(rays, isects, intersect_bounded);
+
+    Intersection cur;
+    for (int k = 0; k < 4; k++) {
+        for (auto obj : unbounded_objects) {
+            if (obj->Intersect(rays[k], cur) && cur.t > 0) {
+                if (!(hit_mask & (1 << k)) || cur.t < isects[k].t) {
+                    isects[k] = cur;
+                    hit_mask |= 1 << k;
+                }
+            }
+        }
+        if (!(hit_mask & (1 << k))) {
+            isects[k].t = -100;
+        }
+    }
+    return hit_mask;
+}
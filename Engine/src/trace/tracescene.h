@@ -1,29 +1,128 @@
 #ifndef TRACESCENE_H
 #define TRACESCENE_H
 
-#include "bsptree.h"
+#include "bvh.h"
+#include "bvh4.h"
 #include "tracesceneobject.h"
+#include "tracemesh.h"
 #include "tracelight.h"
 
 #include <vector>
+#include <QRunnable>
+
+// Rebuild the top level BVH instead of refitting once its SAH cost grows past this factor of the built cost
+#define TRACESCENE_REFIT_MAX_SAH_RATIO 1.5
 
 class TraceScene
 {
 public:
+    TraceScene();
     TraceScene(Scene* scene, bool use_acceleration);
+    ~TraceScene();
+
+    // Brings the trace scene up to date for a new frame, same as Snapshot followed by Prepare.
+    // If only transforms changed the BVH is refit, otherwise the scene is rebuilt reusing unchanged meshes.
+    void Update(Scene* scene, bool use_acceleration);
+
+    // Records which objects, transforms and meshes the scene has right now. This is cheap and must
+    // run on the thread that owns the scene; nothing is built until Prepare.
+    void Snapshot(Scene* scene, bool use_acceleration);
+    // Picks the intersection code used from the next Prepare on, one of the Camera::TRACEKERNEL_* choices
+    void SetKernel(int kernel) { pending_kernel_ = kernel; }
+    // Brings the trace objects and BVHs up to date with the last snapshot, building new meshes in parallel.
+    // Can run on any thread as long as the snapshotted scene objects stay alive. Does nothing without a new snapshot.
+    void Prepare();
 
     bool Intersect(const Ray& r, Intersection& i) const;
 
+    // Closest hits of four coherent rays, e.g. neighboring camera rays. Returns a mask of the rays that hit;
+    // the others get t = -100 like with Intersect.
+    int IntersectPacket(const Ray* rays, Intersection* isects) const;
+
     std::vector<TraceSceneObject*> bounded_objects;
     std::vector<TraceSceneObject*> unbounded_objects;
     std::vector<TraceLight*> lights;
     //A good scene shouldn't use this and use diffuse interreflection instead
     bool uses_blinn_phong_ambient=false;
 
-    TreeBox* tree;
+    BVH bvh;
+    // Collapsed copy of bvh, only kept up to date for the SIMD kernel
+    BVH4 bvh4;
+    int kernel;
+
+    // Bottom level trees, built once per Mesh uid and shared by all of its instances
+    struct MeshCacheEntry {
+        uint64_t version;
+        std::shared_ptr<TraceMesh> mesh;
+    };
+    std::unordered_map<uint64_t, MeshCacheEntry> meshes;
+
+    // How the last Build or Update went, for per frame reports
+    bool last_update_rebuilt;
+    double last_update_ms;
 
 private:
-    void AddSceneObjects(SceneObject* obj, glm::mat4 model_matrix);
+    // What a traced SceneObject looked like when its trace objects were made
+    struct SourceRecord {
+        uint64_t uid;
+        glm::mat4 model_matrix;
+        Geometry* geometry;
+        Material* material;
+        bool custom_trace;
+        uint64_t mesh_uid;
+        uint64_t mesh_version;
+        // Copied from the render mesh on the thread that owns the scene, so building never reads the live Mesh
+        std::shared_ptr<const MeshData> mesh_data;
+        Light* light;
+        // Parameters the trace objects keep copies of, so editing them without moving the object still reaches them
+        bool has_local_bounds;
+        BoundingBox local_bounds; // Custom traced geometry's box in its own space
+        double flare_radius; // A point light's TraceRadius
+
+        TraceSceneObject* trace_object;
+        TraceLight* trace_light;
+        TraceFlare* trace_flare;
+
+        bool SameStructure(const SourceRecord& other) const {
+            return uid == other.uid && geometry == other.geometry && material == other.material &&
+                   mesh_uid == other.mesh_uid && mesh_version == other.mesh_version && light == other.light &&
+                   has_local_bounds == other.has_local_bounds;
+        }
+    };
+    std::vector<SourceRecord> sources_;
+    bool use_acceleration_;
+
+    std::vector<SourceRecord> pending_sources_;
+    bool pending_use_acceleration_;
+    bool has_pending_snapshot_;
+    int pending_kernel_;
+
+    // Mesh copies handed out by Snapshot, reused while a mesh keeps its version. Only Snapshot touches these.
+    struct MeshSnapshot {
+        uint64_t version;
+        std::shared_ptr<const MeshData> data;
+    };
+    std::unordered_map<uint64_t, MeshSnapshot> snapshot_meshes_;
+
+    // Brings bvh4 and the mesh instances in line with pending_kernel_
+    void ApplyKernel();
+
+    // Builds one new bottom level mesh on the thread pool
+    class MeshBuildJob : public QRunnable {
+      public:
+        MeshBuildJob(std::shared_ptr<const MeshData> mesh, MeshCacheEntry& entry) : mesh_(mesh), entry_(entry) {}
+        void run() override;
+      private:
+        std::shared_ptr<const MeshData> mesh_;
+        MeshCacheEntry& entry_;
+    };
+
+    // Records obj and its children, filling snapshot_meshes_ from previous_meshes where the versions still match
+    void CollectSources(SceneObject* obj, std::vector<SourceRecord>& out, const std::unordered_map<uint64_t, MeshSnapshot>& previous_meshes);
+    void CollectSources(Scene* scene, std::vector<SourceRecord>& out);
+    void Build(std::vector<SourceRecord>& sources, bool use_acceleration);
+    void Clear();
+    std::vector<BoundingBox> GetBoundedObjectBounds() const;
 };
 
 #endif // TRACESCENE_H
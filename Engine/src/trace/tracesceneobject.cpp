@@ -6,10 +6,10 @@ TraceGeometry::TraceGeometry(Geometry* geometry_) :
     world_bbox = geometry->HasBoundingBox() ? geometry->GetLocalBoundingBox() : nullptr;
 }
 
-TraceGeometry::TraceGeometry(Geometry* geometry_, glm::mat4 transform_) :
+TraceGeometry::TraceGeometry(Geometry* geometry_, glm::mat4 transform_, const BoundingBox* local_bounds) :
     identity_transform(false), transform(transform_), inverse_transform(glm::inverse(transform_)), normals_transform(glm::transpose(glm::inverse(glm::mat3(transform_)))), geometry(geometry_)
 {
-    world_bbox = geometry->HasBoundingBox() ? geometry->GetWorldBoundingBox(transform_) : nullptr;
+    world_bbox = local_bounds ? BoundingBox(*local_bounds).GetWorldBoundingBox(transform_) : nullptr;
 }
 
 TraceGeometry::~TraceGeometry()
@@ -19,6 +19,18 @@ TraceGeometry::~TraceGeometry()
     }
 }
 
+void TraceGeometry::SetTransform(glm::mat4 transform_, const BoundingBox* local_bounds)
+{
+    identity_transform = false;
+    transform = transform_;
+    inverse_transform = glm::inverse(transform_);
+    normals_transform = glm::transpose(glm::inverse(glm::mat3(transform_)));
+    if (world_bbox) {
+        delete world_bbox;
+    }
+    world_bbox = local_bounds ? BoundingBox(*local_bounds).GetWorldBoundingBox(transform_) : nullptr;
+}
+
 bool TraceGeometry::Intersect(const Ray &r, Intersection &i)
 {
     //no transforms needed... nice
@@ -51,11 +63,22 @@ bool TraceGeometry::Intersect(const Ray &r, Intersection &i)
 }
 
 
-TraceFlare::TraceFlare(TraceLight *light) : trace_light(light)
+TraceFlare::TraceFlare(TraceLight *light, double trace_radius) : trace_light(light)
 {
+    world_bbox = nullptr;
+    UpdateFromLight(trace_radius);
+}
+
+void TraceFlare::UpdateFromLight(double trace_radius)
+{
+    TraceLight* light = trace_light;
+    if (world_bbox) {
+        delete world_bbox;
+    }
+
     center = light->GetTransformPos();
-    if (PointLight* point_light = dynamic_cast<PointLight*>(light->light)) {
-        radius = std::max(point_light->TraceRadius.Get(), 0.001);
+    if (dynamic_cast<PointLight*>(light->light)) {
+        radius = std::max(trace_radius, 0.001);
 
         world_bbox = new BoundingBox(center-glm::vec3{radius}, center+glm::vec3{radius});
     } else if (AreaLight* area_light = dynamic_cast<AreaLight*>(light->light)) {
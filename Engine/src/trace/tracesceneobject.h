@@ -9,6 +9,7 @@
 class TraceSceneObject
 {
 public:
+    virtual ~TraceSceneObject() {}
     virtual bool Intersect(const Ray&r, Intersection&i) = 0;
 
     BoundingBox* world_bbox;
@@ -20,11 +21,15 @@ class TraceGeometry : public TraceSceneObject
 {
 public:
     TraceGeometry(Geometry* geometry_);
-    TraceGeometry(Geometry* geometry_, glm::mat4 transform_);
+    // local_bounds is the geometry's box in its own space as of the snapshot, nullptr if it has none
+    TraceGeometry(Geometry* geometry_, glm::mat4 transform_, const BoundingBox* local_bounds);
     ~TraceGeometry();
 
     virtual bool Intersect(const Ray&r, Intersection&i);
 
+    // Moves the geometry and recomputes its world bounds from its local ones
+    void SetTransform(glm::mat4 transform_, const BoundingBox* local_bounds);
+
     Geometry* geometry;
     bool identity_transform;
     glm::mat4 transform; //local2world
@@ -37,11 +42,15 @@ public:
 class TraceFlare : public TraceSceneObject
 {
 public:
-    TraceFlare(TraceLight* light);
+    // trace_radius is the point light's TraceRadius as of the snapshot, unused for area lights
+    TraceFlare(TraceLight* light, double trace_radius);
     ~TraceFlare();
 
     virtual bool Intersect(const Ray&r, Intersection&i);
 
+    // Recomputes the flare's placement and bounds after its light moved or its radius changed
+    void UpdateFromLight(double trace_radius);
+
     glm::vec3 GetIntensity(const Ray&r);
 
     TraceLight* trace_light;
@@ -0,0 +1,12 @@
+TEMPLATE = subdirs
+
+# One test executable per sub-project, run them all with "make check"
+SUBDIRS = \
+    particlesystem \
+    particlecollision \
+    meshprocessing \
+    bvh \
+    meshtangents \
+    glresidency \
+    worldmatrix \
+    sampler
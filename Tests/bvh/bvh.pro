@@ -0,0 +1,5 @@
+include(../tests.pri)
+
+TARGET = tst_bvh
+
+SOURCES += tst_bvh.cpp
@@ -0,0 +1,129 @@
+#include <trace/bvh.h>
+#include <trace/bsptree.h>
+#include <QtTest>
+#include <random>
+
+// The flattened BVH has to find the same closest hits as the recursive TreeBox it replaced
+class TestBVH : public QObject {
+    Q_OBJECT
+
+public:
+    TestBVH();
+    ~TestBVH();
+
+private slots:
+    void MatchesTreeBox();
+    void TraverseBVH();
+    void TraverseTreeBox();
+
+private:
+    std::vector<TraceSceneObject*> spheres_;
+    std::vector<BoundingBox> bounds_;
+    std::vector<Ray> rays_;
+    BVH bvh_;
+    TreeBox* tree_;
+};
+
+namespace {
+
+const int SPHERES = 20000;
+const int RAYS = 100000;
+
+class Sphere : public TraceSceneObject {
+public:
+    Sphere(glm::dvec3 center, double radius) : center_(center), radius_(radius), bounds_(glm::vec3(center - radius), glm::vec3(center + radius)) {
+        world_bbox = &bounds_;
+    }
+
+    bool Intersect(const Ray& r, Intersection& i) override {
+        glm::dvec3 offset = r.position - center_;
+        double b = glm::dot(offset, r.direction);
+        double discriminant = b * b - glm::dot(offset, offset) + radius_ * radius_;
+        if (discriminant < 0.0) return false;
+        double root = std::sqrt(discriminant);
+        double t = -b - root > RAY_EPSILON ? -b - root : -b + root;
+        if (t <= RAY_EPSILON) return false;
+        i.obj = this;
+        i.t = t;
+        i.normal = glm::vec3(glm::normalize(r.at(t) - center_));
+        return true;
+    }
+
+private:
+    glm::dvec3 center_;
+    double radius_;
+    BoundingBox bounds_;
+};
+
+}
+
+TestBVH::TestBVH() {
+    // Small spheres scattered through a box, with rays from inside it in every direction
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> coordinate(-50.0, 50.0);
+    std::uniform_real_distribution<double> radius(0.05, 1.0);
+    std::normal_distribution<double> normal;
+    for (int i = 0; i < SPHERES; i++) {
+        spheres_.push_back(new Sphere(glm::dvec3(coordinate(rng), coordinate(rng), coordinate(rng)), radius(rng)));
+        bounds_.push_back(*spheres_.back()->world_bbox);
+    }
+    for (int i = 0; i < RAYS; i++) {
+        glm::dvec3 position(coordinate(rng), coordinate(rng), coordinate(rng));
+        rays_.push_back(Ray(position, glm::normalize(glm::dvec3(normal(rng), normal(rng), normal(rng)))));
+    }
+    bvh_.Build(bounds_);
+    tree_ = new TreeBox(spheres_);
+}
+
+TestBVH::~TestBVH() {
+    delete tree_;
+    for (TraceSceneObject* sphere : spheres_) delete sphere;
+}
+
+void TestBVH::MatchesTreeBox() {
+    auto intersect_sphere = [this](uint32_t index, const Ray& r, Intersection& i) {
+        return spheres_[index]->Intersect(r, i);
+    };
+    int hits = 0;
+    for (const Ray& ray : rays_) {
+        Intersection expected, found;
+        bool expected_hit = tree_->Intersect(ray, expected);
+        bool hit = bvh_.Intersect(ray, found, intersect_sphere);
+        QCOMPARE(hit, expected_hit);
+        if (!hit) continue;
+        hits++;
+        QCOMPARE(found.obj, expected.obj);
+        QCOMPARE(found.t, expected.t);
+    }
+    // Enough rays hit something for this to mean anything
+    QVERIFY(hits > RAYS / 4);
+}
+
+void TestBVH::TraverseBVH() {
+    auto intersect_sphere = [this](uint32_t index, const Ray& r, Intersection& i) {
+        return spheres_[index]->Intersect(r, i);
+    };
+    int hits = 0;
+    QBENCHMARK {
+        for (const Ray& ray : rays_) {
+            Intersection i;
+            if (bvh_.Intersect(ray, i, intersect_sphere)) hits++;
+        }
+    }
+    QVERIFY(hits > 0);
+}
+
+void TestBVH::TraverseTreeBox() {
+    int hits = 0;
+    QBENCHMARK {
+        for (const Ray& ray : rays_) {
+            Intersection i;
+            if (tree_->Intersect(ray, i)) hits++;
+        }
+    }
+    QVERIFY(hits > 0);
+}
+
+QTEST_APPLESS_MAIN(TestBVH)
+
+#include "tst_bvh.moc"
@@ -0,0 +1,5 @@
+include(../tests.pri)
+
+TARGET = tst_glresidency
+
+SOURCES += tst_glresidency.cpp
@@ -0,0 +1,120 @@
+#include <opengl/glresidency.h>
+#include <QtTest>
+
+class TestGLResidency : public QObject {
+    Q_OBJECT
+
+private slots:
+    void EvictsOldestFirst();
+    void KeepsWhatLastFrameUsed();
+    void KeepsRenderTargets();
+    void TracksSizeChanges();
+    void UploadsEvictedAgain();
+};
+
+namespace {
+
+// Adds a resource in a frame of its own, so each is older than the next
+void AddInNewFrame(GLResidency& residency, uint64_t uid, size_t bytes, bool pinned = false) {
+    residency.BeginFrame();
+    QVERIFY(!residency.Use(uid));
+    residency.Add(uid, bytes, pinned);
+}
+
+}
+
+void TestGLResidency::EvictsOldestFirst() {
+    GLResidency residency(100);
+    AddInNewFrame(residency, 1, 40);
+    AddInNewFrame(residency, 2, 40);
+    AddInNewFrame(residency, 3, 40);
+    QCOMPARE(residency.GetTotal(), size_t(120));
+
+    // Only as much as it takes to get back under
+    QCOMPARE(residency.BeginFrame(), std::vector<uint64_t>({1}));
+    QCOMPARE(residency.GetTotal(), size_t(80));
+    QCOMPARE(residency.GetEvictions(), 1u);
+    QVERIFY(residency.BeginFrame().empty());
+
+    // Using one makes it the newest
+    QVERIFY(residency.Use(2));
+    AddInNewFrame(residency, 4, 60);
+    QCOMPARE(residency.BeginFrame(), std::vector<uint64_t>({3}));
+    QCOMPARE(residency.GetTotal(), size_t(100));
+}
+
+void TestGLResidency::KeepsWhatLastFrameUsed() {
+    GLResidency residency(100);
+    AddInNewFrame(residency, 1, 80);
+    residency.Add(2, 80);
+    // Both were used in the last frame, so the scene stays resident over budget
+    for (int frame = 0; frame < 3; frame++) {
+        QVERIFY(residency.BeginFrame().empty());
+        QVERIFY(residency.Use(1));
+        QVERIFY(residency.Use(2));
+    }
+    QCOMPARE(residency.GetTotal(), size_t(160));
+
+    // Once one goes unused for a frame it goes
+    residency.BeginFrame();
+    QVERIFY(residency.Use(2));
+    QCOMPARE(residency.BeginFrame(), std::vector<uint64_t>({1}));
+    QCOMPARE(residency.GetTotal(), size_t(80));
+}
+
+void TestGLResidency::KeepsRenderTargets() {
+    GLResidency residency(50);
+    AddInNewFrame(residency, 1, 60, true);
+    AddInNewFrame(residency, 2, 30);
+    AddInNewFrame(residency, 3, 30);
+
+    // The oldest is pinned, so the next oldest goes, and then the rest even though it's still over budget
+    QCOMPARE(residency.BeginFrame(), std::vector<uint64_t>({2}));
+    QCOMPARE(residency.BeginFrame(), std::vector<uint64_t>({3}));
+    QCOMPARE(residency.GetTotal(), size_t(60));
+    QVERIFY(residency.BeginFrame().empty());
+    QVERIFY(residency.Use(1));
+}
+
+void TestGLResidency::TracksSizeChanges() {
+    GLResidency residency(100);
+    AddInNewFrame(residency, 1, 40);
+    AddInNewFrame(residency, 2, 40);
+    // Uploaded again at a different size, e.g. a resized render target
+    residency.Add(1, 10);
+    QCOMPARE(residency.GetTotal(), size_t(50));
+    residency.Add(2, 95);
+    QCOMPARE(residency.GetTotal(), size_t(105));
+    residency.BeginFrame();
+    QCOMPARE(residency.BeginFrame(), std::vector<uint64_t>({1}));
+    QCOMPARE(residency.GetTotal(), size_t(95));
+
+    // Without a budget nothing goes
+    residency.SetBudget(0);
+    AddInNewFrame(residency, 3, 1000);
+    residency.BeginFrame();
+    QVERIFY(residency.BeginFrame().empty());
+    QCOMPARE(residency.GetTotal(), size_t(1095));
+}
+
+void TestGLResidency::UploadsEvictedAgain() {
+    GLResidency residency(50);
+    AddInNewFrame(residency, 1, 40);
+    AddInNewFrame(residency, 2, 40);
+    QCOMPARE(residency.BeginFrame(), std::vector<uint64_t>({1}));
+
+    // The next use finds it gone, so it has to be uploaded before it's drawn
+    QVERIFY(!residency.Use(1));
+    residency.Add(1, 40);
+    QVERIFY(residency.Use(1));
+    QCOMPARE(residency.GetTotal(), size_t(80));
+    // It's now the newest, so the other one goes instead
+    QCOMPARE(residency.BeginFrame(), std::vector<uint64_t>({2}));
+    QVERIFY(residency.Use(1));
+    QVERIFY(!residency.Use(2));
+    QCOMPARE(residency.GetEvictions(), 2u);
+}
+
+QTEST_APPLESS_MAIN(TestGLResidency)
+
+#include "tst_glresidency.moc"
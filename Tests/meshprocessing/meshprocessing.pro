@@ -0,0 +1,5 @@
+include(../tests.pri)
+
+TARGET = tst_meshprocessing
+
+SOURCES += tst_meshprocessing.cpp
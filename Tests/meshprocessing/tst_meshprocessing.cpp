@@ -0,0 +1,253 @@
+#include <meshprocessing.h>
+#include <resource/halfedgemesh.h>
+#include <QtTest>
+#include <random>
+
+class TestMeshProcessing : public QObject {
+    Q_OBJECT
+
+private slots:
+    void SubdivideClosedMesh();
+    void SubdivideToLimit();
+    void SubdivideAcrossUVSeams();
+    void SubdivideOpenMesh();
+    void SmoothNoisySphere();
+    void FindNonManifoldMeshes();
+};
+
+namespace {
+
+void MakeOctahedron(Mesh& mesh) {
+    MeshData data;
+    data.positions = {1,0,0, -1,0,0, 0,1,0, 0,-1,0, 0,0,1, 0,0,-1};
+    data.triangles = {0,2,4, 2,1,4, 1,3,4, 3,0,4, 2,0,5, 1,2,5, 3,1,5, 0,3,5};
+    mesh.SetData(std::move(data));
+}
+
+// A cube with its own copy of each corner on every face, like the built-in one, so each face has its own UVs
+void MakeSplitCube(Mesh& mesh) {
+    static const float faces[6][4][3] = {
+        {{-1,-1,1}, {1,-1,1}, {1,1,1}, {-1,1,1}}, {{1,-1,-1}, {-1,-1,-1}, {-1,1,-1}, {1,1,-1}},
+        {{1,-1,1}, {1,-1,-1}, {1,1,-1}, {1,1,1}}, {{-1,-1,-1}, {-1,-1,1}, {-1,1,1}, {-1,1,-1}},
+        {{-1,1,1}, {1,1,1}, {1,1,-1}, {-1,1,-1}}, {{-1,-1,-1}, {1,-1,-1}, {1,-1,1}, {-1,-1,1}}};
+    MeshData data;
+    for (unsigned int f = 0; f < 6; f++) {
+        for (int c = 0; c < 4; c++) {
+            data.positions.insert(data.positions.end(), faces[f][c], faces[f][c] + 3);
+            data.UVs.push_back(c == 1 || c == 2);
+            data.UVs.push_back(c >= 2);
+        }
+        unsigned int b = 4 * f;
+        data.triangles.insert(data.triangles.end(), {b, b + 1, b + 2, b, b + 2, b + 3});
+    }
+    mesh.SetData(std::move(data));
+}
+
+// Unit square in X-Y split into n by n quads, with every other vertex raised by bump
+void MakeGrid(Mesh& mesh, unsigned int n, float bump) {
+    MeshData data;
+    for (unsigned int y = 0; y <= n; y++) {
+        for (unsigned int x = 0; x <= n; x++) {
+            data.positions.insert(data.positions.end(), {x / float(n), y / float(n), ((x + y) % 2) * bump});
+            data.UVs.insert(data.UVs.end(), {x / float(n), y / float(n)});
+        }
+    }
+    for (unsigned int y = 0; y < n; y++) {
+        for (unsigned int x = 0; x < n; x++) {
+            unsigned int a = y * (n + 1) + x, b = a + 1, c = a + n + 1, d = c + 1;
+            data.triangles.insert(data.triangles.end(), {a, b, d, a, d, c});
+        }
+    }
+    mesh.SetData(std::move(data));
+}
+
+glm::dvec3 Position(const Mesh& mesh, unsigned int mesh_vertex) {
+    const std::vector<float>& positions = mesh.GetPositions();
+    return glm::dvec3(positions[3 * mesh_vertex], positions[3 * mesh_vertex + 1], positions[3 * mesh_vertex + 2]);
+}
+
+int EulerCharacteristic(const HalfEdgeMesh& half_edges) {
+    return (int)half_edges.GetVertexCount() - (int)half_edges.GetEdgeCount() + (int)half_edges.GetFaceCount();
+}
+
+unsigned int CountBoundaryVertices(const HalfEdgeMesh& half_edges) {
+    unsigned int count = 0;
+    for (unsigned int v = 0; v < half_edges.GetVertexCount(); v++) {
+        if (half_edges.IsBoundaryVertex(v)) count++;
+    }
+    return count;
+}
+
+// Mean distance of the welded vertices from the origin
+double MeanRadius(const Mesh& mesh) {
+    const HalfEdgeMesh& half_edges = mesh.GetHalfEdges();
+    double sum = 0.0;
+    for (unsigned int v = 0; v < half_edges.GetVertexCount(); v++) {
+        sum += glm::length(Position(mesh, half_edges.GetMeshVertex(v)));
+    }
+    return sum / half_edges.GetVertexCount();
+}
+
+// Mean distance of each vertex from the mean of its neighbors
+double Roughness(const Mesh& mesh) {
+    const HalfEdgeMesh& half_edges = mesh.GetHalfEdges();
+    double sum = 0.0;
+    for (unsigned int v = 0; v < half_edges.GetVertexCount(); v++) {
+        glm::dvec3 mean(0.0);
+        for (unsigned int i = 0; i < half_edges.GetValence(v); i++) {
+            mean += Position(mesh, half_edges.GetMeshVertex(half_edges.GetNeighbors(v)[i]));
+        }
+        sum += glm::length(mean / double(half_edges.GetValence(v)) - Position(mesh, half_edges.GetMeshVertex(v)));
+    }
+    return sum / half_edges.GetVertexCount();
+}
+
+}
+
+void TestMeshProcessing::SubdivideClosedMesh() {
+    Mesh mesh("octahedron");
+    MakeOctahedron(mesh);
+    for (int level = 0; level < 3; level++) {
+        const HalfEdgeMesh& half_edges = mesh.GetHalfEdges();
+        QVERIFY(half_edges.IsClosed());
+        QVERIFY(half_edges.IsManifold());
+        QCOMPARE(EulerCharacteristic(half_edges), 2);
+
+        unsigned int vertex_count = half_edges.GetVertexCount();
+        unsigned int edge_count = half_edges.GetEdgeCount();
+        unsigned int face_count = half_edges.GetFaceCount();
+        MeshProcessing::SubdivideMesh(mesh, mesh);
+        // A new vertex on every edge, and every face split in four
+        QCOMPARE(mesh.GetHalfEdges().GetVertexCount(), vertex_count + edge_count);
+        QCOMPARE(mesh.GetHalfEdges().GetFaceCount(), 4 * face_count);
+    }
+
+    // Unit length normals, pointing out
+    const std::vector<float>& normals = mesh.GetNormals();
+    QCOMPARE(normals.size(), mesh.GetPositions().size());
+    for (unsigned int i = 0; i < normals.size() / 3; i++) {
+        glm::dvec3 normal(normals[3 * i], normals[3 * i + 1], normals[3 * i + 2]);
+        QVERIFY(std::abs(glm::length(normal) - 1.0) < 1e-5);
+        QVERIFY(glm::dot(normal, Position(mesh, i)) > 0.0);
+    }
+}
+
+void TestMeshProcessing::SubdivideToLimit() {
+    Mesh control("control"), limit("limit"), subdivided("subdivided");
+    MakeOctahedron(control);
+    MeshProcessing::SubdivideMesh(control, control);
+    MeshProcessing::SubdivideMesh(control, limit, true);
+
+    // Where further subdivision takes a vertex is where the limit put it. Vertex 0 keeps its index through every level.
+    MeshProcessing::SubdivideMesh(control, subdivided);
+    for (int level = 0; level < 4; level++) {
+        MeshProcessing::SubdivideMesh(subdivided, subdivided);
+    }
+    QVERIFY(glm::distance(Position(limit, 0), Position(subdivided, 0)) < 1e-3);
+    QVERIFY(std::abs(MeanRadius(limit) - MeanRadius(subdivided)) < 0.01);
+}
+
+void TestMeshProcessing::SubdivideAcrossUVSeams() {
+    Mesh cube("cube"), level1("level 1"), level2("level 2");
+    MakeSplitCube(cube);
+    // The copies of each corner weld into one vertex
+    QCOMPARE(cube.GetHalfEdges().GetVertexCount(), 8u);
+    QVERIFY(cube.GetHalfEdges().IsClosed());
+    QVERIFY(cube.GetHalfEdges().IsManifold());
+
+    MeshProcessing::SubdivideMesh(cube, level1);
+    MeshProcessing::SubdivideMesh(level1, level2, true);
+    // No cracks open up along the seams
+    const HalfEdgeMesh& half_edges = level2.GetHalfEdges();
+    QVERIFY(half_edges.IsClosed());
+    QVERIFY(half_edges.IsManifold());
+    QCOMPARE(EulerCharacteristic(half_edges), 2);
+    QCOMPARE(level2.GetUVs().size() / 2, level2.GetPositions().size() / 3);
+}
+
+void TestMeshProcessing::SubdivideOpenMesh() {
+    Mesh grid("grid"), level1("level 1"), level2("level 2");
+    MakeGrid(grid, 4, 0.2f);
+    const HalfEdgeMesh& half_edges = grid.GetHalfEdges();
+    QVERIFY(!half_edges.IsClosed());
+    QVERIFY(half_edges.IsManifold());
+    QCOMPARE(CountBoundaryVertices(half_edges), 16u);
+
+    MeshProcessing::SubdivideMesh(grid, level1);
+    const HalfEdgeMesh& finer = level1.GetHalfEdges();
+    QCOMPARE(finer.GetVertexCount(), half_edges.GetVertexCount() + half_edges.GetEdgeCount());
+    QVERIFY(!finer.IsClosed());
+    QVERIFY(finer.IsManifold());
+    QCOMPARE(CountBoundaryVertices(finer), 32u);
+
+    // Boundary vertices away from the corners stay on the sides of the square
+    MeshProcessing::SubdivideMesh(level1, level2, true);
+    const HalfEdgeMesh& finest = level2.GetHalfEdges();
+    double bump = 0.0;
+    for (unsigned int v = 0; v < finest.GetVertexCount(); v++) {
+        glm::dvec3 p = Position(level2, finest.GetMeshVertex(v));
+        bump = std::max(bump, std::abs(p.z - 0.1));
+        if (!finest.IsBoundaryVertex(v)) continue;
+        bool near_corner = (p.x < 0.3 || p.x > 0.7) && (p.y < 0.3 || p.y > 0.7);
+        bool on_side = std::abs(p.x) < 1e-6 || std::abs(p.x - 1.0) < 1e-6 || std::abs(p.y) < 1e-6 || std::abs(p.y - 1.0) < 1e-6;
+        QVERIFY(near_corner || on_side);
+    }
+    // The bumps flatten out
+    QVERIFY(bump < 0.1);
+}
+
+void TestMeshProcessing::SmoothNoisySphere() {
+    Mesh sphere("sphere");
+    MakeOctahedron(sphere);
+    for (int i = 0; i < 3; i++) {
+        MeshProcessing::SubdivideMesh(sphere, sphere);
+    }
+
+    // Move each welded vertex, all of its copies the same way
+    Mesh noisy("noisy"), laplacian("laplacian"), taubin("taubin");
+    std::mt19937 rng(457);
+    std::uniform_real_distribution<float> noise(-0.05f, 0.05f);
+    const HalfEdgeMesh& half_edges = sphere.GetHalfEdges();
+    std::vector<glm::vec3> offsets(half_edges.GetVertexCount());
+    for (glm::vec3& offset : offsets) offset = glm::vec3(noise(rng), noise(rng), noise(rng));
+    std::vector<float> positions = sphere.GetPositions();
+    for (unsigned int i = 0; i < positions.size() / 3; i++) {
+        for (int k = 0; k < 3; k++) positions[3 * i + k] += offsets[half_edges.GetVertex(i)][k];
+    }
+    noisy.SetData(MeshData{positions, {}, {}, {}, {}, {}, sphere.GetTriangles()});
+
+    MeshProcessing::FilterMesh(noisy, laplacian, 1.0);
+    MeshProcessing::TaubinFilterMesh(noisy, taubin);
+    for (int i = 0; i < 9; i++) {
+        MeshProcessing::FilterMesh(laplacian, laplacian, 1.0);
+        MeshProcessing::TaubinFilterMesh(taubin, taubin);
+    }
+    QVERIFY(Roughness(laplacian) < Roughness(noisy));
+    QVERIFY(Roughness(taubin) < Roughness(noisy));
+    // Taubin keeps the sphere from shrinking like plain Laplacian smoothing does
+    QVERIFY(std::abs(MeanRadius(taubin) - MeanRadius(noisy)) < std::abs(MeanRadius(laplacian) - MeanRadius(noisy)));
+    QVERIFY(laplacian.GetHalfEdges().IsClosed());
+    QVERIFY(taubin.GetHalfEdges().IsClosed());
+}
+
+void TestMeshProcessing::FindNonManifoldMeshes() {
+    // Three faces on one edge
+    Mesh fin("fin");
+    fin.SetData(MeshData{{0,0,0, 1,0,0, 0,1,0, 0,-1,0, 0,0,1}, {}, {}, {}, {}, {}, {0,1,2, 1,0,3, 0,1,4}});
+    QVERIFY(!fin.GetHalfEdges().IsManifold());
+    // Still processed, with the shared edge kept as a crease
+    Mesh subdivided("subdivided");
+    MeshProcessing::SubdivideMesh(fin, subdivided, true);
+    MeshProcessing::FilterMesh(subdivided, subdivided, 0.5);
+    QCOMPARE(subdivided.GetHalfEdges().GetFaceCount(), 12u);
+
+    // Two fans meeting at a vertex
+    Mesh bowtie("bowtie");
+    bowtie.SetData(MeshData{{0,0,0, 1,0,0, 1,1,0, -1,0,0, -1,-1,0}, {}, {}, {}, {}, {}, {0,1,2, 0,3,4}});
+    QVERIFY(!bowtie.GetHalfEdges().IsManifold());
+    QVERIFY(!bowtie.GetHalfEdges().IsClosed());
+}
+
+QTEST_APPLESS_MAIN(TestMeshProcessing)
+
+#include "tst_meshprocessing.moc"
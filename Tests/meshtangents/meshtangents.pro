@@ -0,0 +1,5 @@
+include(../tests.pri)
+
+TARGET = tst_meshtangents
+
+SOURCES += tst_meshtangents.cpp
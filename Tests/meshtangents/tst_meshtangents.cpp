@@ -0,0 +1,76 @@
+#include <components.h>
+#include <resource/importers.h>
+#include <resource/meshcache.h>
+#include <QtTest>
+#include <QTemporaryDir>
+#include <fstream>
+
+// Binormals and tangents are only found once something asks for them, and then only once per change
+class TestMeshTangents : public QObject {
+    Q_OBJECT
+
+private slots:
+    void FoundOnlyWhenAskedFor();
+};
+
+namespace {
+
+// A unit quad in the X-Y plane, with U along X and V along Y
+void WriteQuad(const std::string& path) {
+    std::ofstream file(path);
+    file << "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+            "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+            "vn 0 0 1\n"
+            "f 1/1/1 2/2/1 3/3/1\nf 1/1/1 3/3/1 4/4/1\n";
+}
+
+}
+
+void TestMeshTangents::FoundOnlyWhenAskedFor() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    std::string path = dir.filePath("quad.obj").toStdString();
+    WriteQuad(path);
+
+    // Importing and writing the cache only reads the arrays the file has
+    std::unique_ptr<Mesh> mesh = Importers::ImportMesh("quad", path);
+    QVERIFY(mesh != nullptr);
+    QCOMPARE(mesh->GetPositions().size(), size_t(12));
+    QCOMPARE(mesh->GetNormals().size(), size_t(12));
+    QCOMPARE(mesh->GetTriangles().size(), size_t(6));
+    QCOMPARE(mesh->GetTangentFindCount(), 0);
+
+    const std::vector<float>& tangents = mesh->GetTangents();
+    QCOMPARE(mesh->GetTangentFindCount(), 1);
+    QCOMPARE(tangents.size(), size_t(12));
+    QVERIFY(glm::distance(glm::vec3(tangents[0], tangents[1], tangents[2]), glm::vec3(1.f, 0.f, 0.f)) < 1e-5f);
+    mesh->GetBinormals();
+    mesh->GetTangents();
+    mesh->GetVertexFormat();
+    QCOMPARE(mesh->GetTangentFindCount(), 1);
+
+    // New arrays make them stale, but they're still only found once asked for
+    MeshData data;
+    data.positions = {0,0,0, 2,0,0, 2,2,0, 0,2,0};
+    data.normals = {0,0,1, 0,0,1, 0,0,1, 0,0,1};
+    data.UVs = {0,0, 1,0, 1,1, 0,1};
+    data.triangles = {0,1,2, 0,2,3};
+    mesh->SetData(std::move(data));
+    mesh->GetPositions();
+    mesh->GetNormals();
+    QCOMPARE(mesh->GetTangentFindCount(), 1);
+    mesh->GetTangents();
+    mesh->GetBinormals();
+    QCOMPARE(mesh->GetTangentFindCount(), 2);
+
+    // The cache written by the import doesn't have them, so they're found after loading it too
+    std::unique_ptr<Mesh> cached = MeshCache::Load("quad", path);
+    QVERIFY(cached != nullptr);
+    QCOMPARE(cached->GetTangentFindCount(), 0);
+    QCOMPARE(cached->GetTangents().size(), size_t(12));
+    QCOMPARE(cached->GetTangentFindCount(), 1);
+}
+
+QTEST_APPLESS_MAIN(TestMeshTangents)
+
+#include "tst_meshtangents.moc"
@@ -0,0 +1,5 @@
+include(../tests.pri)
+
+TARGET = tst_particlecollision
+
+SOURCES += tst_particlecollision.cpp
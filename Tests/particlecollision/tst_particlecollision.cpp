@@ -0,0 +1,224 @@
+#include <scene/particlecollision.h>
+#include <trace/bvh.h>
+#include <QtTest>
+#include <random>
+
+// Particles crossing each collider shape in a single long step must still hit it, on the near side
+class TestParticleCollision : public QObject {
+    Q_OBJECT
+
+private slots:
+    void SphereStopsLongSteps();
+    void SphereStopsLongSteps_data() { AddStepLengths(); }
+    void PlaneStopsLongSteps();
+    void PlaneStopsLongSteps_data() { AddStepLengths(); }
+    void CylinderStopsLongSteps();
+    void CylinderStopsLongSteps_data() { AddStepLengths(); }
+    void TriangleStopsLongSteps();
+    void TriangleStopsLongSteps_data() { AddStepLengths(); }
+    void TreeFindsFirstTriangle();
+
+private:
+    void AddStepLengths();
+};
+
+namespace {
+
+const float PARTICLE_RADIUS = 0.05f;
+const int PATHS = 500;
+
+// How far off the grown surface a hit may be, float precision along the step
+float Tolerance(float length) {
+    return 1e-4f + 2e-7f * length;
+}
+
+glm::vec3 RandomDirection(std::mt19937& rng) {
+    std::normal_distribution<float> normal;
+    return glm::normalize(glm::vec3(normal(rng), normal(rng), normal(rng)));
+}
+
+// Random direction that isn't within about 17 degrees of parallel to the X-Y plane
+glm::vec3 RandomSteepDirection(std::mt19937& rng) {
+    glm::vec3 direction;
+    do {
+        direction = RandomDirection(rng);
+    } while (std::abs(direction.z) < 0.3f);
+    return direction;
+}
+
+// Common checks on a hit of a step centered on the shape
+void VerifyHit(const ParticleSweepHit& hit, const glm::vec3& from, const glm::vec3& to) {
+    QVERIFY(hit.t >= 0.f && hit.t <= 0.5f);
+    QVERIFY(std::abs(glm::length(hit.normal) - 1.f) < 1e-4f);
+    QVERIFY(glm::dot(hit.normal, to - from) < 0.f);
+    QVERIFY(glm::distance(hit.point, from + hit.t * (to - from)) < Tolerance(glm::distance(from, to)));
+}
+
+}
+
+void TestParticleCollision::AddStepLengths() {
+    QTest::addColumn<float>("length");
+
+    QTest::newRow("1e3") << 1e3f;
+    QTest::newRow("1e4") << 1e4f;
+    QTest::newRow("1e5") << 1e5f;
+}
+
+void TestParticleCollision::SphereStopsLongSteps() {
+    QFETCH(float, length);
+    const float sphere_radius = 0.5f;
+    const float r = sphere_radius + PARTICLE_RADIUS;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> offset(-0.5f * sphere_radius, 0.5f * sphere_radius);
+
+    for (int i = 0; i < PATHS; i++) {
+        glm::vec3 direction = RandomDirection(rng);
+        glm::vec3 center = glm::vec3(offset(rng), offset(rng), offset(rng));
+        glm::vec3 from = center - 0.5f * length * direction;
+        glm::vec3 to = center + 0.5f * length * direction;
+        ParticleSweepHit hit;
+        QVERIFY(SweepParticleSphere(from, to, PARTICLE_RADIUS, sphere_radius, hit));
+        VerifyHit(hit, from, to);
+        if (QTest::currentTestFailed()) return;
+        QVERIFY(std::abs(glm::length(hit.point) - r) < Tolerance(length));
+    }
+}
+
+void TestParticleCollision::PlaneStopsLongSteps() {
+    QFETCH(float, length);
+    const float width = 2.f, height = 1.f;
+    std::mt19937 rng(2);
+    // The particle touches the plane up to about 0.16 from where its center crosses it
+    std::uniform_real_distribution<float> x(-0.25f * width, 0.25f * width);
+    std::uniform_real_distribution<float> y(-0.25f * height, 0.25f * height);
+
+    for (int i = 0; i < PATHS; i++) {
+        glm::vec3 direction = RandomSteepDirection(rng);
+        glm::vec3 center = glm::vec3(x(rng), y(rng), 0.f);
+        glm::vec3 from = center - 0.5f * length * direction;
+        glm::vec3 to = center + 0.5f * length * direction;
+        ParticleSweepHit hit;
+        QVERIFY(SweepParticlePlane(from, to, PARTICLE_RADIUS, width, height, hit));
+        VerifyHit(hit, from, to);
+        if (QTest::currentTestFailed()) return;
+        // On the face the particle came from
+        QCOMPARE(hit.normal.z, from.z > 0.f ? 1.f : -1.f);
+        QVERIFY(std::abs(hit.point.z - hit.normal.z * PARTICLE_RADIUS) < Tolerance(length));
+    }
+}
+
+void TestParticleCollision::CylinderStopsLongSteps() {
+    QFETCH(float, length);
+    const float cylinder_radius = 0.5f, height = 2.f;
+    const float r = cylinder_radius + PARTICLE_RADIUS;
+    const float h = height / 2.f + PARTICLE_RADIUS;
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> offset(-0.5f * cylinder_radius, 0.5f * cylinder_radius);
+
+    for (int i = 0; i < PATHS; i++) {
+        // Every few paths run along the axis, to come in through a cap
+        glm::vec3 direction = i % 4 == 0 ? glm::vec3(0.f, i % 8 == 0 ? 1.f : -1.f, 0.f) : RandomDirection(rng);
+        glm::vec3 center = glm::vec3(offset(rng), offset(rng), offset(rng));
+        glm::vec3 from = center - 0.5f * length * direction;
+        glm::vec3 to = center + 0.5f * length * direction;
+        ParticleSweepHit hit;
+        QVERIFY(SweepParticleCylinder(from, to, PARTICLE_RADIUS, cylinder_radius, height, hit));
+        VerifyHit(hit, from, to);
+        if (QTest::currentTestFailed()) return;
+        // On the side or a cap, and within the other
+        float tolerance = Tolerance(length);
+        float radial = glm::length(glm::vec2(hit.point.x, hit.point.z));
+        bool on_side = std::abs(radial - r) < tolerance && std::abs(hit.point.y) < h + tolerance;
+        bool on_cap = std::abs(std::abs(hit.point.y) - h) < tolerance && radial < r + tolerance;
+        QVERIFY(on_side || on_cap);
+    }
+}
+
+void TestParticleCollision::TriangleStopsLongSteps() {
+    QFETCH(float, length);
+    // One face of a mesh collider, tilted out of every axis plane
+    glm::mat4 tilt = glm::rotate(glm::mat4(1.f), 0.7f, glm::normalize(glm::vec3(1.f, 2.f, 0.5f)));
+    glm::vec3 a = glm::vec3(tilt * glm::vec4(-1.f, -1.f, 0.f, 1.f));
+    glm::vec3 b = glm::vec3(tilt * glm::vec4(1.f, -1.f, 0.f, 1.f));
+    glm::vec3 c = glm::vec3(tilt * glm::vec4(0.f, 1.f, 0.f, 1.f));
+    glm::vec3 normal = glm::vec3(tilt * glm::vec4(0.f, 0.f, 1.f, 0.f));
+    std::mt19937 rng(4);
+    std::uniform_real_distribution<float> weight(0.3f, 1.f);
+
+    for (int i = 0; i < PATHS; i++) {
+        glm::vec3 direction = glm::vec3(tilt * glm::vec4(RandomSteepDirection(rng), 0.f));
+        // A point well inside the triangle, so the particle touches it inside the edges too
+        glm::vec3 weights = glm::vec3(weight(rng), weight(rng), weight(rng));
+        weights /= weights.x + weights.y + weights.z;
+        glm::vec3 center = weights.x * a + weights.y * b + weights.z * c;
+        glm::vec3 from = center - 0.5f * length * direction;
+        glm::vec3 to = center + 0.5f * length * direction;
+        ParticleSweepHit hit;
+        QVERIFY(SweepParticleTriangle(from, to, PARTICLE_RADIUS, a, b, c, hit));
+        VerifyHit(hit, from, to);
+        if (QTest::currentTestFailed()) return;
+        float side = glm::dot(from - a, normal) > 0.f ? 1.f : -1.f;
+        QVERIFY(glm::distance(hit.normal, side * normal) < 1e-4f);
+        QVERIFY(std::abs(glm::dot(hit.point - a, normal) - side * PARTICLE_RADIUS) < Tolerance(length));
+    }
+}
+
+void TestParticleCollision::TreeFindsFirstTriangle() {
+    // A cloud of small triangles, swept through by steps short and long
+    const int triangles = 2000;
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> coordinate(-4.f, 4.f);
+    std::uniform_real_distribution<float> corner_offset(-0.3f, 0.3f);
+    std::uniform_real_distribution<float> length(0.1f, 20.f);
+    std::vector<glm::vec3> corners;
+    std::vector<BoundingBox> bounds;
+    for (int i = 0; i < triangles; i++) {
+        glm::vec3 center(coordinate(rng), coordinate(rng), coordinate(rng));
+        BoundingBox box(glm::vec3(std::numeric_limits<float>::max()), glm::vec3(-std::numeric_limits<float>::max()));
+        for (int k = 0; k < 3; k++) {
+            glm::vec3 corner = center + glm::vec3(corner_offset(rng), corner_offset(rng), corner_offset(rng));
+            corners.push_back(corner);
+            box.min = glm::min(box.min, corner);
+            box.max = glm::max(box.max, corner);
+        }
+        bounds.push_back(box);
+    }
+    BVH tree;
+    tree.Build(bounds);
+
+    int hits = 0;
+    for (int i = 0; i < PATHS; i++) {
+        glm::vec3 from(coordinate(rng), coordinate(rng), coordinate(rng));
+        glm::vec3 to = from + length(rng) * RandomDirection(rng);
+        ParticleSweepHit expected, hit;
+        bool expected_found = false;
+        for (int t = 0; t < triangles; t++) {
+            if (SweepParticleTriangle(from, to, PARTICLE_RADIUS, corners[3 * t], corners[3 * t + 1], corners[3 * t + 2], hit) &&
+                    (!expected_found || hit.t < expected.t)) {
+                expected = hit;
+                expected_found = true;
+            }
+        }
+        ParticleSweepHit found_hit;
+        bool found = tree.Sweep(from, to, PARTICLE_RADIUS, [&](uint32_t t, float& closest) {
+            if (!SweepParticleTriangle(from, to, PARTICLE_RADIUS, corners[3 * t], corners[3 * t + 1], corners[3 * t + 2], hit) ||
+                    hit.t >= closest) {
+                return false;
+            }
+            found_hit = hit;
+            closest = hit.t;
+            return true;
+        });
+        QCOMPARE(found, expected_found);
+        if (found) {
+            QCOMPARE(found_hit.t, expected.t);
+            hits++;
+        }
+    }
+    // Enough of the paths hit something for this to mean anything
+    QVERIFY(hits > PATHS / 4);
+}
+
+QTEST_APPLESS_MAIN(TestParticleCollision)
+
+#include "tst_particlecollision.moc"
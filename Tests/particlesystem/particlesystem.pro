@@ -0,0 +1,5 @@
+include(../tests.pri)
+
+TARGET = tst_particlesystem
+
+SOURCES += tst_particlesystem.cpp
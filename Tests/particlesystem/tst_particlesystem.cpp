@@ -0,0 +1,139 @@
+#include <components.h>
+#include <QtTest>
+#include <algorithm>
+#include <random>
+
+class TestParticleSystem : public QObject {
+    Q_OBJECT
+
+private slots:
+    void ReplayDoesNotDependOnThreads();
+    void SpatialHashFindsEveryNeighbor();
+    void SpatialHashFindsEveryNeighbor_data();
+    void UpdateMillionParticles();
+    void UpdateMillionParticles_data();
+};
+
+namespace {
+
+// A sprinkler turning about Y, emitting a few particles every step, that bump into each other as they fall
+void RunSprinkler(ParticleSystem& system, int threads, int steps) {
+    system.SetMaxThreads(threads);
+    system.Period.Set(0.0);
+    system.ParticlesPerPeriod.Set(4);
+    system.MaxParticles.Set(20000);
+    system.DragF.Set(0.5);
+    system.CollisionRadius.Set(0.05);
+    system.ParticleCollisions.Set(true);
+    system.StartSimulation();
+    std::vector<std::pair<SceneObject*, glm::mat4>> colliders;
+    for (int step = 0; step < steps; step++) {
+        system.UpdateModelMatrix(glm::rotate(glm::mat4(1.f), 0.37f * step, glm::vec3(0.f, 1.f, 0.f)));
+        system.UpdateSimulation(0.01f, colliders);
+    }
+}
+
+}
+
+void TestParticleSystem::ReplayDoesNotDependOnThreads() {
+    // Enough steps to fill the ring and wrap, with the live range split into chunks for the pool
+    const int steps = 6000;
+    ParticleSystem single, pooled;
+    RunSprinkler(single, 1, steps);
+    RunSprinkler(pooled, std::max(2, QThread::idealThreadCount()), steps);
+
+    const ParticleBuffer& a = single.GetParticles();
+    const ParticleBuffer& b = pooled.GetParticles();
+    QCOMPARE(a.Count(), size_t(20000));
+    QCOMPARE(b.Count(), a.Count());
+    // Exactly the same, not just close
+    for (size_t i = 0; i < a.Count(); i++) {
+        size_t slot = a.Slot(i);
+        QCOMPARE(b.Slot(i), slot);
+        QVERIFY(a.position[slot] == b.position[slot]);
+        QVERIFY(a.previous_position[slot] == b.previous_position[slot]);
+        QVERIFY(a.velocity[slot] == b.velocity[slot]);
+        QVERIFY(a.age[slot] == b.age[slot]);
+    }
+}
+
+void TestParticleSystem::SpatialHashFindsEveryNeighbor_data() {
+    QTest::addColumn<int>("capacity");
+    QTest::addColumn<int>("emitted");
+    QTest::addColumn<float>("extent");
+    QTest::addColumn<float>("cell_size");
+
+    QTest::newRow("dense") << 2000 << 2000 << 2.f << 0.1f;
+    QTest::newRow("sparse") << 2000 << 2000 << 50.f << 0.5f;
+    QTest::newRow("wrapped ring") << 1500 << 2600 << 4.f << 0.2f;
+    QTest::newRow("single") << 1 << 1 << 1.f << 0.1f;
+}
+
+void TestParticleSystem::SpatialHashFindsEveryNeighbor() {
+    QFETCH(int, capacity);
+    QFETCH(int, emitted);
+    QFETCH(float, extent);
+    QFETCH(float, cell_size);
+
+    // Positions around the origin, so cells have negative coordinates too
+    std::mt19937 rng(457);
+    std::uniform_real_distribution<float> coordinate(-extent, extent);
+    ParticleBuffer particles;
+    particles.Reset(capacity);
+    for (int i = 0; i < emitted; i++) {
+        size_t slot = particles.Emit();
+        particles.position[slot] = glm::vec3(coordinate(rng), coordinate(rng), coordinate(rng));
+    }
+    ParticleSpatialHash hash;
+    hash.Build(particles, cell_size);
+
+    // Whatever is within a cell of a particle has to be among the ones the hash visits
+    for (size_t i = 0; i < particles.Count(); i++) {
+        glm::vec3 point = particles.position[particles.Slot(i)];
+        std::vector<uint32_t> near;
+        hash.ForEachNear(point, [&](uint32_t slot) {
+            if (glm::distance(point, particles.position[slot]) < cell_size) near.push_back(slot);
+        });
+        std::vector<uint32_t> expected;
+        for (size_t j = 0; j < particles.Count(); j++) {
+            size_t slot = particles.Slot(j);
+            if (glm::distance(point, particles.position[slot]) < cell_size) expected.push_back((uint32_t)slot);
+        }
+        std::sort(near.begin(), near.end());
+        std::sort(expected.begin(), expected.end());
+        QVERIFY(std::adjacent_find(near.begin(), near.end()) == near.end());
+        QVERIFY(near == expected);
+    }
+}
+
+void TestParticleSystem::UpdateMillionParticles_data() {
+    QTest::addColumn<int>("threads");
+
+    QTest::newRow("single") << 1;
+    QTest::newRow("pooled") << std::max(2, QThread::idealThreadCount());
+}
+
+void TestParticleSystem::UpdateMillionParticles() {
+    QFETCH(int, threads);
+    const int particles = 1000000;
+
+    // All emitted in one burst, then only integrated, particle collisions would have them all in one cell
+    ParticleSystem system;
+    system.SetMaxThreads(threads);
+    system.Period.Set(1.0);
+    system.ParticlesPerPeriod.Set(particles);
+    system.MaxParticles.Set(particles);
+    system.DragF.Set(0.5);
+    system.StartSimulation();
+    std::vector<std::pair<SceneObject*, glm::mat4>> colliders;
+    system.UpdateSimulation(1.f, colliders);
+    QCOMPARE(system.GetParticles().Count(), size_t(particles));
+
+    QBENCHMARK {
+        system.UpdateSimulation(0.001f, colliders);
+    }
+}
+
+QTEST_APPLESS_MAIN(TestParticleSystem)
+
+#include "tst_particlesystem.moc"
@@ -0,0 +1,5 @@
+include(../tests.pri)
+
+TARGET = tst_sampler
+
+SOURCES += tst_sampler.cpp
@@ -0,0 +1,111 @@
+#include <components.h>
+#include <scene/components/camera.h>
+#include <trace/randomsampler.h>
+#include <QtTest>
+#include <cmath>
+
+// Render workers keep one sampler and restart it per pixel, which must not change the estimates
+class TestSampler : public QObject {
+    Q_OBJECT
+
+private slots:
+    void ReusedMatchesFresh();
+    void ReusedMatchesFresh_data() { AddModes(); }
+    void ErrorFallsWithSamples();
+    void ErrorFallsWithSamples_data() { AddModes(); }
+
+private:
+    void AddModes();
+};
+
+namespace {
+
+const int PIXELS = 32;
+const int FULL_SAMPLES = 64;
+const int REDUCED_SAMPLES = 16;
+
+// Smooth integrand over the unit square, its integral is 2 / (3 pi)
+float Integrand(const glm::vec2& p) {
+    return std::sin((float)M_PI * p.x) * p.y * p.y;
+}
+
+const double REFERENCE = 2.0 / (3.0 * M_PI);
+// Standard deviation of the integrand, the error of plain Monte Carlo is this over sqrt(samples)
+const double DEVIATION = std::sqrt(0.1 - REFERENCE * REFERENCE);
+
+// Average of samples integrand values in the pixel, continuing after first_index samples
+double Estimate(Sampler& sampler, int x, int y, int first_index, int samples) {
+    sampler.StartPixel(x, y, first_index);
+    double sum = 0.0;
+    for (int s = 0; s < samples; s++) {
+        sampler.StartNextSample();
+        sum += Integrand(sampler.Get2D());
+    }
+    return sum / samples;
+}
+
+// Root mean square error of the per pixel estimates against the reference
+double RmsError(Sampler& sampler, int samples) {
+    double sum = 0.0;
+    for (int y = 0; y < PIXELS; y++) {
+        for (int x = 0; x < PIXELS; x++) {
+            double error = Estimate(sampler, x, y, 0, samples) - REFERENCE;
+            sum += error * error;
+        }
+    }
+    return std::sqrt(sum / (PIXELS * PIXELS));
+}
+
+}
+
+void TestSampler::AddModes() {
+    QTest::addColumn<int>("mode");
+    // Largest error allowed at the full sample count, relative to plain Monte Carlo's
+    QTest::addColumn<double>("max_ratio");
+
+    QTest::newRow("uniform") << Camera::TRACERANDOM_UNIFORM << 1.2;
+    QTest::newRow("stratified") << Camera::TRACERANDOM_STRATIFIED << 0.5;
+    QTest::newRow("halton") << Camera::TRACERANDOM_HALTON << 0.5;
+    QTest::newRow("sobol") << Camera::TRACERANDOM_SOBOL << 0.5;
+}
+
+void TestSampler::ReusedMatchesFresh() {
+    QFETCH(int, mode);
+    std::unique_ptr<Sampler> reused = Sampler::Create(mode, FULL_SAMPLES);
+    QVERIFY(reused);
+
+    // A first pass at the reduced count, then the rest of the samples as a later pass would take them
+    for (int y = 0; y < PIXELS; y++) {
+        for (int x = 0; x < PIXELS; x++) {
+            std::unique_ptr<Sampler> fresh = Sampler::Create(mode, FULL_SAMPLES);
+            QCOMPARE(Estimate(*reused, x, y, 0, REDUCED_SAMPLES), Estimate(*fresh, x, y, 0, REDUCED_SAMPLES));
+            fresh = Sampler::Create(mode, FULL_SAMPLES);
+            QCOMPARE(Estimate(*reused, x, y, REDUCED_SAMPLES, FULL_SAMPLES - REDUCED_SAMPLES),
+                     Estimate(*fresh, x, y, REDUCED_SAMPLES, FULL_SAMPLES - REDUCED_SAMPLES));
+        }
+    }
+}
+
+void TestSampler::ErrorFallsWithSamples() {
+    QFETCH(int, mode);
+    QFETCH(double, max_ratio);
+    std::unique_ptr<Sampler> sampler = Sampler::Create(mode, FULL_SAMPLES);
+    QVERIFY(sampler);
+
+    double full = RmsError(*sampler, FULL_SAMPLES);
+    double reduced = RmsError(*sampler, REDUCED_SAMPLES);
+    qDebug("%s: rms error %g at %d samples, %g at %d", QTest::currentDataTag(), full, FULL_SAMPLES, reduced, REDUCED_SAMPLES);
+
+    // Neither worse than plain Monte Carlo would be, and a quarter of the samples is clearly worse
+    QVERIFY(full <= max_ratio * DEVIATION / std::sqrt((double)FULL_SAMPLES));
+    QVERIFY(reduced <= 1.2 * DEVIATION / std::sqrt((double)REDUCED_SAMPLES));
+    QVERIFY(reduced > 1.5 * full);
+    // Plain Monte Carlo is also no better than it should be, or the samples aren't independent
+    if (mode == Camera::TRACERANDOM_UNIFORM) {
+        QVERIFY(full >= 0.8 * DEVIATION / std::sqrt((double)FULL_SAMPLES));
+    }
+}
+
+QTEST_APPLESS_MAIN(TestSampler)
+
+#include "tst_sampler.moc"
@@ -0,0 +1,61 @@
+# Settings shared by the test executables, each of which links the engine library like the editor does
+
+QT = core gui testlib
+
+TEMPLATE = app
+OBJECTS_DIR = tmp
+
+CONFIG -= flat app_bundle
+CONFIG += c++14 console testcase force_debug_info
+
+INCLUDEPATH += \
+    "$$PWD/../Engine/src" \
+    "$$PWD/../Libraries" \
+    "$$PWD/../Libraries/signals"
+
+# Depend on AnimatorEngine Library
+win32:CONFIG(release, debug|release): LIBS += -L$$PWD/../Engine/bin -lAnimatorEngine
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$PWD/../Engine/bin -lAnimatorEngined
+else:unix: LIBS += -L$$PWD/../Engine/bin -lEngine
+
+INCLUDEPATH += $$PWD/../Engine/include
+DEPENDPATH += $$PWD/../Engine/include
+
+win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$PWD/../Engine/bin/libAnimatorEngine.a
+else:win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$PWD/../Engine/bin/libAnimatorEngined.a
+else:win32:!win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$PWD/../Engine/bin/AnimatorEngine.lib
+else:win32:!win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$PWD/../Engine/bin/AnimatorEngined.lib
+else:unix: PRE_TARGETDEPS += $$PWD/../Engine/bin/libEngine.a
+
+# Depend on SOIL Library
+win32:CONFIG(release, debug|release): LIBS += -L$$PWD/../Libraries/soil/bin -lSOIL
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$PWD/../Libraries/soil/bin -lSOILd
+else:unix: LIBS += -L$$PWD/../Libraries/soil/bin -lsoil
+
+INCLUDEPATH += $$PWD/../Libraries/soil/include
+
+# Depend on assimp Library
+win32:CONFIG(release, debug|release): LIBS += -L$$PWD/../Libraries/assimp/bin -lassimp
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$PWD/../Libraries/assimp/bin -lassimpd
+else:unix: LIBS += -L$$PWD/../Libraries/assimp/bin -lassimp
+
+INCLUDEPATH += $$PWD/../Libraries/assimp/include
+
+# Depend on GLEW Library
+win32:CONFIG(release, debug|release): LIBS += -L$$PWD/../Libraries/glew-2.0.0/bin -lGLEW
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$PWD/../Libraries/glew-2.0.0/bin -lGLEWd
+else:linux: LIBS += -L$$PWD/../Libraries/glew-2.0.0/bin -lglew-2
+
+INCLUDEPATH += $$PWD/../Libraries/glew-2.0.0/include
+
+# Depend on yaml-cpp Library
+win32:CONFIG(release, debug|release): LIBS += -L$$PWD/../Libraries/yaml-cpp/bin -llibyaml-cppmd
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$PWD/../Libraries/yaml-cpp/bin -llibyaml-cppmdd
+else:unix: LIBS += -L$$PWD/../Libraries/yaml-cpp/bin -lyaml-cpp
+
+INCLUDEPATH += $$PWD/../Libraries/yaml-cpp/include
+
+# Depend on OpenGL
+win32:LIBS += -lopengl32
+linux:LIBS += -lGL
+macx:LIBS += -framework OpenGL -framework CoreFoundation -framework GLUT
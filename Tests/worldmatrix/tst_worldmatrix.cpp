@@ -0,0 +1,96 @@
+#include <components.h>
+#include <scene/sceneobject.h>
+#include <QtTest>
+
+// Cached world matrices have to follow reparenting and ancestors that move, and stay put otherwise
+class TestWorldMatrix : public QObject {
+    Q_OBJECT
+
+private slots:
+    void ReparentingMovesSubtree();
+    void AnimatedParentMovesChild();
+    void UnrelatedChangesKeepCache();
+};
+
+namespace {
+
+glm::vec3 WorldPosition(SceneObject& object) {
+    return glm::vec3(object.GetModelMatrix() * glm::vec4(0.f, 0.f, 0.f, 1.f));
+}
+
+bool Near(const glm::vec3& a, const glm::vec3& b) {
+    return glm::distance(a, b) < 1e-5f;
+}
+
+}
+
+void TestWorldMatrix::ReparentingMovesSubtree() {
+    // Only the first object ever made is a root that can't have a parent, so it isn't used as a child
+    SceneObject root("Root");
+    SceneObject a("A"), b("B"), child("Child"), grandchild("Grandchild");
+    a.SetParent(root);
+    b.SetParent(root);
+    a.GetTransform().Translation.Set(glm::vec3(1.f, 0.f, 0.f));
+    b.GetTransform().Translation.Set(glm::vec3(0.f, 2.f, 0.f));
+    b.GetTransform().Scale.Set(glm::vec3(2.f));
+    child.GetTransform().Translation.Set(glm::vec3(0.f, 0.f, 3.f));
+    grandchild.GetTransform().Translation.Set(glm::vec3(1.f, 0.f, 0.f));
+    child.SetParent(a);
+    grandchild.SetParent(child);
+
+    QVERIFY(Near(WorldPosition(child), glm::vec3(1.f, 0.f, 3.f)));
+    QVERIFY(Near(WorldPosition(grandchild), glm::vec3(2.f, 0.f, 3.f)));
+    uint64_t child_version = child.GetWorldVersion();
+    uint64_t grandchild_version = grandchild.GetWorldVersion();
+
+    // Both were just read, so moving the child has to be noticed through the cache
+    child.SetParent(b);
+    QVERIFY(Near(WorldPosition(child), glm::vec3(0.f, 2.f, 6.f)));
+    QVERIFY(Near(WorldPosition(grandchild), glm::vec3(2.f, 2.f, 6.f)));
+    QVERIFY(child.GetWorldVersion() != child_version);
+    QVERIFY(grandchild.GetWorldVersion() != grandchild_version);
+    QVERIFY(Near(glm::vec3(child.GetInverseModelMatrix() * glm::vec4(0.f, 2.f, 6.f, 1.f)), glm::vec3(0.f)));
+}
+
+void TestWorldMatrix::AnimatedParentMovesChild() {
+    SceneObject root("Root");
+    SceneObject parent("Parent"), child("Child");
+    parent.SetParent(root);
+    child.SetParent(parent);
+    child.GetTransform().Translation.Set(glm::vec3(0.f, 1.f, 0.f));
+
+    // Like an animation turning the parent a bit each frame, reading the child between frames
+    uint64_t previous_version = 0;
+    for (int frame = 0; frame < 10; frame++) {
+        float angle = 10.f * frame;
+        parent.GetTransform().Rotation.Set(glm::vec3(0.f, 0.f, angle));
+        parent.GetTransform().Translation.Set(glm::vec3(0.1f * frame, 0.f, 0.f));
+        float radians = glm::radians(angle);
+        glm::vec3 expected(0.1f * frame - std::sin(radians), std::cos(radians), 0.f);
+        QVERIFY(Near(WorldPosition(child), expected));
+        uint64_t version = child.GetWorldVersion();
+        QVERIFY(version != previous_version);
+        previous_version = version;
+    }
+}
+
+void TestWorldMatrix::UnrelatedChangesKeepCache() {
+    SceneObject root("Root");
+    SceneObject parent("Parent"), child("Child"), other("Other");
+    parent.SetParent(root);
+    child.SetParent(parent);
+    other.SetParent(root);
+    parent.GetTransform().Translation.Set(glm::vec3(0.f, 0.f, 5.f));
+    glm::mat4 model = child.GetModelMatrix();
+    uint64_t version = child.GetWorldVersion();
+
+    // Another branch moving makes the child check its ancestors, but it keeps its matrix and version
+    other.GetTransform().Translation.Set(glm::vec3(3.f, 0.f, 0.f));
+    QVERIFY(child.GetModelMatrix() == model);
+    QCOMPARE(child.GetWorldVersion(), version);
+    QCOMPARE(child.GetWorldVersion(), version);
+}
+
+QTEST_APPLESS_MAIN(TestWorldMatrix)
+
+#include "tst_worldmatrix.moc"
@@ -0,0 +1,5 @@
+include(../tests.pri)
+
+TARGET = tst_worldmatrix
+
+SOURCES += tst_worldmatrix.cpp
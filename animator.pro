@@ -7,7 +7,8 @@ SUBDIRS = \
     sub_assimp \
     sub_yaml \
     sub_engine \
-    sub_editor
+    sub_editor \
+    sub_tests
 
 sub_glew.subdir = Libraries/glew-2.0.0
 sub_soil.subdir = Libraries/soil
@@ -15,5 +16,7 @@ sub_assimp.subdir = Libraries/assimp
 sub_yaml.subdir = Libraries/yaml-cpp
 sub_engine.subdir = Engine
 sub_editor.subdir = Editor
+sub_tests.subdir = Tests
 sub_engine.depends = sub_glew sub_soil sub_yaml sub_assimp
 sub_editor.depends = sub_engine sub_glew sub_soil sub_yaml sub_assimp
+sub_tests.depends = sub_engine sub_glew sub_soil sub_yaml sub_assimp